@@ -4,11 +4,13 @@
 #pragma warning(disable:4800)
 #include "char.hpp"
 
+#include <chrono>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unordered_map>
 
 #include "../common/cbasetypes.hpp"
 #include "../common/cli.hpp"
@@ -35,6 +37,7 @@
 #include "int_mercenary.hpp"
 #include "int_party.hpp"
 #include "int_storage.hpp"
+#include "inter_sqlpool.hpp"
 
 //definition of exported var declared in header
 int login_fd=-1; //login file descriptor
@@ -70,6 +73,8 @@ int subnet_count = 0;
 DBMap* auth_db; // uint32 account_id -> struct auth_node*
 DBMap* online_char_db; // uint32 account_id -> struct online_char_data*
 DBMap* char_db_; // uint32 char_id -> struct mmo_charstatus*
+static std::unordered_map<uint32, uint32> char_save_failed; // char_id -> sections that failed to save, added to the next save
+static std::unordered_map<uint32, uint32> char_save_seq; // char_id -> number of the map-server save the cached status matches
 DBMap* char_get_authdb() { return auth_db; }
 DBMap* char_get_onlinedb() { return online_char_db; }
 DBMap* char_get_chardb() { return char_db_; }
@@ -161,6 +166,8 @@ void char_set_char_offline(uint32 char_id, uint32 account_id){
 		inter_guild_CharOffline(char_id, cp?cp->guild_id:-1);
 		if (cp)
 			idb_remove(char_db_,char_id);
+		char_save_failed.erase(char_id);
+		char_save_seq.erase(char_id);
 
 		if( SQL_ERROR == Sql_Query(sql_handle, "UPDATE `%s` SET `online`='0' WHERE `char_id`='%d' LIMIT 1", schema_config.char_db, char_id) )
 			Sql_ShowDebug(sql_handle);
@@ -264,23 +271,30 @@ DBData char_create_charstatus(DBKey key, va_list args) {
 	return db_ptr2data(cp);
 }
 
-int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
+int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p, uint32 sections){
 	int i = 0;
 	int count = 0;
 	int diff = 0;
 	char save_status[128]; //For displaying save information. [Skotlex]
 	struct mmo_charstatus *cp;
 	int errors = 0; //If there are any errors while saving, "cp" will not be updated at the end.
+	uint32 failed = 0; // sections with errors, retried with the next save
 	StringBuf buf;
 
 	if (char_id!=p->char_id) return 0;
 
 	cp = (struct mmo_charstatus *)idb_ensure(char_db_, char_id, char_create_charstatus);
 
+	auto retry = char_save_failed.find(char_id);
+	if (retry != char_save_failed.end()) {
+		sections |= retry->second;
+		char_save_failed.erase(retry);
+	}
+
 	StringBuf_Init(&buf);
 	memset(save_status, 0, sizeof(save_status));
 
-	if (
+	if ( (sections&SAVESECTION_STATUS) && (
 		(p->base_exp != cp->base_exp) || (p->base_level != cp->base_level) ||
 		(p->job_level != cp->job_level) || (p->job_exp != cp->job_exp) ||
 		(p->zeny != cp->zeny) ||
@@ -300,7 +314,7 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 		(p->unban_time != cp->unban_time) || (p->font != cp->font) || (p->uniqueitem_counter != cp->uniqueitem_counter) ||
 		(p->hotkey_rowshift != cp->hotkey_rowshift) || (p->clan_id != cp->clan_id ) || (p->title_id != cp->title_id) ||
 		(p->show_equip != cp->show_equip) || (p->hotkey_rowshift2 != cp->hotkey_rowshift2)
-	)
+	) )
 	{	//Save status
 		if( SQL_ERROR == Sql_Query(sql_handle, "UPDATE `%s` SET `base_level`='%d', `job_level`='%d',"
 			"`base_exp`='%" PRIu64 "', `job_exp`='%" PRIu64 "', `zeny`='%d',"
@@ -327,19 +341,20 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 		{
 			Sql_ShowDebug(sql_handle);
 			errors++;
+			failed |= SAVESECTION_STATUS;
 		} else
 			strcat(save_status, " status");
 	}
 
 	//Values that will seldom change (to speed up saving)
-	if (
+	if ( (sections&SAVESECTION_STATUS) && (
 		(p->hair != cp->hair) || (p->hair_color != cp->hair_color) || (p->clothes_color != cp->clothes_color) ||
 		(p->body != cp->body) || (p->class_ != cp->class_) ||
 		(p->partner_id != cp->partner_id) || (p->father != cp->father) ||
 		(p->mother != cp->mother) || (p->child != cp->child) ||
  		(p->karma != cp->karma) || (p->manner != cp->manner) ||
 		(p->fame != cp->fame)
-	)
+	) )
 	{
 		if( SQL_ERROR == Sql_Query(sql_handle, "UPDATE `%s` SET `class`='%d',"
 			"`hair`='%d', `hair_color`='%d', `clothes_color`='%d', `body`='%d',"
@@ -354,24 +369,27 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 		{
 			Sql_ShowDebug(sql_handle);
 			errors++;
+			failed |= SAVESECTION_STATUS;
 		} else
 			strcat(save_status, " status2");
 	}
 
 	/* Mercenary Owner */
-	if( (p->mer_id != cp->mer_id) ||
+	if( (sections&SAVESECTION_STATUS) && ( (p->mer_id != cp->mer_id) ||
 		(p->arch_calls != cp->arch_calls) || (p->arch_faith != cp->arch_faith) ||
 		(p->spear_calls != cp->spear_calls) || (p->spear_faith != cp->spear_faith) ||
-		(p->sword_calls != cp->sword_calls) || (p->sword_faith != cp->sword_faith) )
+		(p->sword_calls != cp->sword_calls) || (p->sword_faith != cp->sword_faith) ) )
 	{
 		if (mercenary_owner_tosql(char_id, p))
 			strcat(save_status, " mercenary");
-		else
+		else {
 			errors++;
+			failed |= SAVESECTION_STATUS;
+		}
 	}
 
 	//memo points
-	if( memcmp(p->memo_point, cp->memo_point, sizeof(p->memo_point)) )
+	if( (sections&SAVESECTION_MEMO) && memcmp(p->memo_point, cp->memo_point, sizeof(p->memo_point)) )
 	{
 		char esc_mapname[NAME_LENGTH*2+1];
 
@@ -380,6 +398,7 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 		{
 			Sql_ShowDebug(sql_handle);
 			errors++;
+			failed |= SAVESECTION_MEMO;
 		}
 
 		//insert here.
@@ -402,19 +421,21 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 			{
 				Sql_ShowDebug(sql_handle);
 				errors++;
+				failed |= SAVESECTION_MEMO;
 			}
 		}
 		strcat(save_status, " memo");
 	}
 
 	//skills
-	if( memcmp(p->skill, cp->skill, sizeof(p->skill)) )
+	if( (sections&SAVESECTION_SKILLS) && memcmp(p->skill, cp->skill, sizeof(p->skill)) )
 	{
 		//`skill` (`char_id`, `id`, `lv`)
 		if( SQL_ERROR == Sql_Query(sql_handle, "DELETE FROM `%s` WHERE `char_id`='%d'", schema_config.skill_db, p->char_id) )
 		{
 			Sql_ShowDebug(sql_handle);
 			errors++;
+			failed |= SAVESECTION_SKILLS;
 		}
 
 		StringBuf_Clear(&buf);
@@ -441,6 +462,7 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 			{
 				Sql_ShowDebug(sql_handle);
 				errors++;
+				failed |= SAVESECTION_SKILLS;
 			}
 		}
 
@@ -448,7 +470,7 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 	}
 
 	diff = 0;
-	for(i = 0; i < MAX_FRIENDS; i++){
+	for(i = 0; (sections&SAVESECTION_FRIENDS) && i < MAX_FRIENDS; i++){
 		if(p->friends[i].char_id != cp->friends[i].char_id ||
 			p->friends[i].account_id != cp->friends[i].account_id){
 			diff = 1;
@@ -462,6 +484,7 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 		{
 			Sql_ShowDebug(sql_handle);
 			errors++;
+			failed |= SAVESECTION_FRIENDS;
 		}
 
 		StringBuf_Clear(&buf);
@@ -482,6 +505,7 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 			{
 				Sql_ShowDebug(sql_handle);
 				errors++;
+				failed |= SAVESECTION_FRIENDS;
 			}
 		}
 		strcat(save_status, " friends");
@@ -492,7 +516,7 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 	StringBuf_Clear(&buf);
 	StringBuf_Printf(&buf, "REPLACE INTO `%s` (`char_id`, `hotkey`, `type`, `itemskill_id`, `skill_lvl`) VALUES ", schema_config.hotkey_db);
 	diff = 0;
-	for(i = 0; i < ARRAYLENGTH(p->hotkeys); i++){
+	for(i = 0; (sections&SAVESECTION_HOTKEYS) && i < ARRAYLENGTH(p->hotkeys); i++){
 		if(memcmp(&p->hotkeys[i], &cp->hotkeys[i], sizeof(struct hotkey)))
 		{
 			if( diff )
@@ -506,6 +530,7 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 		{
 			Sql_ShowDebug(sql_handle);
 			errors++;
+			failed |= SAVESECTION_HOTKEYS;
 		} else
 			strcat(save_status, " hotkeys");
 	}
@@ -513,75 +538,123 @@ int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 	StringBuf_Destroy(&buf);
 	if (save_status[0]!='\0' && charserv_config.save_log)
 		ShowInfo("Saved char %d - %s:%s.\n", char_id, p->name, save_status);
+	if (failed)
+		char_save_failed[char_id] = failed;
 	if (!errors)
 		memcpy(cp, p, sizeof(struct mmo_charstatus));
-	return 0;
+	return errors;
 }
 
-/// Saves an array of 'item' entries into the specified table.
-int char_memitemdata_to_sql(const struct item items[], int max, int id, enum storage_type tableswitch, uint8 stor_id) {
-	StringBuf buf;
+/// Saves a character received from a map-server and remembers which save the cache now matches.
+/// @param seq: number of the save, base of the next delta
+void char_mmo_char_save(uint32 char_id, struct mmo_charstatus* p, uint32 sections, uint32 seq) {
+	if( char_mmo_char_tosql(char_id, p, sections) == 0 )
+		char_save_seq[char_id] = seq;
+	else
+		char_save_seq.erase(char_id); // the cache is older than the save
+}
+
+/// Saves a character received as the bytes that changed since one of its previous saves.
+/// @param data: ranges of <offset>.W <length>.W <bytes>
+/// @return false if the cached status is not the base of the delta, the complete character is needed
+bool char_mmo_char_save_delta(uint32 char_id, uint32 sections, uint32 base_seq, uint32 seq, const uint8* data, size_t len) {
+	struct mmo_charstatus* cp = (struct mmo_charstatus*)idb_get(char_db_, char_id);
+	struct mmo_charstatus status;
+	auto base = char_save_seq.find(char_id);
+
+	if( cp == NULL || base == char_save_seq.end() || base->second != base_seq )
+		return false;
+
+	memcpy(&status, cp, sizeof(struct mmo_charstatus));
+	for( size_t i = 0; i < len; ) {
+		size_t offset, length;
+
+		if( i + 4 > len )
+			return false;
+		offset = RBUFW(data,i);
+		length = RBUFW(data,i+2);
+		i += 4;
+		if( i + length > len || offset + length > sizeof(struct mmo_charstatus) ) {
+			ShowError("char_mmo_char_save_delta: Invalid range %" PRIuPTR "+%" PRIuPTR " for character %d.\n", offset, length, char_id);
+			return false;
+		}
+		memcpy((uint8*)&status + offset, data + i, length);
+		i += length;
+	}
+
+	char_mmo_char_save(char_id, &status, sections, seq);
+	return true;
+}
+
+/// Appends the item columns of a storage table, without the id and owner columns
+static void char_memitemdata_columns(StringBuf* buf, enum storage_type tableswitch) {
+	int j;
+
+	StringBuf_AppendStr(buf, "`nameid`, `amount`, `equip`, `identify`, `refine`, `attribute`, `expire_time`, `bound`, `unique_id`, `enchantgrade`");
+	if (tableswitch == TABLE_INVENTORY)
+		StringBuf_AppendStr(buf, ", `favorite`, `equip_switch`");
+	for( j = 0; j < MAX_SLOTS; ++j )
+		StringBuf_Printf(buf, ", `card%d`", j);
+	for( j = 0; j < MAX_ITEM_RDM_OPT; ++j ) {
+		StringBuf_Printf(buf, ", `option_id%d`", j);
+		StringBuf_Printf(buf, ", `option_val%d`", j);
+		StringBuf_Printf(buf, ", `option_parm%d`", j);
+	}
+}
+
+/// Appends the values of an item, in the order of char_memitemdata_columns
+static void char_memitemdata_values(StringBuf* buf, const struct item* it, enum storage_type tableswitch) {
+	int j;
+
+	StringBuf_Printf(buf, "'%u', '%d', '%u', '%d', '%d', '%d', '%u', '%d', '%" PRIu64 "', '%d'",
+		it->nameid, it->amount, it->equip, it->identify, it->refine, it->attribute, it->expire_time, it->bound, it->unique_id, it->enchantgrade);
+	if (tableswitch == TABLE_INVENTORY)
+		StringBuf_Printf(buf, ", '%d', '%u'", it->favorite, it->equipSwitch);
+	for( j = 0; j < MAX_SLOTS; ++j )
+		StringBuf_Printf(buf, ", '%u'", it->card[j]);
+	for( j = 0; j < MAX_ITEM_RDM_OPT; ++j ) {
+		StringBuf_Printf(buf, ", '%d'", it->option[j].id);
+		StringBuf_Printf(buf, ", '%d'", it->option[j].value);
+		StringBuf_Printf(buf, ", '%d'", it->option[j].param);
+	}
+}
+
+/// Saves an array of 'item' entries into a table.
+/// With 'batch' the changed and new rows are written by a single INSERT ... ON DUPLICATE KEY UPDATE
+/// and the removed rows by a single DELETE, otherwise every row gets its own statement.
+/// @param queries: incremented by the number of statements sent
+static int char_memitemdata_save(const struct item items[], int max, int id, enum storage_type tableswitch, const char* tablename, const char* selectoption, bool batch, int* queries) {
+	StringBuf buf, upsert, remove;
 	SqlStmt* stmt;
-	int i, j, offset = 0, errors = 0;
-	const char *tablename, *selectoption, *printname;
+	int i, j, offset = 0, errors = 0, upserts = 0, removes = 0;
 	struct item item; // temp storage variable
 	bool* flag; // bit array for inventory matching
 	bool found;
 
-	switch (tableswitch) {
-		case TABLE_INVENTORY:
-			printname = "Inventory";
-			tablename = schema_config.inventory_db;
-			selectoption = "char_id";
-			break;
-		case TABLE_CART:
-			printname = "Cart";
-			tablename = schema_config.cart_db;
-			selectoption = "char_id";
-			break;
-		case TABLE_STORAGE:
-			printname = inter_premiumStorage_getPrintableName(stor_id);
-			tablename = inter_premiumStorage_getTableName(stor_id);
-			selectoption = "account_id";
-			break;
-		case TABLE_GUILD_STORAGE:
-			printname = "Guild Storage";
-			tablename = schema_config.guild_storage_db;
-			selectoption = "guild_id";
-			break;
-		default:
-			ShowError("Invalid table name!\n");
-			return 1;
-	}
-
 	// The following code compares inventory with current database values
 	// and performs modification/deletion/insertion only on relevant rows.
 	// This approach is more complicated than a trivial delete&insert, but
 	// it significantly reduces cpu load on the database server.
 
 	StringBuf_Init(&buf);
-	StringBuf_AppendStr(&buf, "SELECT `id`, `nameid`, `amount`, `equip`, `identify`, `refine`, `attribute`, `expire_time`, `bound`, `unique_id`, `enchantgrade`");
-	if (tableswitch == TABLE_INVENTORY) {
-		StringBuf_Printf(&buf, ", `favorite`, `equip_switch`");
+	StringBuf_Init(&upsert);
+	StringBuf_Init(&remove);
+	StringBuf_AppendStr(&buf, "SELECT `id`, ");
+	char_memitemdata_columns(&buf, tableswitch);
+	if (tableswitch == TABLE_INVENTORY)
 		offset = 2;
-	}
-
-	for( i = 0; i < MAX_SLOTS; ++i )
-		StringBuf_Printf(&buf, ", `card%d`", i);
-	for( i = 0; i < MAX_ITEM_RDM_OPT; ++i ) {
-		StringBuf_Printf(&buf, ", `option_id%d`", i);
-		StringBuf_Printf(&buf, ", `option_val%d`", i);
-		StringBuf_Printf(&buf, ", `option_parm%d`", i);
-	}
 	StringBuf_Printf(&buf, " FROM `%s` WHERE `%s`='%d'", tablename, selectoption, id);
 
 	stmt = SqlStmt_Malloc(sql_handle);
+	(*queries)++;
 	if( SQL_ERROR == SqlStmt_PrepareStr(stmt, StringBuf_Value(&buf))
 	||  SQL_ERROR == SqlStmt_Execute(stmt) )
 	{
 		SqlStmt_ShowDebug(stmt);
 		SqlStmt_Free(stmt);
 		StringBuf_Destroy(&buf);
+		StringBuf_Destroy(&upsert);
+		StringBuf_Destroy(&remove);
 		return 1;
 	}
 
@@ -643,6 +716,12 @@ int char_memitemdata_to_sql(const struct item items[], int max, int id, enum sto
 					items[i].enchantgrade == item.enchantgrade &&
 					(tableswitch != TABLE_INVENTORY || (items[i].favorite == item.favorite && items[i].equipSwitch == item.equipSwitch)) )
 				;	//Do nothing.
+				else if( batch )
+				{// overwrite the row by its id
+					StringBuf_Printf(&upsert, "%s('%d', '%d', ", upserts++ ? "," : "", item.id, id);
+					char_memitemdata_values(&upsert, &items[i], tableswitch);
+					StringBuf_AppendStr(&upsert, ")");
+				}
 				else
 				{
 					// update all fields.
@@ -660,6 +739,7 @@ int char_memitemdata_to_sql(const struct item items[], int max, int id, enum sto
 					}
 					StringBuf_Printf(&buf, " WHERE `id`='%d' LIMIT 1", item.id);
 
+					(*queries)++;
 					if( SQL_ERROR == Sql_QueryStr(sql_handle, StringBuf_Value(&buf)) )
 					{
 						Sql_ShowDebug(sql_handle);
@@ -673,29 +753,31 @@ int char_memitemdata_to_sql(const struct item items[], int max, int id, enum sto
 		}
 		if( !found )
 		{// Item not present in inventory, remove it.
-			if( SQL_ERROR == Sql_Query(sql_handle, "DELETE from `%s` where `id`='%d' LIMIT 1", tablename, item.id) )
+			if( batch )
+				StringBuf_Printf(&remove, "%s'%d'", removes++ ? "," : "", item.id);
+			else
 			{
-				Sql_ShowDebug(sql_handle);
-				errors++;
+				(*queries)++;
+				if( SQL_ERROR == Sql_Query(sql_handle, "DELETE from `%s` where `id`='%d' LIMIT 1", tablename, item.id) )
+				{
+					Sql_ShowDebug(sql_handle);
+					errors++;
+				}
 			}
 		}
 	}
 	SqlStmt_Free(stmt);
 
-	StringBuf_Clear(&buf);
-	StringBuf_Printf(&buf, "INSERT INTO `%s`(`%s`, `nameid`, `amount`, `equip`, `identify`, `refine`, `attribute`, `expire_time`, `bound`, `unique_id`, `enchantgrade`", tablename, selectoption);
-	if (tableswitch == TABLE_INVENTORY)
-		StringBuf_Printf(&buf, ", `favorite`, `equip_switch`");
-	for( j = 0; j < MAX_SLOTS; ++j )
-		StringBuf_Printf(&buf, ", `card%d`", j);
-	for( j = 0; j < MAX_ITEM_RDM_OPT; ++j ) {
-		StringBuf_Printf(&buf, ", `option_id%d`", j);
-		StringBuf_Printf(&buf, ", `option_val%d`", j);
-		StringBuf_Printf(&buf, ", `option_parm%d`", j);
+	if( removes > 0 )
+	{
+		(*queries)++;
+		if( SQL_ERROR == Sql_Query(sql_handle, "DELETE FROM `%s` WHERE `id` IN (%s)", tablename, StringBuf_Value(&remove)) )
+		{
+			Sql_ShowDebug(sql_handle);
+			errors++;
+		}
 	}
-	StringBuf_AppendStr(&buf, ") VALUES ");
 
-	found = false;
 	// insert non-matched items into the db as new items
 	for( i = 0; i < max; ++i )
 	{
@@ -703,150 +785,294 @@ int char_memitemdata_to_sql(const struct item items[], int max, int id, enum sto
 		if( items[i].nameid == 0 || flag[i] )
 			continue;
 
-		if( found )
-			StringBuf_AppendStr(&buf, ",");
-		else
-			found = true;
-
-		StringBuf_Printf(&buf, "('%d', '%u', '%d', '%u', '%d', '%d', '%d', '%u', '%d', '%" PRIu64 "', '%d'",
-			id, items[i].nameid, items[i].amount, items[i].equip, items[i].identify, items[i].refine, items[i].attribute, items[i].expire_time, items[i].bound, items[i].unique_id, items[i].enchantgrade);
-		if (tableswitch == TABLE_INVENTORY)
-			StringBuf_Printf(&buf, ", '%d', '%u'", items[i].favorite, items[i].equipSwitch);
-		for( j = 0; j < MAX_SLOTS; ++j )
-			StringBuf_Printf(&buf, ", '%u'", items[i].card[j]);
-		for( j = 0; j < MAX_ITEM_RDM_OPT; ++j ) {
-			StringBuf_Printf(&buf, ", '%d'", items[i].option[j].id);
-			StringBuf_Printf(&buf, ", '%d'", items[i].option[j].value);
-			StringBuf_Printf(&buf, ", '%d'", items[i].option[j].param);
-		}
-		StringBuf_AppendStr(&buf, ")");
+		// a NULL id gets the next auto increment value
+		StringBuf_Printf(&upsert, "%s(%s'%d', ", upserts++ ? "," : "", batch ? "NULL, " : "", id);
+		char_memitemdata_values(&upsert, &items[i], tableswitch);
+		StringBuf_AppendStr(&upsert, ")");
 	}
 
-	if( found && SQL_ERROR == Sql_QueryStr(sql_handle, StringBuf_Value(&buf)) )
+	if( upserts > 0 )
 	{
-		Sql_ShowDebug(sql_handle);
-		errors++;
+		StringBuf_Clear(&buf);
+		StringBuf_Printf(&buf, "INSERT INTO `%s`(%s`%s`, ", tablename, batch ? "`id`, " : "", selectoption);
+		char_memitemdata_columns(&buf, tableswitch);
+		StringBuf_AppendStr(&buf, ") VALUES ");
+		StringBuf_AppendStr(&buf, StringBuf_Value(&upsert));
+		if( batch )
+		{
+			StringBuf_AppendStr(&buf, " ON DUPLICATE KEY UPDATE `nameid`=VALUES(`nameid`), `amount`=VALUES(`amount`), `equip`=VALUES(`equip`), `identify`=VALUES(`identify`), `refine`=VALUES(`refine`), `attribute`=VALUES(`attribute`), `expire_time`=VALUES(`expire_time`), `bound`=VALUES(`bound`), `unique_id`=VALUES(`unique_id`), `enchantgrade`=VALUES(`enchantgrade`)");
+			if (tableswitch == TABLE_INVENTORY)
+				StringBuf_AppendStr(&buf, ", `favorite`=VALUES(`favorite`), `equip_switch`=VALUES(`equip_switch`)");
+			for( j = 0; j < MAX_SLOTS; ++j )
+				StringBuf_Printf(&buf, ", `card%d`=VALUES(`card%d`)", j, j);
+			for( j = 0; j < MAX_ITEM_RDM_OPT; ++j ) {
+				StringBuf_Printf(&buf, ", `option_id%d`=VALUES(`option_id%d`)", j, j);
+				StringBuf_Printf(&buf, ", `option_val%d`=VALUES(`option_val%d`)", j, j);
+				StringBuf_Printf(&buf, ", `option_parm%d`=VALUES(`option_parm%d`)", j, j);
+			}
+		}
+
+		(*queries)++;
+		if( SQL_ERROR == Sql_QueryStr(sql_handle, StringBuf_Value(&buf)) )
+		{
+			Sql_ShowDebug(sql_handle);
+			errors++;
+		}
 	}
 
-	ShowInfo("Saved %s (%d) data to table %s for %s: %d\n", printname, stor_id, tablename, selectoption, id);
 	StringBuf_Destroy(&buf);
+	StringBuf_Destroy(&upsert);
+	StringBuf_Destroy(&remove);
 	aFree(flag);
 
 	return errors;
 }
 
-bool char_memitemdata_from_sql(struct s_storage* p, int max, int id, enum storage_type tableswitch, uint8 stor_id) {
-	StringBuf buf;
-	SqlStmt* stmt;
-	int i,j, offset = 0, max2;
-	struct item item, *storage;
+/// Saves an array of 'item' entries into the specified table.
+int char_memitemdata_to_sql(const struct item items[], int max, int id, enum storage_type tableswitch, uint8 stor_id) {
 	const char *tablename, *selectoption, *printname;
+	int errors, queries = 0;
 
 	switch (tableswitch) {
 		case TABLE_INVENTORY:
 			printname = "Inventory";
 			tablename = schema_config.inventory_db;
 			selectoption = "char_id";
-			storage = p->u.items_inventory;
-			max2 = MAX_INVENTORY;
 			break;
 		case TABLE_CART:
 			printname = "Cart";
 			tablename = schema_config.cart_db;
 			selectoption = "char_id";
-			storage = p->u.items_cart;
-			max2 = MAX_CART;
 			break;
 		case TABLE_STORAGE:
-			printname = "Storage";
+			printname = inter_premiumStorage_getPrintableName(stor_id);
 			tablename = inter_premiumStorage_getTableName(stor_id);
 			selectoption = "account_id";
-			storage = p->u.items_storage;
-			max2 = inter_premiumStorage_getMax(p->stor_id);
 			break;
 		case TABLE_GUILD_STORAGE:
 			printname = "Guild Storage";
 			tablename = schema_config.guild_storage_db;
 			selectoption = "guild_id";
+			break;
+		default:
+			ShowError("Invalid table name!\n");
+			return 1;
+	}
+
+	errors = char_memitemdata_save(items, max, id, tableswitch, tablename, selectoption, charserv_config.item_save_batch, &queries);
+
+	ShowInfo("Saved %s (%d) data to table %s for %s: %d\n", printname, stor_id, tablename, selectoption, id);
+
+	return errors;
+}
+
+/// Compares the per-row and the batched item save on a synthetic full storage.
+/// Runs on a temporary copy of the storage table, the stored data isn't touched.
+void char_memitemdata_benchmark(int rounds) {
+	const char* tablename = "storage_benchmark";
+	struct item* items = (struct item*)aCalloc(MAX_STORAGE, sizeof(struct item));
+
+	if( SQL_ERROR == Sql_Query(sql_handle, "CREATE TEMPORARY TABLE `%s` LIKE `%s`", tablename, schema_config.storage_db) )
+	{
+		Sql_ShowDebug(sql_handle);
+		aFree(items);
+		return;
+	}
+
+	ShowStatus("Saving a storage of %d items %d time(s) per mode...\n", MAX_STORAGE, rounds);
+
+	for( int mode = 0; mode < 2; mode++ ) {
+		bool batch = (mode == 1);
+		int queries = 0, errors = 0;
+		int64 elapsed = 0;
+
+		if( SQL_ERROR == Sql_Query(sql_handle, "DELETE FROM `%s`", tablename) )
+			Sql_ShowDebug(sql_handle);
+
+		// the first save only inserts, the initial state is the same for both modes
+		memset(items, 0, MAX_STORAGE * sizeof(struct item));
+		for( int i = 0; i < MAX_STORAGE; i++ ) {
+			items[i].nameid = 501 + i;
+			items[i].amount = 1 + i % 30;
+			items[i].identify = 1;
+		}
+
+		for( int r = 0; r <= rounds; r++ ) {
+			int round_queries = 0;
+
+			if( r > 0 ) {// a third of the stacks change, a tenth is removed or added back
+				for( int i = 0; i < MAX_STORAGE; i++ ) {
+					if( (i + r) % 3 == 0 )
+						items[i].amount = 1 + (items[i].amount % 30);
+					if( (i + r) % 10 == 0 )
+						items[i].nameid = items[i].nameid ? 0 : 501 + i;
+				}
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			errors += char_memitemdata_save(items, MAX_STORAGE, 0, TABLE_STORAGE, tablename, "account_id", batch, &round_queries);
+			auto end = std::chrono::steady_clock::now();
+
+			if( r > 0 ) {
+				elapsed += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+				queries += round_queries;
+			}
+		}
+
+		ShowInfo("%-8s: %.1f statements and %.2f ms per save, %d error(s)\n", batch ? "batched" : "per-row",
+			(double)queries / max(rounds, 1), elapsed / 1000.0 / max(rounds, 1), errors);
+	}
+
+	if( SQL_ERROR == Sql_Query(sql_handle, "DROP TEMPORARY TABLE `%s`", tablename) )
+		Sql_ShowDebug(sql_handle);
+	aFree(items);
+}
+
+/**
+ * Resolves the table of a storage type and prepares the storage for loading its items
+ * @return Storage's item array or NULL if the type is invalid
+ */
+static struct item* char_memitemdata_table(struct s_storage* p, int id, enum storage_type tableswitch, uint8 stor_id, const char** tablename, const char** selectoption, const char** printname) {
+	struct item* storage;
+	int max2;
+
+	memset(p, 0, sizeof(struct s_storage)); //clean up memory
+
+	switch (tableswitch) {
+		case TABLE_INVENTORY:
+			*printname = "Inventory";
+			*tablename = schema_config.inventory_db;
+			*selectoption = "char_id";
+			storage = p->u.items_inventory;
+			max2 = MAX_INVENTORY;
+			break;
+		case TABLE_CART:
+			*printname = "Cart";
+			*tablename = schema_config.cart_db;
+			*selectoption = "char_id";
+			storage = p->u.items_cart;
+			max2 = MAX_CART;
+			break;
+		case TABLE_STORAGE:
+			*printname = "Storage";
+			*tablename = inter_premiumStorage_getTableName(stor_id);
+			*selectoption = "account_id";
+			storage = p->u.items_storage;
+			max2 = inter_premiumStorage_getMax(stor_id);
+			break;
+		case TABLE_GUILD_STORAGE:
+			*printname = "Guild Storage";
+			*tablename = schema_config.guild_storage_db;
+			*selectoption = "guild_id";
 			storage = p->u.items_guild;
 			max2 = inter_guild_storagemax(id);
 			break;
 		default:
 			ShowError("Invalid table name!\n");
-			return false;
+			return NULL;
 	}
 
-	memset(p, 0, sizeof(struct s_storage)); //clean up memory
 	p->id = id;
 	p->type = tableswitch;
 	p->stor_id = stor_id;
 	p->max_amount = max2;
 
-	stmt = SqlStmt_Malloc(sql_handle);
-	if (stmt == NULL) {
-		SqlStmt_ShowDebug(stmt);
-		return false;
+	return storage;
+}
+
+/**
+ * Appends the query selecting the items of a storage, the column order is the one of char_memitemdata_from_row
+ * @param value: Value compared to the id column, a placeholder or a number
+ */
+static void char_memitemdata_select(StringBuf* buf, enum storage_type tableswitch, const char* tablename, const char* selectoption, const char* value) {
+	int j;
+
+	StringBuf_AppendStr(buf, "SELECT `id`,`nameid`,`amount`,`equip`,`identify`,`refine`,`attribute`,`expire_time`,`bound`,`unique_id`,`enchantgrade`");
+	if (tableswitch == TABLE_INVENTORY)
+		StringBuf_Printf(buf, ", `favorite`, `equip_switch`");
+	for( j = 0; j < MAX_SLOTS; ++j )
+		StringBuf_Printf(buf, ",`card%d`", j);
+	for( j = 0; j < MAX_ITEM_RDM_OPT; ++j ) {
+		StringBuf_Printf(buf, ", `option_id%d`", j);
+		StringBuf_Printf(buf, ", `option_val%d`", j);
+		StringBuf_Printf(buf, ", `option_parm%d`", j);
 	}
+	StringBuf_Printf(buf, " FROM `%s` WHERE `%s`=%s ORDER BY `nameid`", tablename, selectoption, value);
+}
 
-	StringBuf_Init(&buf);
-	StringBuf_AppendStr(&buf, "SELECT `id`,`nameid`,`amount`,`equip`,`identify`,`refine`,`attribute`,`expire_time`,`bound`,`unique_id`,`enchantgrade`");
+/**
+ * Reads an item from a text row selected by char_memitemdata_select
+ */
+static void char_memitemdata_from_row(struct item* item, enum storage_type tableswitch, const std::vector<std::string>& row) {
+	size_t i, offset = 0;
+
+	memset(item, 0, sizeof(struct item));
+	item->id = atoi(row[0].c_str());
+	item->nameid = (t_itemid)strtoul(row[1].c_str(), NULL, 10);
+	item->amount = (short)atoi(row[2].c_str());
+	item->equip = (unsigned int)strtoul(row[3].c_str(), NULL, 10);
+	item->identify = (char)atoi(row[4].c_str());
+	item->refine = (char)atoi(row[5].c_str());
+	item->attribute = (char)atoi(row[6].c_str());
+	item->expire_time = (unsigned int)strtoul(row[7].c_str(), NULL, 10);
+	item->bound = (char)atoi(row[8].c_str());
+	item->unique_id = strtoull(row[9].c_str(), NULL, 10);
+	item->enchantgrade = (int8)atoi(row[10].c_str());
 	if (tableswitch == TABLE_INVENTORY) {
-		StringBuf_Printf(&buf, ", `favorite`, `equip_switch`");
+		item->favorite = (char)atoi(row[11].c_str());
+		item->equipSwitch = (unsigned int)strtoul(row[12].c_str(), NULL, 10);
 		offset = 2;
 	}
-	for( j = 0; j < MAX_SLOTS; ++j )
-		StringBuf_Printf(&buf, ",`card%d`", j);
-	for( j = 0; j < MAX_ITEM_RDM_OPT; ++j ) {
-		StringBuf_Printf(&buf, ", `option_id%d`", j);
-		StringBuf_Printf(&buf, ", `option_val%d`", j);
-		StringBuf_Printf(&buf, ", `option_parm%d`", j);
+	for( i = 0; i < MAX_SLOTS; ++i )
+		item->card[i] = (t_itemid)strtoul(row[11+offset+i].c_str(), NULL, 10);
+	for( i = 0; i < MAX_ITEM_RDM_OPT; ++i ) {
+		item->option[i].id = (short)atoi(row[11+offset+MAX_SLOTS+i*3].c_str());
+		item->option[i].value = (short)atoi(row[12+offset+MAX_SLOTS+i*3].c_str());
+		item->option[i].param = (char)atoi(row[13+offset+MAX_SLOTS+i*3].c_str());
 	}
-	StringBuf_Printf(&buf, " FROM `%s` WHERE `%s`=? ORDER BY `nameid`", tablename, selectoption );
+}
 
-	if( SQL_ERROR == SqlStmt_PrepareStr(stmt, StringBuf_Value(&buf))
-		||	SQL_ERROR == SqlStmt_BindParam(stmt, 0, SQLDT_INT, &id, 0)
-		||	SQL_ERROR == SqlStmt_Execute(stmt) )
-	{
-		SqlStmt_ShowDebug(stmt);
-		SqlStmt_Free(stmt);
-		StringBuf_Destroy(&buf);
-		return false;
-	}
+/**
+ * Loads the items of a storage on the SQL connection pool and hands them to the callback on the main thread
+ * @param fd: Map-server's fd that requested the storage, the callback is skipped if it disconnected
+ * @param key: Id the query is ordered by
+ * @param callback: Function receiving the fd, the loaded storage and whether the load succeeded
+ */
+void char_memitemdata_from_sql_async(int fd, uint32 key, int max, int id, enum storage_type tableswitch, uint8 stor_id, std::function<void(int fd, struct s_storage* p, bool result)> callback) {
+	StringBuf buf;
+	struct s_storage stor;
+	const char *tablename, *selectoption, *printname;
+	char value[12];
 
-	SqlStmt_BindColumn(stmt, 0, SQLDT_INT,          &item.id,        0, NULL, NULL);
-	SqlStmt_BindColumn(stmt, 1, SQLDT_UINT,         &item.nameid,    0, NULL, NULL);
-	SqlStmt_BindColumn(stmt, 2, SQLDT_SHORT,        &item.amount,    0, NULL, NULL);
-	SqlStmt_BindColumn(stmt, 3, SQLDT_UINT,         &item.equip,     0, NULL, NULL);
-	SqlStmt_BindColumn(stmt, 4, SQLDT_CHAR,         &item.identify,  0, NULL, NULL);
-	SqlStmt_BindColumn(stmt, 5, SQLDT_CHAR,         &item.refine,    0, NULL, NULL);
-	SqlStmt_BindColumn(stmt, 6, SQLDT_CHAR,         &item.attribute, 0, NULL, NULL);
-	SqlStmt_BindColumn(stmt, 7, SQLDT_UINT,         &item.expire_time, 0, NULL, NULL);
-	SqlStmt_BindColumn(stmt, 8, SQLDT_CHAR,         &item.bound,     0, NULL, NULL);
-	SqlStmt_BindColumn(stmt, 9, SQLDT_ULONGLONG,    &item.unique_id, 0, NULL, NULL);
-	SqlStmt_BindColumn(stmt,10, SQLDT_INT8,         &item.enchantgrade, 0, NULL, NULL);
-	if (tableswitch == TABLE_INVENTORY){
-		SqlStmt_BindColumn(stmt, 11, SQLDT_CHAR, &item.favorite,    0, NULL, NULL);
-		SqlStmt_BindColumn(stmt, 12, SQLDT_UINT, &item.equipSwitch, 0, NULL, NULL);
+	if (char_memitemdata_table(&stor, id, tableswitch, stor_id, &tablename, &selectoption, &printname) == NULL) {
+		callback(fd, &stor, false);
+		return;
 	}
-	for( i = 0; i < MAX_SLOTS; ++i )
-		SqlStmt_BindColumn(stmt, 11+offset+i, SQLDT_UINT, &item.card[i],   0, NULL, NULL);
- 	for( i = 0; i < MAX_ITEM_RDM_OPT; ++i ) {
-		SqlStmt_BindColumn(stmt, 11+offset+MAX_SLOTS+i*3, SQLDT_SHORT, &item.option[i].id, 0, NULL, NULL);
-		SqlStmt_BindColumn(stmt, 12+offset+MAX_SLOTS+i*3, SQLDT_SHORT, &item.option[i].value, 0, NULL, NULL);
-		SqlStmt_BindColumn(stmt, 13+offset+MAX_SLOTS+i*3, SQLDT_CHAR, &item.option[i].param, 0, NULL, NULL);
- 	}
 
-	for( i = 0; i < max && SQL_SUCCESS == SqlStmt_NextRow(stmt); ++i )
-		memcpy(&storage[i], &item, sizeof(item));
+	StringBuf_Init(&buf);
+	safesnprintf(value, sizeof(value), "'%d'", id);
+	char_memitemdata_select(&buf, tableswitch, tablename, selectoption, value);
+
+	inter_sqlpool_query_map(fd, key, StringBuf_Value(&buf), [max, id, tableswitch, stor_id, callback](int fd, struct s_sqlpool_result& result) {
+		struct s_storage stor;
+		struct item* storage;
+		const char *tablename, *selectoption, *printname;
+		int i;
+
+		storage = char_memitemdata_table(&stor, id, tableswitch, stor_id, &tablename, &selectoption, &printname);
+		if (storage == NULL || !result.success) {
+			callback(fd, &stor, false);
+			return;
+		}
 
-	p->amount = i;
-	ShowInfo("Loaded %s data from table %s for %s: %d (total: %d)\n", printname, tablename, selectoption, id, p->amount);
+		for( i = 0; i < max && i < (int)result.rows.size(); ++i )
+			char_memitemdata_from_row(&storage[i], tableswitch, result.rows[i]);
 
-	SqlStmt_FreeResult(stmt);
-	SqlStmt_Free(stmt);
+		stor.amount = i;
+		ShowInfo("Loaded %s data from table %s for %s: %d (total: %d)\n", printname, tablename, selectoption, id, stor.amount);
+		callback(fd, &stor, true);
+	});
 	StringBuf_Destroy(&buf);
-
-	return true;
 }
 
 /**
@@ -1232,6 +1458,7 @@ int char_mmo_char_fromsql(uint32 char_id, struct mmo_charstatus* p, bool load_ev
 
 	cp = (struct mmo_charstatus *)idb_ensure(char_db_, char_id, char_create_charstatus);
 	memcpy(cp, p, sizeof(struct mmo_charstatus));
+	char_save_seq.erase(char_id); // no longer what the map-server saved
 	StringBuf_Destroy(&msg_buf);
 	return 1;
 }
@@ -2739,6 +2966,7 @@ void char_set_defaults(){
 	safestrncpy(charserv_config.char_config.char_name_letters,"",sizeof(charserv_config.char_config.char_name_letters)); // list of letters/symbols allowed (or not) in a character name. by [Yor]
 
 	charserv_config.save_log = 1; // show loading/saving messages
+	charserv_config.item_save_batch = true;
 	charserv_config.log_char = 1;	// loggin char or not [devil]
 	charserv_config.log_inter = 1;	// loggin inter or not [devil]
 	charserv_config.char_check_db =1;
@@ -2971,6 +3199,8 @@ bool char_config_read(const char* cfgName, bool normal){
 				charserv_config.autosave_interval = DEFAULT_AUTOSAVE_INTERVAL;
 		} else if (strcmpi(w1, "save_log") == 0) {
 			charserv_config.save_log = config_switch(w2);
+		} else if (strcmpi(w1, "item_save_batch") == 0) {
+			charserv_config.item_save_batch = config_switch(w2) > 0;
 #ifdef RENEWAL
 		} else if (strcmpi(w1, "start_point") == 0) {
 #else
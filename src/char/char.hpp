@@ -4,6 +4,7 @@
 #ifndef CHAR_HPP
 #define CHAR_HPP
 
+#include <functional>
 #include <vector>
 
 #include "../common/core.hpp" // CORE_ST_LAST
@@ -166,6 +167,7 @@ struct CharServ_Config {
 #endif
 
 	int save_log; // show loading/saving messages
+	bool item_save_batch; // save the changed items of a storage with one statement per kind of change
 	int log_char;	// loggin char or not [devil]
 	int log_inter;	// loggin inter or not [devil]
 	int char_check_db;	///cheking sql-table at begining ?
@@ -286,14 +288,17 @@ TIMER_FUNC(char_chardb_waiting_disconnect);
 
 int char_mmo_gender(const struct char_session_data *sd, const struct mmo_charstatus *p, char sex);
 int char_mmo_char_tobuf(uint8* buffer, struct mmo_charstatus* p);
-int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p);
+int char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p, uint32 sections = SAVESECTION_ALL);
+void char_mmo_char_save(uint32 char_id, struct mmo_charstatus* p, uint32 sections, uint32 seq);
+bool char_mmo_char_save_delta(uint32 char_id, uint32 sections, uint32 base_seq, uint32 seq, const uint8* data, size_t len);
 int char_mmo_char_fromsql(uint32 char_id, struct mmo_charstatus* p, bool load_everything);
 int char_mmo_chars_fromsql(struct char_session_data* sd, uint8* buf, uint8* count = nullptr);
 enum e_char_del_response char_delete(struct char_session_data* sd, uint32 char_id);
 int char_rename_char_sql(struct char_session_data *sd, uint32 char_id);
 int char_divorce_char_sql(int partner_id1, int partner_id2);
 int char_memitemdata_to_sql(const struct item items[], int max, int id, enum storage_type tableswitch, uint8 stor_id);
-bool char_memitemdata_from_sql(struct s_storage* p, int max, int id, enum storage_type tableswitch, uint8 stor_id);
+void char_memitemdata_benchmark(int rounds);
+void char_memitemdata_from_sql_async(int fd, uint32 key, int max, int id, enum storage_type tableswitch, uint8 stor_id, std::function<void(int fd, struct s_storage* p, bool result)> callback);
 
 int char_married(int pl1,int pl2);
 int char_child(int parent_id, int child_id);
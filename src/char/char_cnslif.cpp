@@ -10,9 +10,12 @@
 #include "../common/ers.hpp"
 #include "../common/showmsg.hpp"
 #include "../common/socket.hpp"
+#include "../common/sql.hpp"
 #include "../common/timer.hpp"
 
 #include "char.hpp"
+#include "inter.hpp"
+#include "inter_sqlpool.hpp"
 
 /*======================================================
  * Login-Server help option info
@@ -25,6 +28,8 @@ void display_helpscreen(bool do_exit)
 	ShowInfo("  -?, -h [--help]\t\tDisplays this help screen.\n");
 	ShowInfo("  -v [--version]\t\tDisplays the server's version.\n");
 	ShowInfo("  --run-once\t\t\tCloses server after loading (testing).\n");
+	ShowInfo("  --timer-wheel\t\t\tUses the timing wheel instead of the timer heap.\n");
+	ShowInfo("  --timer-trace <file>\t\tRecords timer operations for the timerbench tool.\n");
 	ShowInfo("  --char-config <file>\t\tAlternative char-server configuration.\n");
 	ShowInfo("  --lan-config <file>\t\tAlternative lag configuration.\n");
 	ShowInfo("  --inter-config <file>\t\tAlternative inter-server configuration.\n");
@@ -86,12 +91,33 @@ int cnslif_parse(const char* buf)
 	else if( strcmpi("ers_report", type) == 0 ){
 		ers_report();
 	}
+	else if( strcmpi("sql_stats", type) == 0 ){
+		Sql_ShowStmtCacheStats(sql_handle, "char");
+		if( inter_sqlpool_active() ){
+			struct s_sqlpool_stats stats;
+
+			inter_sqlpool_get_stats(&stats);
+			ShowInfo("SQL connection pool: %d connections, %" PRIuPTR " pending, %" PRIu64 " queries (%" PRIu64 " failed), %.2f ms average, %.2f ms longest wait.\n",
+				stats.connections, stats.pending, stats.queries, stats.failed,
+				stats.queries ? stats.total_time / 1000.0 / stats.queries : 0.0, stats.max_wait / 1000.0);
+		}
+	}
+	else if( n == 2 && strcmpi("bench", type) == 0 ){
+		int rounds = 10;
+
+		if( strncmpi(command, "itemsave", 8) == 0 ){
+			sscanf(command + 8, "%d", &rounds);
+			char_memitemdata_benchmark(max(rounds, 1));
+		}
+	}
 	else if( strcmpi("help", type) == 0 ){
 		ShowInfo("Available commands:\n");
 		ShowInfo("\t server:shutdown => Stops the server.\n");
 		ShowInfo("\t server:alive => Checks if the server is running.\n");
 		ShowInfo("\t server:reloadconf => Reload config file: \"%s\"\n", CHAR_CONF_NAME);
 		ShowInfo("\t ers_report => Displays database usage.\n");
+		ShowInfo("\t sql_stats => Displays the prepared statement cache and connection pool usage.\n");
+		ShowInfo("\t bench:itemsave {rounds} => Compares the per-row and batched item save on a full storage.\n");
 	}
 
 	return 0;
@@ -398,20 +398,20 @@ int chmapif_parse_reqsavechar(int fd, int id){
 		struct online_char_data* character;
 		DBMap* online_char_db = char_get_onlinedb();
 
-		if (size - 13 != sizeof(struct mmo_charstatus))
+		if (size - 21 != sizeof(struct mmo_charstatus))
 		{
-			ShowError("parse_from_map (save-char): Size mismatch! %d != %" PRIuPTR "\n", size-13, sizeof(struct mmo_charstatus));
+			ShowError("parse_from_map (save-char): Size mismatch! %d != %" PRIuPTR "\n", size-21, sizeof(struct mmo_charstatus));
 			RFIFOSKIP(fd,size);
 			return 1;
 		}
 		//Check account only if this ain't final save. Final-save goes through because of the char-map reconnect
-		if (RFIFOB(fd,12) || RFIFOB(fd,13) || (
+		if (RFIFOB(fd,12) || RFIFOB(fd,21) || (
 			(character = (struct online_char_data*)idb_get(online_char_db, aid)) != NULL &&
 			character->char_id == cid))
 		{
 			struct mmo_charstatus char_dat;
-			memcpy(&char_dat, RFIFOP(fd,13), sizeof(struct mmo_charstatus));
-			char_mmo_char_tosql(cid, &char_dat);
+			memcpy(&char_dat, RFIFOP(fd,21), sizeof(struct mmo_charstatus));
+			char_mmo_char_save(cid, &char_dat, RFIFOL(fd,13), RFIFOL(fd,17));
 		} else {	//This may be valid on char-server reconnection, when re-sending characters that already logged off.
 			ShowError("parse_from_map (save-char): Received data for non-existant/offline character (%d:%d).\n", aid, cid);
 			char_set_char_online(id, cid, aid);
@@ -431,6 +431,41 @@ int chmapif_parse_reqsavechar(int fd, int id){
 	return 1;
 }
 
+/**
+ * Map-serv request to save the bytes of mmo_charstatus that changed since a previous save
+ * ZA 0x2b2c <len>.W <account_id>.L <char_id>.L <sections>.L <base_seq>.L <seq>.L { <offset>.W <length>.W <bytes>.?B }*
+ * @param fd: wich fd to parse from
+ * @param id: wich map_serv id
+ * @return : 0 not enough data received, 1 success
+ */
+int chmapif_parse_reqsavechar_delta(int fd, int id){
+	if (RFIFOREST(fd) < 4 || RFIFOREST(fd) < RFIFOW(fd,2))
+		return 0;
+	else {
+		uint32 aid = RFIFOL(fd,4), cid = RFIFOL(fd,8);
+		int size = RFIFOW(fd,2);
+		struct online_char_data* character = (struct online_char_data*)idb_get(char_get_onlinedb(), aid);
+		bool saved = false;
+
+		if (character == NULL || character->char_id != cid) {
+			ShowError("parse_from_map (save-char-delta): Received data for non-existant/offline character (%d:%d).\n", aid, cid);
+			char_set_char_online(id, cid, aid);
+		} else if (size >= 24)
+			saved = char_mmo_char_save_delta(cid, RFIFOL(fd,12), RFIFOL(fd,16), RFIFOL(fd,20), RFIFOP(fd,24), size - 24);
+
+		if (!saved) {
+			// ask for the complete character
+			WFIFOHEAD(fd,10);
+			WFIFOW(fd,0) = 0x2b29;
+			WFIFOL(fd,2) = aid;
+			WFIFOL(fd,6) = cid;
+			WFIFOSET(fd,10);
+		}
+		RFIFOSKIP(fd,size);
+	}
+	return 1;
+}
+
 /**
  * Inform mapserv of a new character selection request
  * @param fd : FD link tomapserv
@@ -1429,7 +1464,7 @@ int chmapif_parse(int fd){
 			case 0x2b26: next=chmapif_parse_reqauth(fd,id); break;
 			case 0x2b28: next=chmapif_parse_reqcharban(fd); break; //charban
 			case 0x2b2a: next=chmapif_parse_reqcharunban(fd); break; //charunban
-			//case 0x2b2c: /*free*/; break;
+			case 0x2b2c: next=chmapif_parse_reqsavechar_delta(fd,id); break;
 			case 0x2b2d: next=chmapif_bonus_script_get(fd); break; //Load data
 			case 0x2b2e: next=chmapif_bonus_script_save(fd); break;//Save data
 			default:
@@ -96,40 +96,6 @@ int cart_tosql(uint32 char_id, struct s_storage* p)
 	return char_memitemdata_to_sql(p->u.items_cart, MAX_CART, char_id, TABLE_CART, p->stor_id);
 }
 
-/**
- * Fetch inventory entries from table
- * @param char_id: Character ID to fetch
- * @param p: Inventory entries
- * @return True if success, False if failed
- */
-bool inventory_fromsql(uint32 char_id, struct s_storage* p)
-{
-	return char_memitemdata_from_sql( p, MAX_INVENTORY, char_id, TABLE_INVENTORY, p->stor_id );
-}
-
-/**
- * Fetch cart entries from table
- * @param char_id: Character ID to fetch
- * @param p: Cart entries
- * @return True if success, False if failed
- */
-bool cart_fromsql(uint32 char_id, struct s_storage* p)
-{
-	return char_memitemdata_from_sql( p, MAX_CART, char_id, TABLE_CART, p->stor_id );
-}
-
-/**
- * Fetch storage entries from table
- * @param account_id: Account ID to fetch
- * @param p: Storage entries
- * @param stor_id: Storage ID
- * @return True if success, False if failed
- */
-bool storage_fromsql(uint32 account_id, struct s_storage* p)
-{
-	return char_memitemdata_from_sql( p, MAX_STORAGE, account_id, TABLE_STORAGE, p->stor_id );
-}
-
 /**
  * Save guild_storage data to sql
  * @param guild_id: Guild ID to save
@@ -142,17 +108,6 @@ bool guild_storage_tosql(int guild_id, struct s_storage* p)
 	return char_memitemdata_to_sql(p->u.items_guild, inter_guild_storagemax(guild_id), guild_id, TABLE_GUILD_STORAGE, p->stor_id);
 }
 
-/**
- * Fetch guild_storage entries from table
- * @param guild_id: Guild ID to fetch
- * @param p: Guild Storage entries
- * @return True if success, False if failed
- */
-bool guild_storage_fromsql(int guild_id, struct s_storage* p)
-{
-	return char_memitemdata_from_sql( p, inter_guild_storagemax(guild_id), guild_id, TABLE_GUILD_STORAGE, p->stor_id );
-}
-
 void inter_storage_checkDB(void) {
 	// Checking storage tables
 	for( auto storage_table : interServerDb ){
@@ -185,8 +140,24 @@ void inter_storage_sql_final(void)
 //---------------------------------------------------------
 // packet from map server
 
+/**
+ * Tells the map server that the guild of a storage request does not exist
+ * @param fd: Map server's fd
+ * @param account_id: Account ID requesting
+ */
+static void mapif_load_guild_storage_fail(int fd, uint32 account_id)
+{
+	WFIFOHEAD(fd, 12);
+	WFIFOW(fd,0) = 0x3818;
+	WFIFOW(fd,2) = 12;
+	WFIFOL(fd,4) = account_id;
+	WFIFOL(fd,8) = 0;
+	WFIFOSET(fd, 12);
+}
+
 /**
  * Send guild storage data to the map server
+ * The items are loaded on the SQL connection pool, the data is sent once they are.
  * @param fd: Map server's fd
  * @param account_id: Account ID requesting
  * @param guild_id: Guild ID requesting
@@ -199,24 +170,26 @@ bool mapif_load_guild_storage(int fd,uint32 account_id,int guild_id, char flag)
 		Sql_ShowDebug(sql_handle);
 	else if( Sql_NumRows(sql_handle) > 0 )
 	{// guild exists
-		WFIFOHEAD(fd, sizeof(struct s_storage)+13);
-		WFIFOW(fd,0) = 0x3818;
-		WFIFOW(fd,2) = sizeof(struct s_storage)+13;
-		WFIFOL(fd,4) = account_id;
-		WFIFOL(fd,8) = guild_id;
-		WFIFOB(fd,12) = flag; //1 open storage, 0 don't open
-		guild_storage_fromsql(guild_id, (struct s_storage*)WFIFOP(fd,13));
-		WFIFOSET(fd, WFIFOW(fd,2));
+		Sql_FreeResult(sql_handle);
+		char_memitemdata_from_sql_async(fd, guild_id, inter_guild_storagemax(guild_id), guild_id, TABLE_GUILD_STORAGE, 0, [account_id, guild_id, flag](int fd, struct s_storage* p, bool result) {
+			if( !result ) {
+				mapif_load_guild_storage_fail(fd, account_id);
+				return;
+			}
+			WFIFOHEAD(fd, sizeof(struct s_storage)+13);
+			WFIFOW(fd,0) = 0x3818;
+			WFIFOW(fd,2) = sizeof(struct s_storage)+13;
+			WFIFOL(fd,4) = account_id;
+			WFIFOL(fd,8) = guild_id;
+			WFIFOB(fd,12) = flag; //1 open storage, 0 don't open
+			memcpy(WFIFOP(fd,13), p, sizeof(struct s_storage));
+			WFIFOSET(fd, WFIFOW(fd,2));
+		});
 		return true;
 	}
 	// guild does not exist
 	Sql_FreeResult(sql_handle);
-	WFIFOHEAD(fd, 12);
-	WFIFOW(fd,0) = 0x3818;
-	WFIFOW(fd,2) = 12;
-	WFIFOL(fd,4) = account_id;
-	WFIFOL(fd,8) = 0;
-	WFIFOSET(fd, 12);
+	mapif_load_guild_storage_fail(fd, account_id);
 	return false;
 }
 
@@ -504,6 +477,7 @@ void mapif_storage_saved(int fd, uint32 account_id, uint32 char_id, bool success
 
 /**
  * Requested inventory/cart/storage data for a player
+ * The items are loaded on the SQL connection pool, ordered by the character.
  * ZI 0x308a <type>.B <account_id>.L <char_id>.L <storage_id>.B <mode>.B
  * @param fd
  */
@@ -511,37 +485,34 @@ bool mapif_parse_StorageLoad(int fd) {
 	uint32 aid, cid;
 	int type;
 	uint8 stor_id, mode;
-	struct s_storage stor;
-	bool res = true;
 
 	type = RFIFOB(fd,2);
 	aid = RFIFOL(fd,3);
 	cid = RFIFOL(fd,7);
 	stor_id = RFIFOB(fd,11);
+	mode = RFIFOB(fd, 12);
 
-	memset(&stor, 0, sizeof(struct s_storage));
-	stor.stor_id = stor_id;
+	auto loaded = [aid, type, mode](int fd, struct s_storage* p, bool result) {
+		p->state.put = (mode&STOR_MODE_PUT) ? 1 : 0;
+		p->state.get = (mode&STOR_MODE_GET) ? 1 : 0;
+		mapif_storage_data_loaded(fd, aid, type, p, result);
+	};
 
 	//ShowInfo("Loading storage for AID=%d.\n", aid);
 	switch (type) {
-		case TABLE_INVENTORY: res = inventory_fromsql(cid, &stor); break;
+		case TABLE_INVENTORY: char_memitemdata_from_sql_async(fd, cid, MAX_INVENTORY, cid, TABLE_INVENTORY, stor_id, loaded); break;
 		case TABLE_STORAGE:
 			if( !interServerDb.exists( stor_id ) ){
 				ShowError( "Invalid storage with id %d\n", stor_id );
 				return false;
 			}
 
-			res = storage_fromsql(aid, &stor);
+			char_memitemdata_from_sql_async(fd, cid, MAX_STORAGE, aid, TABLE_STORAGE, stor_id, loaded);
 			break;
-		case TABLE_CART:      res = cart_fromsql(cid, &stor);      break;
+		case TABLE_CART:      char_memitemdata_from_sql_async(fd, cid, MAX_CART, cid, TABLE_CART, stor_id, loaded); break;
 		default: return false;
 	}
 
-	mode = RFIFOB(fd, 12);
-	stor.state.put = (mode&STOR_MODE_PUT) ? 1 : 0;
-	stor.state.get = (mode&STOR_MODE_GET) ? 1 : 0;
-
-	mapif_storage_data_loaded(fd, aid, type, &stor, res);
 	return true;
 }
 
@@ -34,6 +34,7 @@
 #include "int_pet.hpp"
 #include "int_quest.hpp"
 #include "int_storage.hpp"
+#include "inter_sqlpool.hpp"
 
 std::string cfgFile = "inter_athena.yml"; ///< Inter-Config file
 InterServerDatabase interServerDb;
@@ -853,6 +854,8 @@ int inter_config_read(const char* cfgName)
 			safestrncpy(char_server_db,w2,sizeof(char_server_db));
 		else if(!strcmpi(w1,"default_codepage"))
 			safestrncpy(default_codepage,w2,sizeof(default_codepage));
+		else if(!strcmpi(w1,"inter_sql_pool_size"))
+			inter_sqlpool_size = atoi(w2);
 		else if(!strcmpi(w1,"party_share_level"))
 			party_share_level = (unsigned int)atof(w2);
 		else if(!strcmpi(w1,"log_inter"))
@@ -963,28 +966,38 @@ uint64 InterServerDatabase::parseBodyNode( const YAML::Node& node ){
 	return 1;
 }
 
-// initialize
-int inter_init_sql(const char *file)
+/// Opens a new connection to the character database, exits on failure
+Sql* inter_sql_connect(void)
 {
-	inter_config_read(file);
+	Sql* handle = Sql_Malloc();
 
-	//DB connection initialized
-	sql_handle = Sql_Malloc();
 	ShowInfo("Connect Character DB server.... (Character Server)\n");
-	if( SQL_ERROR == Sql_Connect(sql_handle, char_server_id, char_server_pw, char_server_ip, (uint16)char_server_port, char_server_db) )
+	if( SQL_ERROR == Sql_Connect(handle, char_server_id, char_server_pw, char_server_ip, (uint16)char_server_port, char_server_db) )
 	{
 		ShowError("Couldn't connect with username = '%s', password = '%s', host = '%s', port = '%d', database = '%s'\n",
 			char_server_id, char_server_pw, char_server_ip, char_server_port, char_server_db);
-		Sql_ShowDebug(sql_handle);
-		Sql_Free(sql_handle);
+		Sql_ShowDebug(handle);
+		Sql_Free(handle);
 		exit(EXIT_FAILURE);
 	}
 
 	if( *default_codepage ) {
-		if( SQL_ERROR == Sql_SetEncoding(sql_handle, default_codepage) )
-			Sql_ShowDebug(sql_handle);
+		if( SQL_ERROR == Sql_SetEncoding(handle, default_codepage) )
+			Sql_ShowDebug(handle);
 	}
 
+	return handle;
+}
+
+// initialize
+int inter_init_sql(const char *file)
+{
+	inter_config_read(file);
+
+	//DB connection initialized
+	sql_handle = inter_sql_connect();
+	inter_sqlpool_init();
+
 	wis_db = idb_alloc(DB_OPT_RELEASE_DATA);
 	interServerDb.load();
 	inter_guild_sql_init();
@@ -1018,6 +1031,8 @@ void inter_final(void)
 	inter_auction_sql_final();
 	inter_clan_final();
 
+	inter_sqlpool_final();
+
 	if(geoip_cache) aFree(geoip_cache);
 	
 	return;
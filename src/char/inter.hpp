@@ -26,6 +26,7 @@ public:
 
 extern InterServerDatabase interServerDb;
 
+Sql* inter_sql_connect(void);
 int inter_init_sql(const char *file);
 void inter_final(void);
 int inter_parse_frommap(int fd);
@@ -0,0 +1,309 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+#include "inter_sqlpool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "../common/showmsg.hpp"
+#include "../common/socket.hpp"
+#include "../common/sql.hpp"
+#include "../common/timer.hpp"
+#include "../common/utils.hpp"
+
+#include "inter.hpp"
+
+/////////////////////////////////////////////////////////////////////
+// SQL connection pool
+//
+// Each pooled connection is owned by a thread running the queries queued for
+// it in order. A query is queued on the connection picked by its key, so the
+// queries of a character (or account, guild...) never overtake each other,
+// while queries of different keys run concurrently with each other and with
+// the main thread, which keeps sql_handle for itself.
+// The memory manager is not thread-safe: the threads only use the Sql
+// functions documented as usable from the owning thread, and jobs are
+// allocated with new. Callbacks run on the main thread, from a timer.
+
+// interval in which finished queries are handed to their callbacks, in milliseconds
+#define SQLPOOL_POLL_INTERVAL 10
+// maximum number of pooled connections
+#define SQLPOOL_MAX 16
+
+/// Query queued on a pooled connection
+struct s_sqlpool_job {
+	std::string query;
+	sqlpool_callback callback; // run on the main thread
+	std::promise<struct s_sqlpool_result> promise; // set by the pool thread instead, when there is no callback
+	std::chrono::steady_clock::time_point queued;
+	struct s_sqlpool_result result;
+};
+
+/// Pooled connection and the thread owning it
+struct s_sqlpool_connection {
+	Sql* handle;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<struct s_sqlpool_job*> queue; // front is the running query
+};
+
+int inter_sqlpool_size = 4;
+
+static std::vector<struct s_sqlpool_connection*> sqlpool;
+static std::atomic<bool> sqlpool_running(false);
+static std::mutex sqlpool_done_mutex;
+static std::deque<struct s_sqlpool_job*> sqlpool_done; // finished, waiting for the main thread
+static int sqlpool_timer = INVALID_TIMER;
+
+static std::atomic<size_t> sqlpool_stat_pending(0);
+static std::atomic<uint64> sqlpool_stat_queries(0), sqlpool_stat_failed(0), sqlpool_stat_max_wait(0), sqlpool_stat_total_time(0);
+
+/// Runs a query, on the connection of the calling pool thread or on sql_handle without a pool
+static void inter_sqlpool_execute(Sql* handle, struct s_sqlpool_job* job)
+{
+	auto start = std::chrono::steady_clock::now();
+	uint64 wait = std::chrono::duration_cast<std::chrono::microseconds>(start - job->queued).count();
+	uint64 max_wait = sqlpool_stat_max_wait.load();
+
+	while( wait > max_wait && !sqlpool_stat_max_wait.compare_exchange_weak(max_wait, wait) )
+		;
+
+	job->result.success = ( SQL_SUCCESS == Sql_ExecuteStr(handle, job->query.c_str(), job->query.length(), job->result.rows) );
+	job->result.affected_rows = job->result.success ? Sql_NumRowsAffected(handle) : 0;
+	job->result.insert_id = job->result.success ? Sql_LastInsertId(handle) : 0;
+	if( !job->result.success )
+	{
+		ShowDebug("at %s:%d - %s\n", __FILE__, __LINE__, job->query.c_str());
+		sqlpool_stat_failed++;
+	}
+
+	sqlpool_stat_queries++;
+	sqlpool_stat_total_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void inter_sqlpool_run(struct s_sqlpool_connection* con)
+{
+	auto last_query = std::chrono::steady_clock::now();
+
+	Sql_ThreadInit();
+
+	while( true ) {
+		struct s_sqlpool_job* job = nullptr;
+
+		{
+			std::unique_lock<std::mutex> lock(con->mutex);
+
+			con->cv.wait_for(lock, std::chrono::minutes(1), [con] {
+				return !sqlpool_running.load() || !con->queue.empty();
+			});
+			if( !con->queue.empty() )
+				job = con->queue.front();
+			else if( !sqlpool_running.load() )
+				break; // everything queued before the stop was run
+		}
+
+		auto now = std::chrono::steady_clock::now();
+
+		if( job == nullptr ) {
+			if( now - last_query > std::chrono::minutes(5) ) {// keep the connection alive
+				Sql_Ping(con->handle);
+				last_query = now;
+			}
+			continue;
+		}
+
+		inter_sqlpool_execute(con->handle, job);
+		last_query = now;
+
+		{
+			std::lock_guard<std::mutex> lock(con->mutex);
+			con->queue.pop_front();
+		}
+
+		if( job->callback ) {
+			std::lock_guard<std::mutex> lock(sqlpool_done_mutex);
+			sqlpool_done.push_back(job);
+		} else {
+			job->promise.set_value(std::move(job->result));
+			delete job;
+			sqlpool_stat_pending--;
+		}
+	}
+
+	Sql_ThreadEnd();
+}
+
+/// Hands the finished queries to their callbacks
+static void inter_sqlpool_deliver(void)
+{
+	std::deque<struct s_sqlpool_job*> done;
+
+	{
+		std::lock_guard<std::mutex> lock(sqlpool_done_mutex);
+		done.swap(sqlpool_done);
+	}
+
+	for( struct s_sqlpool_job* job : done ) {
+		job->callback(job->result);
+		delete job;
+		sqlpool_stat_pending--;
+	}
+}
+
+static TIMER_FUNC(inter_sqlpool_timer)
+{
+	inter_sqlpool_deliver();
+	return 0;
+}
+
+/// Queues a job on the connection of the key
+static void inter_sqlpool_push(uint32 key, struct s_sqlpool_job* job)
+{
+	struct s_sqlpool_connection* con = sqlpool[key % sqlpool.size()];
+
+	job->queued = std::chrono::steady_clock::now();
+	sqlpool_stat_pending++;
+	{
+		std::lock_guard<std::mutex> lock(con->mutex);
+		con->queue.push_back(job);
+	}
+	con->cv.notify_one();
+}
+
+/**
+ * Runs a query on a pooled connection, the callback gets the result on the main thread.
+ * Queries with the same key are run in the order they were queued.
+ * Without a pool the query is run on sql_handle and the callback is called right away.
+ * @param key: Character, account or other id the query is ordered by
+ * @param query: Query, already escaped
+ * @param callback: Function receiving the result
+ */
+void inter_sqlpool_query(uint32 key, std::string query, sqlpool_callback callback)
+{
+	struct s_sqlpool_job* job = new s_sqlpool_job();
+
+	job->query = std::move(query);
+	job->callback = std::move(callback);
+
+	if( !inter_sqlpool_active() ) {
+		inter_sqlpool_execute(sql_handle, job);
+		job->callback(job->result);
+		delete job;
+		return;
+	}
+
+	inter_sqlpool_push(key, job);
+}
+
+/**
+ * Runs a query on a pooled connection for a map-server request.
+ * The callback is skipped when the map-server disconnected in the meantime.
+ * @param fd: Map-server's fd the answer is sent to
+ * @param key: Character, account or other id the query is ordered by
+ * @param query: Query, already escaped
+ * @param callback: Function receiving the map-server's fd and the result
+ */
+void inter_sqlpool_query_map(int fd, uint32 key, std::string query, std::function<void(int fd, struct s_sqlpool_result& result)> callback)
+{
+	struct socket_data* sd = session[fd];
+
+	inter_sqlpool_query(key, std::move(query), [fd, sd, callback](struct s_sqlpool_result& result) {
+		if( !session_isActive(fd) || session[fd] != sd )
+			return; // the answer would go to another connection
+
+		callback(fd, result);
+	});
+}
+
+/**
+ * Runs a query on a pooled connection and returns a future of its result.
+ * The future is fulfilled by the pool thread, waiting on it blocks the caller.
+ * @param key: Character, account or other id the query is ordered by
+ * @param query: Query, already escaped
+ * @return Future result
+ */
+std::future<struct s_sqlpool_result> inter_sqlpool_query(uint32 key, std::string query)
+{
+	struct s_sqlpool_job* job = new s_sqlpool_job();
+	std::future<struct s_sqlpool_result> future = job->promise.get_future();
+
+	job->query = std::move(query);
+
+	if( !inter_sqlpool_active() ) {
+		inter_sqlpool_execute(sql_handle, job);
+		job->promise.set_value(std::move(job->result));
+		delete job;
+		return future;
+	}
+
+	inter_sqlpool_push(key, job);
+	return future;
+}
+
+bool inter_sqlpool_active(void)
+{
+	return !sqlpool.empty();
+}
+
+void inter_sqlpool_get_stats(struct s_sqlpool_stats* stats)
+{
+	stats->connections = (int)sqlpool.size();
+	stats->pending = sqlpool_stat_pending.load();
+	stats->queries = sqlpool_stat_queries.load();
+	stats->failed = sqlpool_stat_failed.load();
+	stats->max_wait = sqlpool_stat_max_wait.load();
+	stats->total_time = sqlpool_stat_total_time.load();
+}
+
+/// Opens the pooled connections and starts their threads
+void inter_sqlpool_init(void)
+{
+	int size = cap_value(inter_sqlpool_size, 0, SQLPOOL_MAX);
+
+	if( size == 0 )
+		return;
+
+	sqlpool_running = true;
+	for( int i = 0; i < size; i++ ) {
+		struct s_sqlpool_connection* con = new s_sqlpool_connection();
+
+		con->handle = inter_sql_connect();
+		Sql_StopKeepalive(con->handle); // pinged by the pool thread
+		con->thread = std::thread(inter_sqlpool_run, con);
+		sqlpool.push_back(con);
+	}
+
+	add_timer_func_list(inter_sqlpool_timer, "inter_sqlpool_timer");
+	sqlpool_timer = add_timer_interval(gettick() + SQLPOOL_POLL_INTERVAL, inter_sqlpool_timer, 0, 0, SQLPOOL_POLL_INTERVAL);
+
+	ShowStatus("Running inter-server queries on a pool of %d SQL connections.\n", size);
+}
+
+/// Runs the queued queries and closes the pooled connections
+void inter_sqlpool_final(void)
+{
+	if( !inter_sqlpool_active() )
+		return;
+
+	sqlpool_running = false;
+	for( struct s_sqlpool_connection* con : sqlpool ) {
+		con->cv.notify_one();
+		con->thread.join();
+	}
+
+	delete_timer(sqlpool_timer, inter_sqlpool_timer);
+	sqlpool_timer = INVALID_TIMER;
+	inter_sqlpool_deliver();
+
+	for( struct s_sqlpool_connection* con : sqlpool ) {
+		Sql_Free(con->handle);
+		delete con;
+	}
+	sqlpool.clear();
+}
@@ -0,0 +1,47 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+#ifndef INTER_SQLPOOL_HPP
+#define INTER_SQLPOOL_HPP
+
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "../common/cbasetypes.hpp"
+
+/// Result of a query run by the connection pool
+struct s_sqlpool_result {
+	bool success;
+	uint64 affected_rows;
+	uint64 insert_id;
+	std::vector<std::vector<std::string>> rows; // NULL values are empty strings
+};
+
+/// Called on the main thread once the query is done
+typedef std::function<void(struct s_sqlpool_result& result)> sqlpool_callback;
+
+/// Statistics of the connection pool
+struct s_sqlpool_stats {
+	int connections;
+	size_t pending; // queued or running queries
+	uint64 queries;
+	uint64 failed;
+	uint64 max_wait; // longest time a query was queued, in microseconds
+	uint64 total_time; // time spent in the queries, in microseconds
+};
+
+extern int inter_sqlpool_size;
+
+void inter_sqlpool_init(void);
+void inter_sqlpool_final(void);
+bool inter_sqlpool_active(void);
+
+void inter_sqlpool_query(uint32 key, std::string query, sqlpool_callback callback);
+void inter_sqlpool_query_map(int fd, uint32 key, std::string query, std::function<void(int fd, struct s_sqlpool_result& result)> callback);
+std::future<struct s_sqlpool_result> inter_sqlpool_query(uint32 key, std::string query);
+
+void inter_sqlpool_get_stats(struct s_sqlpool_stats* stats);
+
+#endif /* INTER_SQLPOOL_HPP */
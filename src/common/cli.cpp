@@ -108,6 +108,13 @@ int cli_get_options(int argc, char ** argv) {
 			else if (strcmp(arg, "run-once") == 0) { // close the map-server as soon as its done.. for testing [Celest]
 				runflag = CORE_ST_STOP;
 			}
+			else if (strcmp(arg, "timer-wheel") == 0) {
+				timer_set_backend(TIMER_BACKEND_WHEEL);
+			}
+			else if (strcmp(arg, "timer-trace") == 0) {
+				if (opt_has_next_value(arg, i, argc))
+					timer_trace_open(argv[++i]);
+			}
 			else if (SERVER_TYPE & (ATHENA_SERVER_LOGIN | ATHENA_SERVER_CHAR)) { //login or char
 				if (strcmp(arg, "lan-config") == 0) {
 					if (opt_has_next_value(arg, i, argc))
@@ -504,6 +504,16 @@ struct hotkey {
 };
 #endif
 
+/// Parts of mmo_charstatus the char-server writes on a save (map->char 0x2b01)
+enum e_charsave_section : uint32 {
+	SAVESECTION_STATUS = 0x01, ///< Scalar fields, including the mercenary owner data
+	SAVESECTION_MEMO = 0x02,
+	SAVESECTION_SKILLS = 0x04,
+	SAVESECTION_FRIENDS = 0x08,
+	SAVESECTION_HOTKEYS = 0x10,
+	SAVESECTION_ALL = 0x1F,
+};
+
 struct mmo_charstatus {
 	uint32 char_id;
 	uint32 account_id;
@@ -4,6 +4,13 @@
 #include "socket.hpp"
 
 #include <stdlib.h>
+#include <vector>
+
+#ifdef SOCKET_EPOLL
+	#include <atomic>
+	#include <mutex>
+	#include <thread>
+#endif
 
 #ifdef WIN32
 	#include "winapi.hpp"
@@ -15,13 +22,16 @@
 	#include <sys/ioctl.h>
 	#include <sys/socket.h>
 	#include <sys/time.h>
+	#include <sys/uio.h>
 	#include <unistd.h>
 
 	#if defined(__linux__) || defined(__linux)
 		#include <linux/tcp.h>
 
 		#ifdef SOCKET_EPOLL
+			#include <poll.h>
 			#include <sys/epoll.h>
+			#include <sys/eventfd.h>
 		#endif
 	#else 
 		#include <netinet/in.h>
@@ -215,6 +225,34 @@ char* sErr(int code)
 	#define MSG_NOSIGNAL 0
 #endif
 
+// vectored send
+#ifdef WIN32
+typedef WSABUF send_iovec;
+#define IOVEC_SET(v,p,l) ((v).buf = (CHAR*)(p), (v).len = (ULONG)(l))
+
+static int sSendv(int fd, send_iovec* iov, int count)
+{
+	DWORD len = 0;
+
+	if( WSASend(fd2sock(fd), iov, count, &len, 0, NULL, NULL) == SOCKET_ERROR )
+		return SOCKET_ERROR;
+	return (int)len;
+}
+#else
+typedef struct iovec send_iovec;
+#define IOVEC_SET(v,p,l) ((v).iov_base = (void*)(p), (v).iov_len = (size_t)(l))
+
+static int sSendv(int fd, send_iovec* iov, int count)
+{
+	struct msghdr msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = count;
+	return (int)sendmsg(fd, &msg, MSG_NOSIGNAL);
+}
+#endif
+
 #ifndef SOCKET_EPOLL
 	// Select based Event Dispatcher
 	fd_set readfds;
@@ -260,6 +298,416 @@ static time_t socket_data_last_tick = 0;
 
 struct socket_data* session[MAXCONN];
 
+// size of a shared send chunk, any packet fits in an empty chunk
+#define SEND_CHUNK_SIZE (64*1024)
+// number of released chunks kept for reuse
+#define SEND_CHUNK_FREE_MAX 16
+// maximum number of buffers per vectored send
+#define SEND_IOV_MAX 64
+
+struct s_send_chunk {
+	uint32 refs; // queued segments and slices, +1 while it is the current chunk
+	uint32 used;
+	uint8 data[SEND_CHUNK_SIZE];
+};
+
+/// Part of a send queue, either a shared packet range or the next 'len' bytes of wdata
+struct s_send_segment {
+	struct s_send_chunk* chunk; // NULL for private data
+	uint32 offset, len;
+};
+
+/// Send queue of a session once shared packets were queued on it.
+/// Private data written after the last segment is sent after it.
+struct s_send_queue {
+	std::vector<struct s_send_segment> segments;
+	size_t sealed; // bytes of wdata covered by private segments
+};
+
+static struct s_send_queue send_queue[MAXCONN];
+static struct s_send_chunk* send_chunk_current = NULL; // chunk new packets are copied to
+static std::vector<struct s_send_chunk*> send_chunk_free;
+static struct s_send_stats send_stats;
+
+#ifdef SOCKET_EPOLL
+/////////////////////////////////////////////////////////////////////
+// I/O threads
+//
+// With io_threads set, a pool of threads waits on the epoll set and receives
+// the incoming data. Sockets are registered with EPOLLONESHOT so that only one
+// thread handles a socket at a time, the received data is handed to the main
+// thread through a lock-free queue and copied into the rdata fifo before the
+// session is parsed. Parsing and sending stay on the main thread.
+
+// maximum number of I/O threads
+#define IO_THREADS_MAX 16
+// size of a single recv call of an I/O thread
+#define IO_RECV_SIZE (16*1024)
+// a session is not read anymore while it has this many bytes not moved to its rdata fifo
+#define IO_PENDING_MAX (64*1024)
+
+enum e_io_event {
+	IO_RECV,   // data received
+	IO_EOF,    // connection closed or failed
+	IO_ACCEPT, // listen socket is readable
+};
+
+/// Event passed from an I/O thread to the main thread
+struct s_io_event {
+	std::atomic<struct s_io_event*> next;
+	int fd;
+	uint32 generation; // of the session when the event happened
+	enum e_io_event type;
+	uint32 len;
+	uint8 data[1];
+};
+
+/// I/O state of a socket.
+/// The lock is held by an I/O thread while it handles the socket and by the
+/// main thread when it registers, resumes or closes the socket.
+struct s_io_session {
+	std::mutex lock;
+	uint32 generation; // incremented when the socket is closed
+	bool active;       // registered in the epoll set
+	bool listen;
+	bool paused;       // not re-armed because too much data is pending
+	size_t pending;    // received bytes not yet moved to the rdata fifo
+	std::vector<uint8> backlog; // received data not fitting in the rdata fifo (main thread only)
+};
+
+static int io_threads = 0;
+static std::vector<std::thread> io_pool;
+static std::atomic<bool> io_running(false);
+static struct s_io_session io_session[MAXCONN];
+
+// multiple producer, single consumer queue of events (intrusive, Vyukov)
+static struct s_io_event io_queue_stub;
+static std::atomic<struct s_io_event*> io_queue_head(&io_queue_stub); // producers push here
+static struct s_io_event* io_queue_tail = &io_queue_stub;              // main thread pops here
+static std::atomic<bool> io_waiting(false); // main thread is waiting for events
+static int io_wakefd = -1;
+
+static void io_queue_push(struct s_io_event* ev)
+{
+	struct s_io_event* prev;
+
+	ev->next.store(NULL);
+	prev = io_queue_head.exchange(ev);
+	prev->next.store(ev);
+}
+
+static struct s_io_event* io_queue_pop(void)
+{
+	struct s_io_event* tail = io_queue_tail;
+	struct s_io_event* next = tail->next.load();
+
+	if( tail == &io_queue_stub )
+	{
+		if( next == NULL )
+			return NULL;
+		io_queue_tail = tail = next;
+		next = next->next.load();
+	}
+
+	if( next != NULL )
+	{
+		io_queue_tail = next;
+		return tail;
+	}
+
+	if( tail != io_queue_head.load() )
+		return NULL; // a push is in progress, it's picked up on the next pass
+
+	io_queue_push(&io_queue_stub);
+	next = tail->next.load();
+	if( next != NULL )
+	{
+		io_queue_tail = next;
+		return tail;
+	}
+
+	return NULL;
+}
+
+/// Hands an event to the main thread, called from the I/O threads.
+/// The memory manager is not thread-safe, events are allocated with malloc.
+static void io_post(int fd, enum e_io_event type, const uint8* data, size_t len)
+{
+	struct s_io_event* ev = (struct s_io_event*)malloc(sizeof(struct s_io_event) + len);
+
+	if( ev == NULL )
+		return;
+
+	new(&ev->next) std::atomic<struct s_io_event*>(NULL);
+	ev->fd = fd;
+	ev->generation = io_session[fd].generation;
+	ev->type = type;
+	ev->len = (uint32)len;
+	if( len > 0 )
+		memcpy(ev->data, data, len);
+
+	io_queue_push(ev);
+
+	if( io_waiting.exchange(false) )
+	{// wake up the main thread
+		uint64 one = 1;
+
+		if( write(io_wakefd, &one, sizeof(one)) < 0 )
+			;// the counter is already set
+	}
+}
+
+/// Re-arms a oneshot socket, the lock of the socket must be held
+static void io_arm(int fd)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.data.fd = fd;
+	ev.events = EPOLLIN|EPOLLONESHOT;
+	epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+/// Prepares a socket before adding it to the epoll set, returns the events to wait for
+static uint32 io_register(int fd, bool listen)
+{
+	struct s_io_session* io;
+
+	if( io_threads == 0 )
+		return EPOLLIN;
+
+	io = &io_session[fd];
+	std::lock_guard<std::mutex> guard(io->lock);
+
+	io->active = true;
+	io->listen = listen;
+	io->paused = false;
+	io->pending = 0;
+	io->backlog.clear();
+
+	return EPOLLIN|EPOLLONESHOT;
+}
+
+/// Removes a socket from the epoll set, once this returns no I/O thread uses the socket anymore
+static void io_unregister(int fd)
+{
+	struct s_io_session* io = &io_session[fd];
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.data.fd = fd;
+	ev.events = EPOLLIN;
+
+	std::lock_guard<std::mutex> guard(io->lock);
+
+	epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &ev); // removing the socket from epoll when it's being closed is not required but recommended
+	io->active = false;
+	io->generation++; // drop the events still queued for this socket
+	io->pending = 0;
+	io->backlog.clear();
+}
+
+/// Handles an epoll event in an I/O thread
+static void io_handle(int fd, uint32 events, uint8* buf)
+{
+	struct s_io_session* io = &io_session[fd];
+	int len;
+
+	std::lock_guard<std::mutex> guard(io->lock);
+
+	if( !io->active )
+		return; // closed in the meantime
+
+	if( io->listen )
+	{// accepted by the main thread, which re-arms it
+		io_post(fd, IO_ACCEPT, NULL, 0);
+		return;
+	}
+
+	if( (events & (EPOLLERR|EPOLLHUP)) || !(events & EPOLLIN) )
+	{
+		io_post(fd, IO_EOF, NULL, 0);
+		return;
+	}
+
+	len = sRecv(fd, (char *)buf, IO_RECV_SIZE, 0);
+
+	if( len == SOCKET_ERROR )
+	{
+		if( sErrno != S_EWOULDBLOCK )
+		{
+			io_post(fd, IO_EOF, NULL, 0);
+			return;
+		}
+	}
+	else if( len == 0 )
+	{//Normal connection end.
+		io_post(fd, IO_EOF, NULL, 0);
+		return;
+	}
+	else
+	{
+		io_post(fd, IO_RECV, buf, len);
+		io->pending += len;
+	}
+
+	if( io->pending < IO_PENDING_MAX )
+		io_arm(fd);
+	else
+		io->paused = true; // resumed by io_fill
+}
+
+static void io_worker(void)
+{
+	struct epoll_event events[64];
+	std::vector<uint8> buf(IO_RECV_SIZE);
+
+	while( io_running.load() )
+	{
+		// wakes up regularly to notice the shutdown
+		int ret = epoll_wait(epfd, events, ARRAYLENGTH(events), 100);
+
+		for( int i = 0; i < ret; i++ )
+			io_handle(events[i].data.fd, events[i].events, buf.data());
+	}
+}
+
+static void io_start(void)
+{
+	if( io_threads == 0 )
+		return;
+
+	io_wakefd = eventfd(0, EFD_NONBLOCK);
+	if( io_wakefd == -1 )
+	{
+		ShowError("socket_init: Failed to create the wakeup descriptor for the I/O threads (%s), using the main thread instead.\n", sErr(sErrno));
+		io_threads = 0;
+		return;
+	}
+
+	io_running.store(true);
+	for( int i = 0; i < io_threads; i++ )
+		io_pool.push_back(std::thread(io_worker));
+
+	ShowInfo("Server uses '" CL_WHITE "%d" CL_RESET "' I/O threads to receive data\n", io_threads);
+}
+
+static void io_stop(void)
+{
+	struct s_io_event* ev;
+
+	if( io_pool.empty() )
+		return;
+
+	io_running.store(false);
+	for( auto& thread : io_pool )
+		thread.join();
+	io_pool.clear();
+
+	while( (ev = io_queue_pop()) != NULL )
+		free(ev);
+
+	close(io_wakefd);
+	io_wakefd = -1;
+}
+
+/// Waits until an I/O thread posted an event or the timeout expired
+static void io_wait(t_tick timeout)
+{
+	struct pollfd pfd;
+	uint64 count;
+
+	io_waiting.store(true);
+
+	if( io_queue_head.load() == io_queue_tail )
+	{// nothing queued
+		pfd.fd = io_wakefd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		poll(&pfd, 1, (int)timeout);
+	}
+
+	io_waiting.store(false);
+
+	if( read(io_wakefd, &count, sizeof(count)) < 0 )
+		;// not signaled
+}
+
+/// Moves received data into the rdata fifo of a session
+static void io_fill(int fd)
+{
+	struct s_io_session* io = &io_session[fd];
+	struct socket_data* s = session[fd];
+	size_t len;
+
+	if( io->backlog.empty() )
+		return;
+
+	len = min(io->backlog.size(), RFIFOSPACE(fd));
+	if( len == 0 )
+		return;
+
+	memcpy(s->rdata + s->rdata_size, io->backlog.data(), len);
+	io->backlog.erase(io->backlog.begin(), io->backlog.begin() + len);
+	s->rdata_size += len;
+#ifdef SHOW_SERVER_STATS
+	socket_data_qi += len;
+#endif
+
+	std::lock_guard<std::mutex> guard(io->lock);
+
+	io->pending -= len;
+	if( io->paused && io->pending < IO_PENDING_MAX )
+	{
+		io->paused = false;
+		io_arm(fd);
+	}
+}
+
+/// Handles the events posted by the I/O threads
+static void io_dispatch(void)
+{
+	struct s_io_event* ev;
+
+	while( (ev = io_queue_pop()) != NULL )
+	{
+		int fd = ev->fd;
+
+		if( ev->generation == io_session[fd].generation && session[fd] != NULL )
+		{
+			switch( ev->type )
+			{
+				case IO_RECV:
+					io_session[fd].backlog.insert(io_session[fd].backlog.end(), ev->data, ev->data + ev->len);
+					session[fd]->rdata_tick = last_tick;
+#ifdef SHOW_SERVER_STATS
+					socket_data_i += ev->len;
+					if (!session[fd]->flag.server)
+					{
+						socket_data_ci += ev->len;
+					}
+#endif
+					io_fill(fd);
+					break;
+				case IO_EOF:
+					set_eof(fd);
+					break;
+				case IO_ACCEPT:
+					session[fd]->func_recv(fd);
+					if( session[fd] != NULL )
+					{
+						std::lock_guard<std::mutex> guard(io_session[fd].lock);
+						io_arm(fd);
+					}
+					break;
+			}
+		}
+
+		free(ev);
+	}
+}
+#endif
+
 #ifdef SEND_SHORTLIST
 int send_shortlist_array[MAXCONN];// we only support MAXCONN sockets, limit the array to that
 size_t send_shortlist_count = 0;// how many fd's are in the shortlist
@@ -401,6 +849,147 @@ int recv_to_fifo(int fd)
 	return 0;
 }
 
+/// Whether the session has data to send, private or shared
+static bool session_hasdata(int fd)
+{
+	return ( session[fd]->wdata_size > 0 || session[fd]->wdata_shared > 0 );
+}
+
+static void send_chunk_release(struct s_send_chunk* chunk)
+{
+	if( --chunk->refs > 0 )
+		return;
+
+	if( send_chunk_free.size() < SEND_CHUNK_FREE_MAX )
+		send_chunk_free.push_back(chunk);
+	else
+		aFree(chunk);
+}
+
+/// Copies a packet into the current chunk, starting a new chunk when it is full.
+static struct s_send_chunk* send_chunk_append(const void* buf, size_t len, uint32* offset)
+{
+	struct s_send_chunk* chunk = send_chunk_current;
+
+	if( chunk == NULL || chunk->used + len > SEND_CHUNK_SIZE )
+	{
+		if( chunk != NULL )
+			send_chunk_release(chunk);
+
+		if( !send_chunk_free.empty() )
+		{
+			chunk = send_chunk_free.back();
+			send_chunk_free.pop_back();
+		}
+		else
+			chunk = (struct s_send_chunk*)aMalloc(sizeof(struct s_send_chunk));
+
+		chunk->refs = 1;
+		chunk->used = 0;
+		send_chunk_current = chunk;
+	}
+
+	*offset = chunk->used;
+	memcpy(chunk->data + chunk->used, buf, len);
+	chunk->used += (uint32)len;
+
+	return chunk;
+}
+
+/// Drops all shared data queued on the session
+static void send_queue_clear(int fd)
+{
+	struct s_send_queue* queue = &send_queue[fd];
+
+	for( const auto& segment : queue->segments )
+	{
+		if( segment.chunk != NULL )
+			send_chunk_release(segment.chunk);
+	}
+	queue->segments.clear();
+	queue->sealed = 0;
+
+	if( session[fd] != NULL )
+		session[fd]->wdata_shared = 0;
+}
+
+/// Writes the queued segments and the private data after them with one vectored send
+static int send_queue_send(int fd)
+{
+	struct socket_data* s = session[fd];
+	struct s_send_queue* queue = &send_queue[fd];
+	send_iovec iov[SEND_IOV_MAX];
+	size_t i, pos = 0;
+	int count = 0;
+
+	for( i = 0; i < queue->segments.size() && count < SEND_IOV_MAX; i++ )
+	{
+		const struct s_send_segment& segment = queue->segments[i];
+
+		if( segment.chunk == NULL )
+		{
+			IOVEC_SET(iov[count], s->wdata + pos, segment.len);
+			pos += segment.len;
+		}
+		else
+			IOVEC_SET(iov[count], segment.chunk->data + segment.offset, segment.len);
+		count++;
+	}
+
+	// private data written after the last shared packet
+	if( i == queue->segments.size() && count < SEND_IOV_MAX && s->wdata_size > pos )
+	{
+		IOVEC_SET(iov[count], s->wdata + pos, s->wdata_size - pos);
+		count++;
+	}
+
+	return sSendv(fd, iov, count);
+}
+
+/// Removes 'len' sent bytes from the front of the send queue
+static void send_queue_consume(int fd, size_t len)
+{
+	struct socket_data* s = session[fd];
+	struct s_send_queue* queue = &send_queue[fd];
+	size_t i, private_len = 0;
+
+	for( i = 0; i < queue->segments.size() && len > 0; i++ )
+	{
+		struct s_send_segment& segment = queue->segments[i];
+		size_t n = min(len, (size_t)segment.len);
+
+		len -= n;
+		if( segment.chunk == NULL )
+		{
+			private_len += n;
+			queue->sealed -= n;
+		}
+		else
+			s->wdata_shared -= n;
+
+		if( n < segment.len )
+		{// partially sent
+			segment.offset += (uint32)n;
+			segment.len -= (uint32)n;
+			break;
+		}
+
+		if( segment.chunk != NULL )
+			send_chunk_release(segment.chunk);
+	}
+	queue->segments.erase(queue->segments.begin(), queue->segments.begin() + i);
+
+	// the rest came from the private data after the last segment
+	private_len += len;
+
+	if( private_len > 0 )
+	{
+		if( private_len < s->wdata_size )
+			memmove(s->wdata, s->wdata + private_len, s->wdata_size - private_len);
+		s->wdata_size -= private_len;
+	}
+}
+
 int send_from_fifo(int fd)
 {
 	int len;
@@ -408,19 +997,24 @@ int send_from_fifo(int fd)
 	if( !session_isValid(fd) )
 		return -1;
 
-	if( session[fd]->wdata_size == 0 )
+	if( !session_hasdata(fd) )
 		return 0; // nothing to send
 
-	len = sSend(fd, (const char *) session[fd]->wdata, (int)session[fd]->wdata_size, MSG_NOSIGNAL);
+	if( send_queue[fd].segments.empty() )
+		len = sSend(fd, (const char *) session[fd]->wdata, (int)session[fd]->wdata_size, MSG_NOSIGNAL);
+	else
+		len = send_queue_send(fd);
+	send_stats.syscalls++;
 
 	if( len == SOCKET_ERROR )
 	{//An exception has occured
 		if( sErrno != S_EWOULDBLOCK ) {
 			//ShowDebug("send_from_fifo: %s, ending connection #%d\n", error_msg(), fd);
 #ifdef SHOW_SERVER_STATS
-			socket_data_qo -= session[fd]->wdata_size;
+			socket_data_qo -= session[fd]->wdata_size + session[fd]->wdata_shared;
 #endif
 			session[fd]->wdata_size = 0; //Clear the send queue as we can't send anymore. [Skotlex]
+			send_queue_clear(fd);
 			set_eof(fd);
 		}
 		return 0;
@@ -429,13 +1023,19 @@ int send_from_fifo(int fd)
 	if( len > 0 )
 	{
 		session[fd]->wdata_tick = last_tick;
+		send_stats.bytes += len;
 
-		// some data could not be transferred?
-		// shift unsent data to the beginning of the queue
-		if( (size_t)len < session[fd]->wdata_size )
-			memmove(session[fd]->wdata, session[fd]->wdata + len, session[fd]->wdata_size - len);
+		if( !send_queue[fd].segments.empty() )
+			send_queue_consume(fd, len);
+		else
+		{
+			// some data could not be transferred?
+			// shift unsent data to the beginning of the queue
+			if( (size_t)len < session[fd]->wdata_size )
+				memmove(session[fd]->wdata, session[fd]->wdata + len, session[fd]->wdata_size - len);
 
-		session[fd]->wdata_size -= len;
+			session[fd]->wdata_size -= len;
+		}
 #ifdef SHOW_SERVER_STATS
 		socket_data_o += len;
 		socket_data_qo -= len;
@@ -508,7 +1108,7 @@ int connect_client(int listen_fd)
 #else
 	// Epoll based Event Dispatcher
 	epevent.data.fd = fd;
-	epevent.events = EPOLLIN;
+	epevent.events = io_register(fd, false);
 
 	if( epoll_ctl( epfd, EPOLL_CTL_ADD, fd, &epevent ) == SOCKET_ERROR ){
 		ShowError( "connect_client: Failed to add to epoll event dispatcher for new socket #%d: %s\n", fd, error_msg() );
@@ -575,7 +1175,7 @@ int make_listen_bind(uint32 ip, uint16 port)
 #else
 	// Epoll based Event Dispatcher
 	epevent.data.fd = fd;
-	epevent.events = EPOLLIN;
+	epevent.events = io_register(fd, true);
 
 	if( epoll_ctl( epfd, EPOLL_CTL_ADD, fd, &epevent ) == SOCKET_ERROR ){
 		ShowError( "make_listen_bind: failed to add listener socket #%d to epoll event dispatcher: %s\n", fd, error_msg() );
@@ -702,7 +1302,7 @@ int make_connection(uint32 ip, uint16 port, bool silent,int timeout) {
 #else
 	// Epoll based Event Dispatcher
 	epevent.data.fd = fd;
-	epevent.events = EPOLLIN;
+	epevent.events = io_register(fd, false);
 
 	if( epoll_ctl( epfd, EPOLL_CTL_ADD, fd, &epevent ) == SOCKET_ERROR ){
 		ShowError( "make_connection: failed to add socket #%d to epoll event dispatcher: %s\n", fd, error_msg() );
@@ -740,8 +1340,9 @@ static void delete_session(int fd)
 	{
 #ifdef SHOW_SERVER_STATS
 		socket_data_qi -= session[fd]->rdata_size - session[fd]->rdata_pos;
-		socket_data_qo -= session[fd]->wdata_size;
+		socket_data_qo -= session[fd]->wdata_size + session[fd]->wdata_shared;
 #endif
+		send_queue_clear(fd);
 		aFree(session[fd]->rdata);
 		aFree(session[fd]->wdata);
 		aFree(session[fd]->session_data);
@@ -866,6 +1467,7 @@ int WFIFOSET(int fd, size_t len)
 
 	}
 	s->wdata_size += len;
+	send_stats.packets++;
 #ifdef SHOW_SERVER_STATS
 	socket_data_qo += len;
 #endif
@@ -887,6 +1489,98 @@ int WFIFOSET(int fd, size_t len)
 	return 0;
 }
 
+/// Queues a packet that is sent to several sessions.
+/// The first call copies the packet into a shared chunk and the following calls
+/// with the same slice only queue a reference to it.
+/// Call WFIFOSHARE_END once the packet was queued for all sessions.
+int WFIFOSHARE(int fd, struct s_send_slice* slice, const void* buf, size_t len)
+{
+	struct socket_data* s;
+	struct s_send_queue* queue;
+
+	if( !session_isValid(fd) || session[fd]->wdata == NULL )
+		return 0;
+
+	s = session[fd];
+
+	if( len == 0 || len > 0xFFFF )
+	{
+		ShowError("WFIFOSHARE: Dropped packet 0x%04x with invalid length %" PRIuPTR ".\n", WBUFW(buf,0), len);
+		return 0;
+	}
+
+	if( !s->flag.server ) {
+
+		if( len > socket_max_client_packet ) {// see declaration of socket_max_client_packet for details
+			ShowError("WFIFOSHARE: Dropped too large client packet 0x%04x (length=%" PRIuPTR ", max=%" PRIuPTR ").\n", WBUFW(buf,0), len, socket_max_client_packet);
+			return 0;
+		}
+
+		if( s->wdata_size+s->wdata_shared+len > WFIFO_MAX ) {// reached maximum write fifo size
+			ShowError("WFIFOSHARE: Maximum write buffer size for client connection %d exceeded, most likely caused by packet 0x%04x (len=%" PRIuPTR ", ip=%lu.%lu.%lu.%lu).\n", fd, WBUFW(buf,0), len, CONVIP(s->client_addr));
+			set_eof(fd);
+			return 0;
+		}
+
+	}
+
+	if( slice->chunk == NULL )
+	{
+		slice->chunk = send_chunk_append(buf, len, &slice->offset);
+		slice->chunk->refs++; // held by the slice until WFIFOSHARE_END
+		slice->len = (uint32)len;
+	}
+
+	queue = &send_queue[fd];
+
+	// private data queued before this packet is sent first
+	if( s->wdata_size > queue->sealed )
+	{
+		queue->segments.push_back({ NULL, 0, (uint32)(s->wdata_size - queue->sealed) });
+		queue->sealed = s->wdata_size;
+	}
+
+	// packets copied one after another are merged into one buffer
+	if( !queue->segments.empty() && queue->segments.back().chunk == slice->chunk && queue->segments.back().offset + queue->segments.back().len == slice->offset )
+		queue->segments.back().len += slice->len;
+	else
+	{
+		queue->segments.push_back({ slice->chunk, slice->offset, slice->len });
+		slice->chunk->refs++;
+	}
+
+	s->wdata_shared += len;
+	send_stats.packets++;
+	send_stats.shared++;
+#ifdef SHOW_SERVER_STATS
+	socket_data_qo += len;
+#endif
+
+#ifdef SEND_SHORTLIST
+	send_shortlist_add_fd(fd);
+#endif
+
+	return 0;
+}
+
+/// Releases the reference of the slice on its shared chunk
+void WFIFOSHARE_END(struct s_send_slice* slice)
+{
+	if( slice->chunk != NULL )
+		send_chunk_release(slice->chunk);
+	slice->chunk = NULL;
+}
+
+void socket_get_send_stats(struct s_send_stats* stats)
+{
+	*stats = send_stats;
+}
+
+void socket_reset_send_stats(void)
+{
+	memset(&send_stats, 0, sizeof(send_stats));
+}
+
 int do_sockets(t_tick next)
 {
 #ifndef SOCKET_EPOLL
@@ -905,7 +1599,7 @@ int do_sockets(t_tick next)
 		if(!session[i])
 			continue;
 
-		if(session[i]->wdata_size)
+		if(session_hasdata(i))
 			session[i]->func_send(i);
 	}
 #endif
@@ -932,7 +1626,13 @@ int do_sockets(t_tick next)
 #else
 	// Epoll based Event Dispatcher
 
-	ret = epoll_wait( epfd, epevents, epoll_maxevents, next );
+	if( io_threads > 0 )
+	{// data is received by the I/O threads
+		io_wait(next);
+		ret = 0;
+	}
+	else
+		ret = epoll_wait( epfd, epevents, epoll_maxevents, next );
 
 	if( ret == SOCKET_ERROR ){
 		if( sErrno != S_EINTR ){
@@ -957,6 +1657,9 @@ int do_sockets(t_tick next)
 #elif defined(SOCKET_EPOLL)
 	// epoll based selection
 
+	if( io_threads > 0 )
+		io_dispatch();
+
 	for( i = 0; i < ret; i++ ){
 		struct epoll_event *it = &epevents[i];
 		int fd = it->data.fd;
@@ -995,7 +1698,7 @@ int do_sockets(t_tick next)
 		if(!session[i])
 			continue;
 
-		if(session[i]->wdata_size)
+		if(session_hasdata(i))
 			session[i]->func_send(i);
 
 		if(session[i]->flag.eof) //func_send can't free a session, this is safe.
@@ -1021,6 +1724,11 @@ int do_sockets(t_tick next)
 			}
 		}
 
+#ifdef SOCKET_EPOLL
+		if( io_threads > 0 )
+			io_fill(i);
+#endif
+
 		session[i]->func_parse(i);
 
 		if(!session[i])
@@ -1356,6 +2064,16 @@ int socket_config_read(const char* cfgName)
 			}
 		}
 #endif
+#endif
+#ifdef SOCKET_EPOLL
+		else if( !strcmpi( w1, "io_threads" ) ){
+			io_threads = atoi(w2);
+
+			if( io_threads < 0 || io_threads > IO_THREADS_MAX ){
+				ShowWarning( "socket_config_read: io_threads must be between 0 and %d, defaulting to 0...\n", IO_THREADS_MAX );
+				io_threads = 0;
+			}
+		}
 #endif
 		else if (!strcmpi(w1, "import"))
 			socket_config_read(w2);
@@ -1389,6 +2107,10 @@ void socket_final(void)
 		aFree(access_deny);
 #endif
 
+#ifdef SOCKET_EPOLL
+	io_stop();
+#endif
+
 	for( i = 1; i < fd_max; i++ )
 		if(session[i])
 			do_close(i);
@@ -1400,6 +2122,14 @@ void socket_final(void)
 	aFree(session[0]);
 	session[0] = NULL;
 
+	// shared send chunks
+	if( send_chunk_current != NULL )
+		send_chunk_release(send_chunk_current);
+	send_chunk_current = NULL;
+	for( auto chunk : send_chunk_free )
+		aFree(chunk);
+	send_chunk_free.clear();
+
 #ifdef WIN32
 	// Shut down windows networking
 	if( WSACleanup() != 0 ){
@@ -1431,9 +2161,13 @@ void do_close(int fd)
 	sFD_CLR(fd, &readfds);// this needs to be done before closing the socket
 #else
 	// Epoll based Event Dispatcher
-	epevent.data.fd = fd;
-	epevent.events = EPOLLIN;
-	epoll_ctl( epfd, EPOLL_CTL_DEL, fd, &epevent ); // removing the socket from epoll when it's being closed is not required but recommended
+	if( io_threads > 0 )
+		io_unregister(fd);
+	else {
+		epevent.data.fd = fd;
+		epevent.events = EPOLLIN;
+		epoll_ctl( epfd, EPOLL_CTL_DEL, fd, &epevent ); // removing the socket from epoll when it's being closed is not required but recommended
+	}
 #endif
 
 	sShutdown(fd, SHUT_RDWR); // Disallow further reads/writes
@@ -1605,6 +2339,10 @@ void socket_init(void)
 
 	socket_config_read(SOCKET_CONF_FILENAME);
 
+#ifdef SOCKET_EPOLL
+	io_start();
+#endif
+
 	// initialise last send-receive tick
 	last_tick = time(NULL);
 
@@ -1695,6 +2433,7 @@ void send_shortlist_add_fd(int fd)
 void send_shortlist_do_sends()
 {
 	int i;
+	uint64 syscalls = send_stats.syscalls;
 
 	for( i = send_shortlist_count-1; i >= 0; --i )
 	{
@@ -1723,7 +2462,7 @@ void send_shortlist_do_sends()
 		if( session[fd] )
 		{
 			// Send data
-			if( session[fd]->wdata_size )
+			if( session_hasdata(fd) )
 				session[fd]->func_send(fd);
 
 			// If it's been marked as eof, call the parse func on it so that
@@ -1733,9 +2472,12 @@ void send_shortlist_do_sends()
 
 			// If the session still exists, is not eof and has things left to
 			// be sent from it we'll re-add it to the shortlist.
-			if( session_isActive(fd) && session[fd]->wdata_size )
+			if( session_isActive(fd) && session_hasdata(fd) )
 				send_shortlist_add_fd(fd);
 		}
 	}
+
+	if( send_stats.syscalls != syscalls )
+		send_stats.flushes++;
 }
 #endif
@@ -97,6 +97,7 @@ struct socket_data
 	size_t max_rdata, max_wdata;
 	size_t rdata_size, wdata_size;
 	size_t rdata_pos;
+	size_t wdata_shared; // bytes queued in shared send chunks, see WFIFOSHARE
 	time_t rdata_tick; // time of last recv (for detecting timeouts); zero when timeout is disabled
 	time_t wdata_tick; // time of last send (for detecting timeouts);
 
@@ -132,6 +133,28 @@ int realloc_writefifo(int fd, size_t addition);
 int WFIFOSET(int fd, size_t len);
 int RFIFOSKIP(int fd, size_t len);
 
+/// A packet sent to several sessions is copied once into a reference counted
+/// send chunk, each session then queues a slice of it instead of its own copy.
+/// Queued slices and private data are written with one vectored send per session.
+struct s_send_chunk;
+struct s_send_slice {
+	struct s_send_chunk* chunk; // NULL until the packet has been copied
+	uint32 offset, len;
+};
+int WFIFOSHARE(int fd, struct s_send_slice* slice, const void* buf, size_t len);
+void WFIFOSHARE_END(struct s_send_slice* slice);
+
+/// Outgoing traffic counters
+struct s_send_stats {
+	uint64 flushes;  // send passes which wrote to at least one session
+	uint64 syscalls; // send calls, one per session and pass
+	uint64 bytes;    // bytes written
+	uint64 packets;  // packets queued
+	uint64 shared;   // packets queued as a slice of a shared chunk
+};
+void socket_get_send_stats(struct s_send_stats* stats);
+void socket_reset_send_stats(void);
+
 int do_sockets(t_tick next);
 void do_close(int fd);
 void socket_init(void);
@@ -7,8 +7,12 @@
 #include "winapi.hpp"
 #endif
 
+#include <chrono>
+#include <list>
 #include <mysql.h>
 #include <stdlib.h>// strtoul
+#include <string>
+#include <unordered_map>
 
 #include "cbasetypes.hpp"
 #include "malloc.hpp"
@@ -30,6 +34,23 @@ void ra_mysql_error_handler(unsigned int ecode);
 int mysql_reconnect_type;
 unsigned int mysql_reconnect_count;
 
+/// Number of idle prepared statements kept per connection
+#define SQL_STMT_CACHE_SIZE 64
+
+/// Prepared statements of a connection that are not in use, by query text
+struct s_sql_stmt_cache
+{
+	struct s_entry {
+		std::string query;
+		MYSQL_STMT* stmt;
+	};
+
+	std::list<s_entry> lru; // most recently released first
+	std::unordered_multimap<std::string, std::list<s_entry>::iterator> index;
+	unsigned long connection; // mysql_thread_id the statements were prepared on
+	struct s_sql_stmt_cache_stats stats;
+};
+
 /// Sql handle
 struct Sql
 {
@@ -39,6 +60,7 @@ struct Sql
 	MYSQL_ROW row;
 	unsigned long* lengths;
 	int keepalive;
+	struct s_sql_stmt_cache* stmt_cache;
 };
 
 
@@ -58,7 +80,10 @@ typedef struct s_column_length s_column_length;
 struct SqlStmt
 {
 	StringBuf buf;
-	MYSQL_STMT* stmt;
+	Sql* sql;
+	MYSQL_STMT* stmt; // NULL until prepared
+	bool cached; // stmt is prepared with buf and goes back to the cache
+	unsigned long connection; // mysql_thread_id stmt was prepared on
 	MYSQL_BIND* params;
 	MYSQL_BIND* columns;
 	s_column_length* column_lengths;
@@ -87,6 +112,7 @@ Sql* Sql_Malloc(void)
 	self->lengths = NULL;
 	self->result = NULL;
 	self->keepalive = INVALID_TIMER;
+	self->stmt_cache = new s_sql_stmt_cache();
 	my_bool reconnect = 1;
 	mysql_options(&self->handle, MYSQL_OPT_RECONNECT, &reconnect);
 	return self;
@@ -338,6 +364,110 @@ int Sql_QueryStr(Sql* self, const char* query)
 
 
 
+/// Executes a query and discards its result.
+int Sql_ExecuteStr(Sql* self, const char* query, size_t len)
+{
+	MYSQL_RES* result;
+
+	if( self == NULL )
+		return SQL_ERROR;
+
+	if( mysql_real_query(&self->handle, query, (unsigned long)len) )
+	{
+		ShowSQL("DB error - %s\n", mysql_error(&self->handle));
+		ra_mysql_error_handler(mysql_errno(&self->handle));
+		return SQL_ERROR;
+	}
+	result = mysql_store_result(&self->handle);
+	if( result != NULL )
+		mysql_free_result(result);
+	if( mysql_errno(&self->handle) != 0 )
+	{
+		ShowSQL("DB error - %s\n", mysql_error(&self->handle));
+		ra_mysql_error_handler(mysql_errno(&self->handle));
+		return SQL_ERROR;
+	}
+	return SQL_SUCCESS;
+}
+
+
+
+/// Executes a query and copies the rows of its result.
+int Sql_ExecuteStr(Sql* self, const char* query, size_t len, std::vector<std::vector<std::string>>& out_rows)
+{
+	MYSQL_RES* result;
+	MYSQL_ROW row;
+
+	out_rows.clear();
+	if( self == NULL )
+		return SQL_ERROR;
+
+	if( mysql_real_query(&self->handle, query, (unsigned long)len) )
+	{
+		ShowSQL("DB error - %s\n", mysql_error(&self->handle));
+		ra_mysql_error_handler(mysql_errno(&self->handle));
+		return SQL_ERROR;
+	}
+	result = mysql_store_result(&self->handle);
+	if( result == NULL )
+	{
+		if( mysql_errno(&self->handle) != 0 )
+		{
+			ShowSQL("DB error - %s\n", mysql_error(&self->handle));
+			ra_mysql_error_handler(mysql_errno(&self->handle));
+			return SQL_ERROR;
+		}
+		return SQL_SUCCESS;// no result set
+	}
+
+	unsigned int fields = mysql_num_fields(result);
+
+	out_rows.reserve((size_t)mysql_num_rows(result));
+	while( (row = mysql_fetch_row(result)) != NULL )
+	{
+		unsigned long* lengths = mysql_fetch_lengths(result);
+
+		out_rows.emplace_back(fields);
+		for( unsigned int i = 0; i < fields; ++i )
+		{
+			if( row[i] != NULL )
+				out_rows.back()[i].assign(row[i], lengths[i]);
+		}
+	}
+	mysql_free_result(result);
+	return SQL_SUCCESS;
+}
+
+
+
+/// Stops the periodic ping of the connection.
+void Sql_StopKeepalive(Sql* self)
+{
+	if( self && self->keepalive != INVALID_TIMER )
+	{
+		delete_timer(self->keepalive, Sql_P_KeepaliveTimer);
+		self->keepalive = INVALID_TIMER;
+	}
+}
+
+
+
+/// Prepares the client library for the calling thread.
+void Sql_ThreadInit(void)
+{
+	mysql_thread_init();
+}
+
+
+
+/// Releases the client library data of the calling thread.
+void Sql_ThreadEnd(void)
+{
+	mysql_thread_end();
+}
+
+
+
 /// Returns the number of the AUTO_INCREMENT column of the last INSERT/UPDATE query.
 uint64 Sql_LastInsertId(Sql* self)
 {
@@ -448,6 +578,125 @@ void Sql_ShowDebug_(Sql* self, const char* debug_file, const unsigned long debug
 
 
 
+/// Closes the cached statements of the connection.
+///
+/// @private
+static void Sql_P_StmtCacheClear(Sql* self)
+{
+	struct s_sql_stmt_cache* cache = self->stmt_cache;
+
+	for( auto& entry : cache->lru )
+		mysql_stmt_close(entry.stmt);
+	cache->lru.clear();
+	cache->index.clear();
+}
+
+
+
+/// Takes an idle statement prepared with the query out of the cache.
+/// The cache is dropped when the connection was re-established since the statements were prepared.
+///
+/// @return the statement or NULL
+/// @private
+static MYSQL_STMT* Sql_P_StmtCacheTake(Sql* self, const char* query)
+{
+	struct s_sql_stmt_cache* cache = self->stmt_cache;
+	unsigned long connection = mysql_thread_id(&self->handle);
+	MYSQL_STMT* stmt;
+
+	if( cache->connection != connection )
+	{// prepared statements don't survive a reconnect
+		Sql_P_StmtCacheClear(self);
+		cache->connection = connection;
+		return NULL;
+	}
+
+	auto it = cache->index.find(query);
+	if( it == cache->index.end() )
+		return NULL;
+
+	stmt = it->second->stmt;
+	cache->lru.erase(it->second);
+	cache->index.erase(it);
+	return stmt;
+}
+
+
+
+/// Gives a statement that is no longer used back to the cache, evicting the least recently used one when full.
+///
+/// @private
+static void Sql_P_StmtCacheStore(Sql* self, const char* query, MYSQL_STMT* stmt, unsigned long connection)
+{
+	struct s_sql_stmt_cache* cache = self->stmt_cache;
+
+	if( connection != cache->connection || connection != mysql_thread_id(&self->handle) )
+	{// prepared on a previous connection
+		mysql_stmt_close(stmt);
+		return;
+	}
+
+	mysql_stmt_free_result(stmt);
+	cache->lru.push_front({ query, stmt });
+	cache->index.emplace(cache->lru.front().query, cache->lru.begin());
+
+	if( cache->lru.size() > SQL_STMT_CACHE_SIZE )
+	{
+		auto last = std::prev(cache->lru.end());
+		auto range = cache->index.equal_range(last->query);
+
+		for( auto it = range.first; it != range.second; ++it )
+		{
+			if( it->second == last )
+			{
+				cache->index.erase(it);
+				break;
+			}
+		}
+		mysql_stmt_close(last->stmt);
+		cache->lru.erase(last);
+		cache->stats.evictions++;
+	}
+}
+
+
+
+/// Retrieves the statistics of the prepared statement cache.
+void Sql_GetStmtCacheStats(Sql* self, struct s_sql_stmt_cache_stats* out_stats)
+{
+	if( self && out_stats )
+	{
+		*out_stats = self->stmt_cache->stats;
+		out_stats->idle = self->stmt_cache->lru.size();
+	}
+}
+
+
+
+/// Shows the statistics of the prepared statement cache.
+void Sql_ShowStmtCacheStats(Sql* self, const char* name)
+{
+	struct s_sql_stmt_cache_stats stats;
+	uint64 prepares;
+
+	if( self == NULL )
+		return;
+
+	Sql_GetStmtCacheStats(self, &stats);
+	prepares = stats.hits + stats.misses;
+	if( prepares == 0 )
+	{
+		ShowInfo("SQL statement cache (%s): no statements prepared yet.\n", name);
+		return;
+	}
+
+	ShowInfo("SQL statement cache (%s): %" PRIu64 " prepares, %.1f%% hits, %" PRIu64 " evictions, %" PRIu64 " re-prepared after reconnects, ~%" PRIu64 " ms of preparing saved.\n",
+		name, prepares, 100.0 * stats.hits / prepares, stats.evictions, stats.reprepares,
+		stats.misses ? stats.hits * stats.prepare_time / stats.misses / 1000 : 0);
+}
+
+
+
 /// Frees a Sql handle returned by Sql_Malloc.
 void Sql_Free(Sql* self)
 {
@@ -456,6 +705,8 @@ void Sql_Free(Sql* self)
 		Sql_FreeResult(self);
 		StringBuf_Destroy(&self->buf);
 		if( self->keepalive != INVALID_TIMER ) delete_timer(self->keepalive, Sql_P_KeepaliveTimer);
+		Sql_P_StmtCacheClear(self);
+		delete self->stmt_cache;
 		aFree(self);
 	}
 }
@@ -625,24 +876,83 @@ static void SqlStmt_P_ShowDebugTruncatedColumn(SqlStmt* self, size_t i)
 
 
 
+/// Gives the prepared statement back to the connection's cache, or closes it.
+///
+/// @private
+static void SqlStmt_P_Release(SqlStmt* self)
+{
+	if( self->stmt == NULL )
+		return;
+
+	if( self->cached )
+		Sql_P_StmtCacheStore(self->sql, StringBuf_Value(&self->buf), self->stmt, self->connection);
+	else
+		mysql_stmt_close(self->stmt);
+	self->stmt = NULL;
+	self->cached = false;
+}
+
+
+
+/// Prepares the query in buf, reusing an idle statement of the connection when one was prepared with the same text.
+///
+/// @private
+static int SqlStmt_P_Prepare(SqlStmt* self)
+{
+	struct s_sql_stmt_cache_stats* stats = &self->sql->stmt_cache->stats;
+	const char* query = StringBuf_Value(&self->buf);
+
+	self->bind_params = false;
+	self->stmt = Sql_P_StmtCacheTake(self->sql, query);
+	self->connection = self->sql->stmt_cache->connection;
+	if( self->stmt != NULL )
+	{
+		stats->hits++;
+		self->cached = true;
+		return SQL_SUCCESS;
+	}
+
+	self->stmt = mysql_stmt_init(&self->sql->handle);
+	if( self->stmt == NULL )
+	{
+		ShowSQL("DB error - %s\n", mysql_error(&self->sql->handle));
+		return SQL_ERROR;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	if( mysql_stmt_prepare(self->stmt, query, (unsigned long)StringBuf_Length(&self->buf)) )
+	{
+		ShowSQL("DB error - %s\n", mysql_stmt_error(self->stmt));
+		ra_mysql_error_handler(mysql_stmt_errno(self->stmt));
+		mysql_stmt_close(self->stmt);
+		self->stmt = NULL;
+		return SQL_ERROR;
+	}
+	stats->misses++;
+	stats->prepare_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	self->cached = true;
+
+	return SQL_SUCCESS;
+}
+
+
+
 /// Allocates and initializes a new SqlStmt handle.
+/// The MySQL statement itself is taken from the connection's cache or created on prepare.
 SqlStmt* SqlStmt_Malloc(Sql* sql)
 {
 	SqlStmt* self;
-	MYSQL_STMT* stmt;
 
 	if( sql == NULL )
 		return NULL;
 
-	stmt = mysql_stmt_init(&sql->handle);
-	if( stmt == NULL )
-	{
-		ShowSQL("DB error - %s\n", mysql_error(&sql->handle));
-		return NULL;
-	}
 	CREATE(self, SqlStmt, 1);
 	StringBuf_Init(&self->buf);
-	self->stmt = stmt;
+	self->sql = sql;
+	self->stmt = NULL;
+	self->cached = false;
+	self->connection = 0;
 	self->params = NULL;
 	self->columns = NULL;
 	self->column_lengths = NULL;
@@ -678,17 +988,11 @@ int SqlStmt_PrepareV(SqlStmt* self, const char* query, va_list args)
 		return SQL_ERROR;
 
 	SqlStmt_FreeResult(self);
+	SqlStmt_P_Release(self);
 	StringBuf_Clear(&self->buf);
 	StringBuf_Vprintf(&self->buf, query, args);
-	if( mysql_stmt_prepare(self->stmt, StringBuf_Value(&self->buf), (unsigned long)StringBuf_Length(&self->buf)) )
-	{
-		ShowSQL("DB error - %s\n", mysql_stmt_error(self->stmt));
-		ra_mysql_error_handler(mysql_stmt_errno(self->stmt));
-		return SQL_ERROR;
-	}
-	self->bind_params = false;
 
-	return SQL_SUCCESS;
+	return SqlStmt_P_Prepare(self);
 }
 
 
@@ -700,17 +1004,11 @@ int SqlStmt_PrepareStr(SqlStmt* self, const char* query)
 		return SQL_ERROR;
 
 	SqlStmt_FreeResult(self);
+	SqlStmt_P_Release(self);
 	StringBuf_Clear(&self->buf);
 	StringBuf_AppendStr(&self->buf, query);
-	if( mysql_stmt_prepare(self->stmt, StringBuf_Value(&self->buf), (unsigned long)StringBuf_Length(&self->buf)) )
-	{
-		ShowSQL("DB error - %s\n", mysql_stmt_error(self->stmt));
-		ra_mysql_error_handler(mysql_stmt_errno(self->stmt));
-		return SQL_ERROR;
-	}
-	self->bind_params = false;
 
-	return SQL_SUCCESS;
+	return SqlStmt_P_Prepare(self);
 }
 
 
@@ -718,7 +1016,7 @@ int SqlStmt_PrepareStr(SqlStmt* self, const char* query)
 /// Returns the number of parameters in the prepared statement.
 size_t SqlStmt_NumParams(SqlStmt* self)
 {
-	if( self )
+	if( self && self->stmt )
 		return (size_t)mysql_stmt_param_count(self->stmt);
 	else
 		return 0;
@@ -757,18 +1055,40 @@ int SqlStmt_BindParam(SqlStmt* self, size_t idx, enum SqlDataType buffer_type, v
 
 
 /// Executes the prepared statement.
+/// A statement that was lost with its connection is prepared again and executed once more.
 int SqlStmt_Execute(SqlStmt* self)
 {
-	if( self == NULL )
+	if( self == NULL || self->stmt == NULL )
 		return SQL_ERROR;
 
 	SqlStmt_FreeResult(self);
 	if( (self->bind_params && mysql_stmt_bind_param(self->stmt, self->params)) ||
 		mysql_stmt_execute(self->stmt) )
 	{
-		ShowSQL("DB error - %s\n", mysql_stmt_error(self->stmt));
-		ra_mysql_error_handler(mysql_stmt_errno(self->stmt));
-		return SQL_ERROR;
+		unsigned int err = mysql_stmt_errno(self->stmt);
+
+		// 1243 = ER_UNKNOWN_STMT_HANDLER, 2006 = CR_SERVER_GONE_ERROR, 2056 = CR_STMT_CLOSED
+		if( (err == 1243 || err == 2006 || err == 2056) && mysql_ping(&self->sql->handle) == 0 )
+		{
+			bool bind_params = self->bind_params;
+
+			mysql_stmt_close(self->stmt);
+			self->stmt = NULL;
+			self->cached = false;
+			if( SqlStmt_P_Prepare(self) == SQL_ERROR )
+				return SQL_ERROR;
+			self->sql->stmt_cache->stats.reprepares++;
+			self->bind_params = bind_params;
+			if( !(self->bind_params && mysql_stmt_bind_param(self->stmt, self->params)) &&
+				!mysql_stmt_execute(self->stmt) )
+				err = 0;
+		}
+		if( err )
+		{
+			ShowSQL("DB error - %s\n", mysql_stmt_error(self->stmt));
+			ra_mysql_error_handler(mysql_stmt_errno(self->stmt));
+			return SQL_ERROR;
+		}
 	}
 	self->bind_columns = false;
 	if( mysql_stmt_store_result(self->stmt) )// store all the data
@@ -786,7 +1106,7 @@ int SqlStmt_Execute(SqlStmt* self)
 /// Returns the number of the AUTO_INCREMENT column of the last INSERT/UPDATE statement.
 uint64 SqlStmt_LastInsertId(SqlStmt* self)
 {
-	if( self )
+	if( self && self->stmt )
 		return (uint64)mysql_stmt_insert_id(self->stmt);
 	else
 		return 0;
@@ -797,7 +1117,7 @@ uint64 SqlStmt_LastInsertId(SqlStmt* self)
 /// Returns the number of columns in each row of the result.
 size_t SqlStmt_NumColumns(SqlStmt* self)
 {
-	if( self )
+	if( self && self->stmt )
 		return (size_t)mysql_stmt_field_count(self->stmt);
 	else
 		return 0;
@@ -854,7 +1174,7 @@ int SqlStmt_BindColumn(SqlStmt* self, size_t idx, enum SqlDataType buffer_type,
 /// Returns the number of rows in the result.
 uint64 SqlStmt_NumRows(SqlStmt* self)
 {
-	if( self )
+	if( self && self->stmt )
 		return (uint64)mysql_stmt_num_rows(self->stmt);
 	else
 		return 0;
@@ -869,7 +1189,7 @@ int SqlStmt_NextRow(SqlStmt* self)
 	size_t i;
 	size_t cols;
 
-	if( self == NULL )
+	if( self == NULL || self->stmt == NULL )
 		return SQL_ERROR;
 
 	// bind columns
@@ -956,7 +1276,7 @@ int SqlStmt_NextRow(SqlStmt* self)
 /// Frees the result of the statement execution.
 void SqlStmt_FreeResult(SqlStmt* self)
 {
-	if( self )
+	if( self && self->stmt )
 		mysql_stmt_free_result(self->stmt);
 }
 
@@ -981,8 +1301,8 @@ void SqlStmt_Free(SqlStmt* self)
 	if( self )
 	{
 		SqlStmt_FreeResult(self);
+		SqlStmt_P_Release(self);
 		StringBuf_Destroy(&self->buf);
-		mysql_stmt_close(self->stmt);
 		if( self->params )
 			aFree(self->params);
 		if( self->columns )
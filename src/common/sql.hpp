@@ -5,6 +5,8 @@
 #define SQL_HPP
 
 #include <stdarg.h>// va_list
+#include <string>
+#include <vector>
 
 #include "cbasetypes.hpp"
 
@@ -154,6 +156,59 @@ int Sql_QueryStr(Sql* self, const char* query);
 
 
 
+/// Executes a query and discards its result.
+/// Neither the handle's buffer nor the memory manager are used, so the thread
+/// owning the connection can call it (see Sql_StopKeepalive).
+///
+/// @return SQL_SUCCESS or SQL_ERROR
+int Sql_ExecuteStr(Sql* self, const char* query, size_t len);
+
+
+
+/// Executes a query and copies the rows of its result, NULL values are returned as empty strings.
+/// Like the above, the thread owning the connection can call it.
+///
+/// @return SQL_SUCCESS or SQL_ERROR
+int Sql_ExecuteStr(Sql* self, const char* query, size_t len, std::vector<std::vector<std::string>>& out_rows);
+
+
+
+/// Stops the periodic ping of the connection.
+/// For connections used by another thread, which has to call Sql_Ping itself.
+void Sql_StopKeepalive(Sql* self);
+
+
+
+/// Prepares/releases the client library for a thread other than the main thread.
+void Sql_ThreadInit(void);
+void Sql_ThreadEnd(void);
+
+
+
+/// Statistics of the prepared statements a connection keeps for reuse.
+/// SqlStmt handles hand their statement back to the connection when they are prepared again or freed,
+/// so a later SqlStmt with the same query text skips the prepare round-trip.
+struct s_sql_stmt_cache_stats {
+	uint64 hits; // prepares served from the cache
+	uint64 misses; // prepares sent to the server
+	uint64 evictions; // idle statements closed to make room
+	uint64 reprepares; // statements prepared again after the connection was lost
+	uint64 prepare_time; // time spent in the server prepares, in microseconds
+	size_t idle; // statements currently in the cache
+};
+
+
+
+/// Retrieves the statistics of the connection's prepared statement cache.
+void Sql_GetStmtCacheStats(Sql* self, struct s_sql_stmt_cache_stats* out_stats);
+
+
+
+/// Shows the hit rate and estimated time saved by the connection's prepared statement cache.
+void Sql_ShowStmtCacheStats(Sql* self, const char* name);
+
+
+
 /// Returns the number of the AUTO_INCREMENT column of the last INSERT/UPDATE query.
 ///
 /// @return Value of the auto-increment column
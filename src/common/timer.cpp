@@ -3,8 +3,14 @@
 
 #include "timer.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #ifdef WIN32
 #include "winapi.hpp" // GetTickCount()
@@ -47,6 +53,32 @@ static int free_timer_list_pos = 0;
 // timer heap (binary heap of tid's)
 static BHEAP_VAR(int, timer_heap);
 
+// Hierarchical timing wheel: level 0 has one slot per millisecond, every
+// further level has slots as wide as the whole previous level.
+#define TIMER_WHEEL_BITS0 8
+#define TIMER_WHEEL_BITSN 6
+#define TIMER_WHEEL_SIZE0 (1 << TIMER_WHEEL_BITS0)
+#define TIMER_WHEEL_SIZEN (1 << TIMER_WHEEL_BITSN)
+#define TIMER_WHEEL_LEVELS 5 // 8 + 4*6 bits = 2^32 ms ahead
+#define TIMER_WHEEL_SLOTS (TIMER_WHEEL_SIZE0 + (TIMER_WHEEL_LEVELS - 1) * TIMER_WHEEL_SIZEN)
+
+// wheel links, parallel to timer_data
+struct timer_wheel_link {
+	int next;
+	int prev;
+	int slot; // -1 when the timer is not in the wheel
+};
+
+static struct timer_wheel_link* timer_link = NULL;
+static int timer_wheel_head[TIMER_WHEEL_SLOTS];
+static int timer_wheel_tail[TIMER_WHEEL_SLOTS];
+static t_tick timer_wheel_tick = 0; // next millisecond to process
+
+static enum e_timer_backend timer_backend = TIMER_BACKEND_HEAP;
+
+// timer operation trace, replayed by the timerbench tool
+static FILE* timer_trace = NULL;
+
 
 // server startup time
 time_t start_time;
@@ -59,8 +91,30 @@ struct timer_func_list {
 	struct timer_func_list* next;
 	TimerFunc func;
 	char* name;
+	struct TimerProfile profile;
 } *tfl_root = NULL;
 
+// timer function -> list entry, for the profiler
+static std::unordered_map<TimerFunc, struct timer_func_list*> tfl_index;
+static bool timer_profile = false;
+
+/// Creates a list entry for a timer function.
+static struct timer_func_list* create_timer_func_list(TimerFunc func, const char* name)
+{
+	struct timer_func_list* tfl;
+
+	CREATE(tfl,struct timer_func_list,1);
+	tfl->next = tfl_root;
+	tfl->func = func;
+	tfl->name = aStrdup(name);
+	tfl->profile.func = func;
+	tfl->profile.name = tfl->name;
+	tfl_root = tfl;
+	tfl_index[func] = tfl;
+
+	return tfl;
+}
+
 /// Sets the name of a timer function.
 int add_timer_func_list(TimerFunc func, const char* name)
 {
@@ -74,11 +128,7 @@ int add_timer_func_list(TimerFunc func, const char* name)
 			else if( strcmp(name,tfl->name) == 0 )
 				ShowWarning("add_timer_func_list: function %p has the same name as %p(%s)\n",func,tfl->func,tfl->name);
 		}
-		CREATE(tfl,struct timer_func_list,1);
-		tfl->next = tfl_root;
-		tfl->func = func;
-		tfl->name = aStrdup(name);
-		tfl_root = tfl;
+		create_timer_func_list(func, name);
 	}
 	return 0;
 }
@@ -95,6 +145,108 @@ const char* search_timer_func_list(TimerFunc func)
 	return "unknown timer function";
 }
 
+/*----------------------------
+ * 	Timer profiling
+ *----------------------------*/
+
+/// Records the statistics of every timer function called by do_timer.
+void timer_profile_enable(bool enable)
+{
+	timer_profile = enable;
+}
+
+bool timer_profile_enabled(void)
+{
+	return timer_profile;
+}
+
+/// Clears the statistics of all timer functions.
+void timer_profile_reset(void)
+{
+	struct timer_func_list* tfl;
+
+	for( tfl=tfl_root; tfl != NULL; tfl=tfl->next ) {
+		tfl->profile.calls = 0;
+		tfl->profile.total_time = tfl->profile.max_time = 0;
+		tfl->profile.total_lag = 0;
+		tfl->profile.max_lag = 0;
+	}
+}
+
+/// Copies the statistics of the called timer functions into list, most time consuming first.
+/// Returns the number of entries written.
+int timer_profile_get(struct TimerProfile* list, int max)
+{
+	std::vector<struct TimerProfile*> entries;
+	struct timer_func_list* tfl;
+	int i;
+
+	for( tfl=tfl_root; tfl != NULL; tfl=tfl->next )
+		if( tfl->profile.calls )
+			entries.push_back(&tfl->profile);
+
+	std::sort(entries.begin(), entries.end(), [](const struct TimerProfile* a, const struct TimerProfile* b) {
+		return a->total_time > b->total_time;
+	});
+
+	for( i = 0; i < max && i < (int)entries.size(); i++ )
+		list[i] = *entries[i];
+
+	return i;
+}
+
+/// Logs the most time consuming timer functions on a single line.
+void timer_profile_report(int count)
+{
+	std::vector<struct TimerProfile> list(count);
+	std::string line;
+	char buf[256];
+	int i;
+
+	count = timer_profile_get(list.data(), count);
+	if( count == 0 )
+		return;
+
+	for( i = 0; i < count; i++ ) {
+		const struct TimerProfile* p = &list[i];
+
+		snprintf(buf, sizeof(buf), "%s%s %u calls %" PRIu64 "ms (max %" PRIu64 "us, lag max %" PRtf "ms)", (i ? ", " : ""), p->name, p->calls, p->total_time / 1000, p->max_time, p->max_lag);
+		line += buf;
+	}
+
+	ShowInfo("Timer profile: %s\n", line.c_str());
+}
+
+/// Runs a timer function and records its statistics.
+static void profile_timer_func(int tid, t_tick tick, t_tick lag)
+{
+	struct TimerData* timer = &timer_data[tid];
+	struct timer_func_list* tfl;
+	TimerFunc func = timer->func;
+	uint64 elapsed;
+
+	auto it = tfl_index.find(func);
+	if( it != tfl_index.end() )
+		tfl = it->second;
+	else
+	{// not registered with add_timer_func_list, track it by address
+		char name[64];
+
+		snprintf(name, sizeof(name), "unknown timer function %p", func);
+		tfl = create_timer_func_list(func, name);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	func(tid, tick, timer->id, timer->data);
+	elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+	tfl->profile.calls++;
+	tfl->profile.total_time += elapsed;
+	tfl->profile.max_time = max(tfl->profile.max_time, elapsed);
+	tfl->profile.total_lag += lag;
+	tfl->profile.max_lag = max(tfl->profile.max_lag, lag);
+}
+
 /*----------------------------
  * 	Get tick time
  *----------------------------*/
@@ -206,6 +358,108 @@ static void push_timer_heap(int tid)
 	BHEAP_PUSH(timer_heap, tid, DIFFTICK_MINTOPCMP, SWAP);
 }
 
+/*======================================
+ * 	CORE : Timer Wheel
+ *--------------------------------------*/
+
+/// Adds a timer to the wheel slot matching its expiration tick
+static void push_timer_wheel(int tid)
+{
+	t_tick expires = timer_data[tid].tick;
+	t_tick delta;
+	int slot;
+
+	if( DIFF_TICK(expires, timer_wheel_tick) < 0 )
+		expires = timer_wheel_tick; // already expired, run with the current slot
+	delta = expires - timer_wheel_tick;
+
+	if( delta < TIMER_WHEEL_SIZE0 )
+		slot = (int)(expires & (TIMER_WHEEL_SIZE0 - 1));
+	else {
+		int level, shift = TIMER_WHEEL_BITS0;
+
+		for( level = 1; level < TIMER_WHEEL_LEVELS - 1; level++, shift += TIMER_WHEEL_BITSN )
+			if( delta < ((t_tick)1 << (shift + TIMER_WHEEL_BITSN)) )
+				break;
+
+		if( delta >= ((t_tick)1 << (shift + TIMER_WHEEL_BITSN)) ) // out of range, park in the furthest slot and cascade again later
+			expires = timer_wheel_tick + ((t_tick)1 << (shift + TIMER_WHEEL_BITSN)) - 1;
+
+		slot = TIMER_WHEEL_SIZE0 + (level - 1) * TIMER_WHEEL_SIZEN + (int)((expires >> shift) & (TIMER_WHEEL_SIZEN - 1));
+	}
+
+	// append, timers of the same slot expire in insertion order
+	timer_link[tid].slot = slot;
+	timer_link[tid].next = -1;
+	timer_link[tid].prev = timer_wheel_tail[slot];
+	if( timer_wheel_tail[slot] != -1 )
+		timer_link[timer_wheel_tail[slot]].next = tid;
+	else
+		timer_wheel_head[slot] = tid;
+	timer_wheel_tail[slot] = tid;
+}
+
+/// Removes a timer from its wheel slot
+static void pop_timer_wheel(int tid)
+{
+	struct timer_wheel_link* link = &timer_link[tid];
+
+	if( link->prev != -1 )
+		timer_link[link->prev].next = link->next;
+	else
+		timer_wheel_head[link->slot] = link->next;
+	if( link->next != -1 )
+		timer_link[link->next].prev = link->prev;
+	else
+		timer_wheel_tail[link->slot] = link->prev;
+
+	link->next = link->prev = link->slot = -1;
+}
+
+/// Moves the timers of a slot of a higher level down to the lower levels.
+/// Returns the index of the cascaded slot within its level.
+static int cascade_timer_wheel(int level)
+{
+	int shift = TIMER_WHEEL_BITS0 + (level - 1) * TIMER_WHEEL_BITSN;
+	int index = (int)((timer_wheel_tick >> shift) & (TIMER_WHEEL_SIZEN - 1));
+	int slot = TIMER_WHEEL_SIZE0 + (level - 1) * TIMER_WHEEL_SIZEN + index;
+	int tid = timer_wheel_head[slot];
+
+	timer_wheel_head[slot] = timer_wheel_tail[slot] = -1;
+
+	while( tid != -1 ) {
+		int next = timer_link[tid].next;
+
+		push_timer_wheel(tid);
+		tid = next;
+	}
+
+	return index;
+}
+
+/// Returns the milliseconds until the next non-empty level 0 slot, or until
+/// the next cascade if there is none.
+static t_tick next_timer_wheel(void)
+{
+	int base = (int)(timer_wheel_tick & (TIMER_WHEEL_SIZE0 - 1));
+	int i;
+
+	for( i = 0; i < TIMER_WHEEL_SIZE0 - base; i++ )
+		if( timer_wheel_head[base + i] != -1 )
+			break;
+
+	return i;
+}
+
+/// Adds a timer to the active backend
+static void push_timer(int tid)
+{
+	if( timer_backend == TIMER_BACKEND_WHEEL )
+		push_timer_wheel(tid);
+	else
+		push_timer_heap(tid);
+}
+
 /*==========================
  * 	Timer Management
  *--------------------------*/
@@ -234,6 +488,11 @@ static int acquire_timer(void)
 		else
 			CREATE(timer_data, struct TimerData, timer_data_max);
 		memset(timer_data + (timer_data_max - 256), 0, sizeof(struct TimerData)*256);
+		if( timer_link )
+			RECREATE(timer_link, struct timer_wheel_link, timer_data_max);
+		else
+			CREATE(timer_link, struct timer_wheel_link, timer_data_max);
+		memset(timer_link + (timer_data_max - 256), -1, sizeof(struct timer_wheel_link)*256);
 	}
 
 	if( tid >= timer_data_num )
@@ -242,6 +501,17 @@ static int acquire_timer(void)
 	return tid;
 }
 
+/// Puts a timer id back into the free list.
+static void release_timer(int tid)
+{
+	if (free_timer_list_pos >= free_timer_list_max) {
+		free_timer_list_max += 256;
+		RECREATE(free_timer_list,int,free_timer_list_max);
+		memset(free_timer_list + (free_timer_list_max - 256), 0, 256 * sizeof(int));
+	}
+	free_timer_list[free_timer_list_pos++] = tid;
+}
+
 /// Starts a new timer that is deleted once it expires (single-use).
 /// Returns the timer's id.
 int add_timer(t_tick tick, TimerFunc func, int id, intptr_t data)
@@ -255,7 +525,10 @@ int add_timer(t_tick tick, TimerFunc func, int id, intptr_t data)
 	timer_data[tid].data     = data;
 	timer_data[tid].type     = TIMER_ONCE_AUTODEL;
 	timer_data[tid].interval = 1000;
-	push_timer_heap(tid);
+	push_timer(tid);
+
+	if( timer_trace )
+		fprintf(timer_trace, "A %d %" PRtf " 0\n", tid, tick);
 
 	return tid;
 }
@@ -279,7 +552,10 @@ int add_timer_interval(t_tick tick, TimerFunc func, int id, intptr_t data, int i
 	timer_data[tid].data     = data;
 	timer_data[tid].type     = TIMER_INTERVAL;
 	timer_data[tid].interval = interval;
-	push_timer_heap(tid);
+	push_timer(tid);
+
+	if( timer_trace )
+		fprintf(timer_trace, "A %d %" PRtf " %d\n", tid, tick, interval);
 
 	return tid;
 }
@@ -306,6 +582,18 @@ int delete_timer(int tid, TimerFunc func)
 		return -2;
 	}
 
+	if( timer_trace )
+		fprintf(timer_trace, "D %d\n", tid);
+
+	if( timer_backend == TIMER_BACKEND_WHEEL && timer_link[tid].slot != -1 )
+	{// unlink right away instead of waiting for the expiration
+		pop_timer_wheel(tid);
+		timer_data[tid].func = NULL;
+		timer_data[tid].type = 0;
+		release_timer(tid);
+		return 0;
+	}
+
 	timer_data[tid].func = NULL;
 	timer_data[tid].type = TIMER_ONCE_AUTODEL;
 
@@ -325,6 +613,26 @@ t_tick sett_tickimer(int tid, t_tick tick)
 {
 	size_t i;
 
+	if( timer_backend == TIMER_BACKEND_WHEEL )
+	{
+		if( tid < 0 || tid >= timer_data_num || timer_link[tid].slot == -1 )
+		{
+			ShowError("sett_tickimer: no such timer %d (%p(%s))\n", tid, timer_data[tid].func, search_timer_func_list(timer_data[tid].func));
+			return -1;
+		}
+
+		if( tick == -1 )
+			tick = 0;// add 1ms to avoid the error value -1
+
+		if( timer_trace )
+			fprintf(timer_trace, "S %d %" PRtf "\n", tid, tick);
+
+		pop_timer_wheel(tid);
+		timer_data[tid].tick = tick;
+		push_timer_wheel(tid);
+		return tick;
+	}
+
 	// search timer position
 	ARR_FIND(0, BHEAP_LENGTH(timer_heap), i, BHEAP_DATA(timer_heap)[i] == tid);
 	if( i == BHEAP_LENGTH(timer_heap) )
@@ -339,6 +647,9 @@ t_tick sett_tickimer(int tid, t_tick tick)
 	if( timer_data[tid].tick == tick )
 		return tick;// nothing to do, already in propper position
 
+	if( timer_trace )
+		fprintf(timer_trace, "S %d %" PRtf "\n", tid, tick);
+
 	// pop and push adjusted timer
 	BHEAP_POPINDEX(timer_heap, i, DIFFTICK_MINTOPCMP, SWAP);
 	timer_data[tid].tick = tick;
@@ -346,12 +657,89 @@ t_tick sett_tickimer(int tid, t_tick tick)
 	return tick;
 }
 
+/// Runs an expired timer that was already removed from the backend,
+/// then frees or re-arms it.
+static void run_timer(int tid, t_tick tick, t_tick diff)
+{
+	timer_data[tid].type |= TIMER_REMOVE_HEAP;
+
+	if( timer_data[tid].func )
+	{
+		// timer was delayed for more than 1 second, use current tick instead
+		t_tick call_tick = ( diff < -1000 ) ? tick : timer_data[tid].tick;
+
+		if( timer_profile )
+			profile_timer_func(tid, call_tick, -diff);
+		else
+			timer_data[tid].func(tid, call_tick, timer_data[tid].id, timer_data[tid].data);
+	}
+
+	// in the case the function didn't change anything...
+	if( timer_data[tid].type & TIMER_REMOVE_HEAP )
+	{
+		timer_data[tid].type &= ~TIMER_REMOVE_HEAP;
+
+		switch( timer_data[tid].type )
+		{
+		default:
+		case TIMER_ONCE_AUTODEL:
+			timer_data[tid].type = 0;
+			release_timer(tid);
+		break;
+		case TIMER_INTERVAL:
+			if( DIFF_TICK(timer_data[tid].tick, tick) < -1000 )
+				timer_data[tid].tick = tick + timer_data[tid].interval;
+			else
+				timer_data[tid].tick += timer_data[tid].interval;
+			push_timer(tid);
+		break;
+		}
+	}
+}
+
+/// Executes all expired timers of the wheel, one millisecond slot at a time.
+/// Returns the time until the next expiration (or the next cascade).
+static t_tick do_timer_wheel(t_tick tick)
+{
+	while( DIFF_TICK(timer_wheel_tick, tick) <= 0 )
+	{
+		int index = (int)(timer_wheel_tick & (TIMER_WHEEL_SIZE0 - 1));
+		int tid;
+
+		// level 0 wrapped, bring the next slots of the upper levels down
+		if( index == 0 ) {
+			int level;
+
+			for( level = 1; level < TIMER_WHEEL_LEVELS; level++ )
+				if( cascade_timer_wheel(level) != 0 )
+					break;
+		}
+
+		// timers added to this slot by the callbacks run in the same pass
+		while( (tid = timer_wheel_head[index]) != -1 )
+		{
+			pop_timer_wheel(tid);
+			run_timer(tid, tick, DIFF_TICK(timer_data[tid].tick, tick));
+		}
+
+		timer_wheel_tick++;
+	}
+
+	return next_timer_wheel() + 1;
+}
+
 /// Executes all expired timers.
 /// Returns the value of the smallest non-expired timer (or 1 second if there aren't any).
 t_tick do_timer(t_tick tick)
 {
 	t_tick diff = TIMER_MAX_INTERVAL; // return value
 
+	if( timer_trace )
+		fprintf(timer_trace, "T %" PRtf "\n", tick);
+
+	if( timer_backend == TIMER_BACKEND_WHEEL )
+		return cap_value(do_timer_wheel(tick), TIMER_MIN_INTERVAL, TIMER_MAX_INTERVAL);
+
 	// process all timers one by one
 	while( BHEAP_LENGTH(timer_heap) )
 	{
@@ -363,46 +751,71 @@ t_tick do_timer(t_tick tick)
 
 		// remove timer
 		BHEAP_POP(timer_heap, DIFFTICK_MINTOPCMP, SWAP);
-		timer_data[tid].type |= TIMER_REMOVE_HEAP;
+		run_timer(tid, tick, diff);
+	}
+
+	return cap_value(diff, TIMER_MIN_INTERVAL, TIMER_MAX_INTERVAL);
+}
+
+/// Switches the timer storage, moving every pending timer to the new backend.
+/// Meant to be called at startup, not from a timer callback.
+void timer_set_backend(enum e_timer_backend backend)
+{
+	int i;
+
+	if( backend == timer_backend )
+		return;
+
+	if( backend == TIMER_BACKEND_WHEEL )
+	{
+		timer_wheel_tick = gettick_nocache();
+		for( i = 0; i < TIMER_WHEEL_SLOTS; i++ )
+			timer_wheel_head[i] = timer_wheel_tail[i] = -1;
 
-		if( timer_data[tid].func )
+		while( BHEAP_LENGTH(timer_heap) )
 		{
-			if( diff < -1000 )
-				// timer was delayed for more than 1 second, use current tick instead
-				timer_data[tid].func(tid, tick, timer_data[tid].id, timer_data[tid].data);
-			else
-				timer_data[tid].func(tid, timer_data[tid].tick, timer_data[tid].id, timer_data[tid].data);
-		}
+			int tid = BHEAP_PEEK(timer_heap);
 
-		// in the case the function didn't change anything...
-		if( timer_data[tid].type & TIMER_REMOVE_HEAP )
+			BHEAP_POP(timer_heap, DIFFTICK_MINTOPCMP, SWAP);
+			push_timer_wheel(tid);
+		}
+	}
+	else
+	{
+		for( i = 0; i < TIMER_WHEEL_SLOTS; i++ )
 		{
-			timer_data[tid].type &= ~TIMER_REMOVE_HEAP;
+			int tid;
 
-			switch( timer_data[tid].type )
+			while( (tid = timer_wheel_head[i]) != -1 )
 			{
-			default:
-			case TIMER_ONCE_AUTODEL:
-				timer_data[tid].type = 0;
-				if (free_timer_list_pos >= free_timer_list_max) {
-					free_timer_list_max += 256;
-					RECREATE(free_timer_list,int,free_timer_list_max);
-					memset(free_timer_list + (free_timer_list_max - 256), 0, 256 * sizeof(int));
-				}
-				free_timer_list[free_timer_list_pos++] = tid;
-			break;
-			case TIMER_INTERVAL:
-				if( DIFF_TICK(timer_data[tid].tick, tick) < -1000 )
-					timer_data[tid].tick = tick + timer_data[tid].interval;
-				else
-					timer_data[tid].tick += timer_data[tid].interval;
+				pop_timer_wheel(tid);
 				push_timer_heap(tid);
-			break;
 			}
 		}
 	}
 
-	return cap_value(diff, TIMER_MIN_INTERVAL, TIMER_MAX_INTERVAL);
+	timer_backend = backend;
+}
+
+enum e_timer_backend timer_get_backend(void)
+{
+	return timer_backend;
+}
+
+/// Starts recording add/delete/settick/expire operations into a file, for the timerbench tool.
+bool timer_trace_open(const char* filename)
+{
+	if( timer_trace )
+		fclose(timer_trace);
+
+	timer_trace = fopen(filename, "w");
+	if( timer_trace == NULL )
+	{
+		ShowError("timer_trace_open: failed to open '%s' for writing.\n", filename);
+		return false;
+	}
+
+	return true;
 }
 
 unsigned long get_uptime(void)
@@ -528,7 +941,22 @@ void timer_final(void)
 		aFree(tfl);
 	}
 
+	tfl_root = NULL;
+	tfl_index.clear();
+	timer_profile = false;
+
 	if (timer_data) aFree(timer_data);
+	if (timer_link) aFree(timer_link);
 	BHEAP_CLEAR(timer_heap);
 	if (free_timer_list) aFree(free_timer_list);
+	if (timer_trace) fclose(timer_trace);
+
+	// allow a new timer_init, e.g. to replay a trace on another backend
+	timer_data = NULL;
+	timer_link = NULL;
+	timer_data_max = timer_data_num = 0;
+	free_timer_list = NULL;
+	free_timer_list_max = free_timer_list_pos = 0;
+	timer_trace = NULL;
+	timer_backend = TIMER_BACKEND_HEAP;
 }
@@ -30,6 +30,12 @@ enum {
 	TIMER_REMOVE_HEAP = 0x10,
 };
 
+// timer backends
+enum e_timer_backend {
+	TIMER_BACKEND_HEAP = 0, // binary heap, O(log n) insert/expire
+	TIMER_BACKEND_WHEEL,    // hierarchical timing wheel, O(1) insert/cancel
+};
+
 #define TIMER_FUNC(x) int x ( int tid, t_tick tick, int id, intptr_t data )
 
 // Struct declaration
@@ -46,6 +52,17 @@ struct TimerData {
 	intptr_t data;
 };
 
+// per timer function statistics, see timer_profile_enable
+struct TimerProfile {
+	TimerFunc func;
+	const char* name;
+	uint32 calls;
+	uint64 total_time; // microseconds spent in the function
+	uint64 max_time;
+	uint64 total_lag;  // milliseconds between the expiration and the call
+	t_tick max_lag;
+};
+
 // Function prototype declaration
 
 t_tick gettick(void);
@@ -68,6 +85,16 @@ const char* timestamp2string(char* str, size_t size, time_t timestamp, const cha
 void split_time(int time, int* year, int* month, int* day, int* hour, int* minute, int* second);
 double solve_time(char* modif_p);
 
+void timer_profile_enable(bool enable);
+bool timer_profile_enabled(void);
+void timer_profile_reset(void);
+int timer_profile_get(struct TimerProfile* list, int max);
+void timer_profile_report(int count);
+
+void timer_set_backend(enum e_timer_backend backend);
+enum e_timer_backend timer_get_backend(void);
+bool timer_trace_open(const char* filename);
+
 t_tick do_timer(t_tick tick);
 void timer_init(void);
 void timer_final(void);
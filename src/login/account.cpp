@@ -4,8 +4,11 @@
 #include "account.hpp"
 
 #include <algorithm> //min / max
+#include <list>
 #include <stdlib.h>
 #include <string.h>
+#include <string>
+#include <unordered_map>
 
 #include "../common/malloc.hpp"
 #include "../common/mmo.hpp"
@@ -13,11 +16,28 @@
 #include "../common/socket.hpp"
 #include "../common/sql.hpp"
 #include "../common/strlib.hpp"
+#include "../common/timer.hpp"
 
 #include "login.hpp" // login_config
 
 /// global defines
 
+/// Cached account
+struct s_account_cache_entry {
+	struct mmo_account acc;
+	t_tick expire;
+};
+
+/// Accounts loaded from the database, most recently used first.
+/// Userids the database doesn't know are cached too, so guessing names doesn't reach it.
+struct s_account_cache {
+	std::list<struct s_account_cache_entry> lru;
+	std::unordered_map<uint32, std::list<struct s_account_cache_entry>::iterator> by_id;
+	std::unordered_map<std::string, uint32> by_userid; // cache key of the userid -> account id
+	std::unordered_map<std::string, t_tick> missing; // cache key of the userid -> expiration
+	struct s_account_cache_stats stats;
+};
+
 /// internal structure
 typedef struct AccountDB_SQL {
 	AccountDB vtable;    // public interface
@@ -34,6 +54,11 @@ typedef struct AccountDB_SQL {
 	char account_db[32];
 	char global_acc_reg_num_table[32];
 	char global_acc_reg_str_table[32];
+	// cache
+	struct s_account_cache* cache;
+	int cache_size; // maximum number of cached accounts and unknown userids, 0 disables the cache
+	int cache_ttl; // seconds an account is cached
+	int cache_negative_ttl; // seconds an unknown userid is cached
 
 } AccountDB_SQL;
 
@@ -60,6 +85,8 @@ static bool account_db_sql_load_str(AccountDB* self, struct mmo_account* acc, co
 static AccountDBIterator* account_db_sql_iterator(AccountDB* self);
 static void account_db_sql_iter_destroy(AccountDBIterator* self);
 static bool account_db_sql_iter_next(AccountDBIterator* self, struct mmo_account* acc);
+static void account_db_sql_invalidate(AccountDB* self, const uint32 account_id);
+static void account_db_sql_get_cache_stats(AccountDB* self, struct s_account_cache_stats* stats);
 
 static bool mmo_auth_fromsql(AccountDB_SQL* db, struct mmo_account* acc, uint32 account_id);
 static bool mmo_auth_tosql(AccountDB_SQL* db, const struct mmo_account* acc, bool is_new);
@@ -82,6 +109,8 @@ AccountDB* account_db_sql(void) {
 	db->vtable.load_num     = &account_db_sql_load_num;
 	db->vtable.load_str     = &account_db_sql_load_str;
 	db->vtable.iterator     = &account_db_sql_iterator;
+	db->vtable.invalidate   = &account_db_sql_invalidate;
+	db->vtable.get_cache_stats = &account_db_sql_get_cache_stats;
 
 	// initialize to default values
 	db->accounts = NULL;
@@ -97,6 +126,11 @@ AccountDB* account_db_sql(void) {
 	safestrncpy(db->account_db, "login", sizeof(db->account_db));
 	safestrncpy(db->global_acc_reg_num_table, "global_acc_reg_num", sizeof(db->global_acc_reg_num_table));
 	safestrncpy(db->global_acc_reg_str_table, "global_acc_reg_str", sizeof(db->global_acc_reg_str_table));
+	// cache
+	db->cache = new s_account_cache();
+	db->cache_size = 10000;
+	db->cache_ttl = 300;
+	db->cache_negative_ttl = 60;
 
 	return &db->vtable;
 }
@@ -105,6 +139,133 @@ AccountDB* account_db_sql(void) {
 /* ------------------------------------------------------------------------- */
 
 
+/**
+ * Key of a userid in the cache, matching userids the way the database compares them.
+ * @param db: pointer to db
+ * @param userid: name of user account
+ * @return cache key
+ */
+static std::string account_cache_key(AccountDB_SQL* db, const char* userid) {
+	std::string key(userid);
+
+	if( !db->case_sensitive ) {
+		// the collation ignores case and trailing spaces, BINARY compares them
+		while( !key.empty() && key.back() == ' ' )
+			key.pop_back();
+		std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+	}
+
+	return key;
+}
+
+/**
+ * Remove an account from the cache.
+ * @param db: pointer to db
+ * @param it: cached account
+ */
+static void account_cache_erase(AccountDB_SQL* db, std::list<struct s_account_cache_entry>::iterator it) {
+	struct s_account_cache* cache = db->cache;
+	auto name = cache->by_userid.find(account_cache_key(db, it->acc.userid));
+
+	if( name != cache->by_userid.end() && name->second == it->acc.account_id )
+		cache->by_userid.erase(name);
+	cache->by_id.erase(it->acc.account_id);
+	cache->lru.erase(it);
+}
+
+/**
+ * Copy a cached account to acc.
+ * @param db: pointer to db
+ * @param acc: pointer of mmo_account to fill
+ * @param account_id: id of user account
+ * @return true if the account is cached, false if it has to be loaded
+ */
+static bool account_cache_get(AccountDB_SQL* db, struct mmo_account* acc, uint32 account_id) {
+	struct s_account_cache* cache = db->cache;
+	auto it = cache->by_id.find(account_id);
+
+	if( it == cache->by_id.end() ) {
+		cache->stats.misses++;
+		return false;
+	}
+
+	if( DIFF_TICK(it->second->expire, gettick()) <= 0 ) {
+		account_cache_erase(db, it->second);
+		cache->stats.misses++;
+		return false;
+	}
+
+	cache->lru.splice(cache->lru.begin(), cache->lru, it->second);
+	memcpy(acc, &it->second->acc, sizeof(struct mmo_account));
+	cache->stats.hits++;
+
+	return true;
+}
+
+/**
+ * Cache an account as it is in the database.
+ * @param db: pointer to db
+ * @param acc: account loaded or saved
+ */
+static void account_cache_store(AccountDB_SQL* db, const struct mmo_account* acc) {
+	struct s_account_cache* cache = db->cache;
+	std::string key;
+
+	if( db->cache_size <= 0 )
+		return;
+
+	auto it = cache->by_id.find(acc->account_id);
+
+	if( it != cache->by_id.end() )
+		account_cache_erase(db, it->second);
+
+	key = account_cache_key(db, acc->userid);
+	cache->missing.erase(key);
+
+	cache->lru.push_front({ *acc, gettick() + db->cache_ttl * 1000 });
+	cache->lru.front().acc.web_auth_token[0] = '\0'; // not loaded from the database either
+	cache->by_id[acc->account_id] = cache->lru.begin();
+	cache->by_userid[key] = acc->account_id;
+
+	while( cache->lru.size() > (size_t)db->cache_size ) {
+		account_cache_erase(db, std::prev(cache->lru.end()));
+		cache->stats.evictions++;
+	}
+}
+
+/**
+ * Cache a userid the database doesn't know.
+ * @param db: pointer to db
+ * @param key: cache key of the userid
+ */
+static void account_cache_store_missing(AccountDB_SQL* db, const std::string& key) {
+	struct s_account_cache* cache = db->cache;
+
+	if( db->cache_size <= 0 || db->cache_negative_ttl <= 0 )
+		return;
+
+	if( cache->missing.size() >= (size_t)db->cache_size ) {
+		t_tick now = gettick();
+
+		for( auto it = cache->missing.begin(); it != cache->missing.end(); ) {
+			if( DIFF_TICK(it->second, now) <= 0 )
+				it = cache->missing.erase(it);
+			else
+				++it;
+		}
+		if( cache->missing.size() >= (size_t)db->cache_size ) {
+			cache->stats.evictions += cache->missing.size();
+			cache->missing.clear();
+		}
+	}
+
+	cache->missing[key] = gettick() + db->cache_negative_ttl * 1000;
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+
 /**
  * Establish the database connection.
  * @param self: pointer to db
@@ -160,6 +321,7 @@ static void account_db_sql_destroy(AccountDB* self){
 
 	Sql_Free(db->accounts);
 	db->accounts = NULL;
+	delete db->cache;
 	aFree(db);
 }
 
@@ -216,6 +378,15 @@ static bool account_db_sql_get_property(AccountDB* self, const char* key, char*
 		else
 		if( strcmpi(key, "case_sensitive") == 0 )
 			safesnprintf(buf, buflen, "%d", (db->case_sensitive ? 1 : 0));
+		else
+		if( strcmpi(key, "cache_size") == 0 )
+			safesnprintf(buf, buflen, "%d", db->cache_size);
+		else
+		if( strcmpi(key, "cache_ttl") == 0 )
+			safesnprintf(buf, buflen, "%d", db->cache_ttl);
+		else
+		if( strcmpi(key, "cache_negative_ttl") == 0 )
+			safesnprintf(buf, buflen, "%d", db->cache_negative_ttl);
 		else
 			return false;// not found
 		return true;
@@ -275,6 +446,17 @@ static bool account_db_sql_set_property(AccountDB* self, const char* key, const
 		else
 		if( strcmpi(key, "case_sensitive") == 0 )
 			db->case_sensitive = (config_switch(value)==1);
+		else
+		if( strcmpi(key, "cache_size") == 0 ) {
+			db->cache_size = max(atoi(value), 0);
+			account_db_sql_invalidate(self, 0);
+		}
+		else
+		if( strcmpi(key, "cache_ttl") == 0 )
+			db->cache_ttl = max(atoi(value), 0);
+		else
+		if( strcmpi(key, "cache_negative_ttl") == 0 )
+			db->cache_negative_ttl = max(atoi(value), 0);
 		else
 			return false;// not found
 		return true;
@@ -334,7 +516,11 @@ static bool account_db_sql_create(AccountDB* self, struct mmo_account* acc) {
 
 	// insert the data into the database
 	acc->account_id = account_id;
-	return mmo_auth_tosql(db, acc, true);
+	if( !mmo_auth_tosql(db, acc, true) )
+		return false;
+
+	account_cache_store(db, acc);
+	return true;
 }
 
 /**
@@ -358,18 +544,28 @@ static bool account_db_sql_remove(AccountDB* self, const uint32 account_id) {
 
 	result &= ( SQL_SUCCESS == Sql_QueryStr(sql_handle, (result == true) ? "COMMIT" : "ROLLBACK") );
 
+	account_db_sql_invalidate(self, account_id);
+
 	return result;
 }
 
 /**
  * Update an existing account with the new data provided (both account and regs).
+ *  The cached account is updated with it as well.
  * @param self: pointer to db
  * @param acc: pointer of mmo_account to save
  * @return true if successful, false if something has failed
  */
 static bool account_db_sql_save(AccountDB* self, const struct mmo_account* acc) {
 	AccountDB_SQL* db = (AccountDB_SQL*)self;
-	return mmo_auth_tosql(db, acc, false);
+
+	if( !mmo_auth_tosql(db, acc, false) ) {
+		account_db_sql_invalidate(self, acc->account_id);
+		return false;
+	}
+
+	account_cache_store(db, acc);
+	return true;
 }
 
 /**
@@ -382,13 +578,22 @@ static bool account_db_sql_save(AccountDB* self, const struct mmo_account* acc)
  */
 static bool account_db_sql_load_num(AccountDB* self, struct mmo_account* acc, const uint32 account_id) {
 	AccountDB_SQL* db = (AccountDB_SQL*)self;
-	return mmo_auth_fromsql(db, acc, account_id);
+
+	if( account_cache_get(db, acc, account_id) )
+		return true;
+
+	if( !mmo_auth_fromsql(db, acc, account_id) )
+		return false;
+
+	account_cache_store(db, acc);
+	return true;
 }
 
 /**
  * Retrieve data from db and store it in the provided data structure.
  *  Doesn't actually retrieve data yet: escapes and checks userid, then transforms it to accid for fetching.
- *  Filled data structure is done by delegation to account_db_sql_load_num.
+ *  Filled data structure is done by delegation to mmo_auth_fromsql.
+ *  Userids that are not found are remembered for cache_negative_ttl seconds.
  * @param self: pointer to db
  * @param acc: pointer of mmo_account to fill
  * @param userid: name of user account
@@ -397,10 +602,29 @@ static bool account_db_sql_load_num(AccountDB* self, struct mmo_account* acc, co
 static bool account_db_sql_load_str(AccountDB* self, struct mmo_account* acc, const char* userid) {
 	AccountDB_SQL* db = (AccountDB_SQL*)self;
 	Sql* sql_handle = db->accounts;
+	struct s_account_cache* cache = db->cache;
+	std::string key = account_cache_key(db, userid);
 	char esc_userid[2*NAME_LENGTH+1];
 	uint32 account_id;
 	char* data;
 
+	auto missing = cache->missing.find(key);
+
+	if( missing != cache->missing.end() ) {
+		if( DIFF_TICK(missing->second, gettick()) > 0 ) {
+			cache->stats.negative_hits++;
+			return false;
+		}
+		cache->missing.erase(missing);
+	}
+
+	auto name = cache->by_userid.find(key);
+
+	if( name != cache->by_userid.end() && account_cache_get(db, acc, name->second) )
+		return true;
+	if( name == cache->by_userid.end() )
+		cache->stats.misses++;
+
 	Sql_EscapeString(sql_handle, esc_userid, userid);
 
 	// get the list of account IDs for this user ID
@@ -421,13 +645,19 @@ static bool account_db_sql_load_str(AccountDB* self, struct mmo_account* acc, co
 	if( SQL_SUCCESS != Sql_NextRow(sql_handle) )
 	{// no such entry
 		Sql_FreeResult(sql_handle);
+		account_cache_store_missing(db, key);
 		return false;
 	}
 
 	Sql_GetData(sql_handle, 0, &data, NULL);
 	account_id = atoi(data);
+	Sql_FreeResult(sql_handle);
 
-	return account_db_sql_load_num(self, acc, account_id);
+	if( !mmo_auth_fromsql(db, acc, account_id) )
+		return false;
+
+	account_cache_store(db, acc);
+	return true;
 }
 
 /**
@@ -496,6 +726,45 @@ static bool account_db_sql_iter_next(AccountDBIterator* self, struct mmo_account
 	return false;
 }
 
+/**
+ * Drop an account from the cache, its next load reads the database.
+ * @param self: pointer to db
+ * @param account_id: id of user account, 0 for all accounts and unknown userids
+ */
+static void account_db_sql_invalidate(AccountDB* self, const uint32 account_id) {
+	AccountDB_SQL* db = (AccountDB_SQL*)self;
+	struct s_account_cache* cache = db->cache;
+
+	if( account_id == 0 ) {
+		cache->stats.invalidations += cache->lru.size();
+		cache->lru.clear();
+		cache->by_id.clear();
+		cache->by_userid.clear();
+		cache->missing.clear();
+		return;
+	}
+
+	auto it = cache->by_id.find(account_id);
+
+	if( it != cache->by_id.end() ) {
+		account_cache_erase(db, it->second);
+		cache->stats.invalidations++;
+	}
+}
+
+/**
+ * Get the statistics of the cache.
+ * @param self: pointer to db
+ * @param stats: pointer of s_account_cache_stats to fill
+ */
+static void account_db_sql_get_cache_stats(AccountDB* self, struct s_account_cache_stats* stats) {
+	AccountDB_SQL* db = (AccountDB_SQL*)self;
+
+	*stats = db->cache->stats;
+	stats->accounts = db->cache->lru.size();
+	stats->missing = db->cache->missing.size();
+}
+
 /**
  * Fetch a struct mmo_account from sql, excluding web_auth_token.
  * @param db: pointer to db
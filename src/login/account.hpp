@@ -15,6 +15,17 @@
 typedef struct AccountDB AccountDB;
 typedef struct AccountDBIterator AccountDBIterator;
 
+/// Statistics of the account cache
+struct s_account_cache_stats {
+	uint64 hits;
+	uint64 misses;
+	uint64 negative_hits;   // lookups of unknown userids answered from the cache
+	uint64 evictions;
+	uint64 invalidations;
+	size_t accounts;        // cached accounts
+	size_t missing;         // cached unknown userids
+};
+
 
 // standard engines
 AccountDB* account_db_sql(void);
@@ -144,6 +155,19 @@ struct AccountDB {
 	/// @param self Database
 	/// @return Iterator
 	AccountDBIterator* (*iterator)(AccountDB* self);
+
+	/// Drops an account from the cache, its next load reads the database.
+	/// Call this when the account was changed or created by other means.
+	///
+	/// @param self Database
+	/// @param account_id Account id, 0 for all accounts and unknown userids
+	void (*invalidate)(AccountDB* self, const uint32 account_id);
+
+	/// Gets the statistics of the cache.
+	///
+	/// @param self Database
+	/// @param stats Pointer that receives the statistics
+	void (*get_cache_stats)(AccountDB* self, struct s_account_cache_stats* stats);
 };
 
 void mmo_send_global_accreg(AccountDB* self, int fd, uint32 account_id, uint32 char_id);
@@ -0,0 +1,498 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+#include "dnsbl.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef WIN32
+	#include "../common/winapi.hpp"
+#else
+	#include <arpa/inet.h>
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <netinet/in.h>
+	#include <sys/socket.h>
+	#include <unistd.h>
+#endif
+
+#include "../common/cbasetypes.hpp"
+#include "../common/random.hpp"
+#include "../common/showmsg.hpp"
+#include "../common/socket.hpp"
+#include "../common/strlib.hpp"
+#include "../common/timer.hpp"
+
+#include "login.hpp"
+
+/////////////////////////////////////////////////////////////////////
+// DNS blacklist lookups
+//
+// An ip is looked up on a blacklist by resolving the A record of its
+// reversed octets under the blacklist's zone, an answer means it's listed.
+// The queries are sent over UDP to the resolver without waiting, the answers
+// are read by a timer while lookups are pending. The result for an ip is
+// cached, so a client only waits for the first of its logins.
+
+// interval in which the answers are read while lookups are pending, in milliseconds
+#define DNSBL_POLL_INTERVAL 10
+// maximum size of a DNS message over UDP
+#define DNSBL_PACKET_SIZE 512
+// maximum number of cached results, expired ones are dropped first
+#define DNSBL_CACHE_MAX 65536
+
+#ifdef WIN32
+	typedef SOCKET dnsbl_socket_t;
+	#define DNSBL_INVALID_SOCKET INVALID_SOCKET
+	#define dnsbl_closesocket closesocket
+#else
+	typedef int dnsbl_socket_t;
+	#define DNSBL_INVALID_SOCKET -1
+	#define dnsbl_closesocket close
+#endif
+
+// settings
+static char dnsbl_resolver[64] = ""; // ip[:port] of the resolver, empty to use the system's
+static int dnsbl_timeout = 2000; // in milliseconds
+static int dnsbl_cache_ttl = 600; // in seconds
+
+/// Cached result of an ip
+struct s_dnsbl_cache {
+	bool listed;
+	t_tick expire;
+};
+
+/// Lookup of an ip on all blacklists
+struct s_dnsbl_request {
+	std::vector<std::function<void(bool listed)>> callbacks;
+	int outstanding; // queries not answered yet
+	bool listed;
+	t_tick timeout;
+};
+
+/// Query sent to the resolver
+struct s_dnsbl_query {
+	uint32 ip;
+	std::string name;
+};
+
+static dnsbl_socket_t dnsbl_fd = DNSBL_INVALID_SOCKET;
+static struct sockaddr_in dnsbl_addr;
+static int dnsbl_timer = INVALID_TIMER;
+static std::string dnsbl_servers_conf; // dnsbl_servers the list was split from
+static std::vector<std::string> dnsbl_servers;
+static std::unordered_map<uint32, struct s_dnsbl_cache> dnsbl_cache;
+static std::unordered_map<uint32, struct s_dnsbl_request> dnsbl_requests;
+static std::unordered_map<uint16, struct s_dnsbl_query> dnsbl_queries; // by DNS message id
+
+static TIMER_FUNC(dnsbl_poll);
+
+/**
+ * Splits dnsbl_servers when it changed.
+ */
+static void dnsbl_read_servers(void) {
+	const char* p = login_config.dnsbl_servs;
+
+	if( dnsbl_servers_conf == p )
+		return;
+
+	dnsbl_servers_conf = p;
+	dnsbl_servers.clear();
+	while( *p != '\0' ) {
+		const char* end = strchr(p, ',');
+		char server[256];
+
+		if( end == NULL )
+			end = p + strlen(p);
+		safestrncpy(server, p, min((size_t)(end - p) + 1, sizeof(server)));
+		trim(server);
+		if( server[0] != '\0' )
+			dnsbl_servers.push_back(server);
+		p = ( *end == ',' ) ? end + 1 : end;
+	}
+}
+
+/**
+ * Picks the resolver, dnsbl_resolver or the first nameserver of the system.
+ * @return true if an address was found
+ */
+static bool dnsbl_read_resolver(void) {
+	char host[64] = "";
+	unsigned int port = 53;
+
+	if( dnsbl_resolver[0] != '\0' ) {
+		if( sscanf(dnsbl_resolver, "%63[^:]:%u", host, &port) < 1 )
+			return false;
+	}
+#ifndef WIN32
+	else {
+		FILE* fp = fopen("/etc/resolv.conf", "r");
+		char line[256];
+
+		if( fp != NULL ) {
+			while( fgets(line, sizeof(line), fp) ) {
+				if( sscanf(line, "nameserver %63s", host) == 1 && strchr(host, ':') == NULL )
+					break;// first IPv4 nameserver
+				host[0] = '\0';
+			}
+			fclose(fp);
+		}
+	}
+#endif
+
+	if( host[0] == '\0' )
+		return false;
+
+	memset(&dnsbl_addr, 0, sizeof(dnsbl_addr));
+	dnsbl_addr.sin_family = AF_INET;
+	dnsbl_addr.sin_addr.s_addr = htonl(str2ip(host));
+	dnsbl_addr.sin_port = htons((uint16)port);
+	return dnsbl_addr.sin_addr.s_addr != 0;
+}
+
+/**
+ * Opens the socket to the resolver.
+ * @return true on success
+ */
+static bool dnsbl_open(void) {
+	if( dnsbl_fd != DNSBL_INVALID_SOCKET )
+		return true;
+
+	if( !dnsbl_read_resolver() ) {
+		ShowError("DNSBL: No resolver found, set dnsbl_resolver.\n");
+		return false;
+	}
+
+	dnsbl_fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if( dnsbl_fd == DNSBL_INVALID_SOCKET ) {
+		ShowError("DNSBL: Failed to create the socket.\n");
+		return false;
+	}
+#ifdef WIN32
+	{
+		unsigned long nonblocking = 1;
+		ioctlsocket(dnsbl_fd, FIONBIO, &nonblocking);
+	}
+#else
+	fcntl(dnsbl_fd, F_SETFL, fcntl(dnsbl_fd, F_GETFL) | O_NONBLOCK);
+#endif
+	// only accept answers of the resolver
+	if( connect(dnsbl_fd, (struct sockaddr*)&dnsbl_addr, sizeof(dnsbl_addr)) != 0 ) {
+		ShowError("DNSBL: Failed to use the resolver %u.%u.%u.%u:%u.\n", CONVIP(ntohl(dnsbl_addr.sin_addr.s_addr)), ntohs(dnsbl_addr.sin_port));
+		dnsbl_closesocket(dnsbl_fd);
+		dnsbl_fd = DNSBL_INVALID_SOCKET;
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Writes a query for the A record of name.
+ * @return length of the message, 0 if the name doesn't fit
+ */
+static size_t dnsbl_build_query(uint8* buf, uint16 id, const std::string& name) {
+	size_t len = 12;
+
+	memset(buf, 0, 12);
+	buf[0] = (uint8)(id >> 8);
+	buf[1] = (uint8)id;
+	buf[2] = 0x01; // recursion desired
+	buf[5] = 1; // one question
+
+	for( size_t start = 0; start < name.length(); ) {
+		size_t end = name.find('.', start);
+
+		if( end == std::string::npos )
+			end = name.length();
+		if( end - start == 0 || end - start > 63 || len + 1 + (end - start) + 5 > DNSBL_PACKET_SIZE )
+			return 0;
+		buf[len++] = (uint8)(end - start);
+		memcpy(buf + len, name.c_str() + start, end - start);
+		len += end - start;
+		start = end + 1;
+	}
+	buf[len++] = 0;
+	buf[len++] = 0; buf[len++] = 1; // type A
+	buf[len++] = 0; buf[len++] = 1; // class IN
+
+	return len;
+}
+
+/**
+ * Skips a possibly compressed name of a message.
+ * @return offset after the name, 0 if the message is malformed
+ */
+static size_t dnsbl_skip_name(const uint8* buf, size_t len, size_t pos) {
+	while( pos < len ) {
+		if( buf[pos] == 0 )
+			return pos + 1;
+		if( (buf[pos]&0xC0) == 0xC0 )
+			return ( pos + 2 <= len ) ? pos + 2 : 0;
+		pos += 1 + buf[pos];
+	}
+	return 0;
+}
+
+/**
+ * Reads the answer to a query.
+ * @param name: name that was queried, the question of the answer must match it
+ * @return 1 if name has an A record, 0 if not, -1 if the message is not a valid answer
+ */
+static int dnsbl_parse_answer(const uint8* buf, size_t len, const std::string& name) {
+	size_t pos = 12;
+	uint16 answers;
+
+	if( len < 12 || !(buf[2]&0x80) || (buf[4] << 8 | buf[5]) != 1 )
+		return -1;// not an answer to one question
+
+	// the question must be ours
+	std::string qname;
+
+	while( pos < len && buf[pos] != 0 ) {
+		if( (buf[pos]&0xC0) != 0 || pos + 1 + buf[pos] > len )
+			return -1;
+		if( !qname.empty() )
+			qname += '.';
+		qname.append((const char*)buf + pos + 1, buf[pos]);
+		pos += 1 + buf[pos];
+	}
+	if( pos + 5 > len || strcmpi(qname.c_str(), name.c_str()) != 0 )
+		return -1;
+	pos += 5;
+
+	if( (buf[3]&0x0F) != 0 )
+		return 0;// NXDOMAIN or failure, not listed
+
+	answers = buf[6] << 8 | buf[7];
+	for( uint16 i = 0; i < answers; i++ ) {
+		uint16 type, rdlength;
+
+		pos = dnsbl_skip_name(buf, len, pos);
+		if( pos == 0 || pos + 10 > len )
+			return -1;
+		type = buf[pos] << 8 | buf[pos + 1];
+		rdlength = buf[pos + 8] << 8 | buf[pos + 9];
+		pos += 10 + rdlength;
+		if( pos > len )
+			return -1;
+		if( type == 1 )
+			return 1;// A record
+	}
+
+	return 0;
+}
+
+/**
+ * Caches the result of a lookup and runs its callbacks.
+ */
+static void dnsbl_complete(uint32 ip) {
+	auto it = dnsbl_requests.find(ip);
+
+	if( it == dnsbl_requests.end() )
+		return;
+
+	struct s_dnsbl_request request = std::move(it->second);
+
+	dnsbl_requests.erase(it);
+	for( auto q = dnsbl_queries.begin(); q != dnsbl_queries.end(); ) {
+		if( q->second.ip == ip )
+			q = dnsbl_queries.erase(q);
+		else
+			++q;
+	}
+
+	if( dnsbl_cache.size() >= DNSBL_CACHE_MAX ) {
+		t_tick now = gettick();
+
+		for( auto c = dnsbl_cache.begin(); c != dnsbl_cache.end(); ) {
+			if( DIFF_TICK(c->second.expire, now) <= 0 )
+				c = dnsbl_cache.erase(c);
+			else
+				++c;
+		}
+		if( dnsbl_cache.size() >= DNSBL_CACHE_MAX )
+			dnsbl_cache.clear();
+	}
+	dnsbl_cache[ip] = { request.listed, gettick() + dnsbl_cache_ttl * 1000 };
+
+	for( auto& callback : request.callbacks ) {
+		if( callback )
+			callback(request.listed);
+	}
+}
+
+/**
+ * Timered function to read the answers of the resolver and time out lookups.
+ */
+static TIMER_FUNC(dnsbl_poll) {
+	uint8 buf[DNSBL_PACKET_SIZE];
+	int len;
+	std::vector<uint32> done;
+
+	dnsbl_timer = INVALID_TIMER;
+
+	while( dnsbl_fd != DNSBL_INVALID_SOCKET && (len = recv(dnsbl_fd, (char*)buf, sizeof(buf), 0)) > 0 ) {
+		auto q = dnsbl_queries.find((uint16)(buf[0] << 8 | buf[1]));
+
+		if( q == dnsbl_queries.end() )
+			continue;// late or unknown answer
+
+		int answer = dnsbl_parse_answer(buf, len, q->second.name);
+
+		if( answer < 0 )
+			continue;// not the answer to this query
+
+		auto r = dnsbl_requests.find(q->second.ip);
+
+		dnsbl_queries.erase(q);
+		if( r == dnsbl_requests.end() )
+			continue;
+		if( answer > 0 )
+			r->second.listed = true;
+		if( --r->second.outstanding == 0 || r->second.listed )
+			done.push_back(r->first);
+	}
+
+	for( auto& r : dnsbl_requests ) {
+		if( DIFF_TICK(tick, r.second.timeout) >= 0 )
+			done.push_back(r.first);// unanswered blacklists don't list the ip, like a failed resolve
+	}
+
+	for( uint32 ip : done )
+		dnsbl_complete(ip);
+
+	if( !dnsbl_requests.empty() )
+		dnsbl_timer = add_timer(tick + DNSBL_POLL_INTERVAL, dnsbl_poll, 0, 0);
+
+	return 0;
+}
+
+/**
+ * Check if ip is listed by one of the DNS blacklists, from the cache only.
+ * @param ip: ipv4 ip to check
+ * @return true if listed, false if not listed or not looked up yet
+ */
+bool dnsbl_listed(uint32 ip) {
+	auto it = dnsbl_cache.find(ip);
+
+	if( it == dnsbl_cache.end() )
+		return false;
+
+	return it->second.listed && DIFF_TICK(it->second.expire, gettick()) > 0;
+}
+
+/**
+ * Look up ip on the DNS blacklists, unless the result is cached.
+ * The lookups are sent to the resolver without waiting for the answers.
+ * @param ip: ipv4 ip to check
+ * @param callback: called on completion when the lookup is not answered from the cache, with whether ip is listed
+ * @return true if the result is cached (see dnsbl_listed), false if the callback will be called
+ */
+bool dnsbl_lookup(uint32 ip, std::function<void(bool listed)> callback) {
+	auto cached = dnsbl_cache.find(ip);
+
+	if( cached != dnsbl_cache.end() ) {
+		if( DIFF_TICK(cached->second.expire, gettick()) > 0 )
+			return true;
+		dnsbl_cache.erase(cached);
+	}
+
+	auto pending = dnsbl_requests.find(ip);
+
+	if( pending != dnsbl_requests.end() ) {// already being looked up
+		pending->second.callbacks.push_back(std::move(callback));
+		return false;
+	}
+
+	dnsbl_read_servers();
+	if( dnsbl_servers.empty() || !dnsbl_open() )
+		return true;// nothing to look up, not listed
+
+	struct s_dnsbl_request& request = dnsbl_requests[ip];
+	char r_ip[16];
+
+	request.callbacks.push_back(std::move(callback));
+	request.outstanding = 0;
+	request.listed = false;
+	request.timeout = gettick() + dnsbl_timeout;
+
+	safesnprintf(r_ip, sizeof(r_ip), "%u.%u.%u.%u", ip&0xFF, (ip>>8)&0xFF, (ip>>16)&0xFF, (ip>>24)&0xFF);
+	for( const std::string& server : dnsbl_servers ) {
+		struct s_dnsbl_query query = { ip, std::string(r_ip) + "." + server };
+		uint8 buf[DNSBL_PACKET_SIZE];
+		uint16 id;
+		size_t len;
+
+		do {
+			id = (uint16)rnd();
+		} while( dnsbl_queries.find(id) != dnsbl_queries.end() );
+
+		len = dnsbl_build_query(buf, id, query.name);
+		if( len == 0 || send(dnsbl_fd, (const char*)buf, (int)len, 0) != (int)len )
+			continue;// treated as not listed
+
+		dnsbl_queries[id] = std::move(query);
+		request.outstanding++;
+	}
+
+	if( request.outstanding == 0 ) {
+		dnsbl_requests.erase(ip);
+		return true;// no query could be sent, not listed
+	}
+
+	if( dnsbl_timer == INVALID_TIMER )
+		dnsbl_timer = add_timer(gettick() + DNSBL_POLL_INTERVAL, dnsbl_poll, 0, 0);
+
+	return false;
+}
+
+/**
+ * Read configuration options.
+ * @param key: config keyword
+ * @param value: config value for keyword
+ * @return true if successful, false if not found
+ */
+bool dnsbl_config_read(const char* key, const char* value) {
+	if( strcmpi(key, "dnsbl_resolver") == 0 )
+		safestrncpy(dnsbl_resolver, value, sizeof(dnsbl_resolver));
+	else if( strcmpi(key, "dnsbl_timeout") == 0 )
+		dnsbl_timeout = max(atoi(value), 100);
+	else if( strcmpi(key, "dnsbl_cache_ttl") == 0 )
+		dnsbl_cache_ttl = max(atoi(value), 0);
+	else
+		return false;
+
+	return true;
+}
+
+/**
+ * Initialize the module.
+ * Launched at login-serv start, create db or other long scope variable here.
+ */
+void dnsbl_init(void) {
+	add_timer_func_list(dnsbl_poll, "dnsbl_poll");
+}
+
+/**
+ * Destroy the module.
+ * Launched at login-serv end, cleanup db connection or other thing here.
+ */
+void dnsbl_final(void) {
+	if( dnsbl_timer != INVALID_TIMER ) {
+		delete_timer(dnsbl_timer, dnsbl_poll);
+		dnsbl_timer = INVALID_TIMER;
+	}
+	if( dnsbl_fd != DNSBL_INVALID_SOCKET ) {
+		dnsbl_closesocket(dnsbl_fd);
+		dnsbl_fd = DNSBL_INVALID_SOCKET;
+	}
+	dnsbl_requests.clear();
+	dnsbl_queries.clear();
+	dnsbl_cache.clear();
+}
@@ -0,0 +1,47 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+#ifndef DNSBL_HPP
+#define DNSBL_HPP
+
+#include <functional>
+
+#include "../common/cbasetypes.hpp"
+
+/**
+ * Check if ip is listed by one of the DNS blacklists, from the cache only.
+ * @param ip: ipv4 ip to check
+ * @return true if listed, false if not listed or not looked up yet
+ */
+bool dnsbl_listed(uint32 ip);
+
+/**
+ * Look up ip on the DNS blacklists, unless the result is cached.
+ * The lookups are sent to the resolver without waiting for the answers.
+ * @param ip: ipv4 ip to check
+ * @param callback: called on completion when the lookup is not answered from the cache, with whether ip is listed
+ * @return true if the result is cached (see dnsbl_listed), false if the callback will be called
+ */
+bool dnsbl_lookup(uint32 ip, std::function<void(bool listed)> callback);
+
+/**
+ * Read configuration options.
+ * @param key: config keyword
+ * @param value: config value for keyword
+ * @return true if successful, false if not found
+ */
+bool dnsbl_config_read(const char* key, const char* value);
+
+/**
+ * Initialize the module.
+ * Launched at login-serv start, create db or other long scope variable here.
+ */
+void dnsbl_init(void);
+
+/**
+ * Destroy the module.
+ * Launched at login-serv end, cleanup db connection or other thing here.
+ */
+void dnsbl_final(void);
+
+#endif /* DNSBL_HPP */
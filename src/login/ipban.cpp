@@ -3,10 +3,15 @@
 
 #include "ipban.hpp"
 
+#include <chrono>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unordered_map>
+#include <vector>
 
 #include "../common/cbasetypes.hpp"
+#include "../common/random.hpp"
 #include "../common/showmsg.hpp"
 #include "../common/sql.hpp"
 #include "../common/strlib.hpp"
@@ -27,24 +32,101 @@ static char   ipban_table[32] = "ipbanlist";
 // globals
 static Sql* sql_handle = NULL;
 static int cleanup_timer_id = INVALID_TIMER;
+static int refresh_timer_id = INVALID_TIMER;
 static bool ipban_inited = false;
 
+/// Active bans by the number of leading octets they match ('a.*.*.*' to 'a.b.c.d'),
+/// keyed by these octets, with the time they expire at.
+static std::unordered_map<uint32, time_t> ipban_list[4];
+
 //early declaration
 TIMER_FUNC(ipban_cleanup);
+TIMER_FUNC(ipban_refresh);
+
+/**
+ * Add a ban to the in-memory list.
+ * @param ip: ipv4 ip banned
+ * @param octets: number of leading octets the ban matches (1-4)
+ * @param expire: time the ban expires
+ */
+static void ipban_add(uint32 ip, int octets, time_t expire) {
+	uint32 key = ip >> (32 - 8 * octets);
+	auto it = ipban_list[octets - 1].find(key);
+
+	if( it == ipban_list[octets - 1].end() )
+		ipban_list[octets - 1][key] = expire;
+	else if( it->second < expire )
+		it->second = expire;
+}
+
+/**
+ * Parse a ban mask of the table, 'a.*.*.*', 'a.b.*.*', 'a.b.c.*' or 'a.b.c.d'.
+ * @param list: mask to parse
+ * @param ip: resulting ipv4 ip, unmatched octets are 0
+ * @return number of leading octets matched, 0 if the mask is invalid
+ */
+static int ipban_parse_mask(const char* list, uint32* ip) {
+	unsigned int octet[4];
+	int octets = 0;
+	const char* p = list;
+
+	*ip = 0;
+	for( int i = 0; i < 4; i++ ) {
+		if( i > 0 && *p++ != '.' )
+			return 0;
+		if( *p == '*' ) {
+			p++;
+			continue;
+		}
+		if( octets != i || !ISDIGIT(*p) )
+			return 0;// a number after a wildcard
+		octet[i] = (unsigned int)strtoul(p, (char**)&p, 10);
+		if( octet[i] > 255 )
+			return 0;
+		*ip |= octet[i] << (24 - 8 * i);
+		octets++;
+	}
+
+	return ( *p == '\0' ) ? octets : 0;
+}
 
 /**
- * Check if ip is in the active bans list.
+ * Check if ip is in the active bans list, without going to the database.
+ * The list is loaded by ipban_refresh, failed attempt bans are added right away.
  * @param ip: ipv4 ip to check if ban
- * @return true if found or error, false if not in list
+ * @return true if found, false if not in list
  */
 bool ipban_check(uint32 ip) {
-	uint8* p = (uint8*)&ip;
-	char* data = NULL;
-	int matches;
+	time_t now;
 
 	if( !login_config.ipban )
 		return false;// ipban disabled
 
+	now = time(NULL);
+	for( int octets = 1; octets <= 4; octets++ ) {
+		auto it = ipban_list[octets - 1].find(ip >> (32 - 8 * octets));
+
+		if( it == ipban_list[octets - 1].end() )
+			continue;
+		if( it->second > now )
+			return true;
+		ipban_list[octets - 1].erase(it);// expired
+	}
+
+	return false;
+}
+
+/**
+ * Check if ip is in the active bans list of the database.
+ * Used by the login flood benchmark, ipban_check answers from memory.
+ * @param ip: ipv4 ip to check if ban
+ * @return true if found or error, false if not in list
+ */
+static bool ipban_check_sql(uint32 ip) {
+	uint8* p = (uint8*)&ip;
+	char* data = NULL;
+	int matches;
+
 	if( SQL_ERROR == Sql_Query(sql_handle, "SELECT count(*) FROM `%s` WHERE `rtime` > NOW() AND (`list` = '%u.*.*.*' OR `list` = '%u.%u.*.*' OR `list` = '%u.%u.%u.*' OR `list` = '%u.%u.%u.%u')",
 		ipban_table, p[3], p[3], p[2], p[3], p[2], p[1], p[3], p[2], p[1], p[0]) )
 	{
@@ -80,6 +162,8 @@ void ipban_log(uint32 ip) {
 	if( failures >= login_config.dynamic_pass_failure_ban_limit )
 	{
 		uint8* p = (uint8*)&ip;
+
+		ipban_add(ip, 3, time(NULL) + login_config.dynamic_pass_failure_ban_duration * 60);
 		if( SQL_ERROR == Sql_Query(sql_handle, "INSERT INTO `%s`(`list`,`btime`,`rtime`,`reason`) VALUES ('%u.%u.%u.*', NOW() , NOW() +  INTERVAL %d MINUTE ,'Password error ban')",
 			ipban_table, p[3], p[2], p[1], login_config.dynamic_pass_failure_ban_duration) )
 			Sql_ShowDebug(sql_handle);
@@ -97,15 +181,110 @@ void ipban_log(uint32 ip) {
  * @return 0
  */
 TIMER_FUNC(ipban_cleanup){
+	time_t now;
+
 	if( !login_config.ipban )
 		return 0;// ipban disabled
 
 	if( SQL_ERROR == Sql_Query(sql_handle, "DELETE FROM `%s` WHERE `rtime` <= NOW()", ipban_table) )
 		Sql_ShowDebug(sql_handle);
 
+	now = time(NULL);
+	for( auto& list : ipban_list ) {
+		for( auto it = list.begin(); it != list.end(); ) {
+			if( it->second <= now )
+				it = list.erase(it);
+			else
+				++it;
+		}
+	}
+
 	return 0;
 }
 
+/**
+ * Timered function to reload the active bans into memory.
+ *  Picks up bans added to or removed from the table by other means.
+ *  Performed each ipban_refresh_interval, the list is kept if the query fails.
+ * @param tid: timer id
+ * @param tick: tick of execution
+ * @param id: unused
+ * @param data: unused
+ * @return 0
+ */
+TIMER_FUNC(ipban_refresh){
+	std::unordered_map<uint32, time_t> list[4];
+	time_t now;
+	char* value;
+
+	if( !login_config.ipban )
+		return 0;// ipban disabled
+
+	// remaining time instead of rtime, the database clock may differ from ours
+	if( SQL_ERROR == Sql_Query(sql_handle, "SELECT `list`, TIMESTAMPDIFF(SECOND, NOW(), `rtime`) FROM `%s` WHERE `rtime` > NOW()", ipban_table) )
+	{
+		Sql_ShowDebug(sql_handle);
+		return 0;
+	}
+
+	for( int i = 0; i < 4; i++ )
+		list[i].swap(ipban_list[i]);
+
+	now = time(NULL);
+	while( SQL_SUCCESS == Sql_NextRow(sql_handle) )
+	{
+		uint32 ip;
+		int octets;
+		time_t remaining;
+
+		Sql_GetData(sql_handle, 0, &value, NULL);
+		octets = ipban_parse_mask(value, &ip);
+		Sql_GetData(sql_handle, 1, &value, NULL);
+		remaining = (time_t)strtoll(value, NULL, 10);
+		if( octets > 0 )
+			ipban_add(ip, octets, now + remaining);
+	}
+	Sql_FreeResult(sql_handle);
+
+	return 0;
+}
+
+/**
+ * Compares the ban and failed attempt checks of a login flood on the database and in memory.
+ * @param attempts: number of login attempts simulated
+ */
+void ipban_benchmark(int attempts) {
+	const int addresses = 1024;
+	std::vector<uint32> ips;
+
+	if( !login_config.ipban ) {
+		ShowWarning("ipban_benchmark: ipban is disabled.\n");
+		return;
+	}
+
+	// a flood from the addresses 10.0.0.0 to 10.0.3.255
+	for( int i = 0; i < attempts; i++ )
+		ips.push_back(0x0a000000 | rnd() % addresses);
+
+	ShowInfo("Login flood of %d attempts from %d addresses:\n", attempts, addresses);
+	for( int cached = 0; cached < 2; cached++ ) {
+		unsigned long failures = 0;
+		int banned = 0;
+		auto start = std::chrono::steady_clock::now();
+
+		for( uint32 ip : ips ) {
+			if( cached ? ipban_check(ip) : ipban_check_sql(ip) )
+				banned++;
+			failures += cached ? loginlog_failedattempts(ip, login_config.dynamic_pass_failure_ban_interval) : loginlog_failedattempts_sql(ip, login_config.dynamic_pass_failure_ban_interval);
+		}
+
+		double elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000000.0;
+
+		ShowInfo("%-8s: %.0f attempts/s (%d banned, %lu failures counted)\n", cached ? "memory" : "database",
+			elapsed > 0 ? attempts / elapsed : 0.0, banned, failures);
+	}
+}
+
 /**
  * Read configuration options.
  * @param key: config keyword
@@ -224,6 +403,13 @@ void ipban_init(void) {
 		cleanup_timer_id = add_timer_interval(gettick()+10, ipban_cleanup, 0, 0, login_config.ipban_cleanup_interval*1000);
 	} else // make sure it gets cleaned up on login-server start regardless of interval-based cleanups
 		ipban_cleanup(0,0,0,0);
+
+	ipban_refresh(0,0,0,0);
+	if( login_config.ipban_refresh_interval > 0 )
+	{ // set up periodic reload of the active bans
+		add_timer_func_list(ipban_refresh, "ipban_refresh");
+		refresh_timer_id = add_timer_interval(gettick()+login_config.ipban_refresh_interval*1000, ipban_refresh, 0, 0, login_config.ipban_refresh_interval*1000);
+	}
 }
 
 /**
@@ -237,8 +423,12 @@ void ipban_final(void) {
 	if( login_config.ipban_cleanup_interval > 0 )
 		// release data
 		delete_timer(cleanup_timer_id, ipban_cleanup);
+	if( login_config.ipban_refresh_interval > 0 )
+		delete_timer(refresh_timer_id, ipban_refresh);
 
 	ipban_cleanup(0,0,0,0); // always clean up on login-server stop
+	for( auto& list : ipban_list )
+		list.clear();
 
 	// close connections
 	Sql_Free(sql_handle);
@@ -7,9 +7,9 @@
 #include "../common/cbasetypes.hpp"
 
 /**
- * Check if ip is in the active bans list.
+ * Check if ip is in the active bans list, without going to the database.
  * @param ip: ipv4 ip to check if ban
- * @return true if found or error, false if not in list
+ * @return true if found, false if not in list
  */
 bool ipban_check(uint32 ip);
 
@@ -20,6 +20,12 @@ bool ipban_check(uint32 ip);
  */
 void ipban_log(uint32 ip);
 
+/**
+ * Compares the ban and failed attempt checks of a login flood on the database and in memory.
+ * @param attempts: number of login attempts simulated
+ */
+void ipban_benchmark(int attempts);
+
 /**
  * Read configuration options.
  * @param key: config keyword
@@ -25,6 +25,7 @@
 #include "../config/core.hpp"
 
 #include "account.hpp"
+#include "dnsbl.hpp"
 #include "ipban.hpp"
 #include "loginchrif.hpp"
 #include "loginclif.hpp"
@@ -296,23 +297,10 @@ int login_mmo_auth(struct login_session_data* sd, bool isServer) {
 	char ip[16];
 	ip2str(session[sd->fd]->client_addr, ip);
 
-	// DNS Blacklist check
-	if( login_config.use_dnsbl ) {
-		char r_ip[16];
-		char ip_dnsbl[256];
-		char* dnsbl_serv;
-		uint8* sin_addr = (uint8*)&session[sd->fd]->client_addr;
-
-		sprintf(r_ip, "%u.%u.%u.%u", sin_addr[0], sin_addr[1], sin_addr[2], sin_addr[3]);
-
-		for( dnsbl_serv = strtok(login_config.dnsbl_servs,","); dnsbl_serv != NULL; dnsbl_serv = strtok(NULL,",") ) {
-			sprintf(ip_dnsbl, "%s.%s", r_ip, trim(dnsbl_serv));
-			if( host2ip(ip_dnsbl) ) {
-				ShowInfo("DNSBL: (%s) Blacklisted. User Kicked.\n", r_ip);
-				return 3;
-			}
-		}
-
+	// DNS Blacklist check, looked up before the authentication packet was parsed
+	if( login_config.use_dnsbl && sd->dnsbl_listed ) {
+		ShowInfo("DNSBL: (%s) Blacklisted. User Kicked.\n", ip);
+		return 3;
 	}
 
 	len = strnlen(sd->userid, NAME_LENGTH);
@@ -640,6 +628,8 @@ bool login_config_read(const char* cfgName, bool normal) {
 			safestrncpy(login_config.dnsbl_servs, w2, sizeof(login_config.dnsbl_servs));
 		else if(!strcmpi(w1, "ipban_cleanup_interval"))
 			login_config.ipban_cleanup_interval = (unsigned int)atoi(w2);
+		else if(!strcmpi(w1, "ipban_refresh_interval"))
+			login_config.ipban_refresh_interval = (unsigned int)atoi(w2);
 		else if(!strcmpi(w1, "ip_sync_interval"))
 			login_config.ip_sync_interval = (unsigned int)1000*60*atoi(w2); //w2 comes in minutes.
 		else if(!strcmpi(w1, "client_hash_check"))
@@ -715,6 +705,7 @@ bool login_config_read(const char* cfgName, bool normal) {
 			// try others
 			ipban_config_read(w1, w2);
 			loginlog_config_read(w1, w2);
+			dnsbl_config_read(w1, w2);
 		}
 	}
 	fclose(fp);
@@ -729,6 +720,7 @@ void login_set_defaults() {
 	login_config.login_ip = INADDR_ANY;
 	login_config.login_port = 6900;
 	login_config.ipban_cleanup_interval = 60;
+	login_config.ipban_refresh_interval = 30;
 	login_config.ip_sync_interval = 0;
 	login_config.log_login = true;
 	safestrncpy(login_config.date_format, "%Y-%m-%d %H:%M:%S", sizeof(login_config.date_format));
@@ -796,6 +788,7 @@ void do_final(void) {
 
 	do_final_msg();
 	ipban_final();
+	dnsbl_final();
 	do_final_loginclif();
 	do_final_logincnslif();
 
@@ -885,6 +878,9 @@ int do_init(int argc, char** argv) {
 	// initialize static and dynamic ipban system
 	ipban_init();
 
+	// initialize DNS blacklist lookups
+	dnsbl_init();
+
 	add_timer_func_list(login_waiting_disconnect_timer, "waiting_disconnect_timer");
 
 	// set default parser as parse_login function
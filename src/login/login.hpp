@@ -45,6 +45,9 @@ struct login_session_data {
 	int has_client_hash;		///client ha sent an hash
 
 	int fd;				///socket of client
+	bool dnsbl_wait;		///parsing paused until the DNS blacklists answered
+	bool dnsbl_checked;		///DNS blacklists answered for this session
+	bool dnsbl_listed;		///ip is listed by one of the DNS blacklists (when dnsbl_checked)
 
 	char web_auth_token[WEB_AUTH_TOKEN_LENGTH]; /// web authentication token
 };
@@ -72,6 +75,7 @@ struct Login_Config {
 	uint32 login_ip;                                /// the address to bind to
 	uint16 login_port;                              /// the port to bind to
 	unsigned int ipban_cleanup_interval;            /// interval (in seconds) to clean up expired IP bans
+	unsigned int ipban_refresh_interval;            /// interval (in seconds) to reload the IP bans kept in memory
 	unsigned int ip_sync_interval;                  /// interval (in minutes) to execute a DNS/IP update (for dynamic IPs)
 	bool log_login;                                 /// whether to log login server actions or not
 	char date_format[32];                           /// date format used in messages
@@ -16,6 +16,7 @@
 #include "../common/utils.hpp"
 
 #include "account.hpp"
+#include "dnsbl.hpp"
 #include "ipban.hpp" //ipban_check
 #include "login.hpp"
 #include "loginchrif.hpp"
@@ -471,6 +472,36 @@ int logclif_parse_otp_login( int fd, struct login_session_data* sd ){
 	return 1;
 }
 
+/**
+ * Looks up the client on the DNS blacklists before its authentication is parsed.
+ * Parsing is paused until the answers arrived, unless the result is cached.
+ * The result is kept in the session, so resuming doesn't look it up again.
+ * @param fd: fd to parse from (client fd)
+ * @param sd: client session
+ * @return true if parsing is paused, false to go on with the packet
+ */
+static bool logclif_dnsbl_wait(int fd, struct login_session_data* sd) {
+	if( !login_config.use_dnsbl || sd->dnsbl_checked )
+		return false;
+
+	sd->dnsbl_wait = !dnsbl_lookup(session[fd]->client_addr, [fd, sd]( bool listed ){
+		if( !session_isActive(fd) || session[fd]->session_data != sd )
+			return; // client is gone
+
+		sd->dnsbl_wait = false;
+		sd->dnsbl_checked = true;
+		sd->dnsbl_listed = listed;
+		logclif_parse(fd);
+	});
+
+	if( !sd->dnsbl_wait ) {// answered from the cache
+		sd->dnsbl_checked = true;
+		sd->dnsbl_listed = dnsbl_listed(session[fd]->client_addr);
+	}
+
+	return sd->dnsbl_wait;
+}
+
 /**
  * Entry point from client to log-server.
  * Function that checks incoming command, then splits it to the correct handler.
@@ -511,6 +542,9 @@ int logclif_parse(int fd) {
 		sd->fd = fd;
 	}
 
+	if( sd->dnsbl_wait )
+		return 0; // resumed once the DNS blacklists answered
+
 	while( RFIFOREST(fd) >= 2 )
 	{
 		uint16 command = RFIFOW(fd,0);
@@ -531,6 +565,8 @@ int logclif_parse(int fd) {
 		case 0x01fa: // S 01fa <version>.L <username>.24B <password hash>.16B <clienttype>.B <?>.B(index of the connection in the clientinfo file (+10 if the command-line contains "pc"))
 		case 0x027c: // S 027c <version>.L <username>.24B <password hash>.16B <clienttype>.B <?>.13B(junk)
 		case 0x0825: // S 0825 <packetsize>.W <version>.L <clienttype>.B <userid>.24B <password>.27B <mac>.17B <ip>.15B <token>.(packetsize - 0x5C)B
+			if( logclif_dnsbl_wait(fd, sd) )
+				return 0;
 			next = logclif_parse_reqauth(fd,  sd, command, ip); 
 			break;
 		// Sending request of the coding key
@@ -540,7 +576,11 @@ int logclif_parse(int fd) {
 			next = logclif_parse_otp_login( fd, sd );
 			break;
 		// Connection request of a char-server
-		case 0x2710: logclif_parse_reqcharconnec(fd,sd, ip); return 0; // processing will continue elsewhere
+		case 0x2710:
+			if( logclif_dnsbl_wait(fd, sd) )
+				return 0;
+			logclif_parse_reqcharconnec(fd,sd, ip);
+			return 0; // processing will continue elsewhere
 		default:
 			ShowNotice("Abnormal end of connection (ip: %s): Unknown packet 0x%x\n", ip, command);
 			set_eof(fd);
@@ -13,6 +13,8 @@
 #include "../common/strlib.hpp"
 #include "../common/timer.hpp"
 
+#include "account.hpp"
+#include "ipban.hpp"
 #include "login.hpp"
 
 /**
@@ -27,6 +29,8 @@ void display_helpscreen(bool do_exit) {
 	ShowInfo("  -?, -h [--help]\t\tDisplays this help screen.\n");
 	ShowInfo("  -v [--version]\t\tDisplays the server's version.\n");
 	ShowInfo("  --run-once\t\t\tCloses server after loading (testing).\n");
+	ShowInfo("  --timer-wheel\t\t\tUses the timing wheel instead of the timer heap.\n");
+	ShowInfo("  --timer-trace <file>\t\tRecords timer operations for the timerbench tool.\n");
 	ShowInfo("  --login-config <file>\t\tAlternative login-server configuration.\n");
 	ShowInfo("  --lan-config <file>\t\tAlternative lan configuration.\n");
 	ShowInfo("  --msg-config <file>\t\tAlternative message configuration.\n");
@@ -58,6 +62,10 @@ int logcnslif_get_options(int argc, char ** argv) {
 				display_versionscreen(true);
 			} else if (strcmp(arg, "run-once") == 0){ // close the map-server as soon as its done.. for testing [Celest]
 				runflag = CORE_ST_STOP;
+			} else if (strcmp(arg, "timer-wheel") == 0) {
+				timer_set_backend(TIMER_BACKEND_WHEEL);
+			} else if (strcmp(arg, "timer-trace") == 0) {
+				if (opt_has_next_value(arg, i, argc)) timer_trace_open(argv[++i]);
 			} else if (SERVER_TYPE & (ATHENA_SERVER_LOGIN)) { //login
 				if (strcmp(arg, "lan-config") == 0) {
 					if (opt_has_next_value(arg, i, argc)) safestrncpy(login_config.lanconf_name, argv[++i], sizeof(login_config.lanconf_name));
@@ -139,6 +147,34 @@ int cnslif_parse(const char* buf){
 			}
 			ShowStatus("Console: Account '%s' created successfully.\n", username);
 		}
+		if( strcmpi("bench", type) == 0 && strncmpi(command, "loginflood", 10) == 0 ){
+			int attempts = 10000;
+
+			sscanf(command + 10, "%d", &attempts);
+			ipban_benchmark(max(attempts, 1));
+		}
+		if( strcmpi("account", type) == 0 ){
+			AccountDB* accounts = login_get_accounts_db();
+
+			if( strcmpi("cache", command) == 0 ){
+				struct s_account_cache_stats stats;
+
+				accounts->get_cache_stats(accounts, &stats);
+				ShowInfo("Account cache: %" PRIuPTR " accounts, %" PRIuPTR " unknown userids\n", stats.accounts, stats.missing);
+				ShowInfo("  hits: %" PRIu64 ", misses: %" PRIu64 ", unknown userid hits: %" PRIu64 "\n", stats.hits, stats.misses, stats.negative_hits);
+				ShowInfo("  evictions: %" PRIu64 ", invalidations: %" PRIu64 "\n", stats.evictions, stats.invalidations);
+			}
+			else if( strncmpi("invalidate", command, 10) == 0 ){
+				unsigned int account_id = 0;
+
+				if( strcmpi(command + 10, " all") != 0 && sscanf(command + 10, "%u", &account_id) < 1 ){
+					ShowWarning("Console: Invalid parameters for '%s'. Usage: %s:invalidate <account_id|all>\n", type, type);
+					return 0;
+				}
+				accounts->invalidate(accounts, account_id);
+				ShowStatus("Console: Account cache invalidated.\n");
+			}
+		}
 	}
 	else if( strcmpi("help", type) == 0 ){
 		ShowInfo("Available commands:\n");
@@ -146,6 +182,9 @@ int cnslif_parse(const char* buf){
 		ShowInfo("\t server:alive => Checks if the server is running.\n");
 		ShowInfo("\t server:reloadconf => Reload config file: \"%s\"\n", login_config.loginconf_name);
 		ShowInfo("\t create:<username> <password> <sex:M|F> => Creates a new account.\n");
+		ShowInfo("\t bench:loginflood {attempts} => Compares the ban and failed attempt checks on the database and in memory.\n");
+		ShowInfo("\t account:cache => Shows the statistics of the account cache.\n");
+		ShowInfo("\t account:invalidate <account_id|all> => Reloads accounts changed outside of the login-server from the database.\n");
 	}
 	return 1;
 }
@@ -3,8 +3,13 @@
 
 #include "loginlog.hpp"
 
+#include <deque>
 #include <stdlib.h> // exit
 #include <string.h>
+#include <string>
+#include <time.h>
+#include <unordered_map>
+#include <vector>
 
 #include "../common/cbasetypes.hpp"
 #include "../common/mmo.hpp"
@@ -12,6 +17,16 @@
 #include "../common/socket.hpp"
 #include "../common/sql.hpp"
 #include "../common/strlib.hpp"
+#include "../common/timer.hpp"
+
+#include "login.hpp"
+
+// interval in which queued log rows are written, in milliseconds
+#define LOGINLOG_FLUSH_INTERVAL 1000
+// number of queued log rows written right away
+#define LOGINLOG_FLUSH_ROWS 100
+// failed attempts remembered per ip, enough to reach the dynamic ban limit
+#define LOGINLOG_FAILURES_MAX ( (size_t)max(login_config.dynamic_pass_failure_ban_limit, 1) )
 
 // global sql settings (in ipban_sql.cpp)
 static char   global_db_hostname[64] = "127.0.0.1"; // Doubled to reflect the change on commit #0f2dd7f
@@ -31,15 +46,59 @@ static char   log_login_db[256] = "loginlog";
 
 static Sql* sql_handle = NULL;
 static bool enabled = false;
+static int flush_timer_id = INVALID_TIMER;
 
+/// Log row waiting to be written
+struct s_loginlog_row {
+	time_t time;
+	uint32 ip;
+	int rcode;
+	std::string username; // escaped
+	std::string message; // escaped
+};
+
+static std::vector<struct s_loginlog_row> loginlog_rows;
+/// Times of the recent failed attempts (rcode 0 and 1) by ip, oldest first
+static std::unordered_map<uint32, std::deque<time_t>> loginlog_failures;
+static time_t loginlog_failures_pruned = 0;
 
 /**
  * Get the number of failed login attempts by the ip in the last minutes.
+ * The attempts are counted in memory, see loginlog_failedattempts_sql.
  * @param ip: ip to search attempt from
  * @param minutes: intervall to search
  * @return number of failed attempts
  */
 unsigned long loginlog_failedattempts(uint32 ip, unsigned int minutes) {
+	time_t since;
+
+	if( !enabled )
+		return 0;
+
+	auto it = loginlog_failures.find(ip);
+
+	if( it == loginlog_failures.end() )
+		return 0;
+
+	since = time(NULL) - (time_t)minutes * 60;
+	while( !it->second.empty() && it->second.front() <= since )
+		it->second.pop_front();
+	if( it->second.empty() ) {
+		loginlog_failures.erase(it);
+		return 0;
+	}
+
+	return (unsigned long)it->second.size();
+}
+
+/**
+ * Get the number of failed login attempts by the ip in the last minutes from the log table.
+ * Used by the login flood benchmark, only sees the attempts already written.
+ * @param ip: ip to search attempt from
+ * @param minutes: intervall to search
+ * @return number of failed attempts
+ */
+unsigned long loginlog_failedattempts_sql(uint32 ip, unsigned int minutes) {
 	unsigned long failures = 0;
 
 	if( !enabled )
@@ -60,8 +119,56 @@ unsigned long loginlog_failedattempts(uint32 ip, unsigned int minutes) {
 }
 
 
+/**
+ * Writes the queued log rows with a single statement.
+ */
+static void loginlog_flush(void) {
+	StringBuf buf;
+
+	if( loginlog_rows.empty() )
+		return;
+
+	StringBuf_Init(&buf);
+	StringBuf_Printf(&buf, "INSERT INTO `%s`(`time`,`ip`,`user`,`rcode`,`log`) VALUES ", log_login_db);
+	for( size_t i = 0; i < loginlog_rows.size(); i++ ) {
+		const struct s_loginlog_row& row = loginlog_rows[i];
+
+		StringBuf_Printf(&buf, "%s(FROM_UNIXTIME(%" PRId64 "), '%s', '%s', '%d', '%s')", i ? "," : "",
+			(int64)row.time, ip2str(row.ip, NULL), row.username.c_str(), row.rcode, row.message.c_str());
+	}
+
+	if( SQL_ERROR == Sql_QueryStr(sql_handle, StringBuf_Value(&buf)) )
+		Sql_ShowDebug(sql_handle);
+	StringBuf_Destroy(&buf);
+	loginlog_rows.clear();
+}
+
+/**
+ * Timered function to write the queued log rows and forget failed attempts older than the ban interval.
+ */
+static TIMER_FUNC(loginlog_flush_timer) {
+	time_t now = time(NULL);
+
+	loginlog_flush();
+
+	if( now - loginlog_failures_pruned >= 60 ) {
+		time_t since = now - (time_t)login_config.dynamic_pass_failure_ban_interval * 60;
+
+		for( auto it = loginlog_failures.begin(); it != loginlog_failures.end(); ) {
+			if( it->second.back() <= since )
+				it = loginlog_failures.erase(it);
+			else
+				++it;
+		}
+		loginlog_failures_pruned = now;
+	}
+
+	return 0;
+}
+
 /**
  * Records an event in the login log.
+ *  The row is written behind, with the next batch.
  * @param ip:
  * @param username:
  * @param rcode:
@@ -70,7 +177,7 @@ unsigned long loginlog_failedattempts(uint32 ip, unsigned int minutes) {
 void login_log(uint32 ip, const char* username, int rcode, const char* message) {
 	char esc_username[NAME_LENGTH*2+1];
 	char esc_message[255*2+1];
-	int retcode;
+	struct s_loginlog_row row;
 
 	if( !enabled )
 		return;
@@ -78,12 +185,53 @@ void login_log(uint32 ip, const char* username, int rcode, const char* message)
 	Sql_EscapeStringLen(sql_handle, esc_username, username, strnlen(username, NAME_LENGTH));
 	Sql_EscapeStringLen(sql_handle, esc_message, message, strnlen(message, 255));
 
-	retcode = Sql_Query(sql_handle,
-		"INSERT INTO `%s`(`time`,`ip`,`user`,`rcode`,`log`) VALUES (NOW(), '%s', '%s', '%d', '%s')",
-		log_login_db, ip2str(ip,NULL), esc_username, rcode, esc_message);
+	row.time = time(NULL);
+	row.ip = ip;
+	row.rcode = rcode;
+	row.username = esc_username;
+	row.message = esc_message;
+	loginlog_rows.push_back(row);
+
+	if( rcode == 0 || rcode == 1 ) {// failed attempt
+		std::deque<time_t>& failures = loginlog_failures[ip];
+
+		while( failures.size() >= LOGINLOG_FAILURES_MAX )
+			failures.pop_front();
+		failures.push_back(row.time);
+	}
+
+	if( loginlog_rows.size() >= LOGINLOG_FLUSH_ROWS )
+		loginlog_flush();
+}
+
+/**
+ * Loads the failed attempts of the ban interval, so a restart doesn't reset them.
+ */
+static void loginlog_load_failures(void) {
+	char* data;
 
-	if( retcode != SQL_SUCCESS )
+	if( SQL_ERROR == Sql_Query(sql_handle, "SELECT `ip`, UNIX_TIMESTAMP(`time`) FROM `%s` WHERE (`rcode` = '0' OR `rcode` = '1') AND `time` > NOW() - INTERVAL %d MINUTE ORDER BY `time`",
+		log_login_db, login_config.dynamic_pass_failure_ban_interval) )
+	{
 		Sql_ShowDebug(sql_handle);
+		return;
+	}
+
+	while( SQL_SUCCESS == Sql_NextRow(sql_handle) )
+	{
+		uint32 ip;
+
+		Sql_GetData(sql_handle, 0, &data, NULL);
+		ip = str2ip(data);
+		Sql_GetData(sql_handle, 1, &data, NULL);
+
+		std::deque<time_t>& failures = loginlog_failures[ip];
+
+		while( failures.size() >= LOGINLOG_FAILURES_MAX )
+			failures.pop_front();
+		failures.push_back((time_t)strtoll(data, NULL, 10));
+	}
+	Sql_FreeResult(sql_handle);
 }
 
 /**
@@ -198,6 +346,10 @@ bool loginlog_init(void) {
 
 	enabled = true;
 
+	loginlog_load_failures();
+	add_timer_func_list(loginlog_flush_timer, "loginlog_flush_timer");
+	flush_timer_id = add_timer_interval(gettick() + LOGINLOG_FLUSH_INTERVAL, loginlog_flush_timer, 0, 0, LOGINLOG_FLUSH_INTERVAL);
+
 	return true;
 }
 
@@ -208,6 +360,14 @@ bool loginlog_init(void) {
  * @return true success
  */
 bool loginlog_final(void) {
+	if( flush_timer_id != INVALID_TIMER ) {
+		delete_timer(flush_timer_id, loginlog_flush_timer);
+		flush_timer_id = INVALID_TIMER;
+	}
+	loginlog_flush();
+	loginlog_failures.clear();
+	enabled = false;
+
 	Sql_Free(sql_handle);
 	sql_handle = NULL;
 	return true;
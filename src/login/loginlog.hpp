@@ -10,14 +10,25 @@
 
 /**
  * Get the number of failed login attempts by the ip in the last minutes.
+ * The attempts are counted in memory, see loginlog_failedattempts_sql.
  * @param ip: ip to search attempt from
  * @param minutes: intervall to search
  * @return number of failed attempts
  */
 unsigned long loginlog_failedattempts(uint32 ip, unsigned int minutes);
 
+/**
+ * Get the number of failed login attempts by the ip in the last minutes from the log table.
+ * Used by the login flood benchmark, only sees the attempts already written.
+ * @param ip: ip to search attempt from
+ * @param minutes: intervall to search
+ * @return number of failed attempts
+ */
+unsigned long loginlog_failedattempts_sql(uint32 ip, unsigned int minutes);
+
 /**
  * Records an event in the login log.
+ *  The row is written behind, with the next batch.
  * @param ip:
  * @param username:
  * @param rcode:
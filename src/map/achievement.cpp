@@ -35,13 +35,46 @@ using namespace rathena;
 
 void AchievementDatabase::clear(){
 	TypesafeYamlDatabase::clear();
-	this->achievement_mobs.clear();
+	this->objective_index.clear();
 }
 
 const std::string AchievementDatabase::getDefaultLocation(){
 	return std::string(db_path) + "/achievement_db.yml";
 }
 
+/**
+ * Rewrites the ARG<n> references of a condition into achievement_condition_arg(<n>), so the
+ * objective arguments are read from the dispatch parameter block instead of the character registry.
+ * @param condition: Condition script source
+ */
+static void achievement_condition_bind_args( std::string& condition ){
+	std::string result;
+	size_t i = 0, len = condition.length();
+
+	result.reserve( len );
+
+	while( i < len ){
+		// Skip identifiers that only end with ARG and other variable scopes ('.ARG0', '@ARG0', '$ARG0', ...)
+		if( condition.compare( i, 3, "ARG" ) == 0 && ( i == 0 || !( ISALNUM( condition[i - 1] ) || strchr( "_.@$#'", condition[i - 1] ) ) ) ){
+			size_t j = i + 3;
+
+			while( j < len && ISDIGIT( condition[j] ) ){
+				j++;
+			}
+
+			if( j > i + 3 && ( j == len || !( ISALNUM( condition[j] ) || condition[j] == '_' || condition[j] == '$' ) ) ){
+				result += "achievement_condition_arg(" + condition.substr( i + 3, j - i - 3 ) + ")";
+				i = j;
+				continue;
+			}
+		}
+
+		result += condition[i++];
+	}
+
+	condition = result;
+}
+
 /**
  * Reads and parses an entry from the achievement_db.
  * @param node: YAML node containing the entry.
@@ -167,13 +200,7 @@ uint64 AchievementDatabase::parseBodyNode(const YAML::Node &node){
 					return 0;
 				}
 
-				uint32 mob_id = mob->id;
-
-				if( !this->mobexists( mob_id ) ){
-					this->achievement_mobs.push_back( mob_id );
-				}
-
-				target->mob = mob_id;
+				target->mob = mob->id;
 			}else{
 				if( !targetExists ){
 					target->mob = 0;
@@ -195,6 +222,8 @@ uint64 AchievementDatabase::parseBodyNode(const YAML::Node &node){
 			condition = "achievement_condition( " + condition + " );";
 		}
 
+		achievement_condition_bind_args( condition );
+
 		if( achievement->condition ){
 			script_free_code( achievement->condition );
 			achievement->condition = nullptr;
@@ -364,6 +393,27 @@ void AchievementDatabase::loadingFinished(){
 
 		ach->dependent_ids.shrink_to_fit();
 	}
+
+	// Index the achievements by the objective that can update them
+	this->objective_index.clear();
+
+	for (const auto &achit : achievement_db) {
+		const std::shared_ptr<s_achievement_db> ach = achit.second;
+
+		if (ach->group <= AG_NONE || ach->group >= AG_MAX)
+			continue;
+
+		if (ach->group == AG_BATTLE || ach->group == AG_TAMING) {
+			// Only kills/tames of one of the target monsters update these
+			for (const auto &target : ach->targets) {
+				std::vector<std::shared_ptr<s_achievement_db>> &list = this->objective_index[objectiveKey(ach->group, target.second->mob)];
+
+				if (!util::vector_exists(list, ach))
+					list.push_back(ach);
+			}
+		} else
+			this->objective_index[objectiveKey(ach->group, 0)].push_back(ach);
+	}
 }
 
 AchievementDatabase achievement_db;
@@ -377,9 +427,23 @@ bool AchievementDatabase::mobexists( uint32 mob_id ){
 	if (!battle_config.feature_achievement)
 		return false;
 
-	auto it = std::find(this->achievement_mobs.begin(), this->achievement_mobs.end(), mob_id);
+	return this->getObjectiveCandidates( AG_BATTLE, mob_id ) != nullptr;
+}
 
-	return (it != this->achievement_mobs.end()) ? true : false;
+/**
+ * Looks up the achievements that an objective update can affect
+ * @param group: Achievement group of the event
+ * @param target: Killed/tamed monster ID for AG_BATTLE and AG_TAMING, 0 otherwise
+ * @return List of candidate achievements or nullptr if there are none
+ */
+const std::vector<std::shared_ptr<s_achievement_db>>* AchievementDatabase::getObjectiveCandidates( enum e_achievement_group group, uint32 target ){
+	auto it = this->objective_index.find( objectiveKey( group, target ) );
+
+	if( it == this->objective_index.end() ){
+		return nullptr;
+	}
+
+	return &it->second;
 }
 
 const std::string AchievementLevelDatabase::getDefaultLocation(){
@@ -903,6 +967,22 @@ bool achievement_check_condition( struct script_code* condition, struct map_sess
 	return value != 0;
 }
 
+/// Objective arguments of the update being evaluated, read by conditions through ARG<n>
+static const std::array<int, MAX_ACHIEVEMENT_OBJECTIVES>* achievement_args = nullptr;
+
+/**
+ * Returns an objective argument of the update currently being evaluated
+ * @param index: Argument index (ARG<index>)
+ * @return Argument value or 0 outside of an objective update
+ */
+int achievement_condition_arg( int index ){
+	if( achievement_args == nullptr || index < 0 || index >= MAX_ACHIEVEMENT_OBJECTIVES ){
+		return 0;
+	}
+
+	return (*achievement_args)[index];
+}
+
 /**
  * Check to see if an achievement's target count is complete
  * @param ad: Achievement data
@@ -1094,24 +1174,25 @@ void achievement_update_objective(struct map_session_data *sd, enum e_achievemen
 		std::array<int, MAX_ACHIEVEMENT_OBJECTIVES> count = {};
 
 		va_start(ap, arg_count);
-		for (int i = 0; i < arg_count; i++){
-			std::string name = "ARG" + std::to_string(i);
-
+		for (int i = 0; i < arg_count; i++)
 			count[i] = va_arg(ap, int);
-
-			pc_setglobalreg( sd, add_str( name.c_str() ), (int)count[i] );
-		}
 		va_end(ap);
 
-		for (auto &ach : achievement_db)
-			achievement_update_objectives(sd, ach.second, group, count);
+		// Battle and taming objectives are indexed by monster ID (ARG0)
+		const std::vector<std::shared_ptr<s_achievement_db>> *candidates = achievement_db.getObjectiveCandidates(group, (group == AG_BATTLE || group == AG_TAMING) ? count[0] : 0);
 
-		// Remove variables that might have been set
-		for (int i = 0; i < arg_count; i++){
-			std::string name = "ARG" + std::to_string(i);
+		if (candidates == nullptr)
+			return;
 
-			pc_setglobalreg( sd, add_str( name.c_str() ), 0 );
-		}
+		// Hand the arguments to the conditions, restoring the outer ones after a nested update
+		const std::array<int, MAX_ACHIEVEMENT_OBJECTIVES> *previous_args = achievement_args;
+
+		achievement_args = &count;
+
+		for (auto &ach : *candidates)
+			achievement_update_objectives(sd, ach, group, count);
+
+		achievement_args = previous_args;
 	}
 }
 
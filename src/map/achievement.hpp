@@ -99,7 +99,12 @@ struct s_achievement_db {
 
 class AchievementDatabase : public TypesafeYamlDatabase<uint32, s_achievement_db>{
 private:
-	std::vector<uint32> achievement_mobs; // Avoids checking achievements on every mob killed
+	// (group, target mob) -> achievements updated by that objective, avoids walking the whole database on every event
+	std::unordered_map<uint64, std::vector<std::shared_ptr<s_achievement_db>>> objective_index;
+
+	static uint64 objectiveKey( enum e_achievement_group group, uint32 target ){
+		return ( static_cast<uint64>( group ) << 32 ) | target;
+	}
 
 public:
 	AchievementDatabase() : TypesafeYamlDatabase( "ACHIEVEMENT_DB", 2 ){
@@ -113,6 +118,7 @@ public:
 
 	// Additional
 	bool mobexists(uint32 mob_id);
+	const std::vector<std::shared_ptr<s_achievement_db>>* getObjectiveCandidates( enum e_achievement_group group, uint32 target );
 };
 
 extern AchievementDatabase achievement_db;
@@ -143,6 +149,7 @@ void achievement_free(struct map_session_data *sd);
 int achievement_check_progress(struct map_session_data *sd, int achievement_id, int type);
 int *achievement_level(struct map_session_data *sd, bool flag);
 bool achievement_check_condition(struct script_code* condition, struct map_session_data* sd);
+int achievement_condition_arg(int index);
 void achievement_get_titles(uint32 char_id);
 void achievement_update_objective(struct map_session_data *sd, enum e_achievement_group group, uint8 arg_count, ...);
 int achievement_update_objective_sub(block_list *bl, va_list ap);
@@ -5,6 +5,7 @@
 
 #include <set>
 #include <unordered_map>
+#include <vector>
 
 #include <math.h>
 #include <stdlib.h>
@@ -7259,6 +7260,120 @@ ACMD_FUNC(uptime)
 	return 0;
 }
 
+/*==========================================
+ * @timerstats [on|off|reset|<count>]
+ * Lists the most time consuming timer functions
+ *------------------------------------------*/
+ACMD_FUNC(timerstats)
+{
+	std::vector<struct TimerProfile> list;
+	int count = 10;
+	nullpo_retr(-1, sd);
+
+	if (message && *message) {
+		if (strcmpi(message, "on") == 0) {
+			timer_profile_enable(true);
+			clif_displaymessage(fd, "Timer profiling enabled.");
+			return 0;
+		} else if (strcmpi(message, "off") == 0) {
+			timer_profile_enable(false);
+			clif_displaymessage(fd, "Timer profiling disabled.");
+			return 0;
+		} else if (strcmpi(message, "reset") == 0) {
+			timer_profile_reset();
+			clif_displaymessage(fd, "Timer statistics cleared.");
+			return 0;
+		} else if ((count = atoi(message)) < 1) {
+			clif_displaymessage(fd, "Usage: @timerstats [on|off|reset|<count>]");
+			return -1;
+		}
+		count = min(count, 100); // one message per function
+	}
+
+	if (!timer_profile_enabled())
+		clif_displaymessage(fd, "Timer profiling is disabled, showing the last recorded statistics.");
+
+	list.resize(count);
+	count = timer_profile_get(list.data(), count);
+	if (count == 0) {
+		clif_displaymessage(fd, "No timer statistics recorded.");
+		return 0;
+	}
+
+	clif_displaymessage(fd, "Function: calls, total ms, avg/max us, avg/max lag ms");
+	for (int i = 0; i < count; i++) {
+		const struct TimerProfile* p = &list[i];
+
+		snprintf(atcmd_output, sizeof(atcmd_output), "%s: %u, %" PRIu64 ", %" PRIu64 "/%" PRIu64 ", %" PRIu64 "/%" PRtf,
+			p->name, p->calls, p->total_time / 1000, p->total_time / p->calls, p->max_time, p->total_lag / p->calls, p->max_lag);
+		clif_displaymessage(fd, atcmd_output);
+	}
+
+	return 0;
+}
+
+/*==========================================
+ * @sendstats [reset]
+ * Shows the outgoing traffic counters
+ *------------------------------------------*/
+ACMD_FUNC(sendstats)
+{
+	struct s_send_stats stats;
+	nullpo_retr(-1, sd);
+
+	if (message && *message) {
+		if (strcmpi(message, "reset") == 0) {
+			socket_reset_send_stats();
+			clif_displaymessage(fd, "Send statistics cleared.");
+			return 0;
+		}
+		clif_displaymessage(fd, "Usage: @sendstats [reset]");
+		return -1;
+	}
+
+	socket_get_send_stats(&stats);
+	if (stats.flushes == 0) {
+		clif_displaymessage(fd, "No send statistics recorded.");
+		return 0;
+	}
+
+	snprintf(atcmd_output, sizeof(atcmd_output), "Flushes: %" PRIu64 ", bytes: %" PRIu64 ", send calls: %" PRIu64 ", packets: %" PRIu64 " (%" PRIu64 " shared)",
+		stats.flushes, stats.bytes, stats.syscalls, stats.packets, stats.shared);
+	clif_displaymessage(fd, atcmd_output);
+	snprintf(atcmd_output, sizeof(atcmd_output), "Per flush: %" PRIu64 " bytes, %.1f send calls, %.1f packets",
+		stats.bytes / stats.flushes, (double)stats.syscalls / stats.flushes, (double)stats.packets / stats.flushes);
+	clif_displaymessage(fd, atcmd_output);
+
+	return 0;
+}
+
+/*==========================================
+ * @logstats
+ * Shows the state of the SQL log writer
+ *------------------------------------------*/
+ACMD_FUNC(logstats)
+{
+	struct s_log_writer_stats stats;
+	nullpo_retr(-1, sd);
+
+	if (!log_writer_active()) {
+		clif_displaymessage(fd, "The log writer is not running (log_async is disabled).");
+		return 0;
+	}
+
+	log_writer_get_stats(&stats);
+	snprintf(atcmd_output, sizeof(atcmd_output), "Queue: %" PRIuPTR " (max %" PRIuPTR "), queued: %" PRIu64 ", written: %" PRIu64 ", dropped: %" PRIu64 ", spilled: %" PRIu64 ", failed: %" PRIu64,
+		stats.depth, stats.max_depth, stats.queued, stats.written, stats.dropped, stats.spilled, stats.failed);
+	clif_displaymessage(fd, atcmd_output);
+	if (stats.batches > 0) {
+		snprintf(atcmd_output, sizeof(atcmd_output), "Batches: %" PRIu64 ", flush time: %" PRIu64 " us average, %" PRIu64 " us max, %" PRIu64 " us last",
+			stats.batches, stats.total_flush / stats.batches, stats.max_flush, stats.last_flush);
+		clif_displaymessage(fd, atcmd_output);
+	}
+
+	return 0;
+}
+
 /*==========================================
  * @changesex 
  * => Changes one's account sex. Switch from male to female or visversa
@@ -9476,35 +9591,51 @@ ACMD_FUNC(mount2) {
 
 /**
  * @brief Handles the @autoattack command to toggle the feature ON/OFF.
- * This function initiates or stops the timer loop defined in autoattack.cpp.
+ * This function registers or removes the player from the scheduler in autoattack.cpp.
  * @param sd The map session data of the player.
  * @param command The command string.
- * @param message The message arguments (unused).
  * @return 0 on success, -1 on failure.
  */
 ACMD_FUNC(autoattack)
 {
 	nullpo_retr(-1, sd);
-	
+
 	if (sd->sc.option & OPTION_AUTOATTACK)
 	{
 		// Toggle OFF
 		clif_displaymessage(fd, "Auto-attack OFF");
 		sd->sc.option &= ~OPTION_AUTOATTACK;
+		autoattack_stop(sd);
 		unit_stop_attack(&sd->bl); // Stop current attack/movement
 	}else
 	{
 		// Toggle ON
 		clif_displaymessage(fd, "Auto-attack ON");
 		sd->sc.option |= OPTION_AUTOATTACK;
-		// Start the timer loop defined in autoattack.cpp
-		add_timer(gettick()+2000, autoattack_timer, sd->bl.id, 0); 
+		// Hand the player to the scheduler defined in autoattack.cpp
+		autoattack_start(sd, 2000);
 	}
 	
 	clif_changeoption(&sd->bl); // Update client status
 	return 0;
 }
 
+/*==========================================
+ * @autoattackstats
+ * Shows the block cells visited by the auto-attack area scans, server-wide
+ *------------------------------------------*/
+ACMD_FUNC(autoattackstats)
+{
+	const autoattack_scan_stats& stats = autoattack_get_scan_stats();
+
+	sprintf(atcmd_output, "Auto-attack scans: %" PRIu64 " in %" PRIu64 " ticks, %" PRIu64 " block cells visited.", stats.scans, stats.ticks, stats.cells_visited);
+	clif_displaymessage(fd, atcmd_output);
+	sprintf(atcmd_output, "Block cells visited per tick: last %d, max %d, average %" PRIu64 ". Per scan: last %d.",
+		stats.last_tick_cells_visited, stats.max_tick_cells_visited, stats.ticks ? stats.cells_visited / stats.ticks : 0, stats.last_cells_visited);
+	clif_displaymessage(fd, atcmd_output);
+	return 0;
+}
+
 ACMD_FUNC(accinfo) {
 	char query[NAME_LENGTH];
 	char type = 0; // type = 1, get only account name
@@ -10710,6 +10841,10 @@ void atcommand_basecommands(void) {
 		ACMD_DEF(unmute),
 		ACMD_DEF(clearweather),
 		ACMD_DEF(uptime),
+		ACMD_DEF(timerstats),
+		ACMD_DEF(autoattackstats),
+		ACMD_DEF(sendstats),
+		ACMD_DEF(logstats),
 		ACMD_DEF(changesex),
 		ACMD_DEF(changecharsex),
 		ACMD_DEF(mute),
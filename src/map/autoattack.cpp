@@ -3,6 +3,7 @@
 #include <unordered_map>
 #include <stdarg.h> 
 #include <cmath>    
+#include <algorithm>
 
 // FIXED INCLUDES: Using the correct .hpp extension
 #include "clif.hpp"
@@ -15,7 +16,9 @@
 #include "skill.hpp"  // For Skill IDs (WZ_ENERGYCOAT, etc.)
 #include "status.hpp" // For Status Change IDs (SC_AGIUP, SC_ADRENALINERUSH, etc.)
 #include "map.hpp"    // For general map/game constants
+#include "path.hpp"   // check_distance_blxy
 #include "script.hpp"
+#include "../common/nullpo.hpp"
 #include "../common/strlib.hpp"
 
 #define AA_DEBUG 1
@@ -25,36 +28,25 @@
 // === PRIVATE DATA (Static to this file) ===
 // =====================================================================================
 
-// Helper to read character variables from the script engine
-static int get_aa_var(struct map_session_data* sd, const char* var_name)
-{
-    if (!sd || !var_name)
-        return 0;
+// Script string IDs of the AA_* variables, interned once at startup
+static int64 aa_var_uid[AA_VAR_MAX];
+static int64 aa_ic_exp_uid;
 
-    // add_str converts the variable name string into a unique ID (integer)
-    // pc_readglobalreg reads the value from the player's permanent variable storage
-    return pc_readglobalreg(sd, add_str(var_name));
-}
+static const char* aa_var_names[AA_VAR_MAX] = {
+#define AA_VAR_NAME(name) "AA_" #name,
+    AUTOATTACK_VARS(AA_VAR_NAME)
+#undef AA_VAR_NAME
+};
 
-static int buildin_autoattack_count_mobs(struct block_list *bl, va_list ap)
-{
-    int *count = va_arg(ap, int *);
-    (*count)++;
-    return 0;
-}
+static autoattack_config& autoattack_compile(struct map_session_data* sd);
 
-static int autoattack_count_nearby_mobs(struct map_session_data* sd, int radius)
+// Helper to read character variables compiled from the script engine
+static int get_aa_var(struct map_session_data* sd, e_aa_var var)
 {
-    int count = 0;
-    map_foreachinarea(
-        buildin_autoattack_count_mobs,
-        sd->bl.m,
-        sd->bl.x - radius, sd->bl.y - radius,
-        sd->bl.x + radius, sd->bl.y + radius,
-        BL_MOB,
-        &count
-    );
-    return count;
+    if (!sd)
+        return 0;
+
+    return autoattack_compile(sd).vars[var];
 }
 
 static void aa_debug(struct map_session_data* sd, const char* fmt, ...)
@@ -76,8 +68,8 @@ static void autoattack_perform_teleport(struct map_session_data* sd) {
     if (!sd) return;
 
     // Read the NPC choice: 0 = Free (@jump), 1 = Fly Wing
-    int tp_use_flywing = get_aa_var(sd, "AA_TP_USE_FLY_WING");
-    int tp_use_jump = get_aa_var(sd, "AA_TP_USE_JUMP");
+    int tp_use_flywing = get_aa_var(sd, AA_VAR_TP_USE_FLY_WING);
+    int tp_use_jump = get_aa_var(sd, AA_VAR_TP_USE_JUMP);
 
     if (tp_use_flywing == 1) {
         // Try to use a Fly Wing (Item ID: 601)
@@ -96,6 +88,9 @@ static void autoattack_perform_teleport(struct map_session_data* sd) {
 
 // Global storage for per-player configurations
 static std::unordered_map<int, autoattack_config> autoattack_configs;
+// Last configuration looked up, the loop asks for the same player many times in a row
+static struct map_session_data* aa_config_sd = nullptr;
+static autoattack_config* aa_config_last = nullptr;
 
 // Default list of ASPD consumables to check/use
 static const autoattack_item_entry AUTOATTACK_ITEMS[] = {
@@ -113,22 +108,55 @@ static const autoattack_pot_entry AUTOATTACK_POTS[] = {
 
 static const int AUTOATTACK_BB_MAX_MOBS = 5;
 
+// Block cell counters of the area scan
+static autoattack_scan_stats aa_scan_stats;
+
+/**
+ * @brief Dense per-bot state, addressed by index from the map buckets and the work queue.
+ */
+struct s_autoattack_bot {
+    struct map_session_data* sd = nullptr; // Owner, nullptr while the entry is free.
+    int16 m = -1;                // Map whose bucket holds this bot.
+    uint8 slot = 0;              // Time slot within AUTOATTACK_INTERVAL.
+    int pos = 0;                 // Position inside the bucket's slot list.
+    bool queued = false;         // Waiting in the work queue.
+    int miss = 0;                // Cycles without a target.
+    t_tick next_tick = 0;        // The bot stays idle before this tick (start/sit delays).
+    bool healing_hp = false;     // Auto-pot hysteresis for HP.
+    bool healing_sp = false;     // Auto-pot hysteresis for SP.
+};
+
+/**
+ * @brief Bots on one map, split by time slot.
+ */
+struct s_autoattack_bucket {
+    std::vector<int> slots[AUTOATTACK_SLOTS];
+};
+
+static std::vector<s_autoattack_bot> aa_bots;       // Dense bot state.
+static std::vector<int> aa_free;                     // Free indexes in aa_bots.
+static std::unordered_map<int, int> aa_bot_index;    // Block ID -> index, used on start/stop only.
+static std::unordered_map<int16, s_autoattack_bucket> aa_buckets; // Map ID -> bucket.
+static int aa_slot_load[AUTOATTACK_SLOTS];           // Bots per slot, to balance new registrations.
+static int aa_cur_slot = 0;                          // Slot run by the next timer call.
+static std::vector<int> aa_queue;                    // Bots due but not yet processed.
+static size_t aa_queue_pos = 0;                      // Next entry of aa_queue to process.
+
 // =====================================================================================
 // === PRIVATE FUNCTION PROTOTYPES (Static to this file) ===
 // =====================================================================================
 
 static const std::vector<t_itemid> get_aspd_pot_list(struct map_session_data* sd);
 static const std::vector<autoattack_pot_entry> get_heal_pot_configs(struct map_session_data* sd);
-static int buildin_autoattack_sub(struct block_list *bl,va_list ap);
-static int buildin_autoattack_count_attackers(struct block_list *bl, va_list ap);
-static int autoattack_count_attackers(struct map_session_data* sd, int radius);
+static void autoattack_scan_sub(struct block_list *bl, struct map_session_data *sd, autoattack_scan *scan);
+static autoattack_scan& autoattack_gather(struct map_session_data* sd, int radius);
 static bool autoattack_has_aspd_potion(struct map_session_data* sd);
 // autoattack_use_item_timer is REMOVED/NO LONGER NEEDED
 static void autoattack_try_consumables(struct map_session_data* sd);
-static void autoattack_try_autopots(struct map_session_data* sd);
+static void autoattack_try_autopots(struct map_session_data* sd, s_autoattack_bot& bot);
 static void autoattack_rebuff(struct map_session_data* sd);
 static void autoattack_use_offensive_skill(struct map_session_data* sd, int mob_count);
-static bool autoattack_motion(struct map_session_data* sd);
+static bool autoattack_motion(struct map_session_data* sd, const autoattack_scan& scan);
 
 
 // =====================================================================================
@@ -136,7 +164,12 @@ static bool autoattack_motion(struct map_session_data* sd);
 // =====================================================================================
 
 autoattack_config& get_autoattack_config(struct map_session_data* sd) {
+    if (sd == aa_config_sd)
+        return *aa_config_last;
+
     auto& config = autoattack_configs[sd->bl.id];
+    aa_config_sd = sd;
+    aa_config_last = &config;
     if (config.max_mobs_before_tp == 0) {
         config.max_mobs_before_tp = AUTOATTACK_MAX_MOBS_DEFAULT;
         config.idle_cycles_before_tp = AUTOATTACK_MISS_CYCLES_DEFAULT;
@@ -146,6 +179,63 @@ autoattack_config& get_autoattack_config(struct map_session_data* sd) {
     return config;
 }
 
+/**
+ * @brief Returns the player's configuration, re-reading the AA_* variables if one changed.
+ */
+static autoattack_config& autoattack_compile(struct map_session_data* sd) {
+    auto& config = get_autoattack_config(sd);
+
+    if (config.vars_dirty) {
+        for (int i = 0; i < AA_VAR_MAX; i++)
+            config.vars[i] = (int)pc_readglobalreg(sd, aa_var_uid[i]);
+        config.vars_dirty = false;
+    }
+
+    if (!config.ticks_loaded) {
+        config.ic_expire = pc_readglobalreg(sd, aa_ic_exp_uid);
+        config.ticks_loaded = true;
+    }
+
+    return config;
+}
+
+void autoattack_config_invalidate(struct map_session_data* sd) {
+    nullpo_retv(sd);
+
+    auto it = autoattack_configs.find(sd->bl.id);
+
+    if (it != autoattack_configs.end())
+        it->second.vars_dirty = true;
+}
+
+void autoattack_save(struct map_session_data* sd) {
+    nullpo_retv(sd);
+
+    auto it = autoattack_configs.find(sd->bl.id);
+
+    if (it == autoattack_configs.end() || !it->second.ticks_dirty)
+        return;
+
+    pc_setglobalreg(sd, aa_ic_exp_uid, (int)it->second.ic_expire);
+    it->second.ticks_dirty = false;
+}
+
+void autoattack_free(struct map_session_data* sd) {
+    nullpo_retv(sd);
+
+    autoattack_stop(sd);
+    autoattack_configs.erase(sd->bl.id);
+
+    if (aa_config_sd == sd) {
+        aa_config_sd = nullptr;
+        aa_config_last = nullptr;
+    }
+}
+
+const autoattack_scan_stats& autoattack_get_scan_stats(void) {
+    return aa_scan_stats;
+}
+
 static const std::vector<t_itemid> get_aspd_pot_list(struct map_session_data* sd) {
     auto& config = get_autoattack_config(sd);
     if (!config.aspd_pot_ids.empty())
@@ -176,28 +266,67 @@ static const std::vector<autoattack_pot_entry> get_heal_pot_configs(struct map_s
 // === TARGETING AND UTILITY FUNCTIONS ===
 // =====================================================================================
 
-static int buildin_autoattack_sub(struct block_list *bl,va_list ap)
-{
-    int *target_id=va_arg(ap,int *);
-    *target_id = bl->id;
-    return 1; // Stop iteration (found first mob)
-}
-
-static int buildin_autoattack_count_attackers(struct block_list *bl, va_list ap)
+/**
+ * @brief Collects one mob into the scan: counts it and records its distance.
+ */
+static void autoattack_scan_sub(struct block_list *bl, struct map_session_data *sd, autoattack_scan *scan)
 {
-    struct map_session_data *sd = va_arg(ap, struct map_session_data *);
-    int *count = va_arg(ap, int *);
     struct mob_data *md = (struct mob_data *)bl;
-    if (md && md->target_id == sd->bl.id)
-        (*count)++;
-    return 0; // Continue iteration
+
+    scan->mob_count++;
+    if (md->target_id == sd->bl.id)
+        scan->attacker_count++;
+
+    int dist = max(abs(bl->x - sd->bl.x), abs(bl->y - sd->bl.y));
+    scan->candidates.push_back({ bl->id, dist });
 }
 
-static int autoattack_count_attackers(struct map_session_data* sd, int radius)
+/**
+ * @brief Walks the block grid around the player once and builds the candidate list
+ * shared by the teleport, offensive skill and target selection decisions.
+ * @return The file-wide scan buffer, valid until the next call.
+ */
+static autoattack_scan& autoattack_gather(struct map_session_data* sd, int radius)
 {
-    int count = 0;
-    map_foreachinarea(buildin_autoattack_count_attackers, sd->bl.m, sd->bl.x - radius, sd->bl.y - radius, sd->bl.x + radius, sd->bl.y + radius, BL_MOB, sd, &count);
-    return count;
+    static autoattack_scan scan;
+    struct map_data *mapdata = map_getmapdata(sd->bl.m);
+
+    scan.clear();
+
+    if (mapdata == nullptr || mapdata->block == nullptr)
+        return scan;
+
+    int x0 = max(sd->bl.x - radius, 0);
+    int y0 = max(sd->bl.y - radius, 0);
+    int x1 = min(sd->bl.x + radius, mapdata->xs - 1);
+    int y1 = min(sd->bl.y + radius, mapdata->ys - 1);
+
+    // Mobs have their own block lists, walk them directly to count the cells visited
+    for (int by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++) {
+        for (int bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++) {
+            scan.cells_visited++;
+            for (struct block_list *bl = mapdata->block_mob[bx + by * mapdata->bxs]; bl != nullptr; bl = bl->next) {
+                if (bl->x < x0 || bl->x > x1 || bl->y < y0 || bl->y > y1)
+                    continue;
+#ifdef CIRCULAR_AREA
+                if (!check_distance_blxy(bl, sd->bl.x, sd->bl.y, radius))
+                    continue;
+#endif
+                autoattack_scan_sub(bl, sd, &scan);
+            }
+        }
+    }
+
+    // Stable so that mobs on the same ring keep block order, like the old ring-by-ring search
+    std::stable_sort(scan.candidates.begin(), scan.candidates.end(),
+        [](const autoattack_candidate& a, const autoattack_candidate& b) { return a.dist < b.dist; });
+
+    aa_scan_stats.scans++;
+    aa_scan_stats.cells_visited += scan.cells_visited;
+    aa_scan_stats.last_cells_visited = scan.cells_visited;
+    aa_scan_stats.tick_cells_visited += scan.cells_visited;
+
+    return scan;
 }
 
 static bool autoattack_has_aspd_potion(struct map_session_data* sd)
@@ -217,32 +346,32 @@ static void autoattack_try_consumables(struct map_session_data* sd)
     if (!sd) return;
 
     // --- 1. ASPD Potions ---
-    int aspd_id = get_aa_var(sd, "AA_ASPD_ITEM");
+    int aspd_id = get_aa_var(sd, AA_VAR_ASPD_ITEM);
     if (aspd_id > 0 && !autoattack_has_aspd_potion(sd)) {
         int idx = pc_search_inventory(sd, aspd_id);
         if (idx >= 0) pc_useitem(sd, idx);
     }
 
     // --- 2. Battle Manual ---
-    if (get_aa_var(sd, "AA_USE_BATTLE_MANUAL") > 0 && !sd->sc.data[SC_EXPBOOST]) {
+    if (get_aa_var(sd, AA_VAR_USE_BATTLE_MANUAL) > 0 && !sd->sc.data[SC_EXPBOOST]) {
         int idx = pc_search_inventory(sd, 12263); 
         if (idx >= 0) pc_useitem(sd, idx);
     }
 
     // --- 3. Bubble Gum ---
-    if (get_aa_var(sd, "AA_USE_BUBBLE_GUM") > 0 && !sd->sc.data[SC_ITEMBOOST]) {
+    if (get_aa_var(sd, AA_VAR_USE_BUBBLE_GUM) > 0 && !sd->sc.data[SC_ITEMBOOST]) {
         int idx = pc_search_inventory(sd, 12210);
         if (idx >= 0) pc_useitem(sd, idx);
     }
 
     // --- 4. LV10 Agil Scroll ---
-    if (get_aa_var(sd, "AA_USE_AGI_SCROLL") > 0 && !sd->sc.data[SC_ITEMBOOST]) {
+    if (get_aa_var(sd, AA_VAR_USE_AGI_SCROLL) > 0 && !sd->sc.data[SC_ITEMBOOST]) {
         int idx = pc_search_inventory(sd, 12216);
         if (idx >= 0) pc_useitem(sd, idx);
     }
 
     // --- 5. LV10 Blessing Scroll ---
-    if (get_aa_var(sd, "AA_USE_BLESS_SCROLL") > 0 && !sd->sc.data[SC_ITEMBOOST]) {
+    if (get_aa_var(sd, AA_VAR_USE_BLESS_SCROLL) > 0 && !sd->sc.data[SC_ITEMBOOST]) {
         int idx = pc_search_inventory(sd, 12215);
         if (idx >= 0) pc_useitem(sd, idx);
     }
@@ -251,7 +380,7 @@ static void autoattack_try_consumables(struct map_session_data* sd)
 /**
  * @brief Attempts to use HP/SP healing potions based on NPC thresholds.
  */
-static void autoattack_try_autopots(struct map_session_data* sd)
+static void autoattack_try_autopots(struct map_session_data* sd, s_autoattack_bot& bot)
 {
     if (!sd) return;
     
@@ -267,36 +396,32 @@ static void autoattack_try_autopots(struct map_session_data* sd)
     int cur_sp = pct(sd->battle_status.sp, sd->battle_status.max_sp);
 
     // --- HP LOGIC ---
-    int hp_id  = get_aa_var(sd, "AA_HP_ITEM");
-    int hp_threshold = get_aa_var(sd, "AA_HP_THRESHOLD");
-
-    static std::unordered_map<int, bool> is_healing_hp;
+    int hp_id  = get_aa_var(sd, AA_VAR_HP_ITEM);
+    int hp_threshold = get_aa_var(sd, AA_VAR_HP_THRESHOLD);
 
     if (hp_id > 0 && hp_threshold > 0) {
-        if (cur_hp <= hp_threshold) is_healing_hp[sd->bl.id] = true;
-        else if (cur_hp > hp_threshold) is_healing_hp[sd->bl.id] = false;
+        if (cur_hp <= hp_threshold) bot.healing_hp = true;
+        else if (cur_hp > hp_threshold) bot.healing_hp = false;
 
-        if (is_healing_hp[sd->bl.id]) {
+        if (bot.healing_hp) {
             int idx = pc_search_inventory(sd, hp_id);
             if (idx >= 0) pc_useitem(sd, idx);
-            else is_healing_hp[sd->bl.id] = false; // Out of pots
+            else bot.healing_hp = false; // Out of pots
         }
     }
 
     // --- SP LOGIC ---
-    int sp_id  = get_aa_var(sd, "AA_SP_ITEM");
-    int sp_threshold = get_aa_var(sd, "AA_SP_THRESHOLD");
-
-    static std::unordered_map<int, bool> is_healing_sp;
+    int sp_id  = get_aa_var(sd, AA_VAR_SP_ITEM);
+    int sp_threshold = get_aa_var(sd, AA_VAR_SP_THRESHOLD);
 
     if (sp_id > 0 && sp_threshold > 0) {
-        if (cur_sp <= sp_threshold) is_healing_sp[sd->bl.id] = true;
-        else if (cur_sp > sp_threshold) is_healing_sp[sd->bl.id] = false;
+        if (cur_sp <= sp_threshold) bot.healing_sp = true;
+        else if (cur_sp > sp_threshold) bot.healing_sp = false;
 
-        if (is_healing_sp[sd->bl.id]) {
+        if (bot.healing_sp) {
             int idx = pc_search_inventory(sd, sp_id);
             if (idx >= 0) pc_useitem(sd, idx);
-            else is_healing_sp[sd->bl.id] = false; // Out of pots
+            else bot.healing_sp = false; // Out of pots
         }
     }
 }
@@ -304,14 +429,19 @@ static void autoattack_try_autopots(struct map_session_data* sd)
 // =====================================================================================
 // === AUTO-BUFF (REBUFF) LOGIC (Complete Pre-Renewal) ===
 // =====================================================================================
-static int get_aa_tick(struct map_session_data* sd, const char* var) {
+// Cooldown ticks stay in memory and are flushed by autoattack_save on logout
+static t_tick get_aa_tick(struct map_session_data* sd) {
     if (!sd) return 0;
-    return pc_readglobalreg(sd, add_str(var));
+    return autoattack_compile(sd).ic_expire;
 }
 
-static void set_aa_tick(struct map_session_data* sd, const char* var, int value) {
+static void set_aa_tick(struct map_session_data* sd, t_tick value) {
     if (!sd) return;
-    pc_setglobalreg(sd, add_str(var), value);
+    auto& config = autoattack_compile(sd);
+    if (config.ic_expire != value) {
+        config.ic_expire = value;
+        config.ticks_dirty = true;
+    }
 }
 
 static void autoattack_rebuff(struct map_session_data* sd)
@@ -327,14 +457,14 @@ static void autoattack_rebuff(struct map_session_data* sd)
     int final_skill_lv = 0;
 
     if (!sd->sc.data[SC_CONCENTRATE]) {
-        set_aa_tick(sd, "AA_IC_EXP", 0);
+        set_aa_tick(sd, 0);
     }
 
     auto get_needed_buff = [&]() -> e_skill {
         int temp_lv = 0;
         
-        auto can_cast = [&](int s_id, int sc_id, const char* var) -> bool {
-            if (var != nullptr && get_aa_var(sd, var) <= 0) return false;
+        auto can_cast = [&](int s_id, int sc_id, e_aa_var var) -> bool {
+            if (get_aa_var(sd, var) <= 0) return false;
             temp_lv = pc_checkskill(sd, s_id);
             if (temp_lv <= 0) return false;
             if (sd->battle_status.sp < skill_get_sp(s_id, temp_lv)) return false;
@@ -346,29 +476,29 @@ static void autoattack_rebuff(struct map_session_data* sd)
 
         switch ((enum e_job)sd->status.class_) {
             case JOB_KNIGHT: case JOB_LORD_KNIGHT: case JOB_SWORDMAN: case JOB_CRUSADER: case JOB_PALADIN:
-                if (can_cast(LK_AURABLADE, SC_AURABLADE, "AA_USE_BUFF_AURA_BLADE")) return (e_skill)LK_AURABLADE;
-                if (can_cast(LK_CONCENTRATION, SC_CONCENTRATION, "AA_USE_BUFF_CONCENTRATION")) return (e_skill)LK_CONCENTRATION;
+                if (can_cast(LK_AURABLADE, SC_AURABLADE, AA_VAR_USE_BUFF_AURA_BLADE)) return (e_skill)LK_AURABLADE;
+                if (can_cast(LK_CONCENTRATION, SC_CONCENTRATION, AA_VAR_USE_BUFF_CONCENTRATION)) return (e_skill)LK_CONCENTRATION;
                 if (sd->status.weapon == W_2HSWORD) {
-                    if (can_cast(KN_TWOHANDQUICKEN, SC_TWOHANDQUICKEN, "AA_USE_BUFF_2H_QUICKEN")) return (e_skill)KN_TWOHANDQUICKEN;
-                    if (can_cast(LK_PARRYING, SC_PARRYING, "AA_USE_BUFF_PARRYING")) return (e_skill)LK_PARRYING;
+                    if (can_cast(KN_TWOHANDQUICKEN, SC_TWOHANDQUICKEN, AA_VAR_USE_BUFF_2H_QUICKEN)) return (e_skill)KN_TWOHANDQUICKEN;
+                    if (can_cast(LK_PARRYING, SC_PARRYING, AA_VAR_USE_BUFF_PARRYING)) return (e_skill)LK_PARRYING;
                 }
-                if (can_cast(SM_ENDURE, SC_ENDURE, "AA_USE_BUFF_ENDURE")) return (e_skill)SM_ENDURE;
-                if (can_cast(LK_TENSIONRELAX, SC_TENSIONRELAX, "AA_USE_BUFF_RELAX") && sd->battle_status.hp < (sd->battle_status.max_hp / 2)) return (e_skill)LK_TENSIONRELAX;
-                if (can_cast(LK_BERSERK, SC_BERSERK, "AA_USE_BUFF_BERSERK") && sd->battle_status.hp < (sd->battle_status.max_hp / 5)) return (e_skill)LK_BERSERK;
+                if (can_cast(SM_ENDURE, SC_ENDURE, AA_VAR_USE_BUFF_ENDURE)) return (e_skill)SM_ENDURE;
+                if (can_cast(LK_TENSIONRELAX, SC_TENSIONRELAX, AA_VAR_USE_BUFF_RELAX) && sd->battle_status.hp < (sd->battle_status.max_hp / 2)) return (e_skill)LK_TENSIONRELAX;
+                if (can_cast(LK_BERSERK, SC_BERSERK, AA_VAR_USE_BUFF_BERSERK) && sd->battle_status.hp < (sd->battle_status.max_hp / 5)) return (e_skill)LK_BERSERK;
                 if (sd->status.shield > 0) {
-                    if (can_cast(CR_AUTOGUARD, SC_AUTOGUARD, "AA_USE_BUFF_GUARD")) return (e_skill)CR_AUTOGUARD;
-                    if (can_cast(CR_REFLECTSHIELD, SC_REFLECTSHIELD, "AA_USE_BUFF_REFLECT")) return (e_skill)CR_REFLECTSHIELD;
-                    if (can_cast(CR_DEFENDER, SC_DEFENDER, "AA_USE_BUFF_DEFENDER")) return (e_skill)CR_DEFENDER;
+                    if (can_cast(CR_AUTOGUARD, SC_AUTOGUARD, AA_VAR_USE_BUFF_GUARD)) return (e_skill)CR_AUTOGUARD;
+                    if (can_cast(CR_REFLECTSHIELD, SC_REFLECTSHIELD, AA_VAR_USE_BUFF_REFLECT)) return (e_skill)CR_REFLECTSHIELD;
+                    if (can_cast(CR_DEFENDER, SC_DEFENDER, AA_VAR_USE_BUFF_DEFENDER)) return (e_skill)CR_DEFENDER;
                 }
-                if ((sd->status.weapon == W_1HSPEAR || sd->status.weapon == W_2HSPEAR) && can_cast(CR_SPEARQUICKEN, SC_SPEARQUICKEN, "AA_USE_BUFF_SPEAR_QUICKEN")) return (e_skill)CR_SPEARQUICKEN;
-                if (can_cast(CR_PROVIDENCE, SC_PROVIDENCE, "AA_USE_BUFF_PROVIDENCE")) return (e_skill)CR_PROVIDENCE;
+                if ((sd->status.weapon == W_1HSPEAR || sd->status.weapon == W_2HSPEAR) && can_cast(CR_SPEARQUICKEN, SC_SPEARQUICKEN, AA_VAR_USE_BUFF_SPEAR_QUICKEN)) return (e_skill)CR_SPEARQUICKEN;
+                if (can_cast(CR_PROVIDENCE, SC_PROVIDENCE, AA_VAR_USE_BUFF_PROVIDENCE)) return (e_skill)CR_PROVIDENCE;
                 break;
 
             case JOB_ARCHER: case JOB_HUNTER: case JOB_SNIPER: case JOB_BARD: case JOB_DANCER: case JOB_CLOWN: case JOB_GYPSY:
             {
-                if (can_cast(SN_SIGHT, SC_TRUESIGHT, "AA_USE_BUFF_TRUE_SIGHT")) return (e_skill)SN_SIGHT;
-                if (can_cast(SN_WINDWALK, SC_WINDWALK, "AA_USE_BUFF_WIND_WALK")) return (e_skill)SN_WINDWALK;
-                if (get_aa_var(sd, "AA_USE_BUFF_IMPROVE_CON") > 0) {
+                if (can_cast(SN_SIGHT, SC_TRUESIGHT, AA_VAR_USE_BUFF_TRUE_SIGHT)) return (e_skill)SN_SIGHT;
+                if (can_cast(SN_WINDWALK, SC_WINDWALK, AA_VAR_USE_BUFF_WIND_WALK)) return (e_skill)SN_WINDWALK;
+                if (get_aa_var(sd, AA_VAR_USE_BUFF_IMPROVE_CON) > 0) {
                     int ic_lv = pc_checkskill(sd, 45); 
                     if (ic_lv > 0) {
                         // 1. Check if the status is actually on the player
@@ -376,7 +506,7 @@ static void autoattack_rebuff(struct map_session_data* sd)
 
                         if (has_icon) {
                             // Keep the timer synced while the buff is active
-                            set_aa_tick(sd, "AA_IC_EXP", now + 240000); 
+                            set_aa_tick(sd, now + 240000); 
                             return (e_skill)0; 
                         }
 
@@ -392,67 +522,67 @@ static void autoattack_rebuff(struct map_session_data* sd)
                             printf("[AA_DEBUG] Bard IC: Icon missing. Re-casting.\n");
                             
                             // Reset the timer since we are actually re-casting now
-                            set_aa_tick(sd, "AA_IC_EXP", 0);
+                            set_aa_tick(sd, 0);
 
                             final_skill_lv = ic_lv;
                             return (e_skill)45;
                         }
                     }
                 }
-                if (can_cast(321, SC_MARIONETTE, "AA_USE_BUFF_MARIONETTE")) return (e_skill)321;
+                if (can_cast(321, SC_MARIONETTE, AA_VAR_USE_BUFF_MARIONETTE)) return (e_skill)321;
                 if (sd->sc.data[SC_DANCING]) {
-                    if (can_cast(311, SC_LONGING, "AA_USE_BUFF_LONGING")) return (e_skill)311;
+                    if (can_cast(311, SC_LONGING, AA_VAR_USE_BUFF_LONGING)) return (e_skill)311;
                 }
                 if (sd->status.weapon == W_WHIP && !sd->sc.data[SC_DANCING]) {
-                    if (can_cast(401, SC_SERVICE4U, "AA_USE_BUFF_SERVICE")) return (e_skill)401;
-                    if (can_cast(403, SC_HUMMING, "AA_USE_BUFF_HUMMING")) return (e_skill)403;
-                    if (can_cast(404, SC_DONTFORGETME, "AA_USE_BUFF_KISS")) return (e_skill)404;
+                    if (can_cast(401, SC_SERVICE4U, AA_VAR_USE_BUFF_SERVICE)) return (e_skill)401;
+                    if (can_cast(403, SC_HUMMING, AA_VAR_USE_BUFF_HUMMING)) return (e_skill)403;
+                    if (can_cast(404, SC_DONTFORGETME, AA_VAR_USE_BUFF_KISS)) return (e_skill)404;
                 }
                 if (sd->status.weapon == W_MUSICAL && !sd->sc.data[SC_DANCING]) {
-                    if (can_cast(312, SC_POEMBRAGI, "AA_USE_BUFF_BRAGI")) return (e_skill)312;
-                    if (can_cast(313, SC_ASSNCROS, "AA_USE_BUFF_ASSASSIN")) return (e_skill)313;
+                    if (can_cast(312, SC_POEMBRAGI, AA_VAR_USE_BUFF_BRAGI)) return (e_skill)312;
+                    if (can_cast(313, SC_ASSNCROS, AA_VAR_USE_BUFF_ASSASSIN)) return (e_skill)313;
                 }
                 break;
             }
 
             case JOB_MERCHANT: case JOB_BLACKSMITH: case JOB_WHITESMITH: case JOB_ALCHEMIST: case JOB_CREATOR:
             {
-                if (can_cast(111, SC_ADRENALINE, "AA_USE_BUFF_ADRENALINE")) return (e_skill)111;
-                if (can_cast(112, SC_WEAPONPERFECTION, "AA_USE_BUFF_PERFECTION")) return (e_skill)112;
-                if (get_aa_var(sd, "AA_USE_BUFF_MAXIMIZE") > 0) {
+                if (can_cast(111, SC_ADRENALINE, AA_VAR_USE_BUFF_ADRENALINE)) return (e_skill)111;
+                if (can_cast(112, SC_WEAPONPERFECTION, AA_VAR_USE_BUFF_PERFECTION)) return (e_skill)112;
+                if (get_aa_var(sd, AA_VAR_USE_BUFF_MAXIMIZE) > 0) {
                     if (pc_checkskill(sd, 114) > 0 && !sd->sc.data[SC_MAXIMIZEPOWER]) {
                         final_skill_lv = pc_checkskill(sd, 114);
                         return (e_skill)114;
                     }
                 }
                 if (!sd->sc.data[SC_MAXOVERTHRUST]) {
-                    if (can_cast(113, SC_OVERTHRUST, "AA_USE_BUFF_OVERTHRUST")) return (e_skill)113;
+                    if (can_cast(113, SC_OVERTHRUST, AA_VAR_USE_BUFF_OVERTHRUST)) return (e_skill)113;
                 }
-                if (can_cast(387, SC_CARTBOOST, "AA_USE_BUFF_CARTBOOST")) return (e_skill)387;
-                if (can_cast(384, SC_MELTDOWN, "AA_USE_BUFF_MELTDOWN")) return (e_skill)384;
-                if (can_cast(486, SC_MAXOVERTHRUST, "AA_USE_BUFF_OVERTHRUSTMAX")) return (e_skill)486;
-                if (can_cast(479, SC_CP_ARMOR, "AA_USE_BUFF_FCP")) return (e_skill)479;
+                if (can_cast(387, SC_CARTBOOST, AA_VAR_USE_BUFF_CARTBOOST)) return (e_skill)387;
+                if (can_cast(384, SC_MELTDOWN, AA_VAR_USE_BUFF_MELTDOWN)) return (e_skill)384;
+                if (can_cast(486, SC_MAXOVERTHRUST, AA_VAR_USE_BUFF_OVERTHRUSTMAX)) return (e_skill)486;
+                if (can_cast(479, SC_CP_ARMOR, AA_VAR_USE_BUFF_FCP)) return (e_skill)479;
                 if (!sd->sc.data[SC_CP_ARMOR]) {
-                    if (can_cast(234, SC_CP_WEAPON, "AA_USE_BUFF_CP_WEAPON")) return (e_skill)234;
-                    if (can_cast(236, SC_CP_ARMOR, "AA_USE_BUFF_CP_ARMOR")) return (e_skill)236;
-                    if (can_cast(235, SC_CP_SHIELD, "AA_USE_BUFF_CP_SHIELD")) return (e_skill)235;
-                    if (can_cast(237, SC_CP_HELM, "AA_USE_BUFF_CP_HELM")) return (e_skill)237;
+                    if (can_cast(234, SC_CP_WEAPON, AA_VAR_USE_BUFF_CP_WEAPON)) return (e_skill)234;
+                    if (can_cast(236, SC_CP_ARMOR, AA_VAR_USE_BUFF_CP_ARMOR)) return (e_skill)236;
+                    if (can_cast(235, SC_CP_SHIELD, AA_VAR_USE_BUFF_CP_SHIELD)) return (e_skill)235;
+                    if (can_cast(237, SC_CP_HELM, AA_VAR_USE_BUFF_CP_HELM)) return (e_skill)237;
                 }
                 break;
             }
 
             case JOB_MAGE: case JOB_WIZARD: case JOB_HIGH_WIZARD: case JOB_SAGE: case JOB_PROFESSOR:
             {
-                if (can_cast(157, SC_ENERGYCOAT, "AA_USE_BUFF_ECOAT")) return (e_skill)157;
-                if (can_cast(482, SC_DOUBLECAST, "AA_USE_BUFF_DOUBLECAST")) return (e_skill)482;
-                if (can_cast(403, SC_MEMORIZE, "AA_USE_BUFF_MEMORIZE")) return (e_skill)403;
+                if (can_cast(157, SC_ENERGYCOAT, AA_VAR_USE_BUFF_ECOAT)) return (e_skill)157;
+                if (can_cast(482, SC_DOUBLECAST, AA_VAR_USE_BUFF_DOUBLECAST)) return (e_skill)482;
+                if (can_cast(403, SC_MEMORIZE, AA_VAR_USE_BUFF_MEMORIZE)) return (e_skill)403;
                 if (!sd->sc.data[SC_FIREWEAPON] && !sd->sc.data[SC_WATERWEAPON] && !sd->sc.data[SC_WINDWEAPON] && !sd->sc.data[SC_EARTHWEAPON]) {
-                    if (can_cast(280, SC_FIREWEAPON, "AA_USE_BUFF_FIRE_WPN")) return (e_skill)280;
-                    if (can_cast(281, SC_WATERWEAPON, "AA_USE_BUFF_WATER_WPN")) return (e_skill)281;
-                    if (can_cast(282, SC_WINDWEAPON, "AA_USE_BUFF_WIND_WPN")) return (e_skill)282;
-                    if (can_cast(283, SC_EARTHWEAPON, "AA_USE_BUFF_EARTH_WPN")) return (e_skill)283;
+                    if (can_cast(280, SC_FIREWEAPON, AA_VAR_USE_BUFF_FIRE_WPN)) return (e_skill)280;
+                    if (can_cast(281, SC_WATERWEAPON, AA_VAR_USE_BUFF_WATER_WPN)) return (e_skill)281;
+                    if (can_cast(282, SC_WINDWEAPON, AA_VAR_USE_BUFF_WIND_WPN)) return (e_skill)282;
+                    if (can_cast(283, SC_EARTHWEAPON, AA_VAR_USE_BUFF_EARTH_WPN)) return (e_skill)283;
                 }
-                if (get_aa_var(sd, "AA_USE_BUFF_INDULGE") > 0) {
+                if (get_aa_var(sd, AA_VAR_USE_BUFF_INDULGE) > 0) {
                     int indulge_lv = pc_checkskill(sd, 373);
                     if (indulge_lv > 0 && sd->battle_status.hp > (sd->battle_status.max_hp * 8 / 10) && 
                         sd->battle_status.sp < (sd->battle_status.max_sp * 3 / 10)) {
@@ -466,16 +596,16 @@ static void autoattack_rebuff(struct map_session_data* sd)
 
             case JOB_ACOLYTE: case JOB_PRIEST: case JOB_HIGH_PRIEST: case JOB_MONK: case JOB_CHAMPION:
             {
-                if (can_cast(34, SC_BLESSING, "AA_USE_BUFF_BLESSING")) return (e_skill)34;
-                if (can_cast(29, SC_INCREASEAGI, "AA_USE_BUFF_INCAGI")) return (e_skill)29;
-                if (can_cast(33, SC_ANGELUS, "AA_USE_BUFF_ANGELUS")) return (e_skill)33;
-                if (can_cast(361, SC_ASSUMPTIO, "AA_USE_BUFF_ASSUMPTIO")) return (e_skill)361;
+                if (can_cast(34, SC_BLESSING, AA_VAR_USE_BUFF_BLESSING)) return (e_skill)34;
+                if (can_cast(29, SC_INCREASEAGI, AA_VAR_USE_BUFF_INCAGI)) return (e_skill)29;
+                if (can_cast(33, SC_ANGELUS, AA_VAR_USE_BUFF_ANGELUS)) return (e_skill)33;
+                if (can_cast(361, SC_ASSUMPTIO, AA_VAR_USE_BUFF_ASSUMPTIO)) return (e_skill)361;
                 if (!sd->sc.data[SC_ASSUMPTIO]) {
-                    if (can_cast(73, SC_KYRIE, "AA_USE_BUFF_KYRIE")) return (e_skill)73;
+                    if (can_cast(73, SC_KYRIE, AA_VAR_USE_BUFF_KYRIE)) return (e_skill)73;
                 }
-                if (can_cast(74, SC_MAGNIFICAT, "AA_USE_BUFF_MAGNIFICAT")) return (e_skill)74;
-                if (can_cast(75, SC_GLORIA, "AA_USE_BUFF_GLORIA")) return (e_skill)75;
-                if (can_cast(66, SC_IMPOSITIO, "AA_USE_BUFF_IMPOSITIO")) return (e_skill)66;
+                if (can_cast(74, SC_MAGNIFICAT, AA_VAR_USE_BUFF_MAGNIFICAT)) return (e_skill)74;
+                if (can_cast(75, SC_GLORIA, AA_VAR_USE_BUFF_GLORIA)) return (e_skill)75;
+                if (can_cast(66, SC_IMPOSITIO, AA_VAR_USE_BUFF_IMPOSITIO)) return (e_skill)66;
 
                 break;
             }
@@ -483,33 +613,33 @@ static void autoattack_rebuff(struct map_session_data* sd)
             case JOB_THIEF: case JOB_ASSASSIN: case JOB_ASSASSIN_CROSS:
             case JOB_ROGUE: case JOB_STALKER:
             {
-                if (can_cast(378, SC_EDP, "AA_USE_BUFF_EDP")) return (e_skill)378;
+                if (can_cast(378, SC_EDP, AA_VAR_USE_BUFF_EDP)) return (e_skill)378;
                 if (!sd->sc.data[SC_EDP]) {
-                    if (can_cast(138, SC_ENCPOISON, "AA_USE_BUFF_ENCPOISON")) return (e_skill)138;
+                    if (can_cast(138, SC_ENCPOISON, AA_VAR_USE_BUFF_ENCPOISON)) return (e_skill)138;
                 }
-                if (can_cast(139, SC_POISONREACT, "AA_USE_BUFF_POISONREACT")) return (e_skill)139;
+                if (can_cast(139, SC_POISONREACT, AA_VAR_USE_BUFF_POISONREACT)) return (e_skill)139;
                 if (pc_checkskill(sd, 219) > 0) {
-                    if (can_cast(475, SC_PRESERVE, "AA_USE_BUFF_PRESERVE")) return (e_skill)475;
+                    if (can_cast(475, SC_PRESERVE, AA_VAR_USE_BUFF_PRESERVE)) return (e_skill)475;
                 }
-                if (can_cast(471, SC_REJECTSWORD, "AA_USE_BUFF_REJECTSWORD")) return (e_skill)471;
+                if (can_cast(471, SC_REJECTSWORD, AA_VAR_USE_BUFF_REJECTSWORD)) return (e_skill)471;
 
                 break;
             }
 
             case JOB_SUPER_NOVICE:
             {
-                if (can_cast(34, SC_BLESSING, "AA_USE_BUFF_BLESSING")) return (e_skill)34;
-                if (can_cast(29, SC_INCREASEAGI, "AA_USE_BUFF_INCAGI")) return (e_skill)29;
-                if (can_cast(33, SC_ANGELUS, "AA_USE_BUFF_ANGELUS")) return (e_skill)33;
-                if (can_cast(8, SC_ENDURE, "AA_USE_BUFF_ENDURE")) return (e_skill)8;
-                if (get_aa_var(sd, "AA_USE_BUFF_IMPROVE_CON") > 0) {
+                if (can_cast(34, SC_BLESSING, AA_VAR_USE_BUFF_BLESSING)) return (e_skill)34;
+                if (can_cast(29, SC_INCREASEAGI, AA_VAR_USE_BUFF_INCAGI)) return (e_skill)29;
+                if (can_cast(33, SC_ANGELUS, AA_VAR_USE_BUFF_ANGELUS)) return (e_skill)33;
+                if (can_cast(8, SC_ENDURE, AA_VAR_USE_BUFF_ENDURE)) return (e_skill)8;
+                if (get_aa_var(sd, AA_VAR_USE_BUFF_IMPROVE_CON) > 0) {
                     int ic_lv = pc_checkskill(sd, 45); 
                     if (ic_lv > 0) {
                         if (sd->sc.data[SC_CONCENTRATE]) {
                             break;
                         }
-                        int expire_at = get_aa_tick(sd, "AA_IC_EXP");
-                        int time_left = expire_at - now;
+                        t_tick expire_at = get_aa_tick(sd);
+                        t_tick time_left = expire_at - now;
                         if (time_left > 3600000 || time_left < -3600000) {
                             expire_at = 0;
                         }
@@ -522,39 +652,39 @@ static void autoattack_rebuff(struct map_session_data* sd)
                         }
                     }
                 }
-                if (can_cast(157, SC_ENERGYCOAT, "AA_USE_BUFF_ECOAT")) return (e_skill)157;
+                if (can_cast(157, SC_ENERGYCOAT, AA_VAR_USE_BUFF_ECOAT)) return (e_skill)157;
 
                 break;
             }
 
             case JOB_GUNSLINGER:
             {
-                if (can_cast(503, (sc_type)160, "AA_USE_BUFF_ACCURACY")) return (e_skill)503;
+                if (can_cast(503, (sc_type)160, AA_VAR_USE_BUFF_ACCURACY)) return (e_skill)503;
                 if (sd->status.weapon == W_GATLING) {
-                    if (can_cast(509, (sc_type)163, "AA_USE_BUFF_GATLING")) return (e_skill)509;
+                    if (can_cast(509, (sc_type)163, AA_VAR_USE_BUFF_GATLING)) return (e_skill)509;
                 }
                 if (sd->status.weapon == W_REVOLVER) {
-                    if (can_cast(510, (sc_type)164, "AA_USE_BUFF_MADNESS")) return (e_skill)510;
+                    if (can_cast(510, (sc_type)164, AA_VAR_USE_BUFF_MADNESS)) return (e_skill)510;
                 }
                 break;
             }
 
             case JOB_NINJA:
             {
-                if (can_cast(516, (sc_type)167, "AA_USE_BUFF_CICADA")) return (e_skill)516;   
+                if (can_cast(516, (sc_type)167, AA_VAR_USE_BUFF_CICADA)) return (e_skill)516;   
                 if (sd->sc.data[165]) {
-                    if (can_cast(527, (sc_type)173, "AA_USE_BUFF_MIRROR")) return (e_skill)527;
+                    if (can_cast(527, (sc_type)173, AA_VAR_USE_BUFF_MIRROR)) return (e_skill)527;
                 }
-                if (can_cast(512, (sc_type)165, "AA_USE_BUFF_NINJA_AURA")) return (e_skill)512;
+                if (can_cast(512, (sc_type)165, AA_VAR_USE_BUFF_NINJA_AURA)) return (e_skill)512;
 
                 break;
             }
 
             case JOB_TAEKWON: case JOB_STAR_GLADIATOR: case JOB_SOUL_LINKER:
             {
-                if (can_cast(411, (sc_type)115, "AA_USE_BUFF_RUNNING")) return (e_skill)411;
-                if (can_cast(462, (sc_type)148, "AA_USE_BUFF_LINK")) return (e_skill)462;
-                if (can_cast(436, (sc_type)131, "AA_USE_BUFF_PROTECTION")) return (e_skill)436;
+                if (can_cast(411, (sc_type)115, AA_VAR_USE_BUFF_RUNNING)) return (e_skill)411;
+                if (can_cast(462, (sc_type)148, AA_VAR_USE_BUFF_LINK)) return (e_skill)462;
+                if (can_cast(436, (sc_type)131, AA_VAR_USE_BUFF_PROTECTION)) return (e_skill)436;
 
                 break;
             }
@@ -581,7 +711,7 @@ static void autoattack_rebuff(struct map_session_data* sd)
                 duration *= 1000;
             }
 
-            set_aa_tick(sd, "AA_IC_EXP", (int)(now + duration));
+            set_aa_tick(sd, now + duration);
             sd->canskill_tick = now + 2000; // Delay next buff check
         } else {
             // Standard delay for all other buffs
@@ -598,10 +728,10 @@ static void autoattack_rebuff(struct map_session_data* sd)
  * Helper function to handle repetitive skill checks
  * Returns true if the skill was successfully cast
  **/
-static bool aa_can_use_offensive_skill(struct map_session_data* sd, int target_id, int skill_id, int delay, const char* var_name, int mob_count_req = 0, int current_mobs = 0) 
+static bool aa_can_use_offensive_skill(struct map_session_data* sd, int target_id, int skill_id, int delay, e_aa_var var, int mob_count_req = 0, int current_mobs = 0) 
 {
     // 1. Check if the toggle is ON in the NPC script
-    if (get_aa_var(sd, var_name) <= 0) return false;
+    if (get_aa_var(sd, var) <= 0) return false;
 
     // 2. Check if it's an AoE skill and if enough mobs are present
     if (mob_count_req > 0 && current_mobs < mob_count_req) return false;
@@ -644,22 +774,22 @@ static void autoattack_use_offensive_skill(struct map_session_data* sd, int mob_
         case JOB_KNIGHT: case JOB_LORD_KNIGHT: case JOB_CRUSADER: case JOB_PALADIN: case JOB_SWORDMAN:
         {
             bool has_spear = (weapon == W_1HSPEAR || weapon == W_2HSPEAR);
-            if (has_spear && aa_can_use_offensive_skill(sd, target_id, 397, 1200, "AA_USE_SKILL_SPIRAL_PIERCE")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 398, 800, "AA_USE_SKILL_HEAD_CRUSH")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 399, 800, "AA_USE_SKILL_JOINT_BEAT")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 367, 800, "AA_USE_SKILL_PRESSURE")) return;
-            if (has_shield && aa_can_use_offensive_skill(sd, target_id, 480, 800, "AA_USE_SKILL_SHIELD_CHAIN")) return;
-            if (aa_can_use_offensive_skill(sd, sd->bl.id, 254, 1500, "AA_USE_SKILL_GRAND_CROSS", 2, mob_count)) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 253, 800, "AA_USE_SKILL_HOLY_CROSS")) return;
-            if (has_shield && aa_can_use_offensive_skill(sd, target_id, 251, 800, "AA_USE_SKILL_SHIELD_BOOMERANG")) return;
-            if (has_shield && aa_can_use_offensive_skill(sd, target_id, 250, 800, "AA_USE_SKILL_SHIELD_CHARGE")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 62, 1000, "AA_USE_SKILL_BOWLING_BASH", 2, mob_count)) return;
-            if (has_spear && aa_can_use_offensive_skill(sd, target_id, 57, 1000, "AA_USE_SKILL_BRANDISH_SPEAR", 2, mob_count)) return;
-            if (has_spear && aa_can_use_offensive_skill(sd, target_id, 59, 800, "AA_USE_SKILL_SPEAR_BOOMERANG")) return;
-            if (has_spear && aa_can_use_offensive_skill(sd, target_id, 58, 800, "AA_USE_SKILL_SPEAR_STAB")) return;
-            if (has_spear && aa_can_use_offensive_skill(sd, target_id, 56, 800, "AA_USE_SKILL_PIERCE")) return;
-            if (aa_can_use_offensive_skill(sd, sd->bl.id, 7, 1000, "AA_USE_SKILL_MAGNUM_BREAK", 1, mob_count)) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 5, 800, "AA_USE_SKILL_BASH")) return;
+            if (has_spear && aa_can_use_offensive_skill(sd, target_id, 397, 1200, AA_VAR_USE_SKILL_SPIRAL_PIERCE)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 398, 800, AA_VAR_USE_SKILL_HEAD_CRUSH)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 399, 800, AA_VAR_USE_SKILL_JOINT_BEAT)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 367, 800, AA_VAR_USE_SKILL_PRESSURE)) return;
+            if (has_shield && aa_can_use_offensive_skill(sd, target_id, 480, 800, AA_VAR_USE_SKILL_SHIELD_CHAIN)) return;
+            if (aa_can_use_offensive_skill(sd, sd->bl.id, 254, 1500, AA_VAR_USE_SKILL_GRAND_CROSS, 2, mob_count)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 253, 800, AA_VAR_USE_SKILL_HOLY_CROSS)) return;
+            if (has_shield && aa_can_use_offensive_skill(sd, target_id, 251, 800, AA_VAR_USE_SKILL_SHIELD_BOOMERANG)) return;
+            if (has_shield && aa_can_use_offensive_skill(sd, target_id, 250, 800, AA_VAR_USE_SKILL_SHIELD_CHARGE)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 62, 1000, AA_VAR_USE_SKILL_BOWLING_BASH, 2, mob_count)) return;
+            if (has_spear && aa_can_use_offensive_skill(sd, target_id, 57, 1000, AA_VAR_USE_SKILL_BRANDISH_SPEAR, 2, mob_count)) return;
+            if (has_spear && aa_can_use_offensive_skill(sd, target_id, 59, 800, AA_VAR_USE_SKILL_SPEAR_BOOMERANG)) return;
+            if (has_spear && aa_can_use_offensive_skill(sd, target_id, 58, 800, AA_VAR_USE_SKILL_SPEAR_STAB)) return;
+            if (has_spear && aa_can_use_offensive_skill(sd, target_id, 56, 800, AA_VAR_USE_SKILL_PIERCE)) return;
+            if (aa_can_use_offensive_skill(sd, sd->bl.id, 7, 1000, AA_VAR_USE_SKILL_MAGNUM_BREAK, 1, mob_count)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 5, 800, AA_VAR_USE_SKILL_BASH)) return;
 
             break;
         }
@@ -667,45 +797,45 @@ static void autoattack_use_offensive_skill(struct map_session_data* sd, int mob_
         case JOB_ARCHER: case JOB_HUNTER: case JOB_SNIPER: case JOB_BARD: case JOB_CLOWN: case JOB_DANCER: case JOB_GYPSY:
         {
             bool has_falcon = (sd->sc.option & OPTION_FALCON);
-            if ((weapon == W_MUSICAL || weapon == W_WHIP) && aa_can_use_offensive_skill(sd, target_id, 394, 1500, "AA_USE_SKILL_ARROW_VULCAN")) return;
-            if (has_falcon && aa_can_use_offensive_skill(sd, target_id, 381, 1000, "AA_USE_SKILL_FALCON_ASSAULT")) return;
-            if (weapon == W_BOW && aa_can_use_offensive_skill(sd, target_id, 382, 1200, "AA_USE_SKILL_SHARP_SHOOTING", 2, mob_count)) return;
-            if (weapon == W_MUSICAL && aa_can_use_offensive_skill(sd, target_id, 316, 800, "AA_USE_SKILL_MUSICAL_STRIKE")) return;
-            if (weapon == W_WHIP && aa_can_use_offensive_skill(sd, target_id, 324, 800, "AA_USE_SKILL_THROW_ARROW")) return;
-            if (has_falcon && aa_can_use_offensive_skill(sd, target_id, 129, 1000, "AA_USE_SKILL_BLITZ_BEAT", 2, mob_count)) return;
-            if (weapon == W_BOW && aa_can_use_offensive_skill(sd, target_id, 47, 800, "AA_USE_SKILL_ARROW_SHOWER", 2, mob_count)) return;
-            if (weapon == W_BOW && aa_can_use_offensive_skill(sd, target_id, 46, 600, "AA_USE_SKILL_DOUBLE_STRAFE")) return;
+            if ((weapon == W_MUSICAL || weapon == W_WHIP) && aa_can_use_offensive_skill(sd, target_id, 394, 1500, AA_VAR_USE_SKILL_ARROW_VULCAN)) return;
+            if (has_falcon && aa_can_use_offensive_skill(sd, target_id, 381, 1000, AA_VAR_USE_SKILL_FALCON_ASSAULT)) return;
+            if (weapon == W_BOW && aa_can_use_offensive_skill(sd, target_id, 382, 1200, AA_VAR_USE_SKILL_SHARP_SHOOTING, 2, mob_count)) return;
+            if (weapon == W_MUSICAL && aa_can_use_offensive_skill(sd, target_id, 316, 800, AA_VAR_USE_SKILL_MUSICAL_STRIKE)) return;
+            if (weapon == W_WHIP && aa_can_use_offensive_skill(sd, target_id, 324, 800, AA_VAR_USE_SKILL_THROW_ARROW)) return;
+            if (has_falcon && aa_can_use_offensive_skill(sd, target_id, 129, 1000, AA_VAR_USE_SKILL_BLITZ_BEAT, 2, mob_count)) return;
+            if (weapon == W_BOW && aa_can_use_offensive_skill(sd, target_id, 47, 800, AA_VAR_USE_SKILL_ARROW_SHOWER, 2, mob_count)) return;
+            if (weapon == W_BOW && aa_can_use_offensive_skill(sd, target_id, 46, 600, AA_VAR_USE_SKILL_DOUBLE_STRAFE)) return;
 
             break;
         }
 
         case JOB_MAGE: case JOB_WIZARD: case JOB_HIGH_WIZARD: case JOB_SAGE: case JOB_PROFESSOR:
         {
-            if (aa_can_use_offensive_skill(sd, target_id, 89, 1500, "AA_USE_SKILL_STORM_GUST", 2, mob_count)) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 83, 1500, "AA_USE_SKILL_METEOR_STORM", 2, mob_count)) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 85, 1500, "AA_USE_SKILL_VERMILION", 2, mob_count)) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 300, 1200, "AA_USE_SKILL_NAPALM_VULCAN")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 91, 1200, "AA_USE_SKILL_HEAVEN_DRIVE", 2, mob_count)) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 90, 1000, "AA_USE_SKILL_EARTH_SPIKE")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 84, 1000, "AA_USE_SKILL_JUPITEL_THUNDER")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 86, 1000, "AA_USE_SKILL_WATER_BALL")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 21, 1200, "AA_USE_SKILL_THUNDER_STORM", 2, mob_count)) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 17, 800, "AA_USE_SKILL_FIRE_BALL", 2, mob_count)) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 19, 1000, "AA_USE_SKILL_FIRE_BOLT")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 14, 1000, "AA_USE_SKILL_COLD_BOLT")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 20, 1000, "AA_USE_SKILL_LIGHTNING_BOLT")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 13, 800, "AA_USE_SKILL_SOUL_STRIKE")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 11, 800, "AA_USE_SKILL_NAPALM_BEAT", 2, mob_count)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 89, 1500, AA_VAR_USE_SKILL_STORM_GUST, 2, mob_count)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 83, 1500, AA_VAR_USE_SKILL_METEOR_STORM, 2, mob_count)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 85, 1500, AA_VAR_USE_SKILL_VERMILION, 2, mob_count)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 300, 1200, AA_VAR_USE_SKILL_NAPALM_VULCAN)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 91, 1200, AA_VAR_USE_SKILL_HEAVEN_DRIVE, 2, mob_count)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 90, 1000, AA_VAR_USE_SKILL_EARTH_SPIKE)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 84, 1000, AA_VAR_USE_SKILL_JUPITEL_THUNDER)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 86, 1000, AA_VAR_USE_SKILL_WATER_BALL)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 21, 1200, AA_VAR_USE_SKILL_THUNDER_STORM, 2, mob_count)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 17, 800, AA_VAR_USE_SKILL_FIRE_BALL, 2, mob_count)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 19, 1000, AA_VAR_USE_SKILL_FIRE_BOLT)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 14, 1000, AA_VAR_USE_SKILL_COLD_BOLT)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 20, 1000, AA_VAR_USE_SKILL_LIGHTNING_BOLT)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 13, 800, AA_VAR_USE_SKILL_SOUL_STRIKE)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 11, 800, AA_VAR_USE_SKILL_NAPALM_BEAT, 2, mob_count)) return;
 
             break;
         }
 
         case JOB_ASSASSIN: case JOB_ASSASSIN_CROSS: case JOB_ROGUE: case JOB_STALKER:
         {
-            if (aa_can_use_offensive_skill(sd, target_id, 406, 1000, "AA_USE_SKILL_METEOR_ASSAULT", 2, mob_count)) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 379, 1200, "AA_USE_SKILL_SOUL_BREAKER")) return;
-            if (weapon == W_KATAR && aa_can_use_offensive_skill(sd, target_id, 136, 2000, "AA_USE_SKILL_SONIC_BLOW")) return;
-            if (weapon == W_BOW && aa_can_use_offensive_skill(sd, target_id, 46, 600, "AA_USE_SKILL_DOUBLE_STRAFE")) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 406, 1000, AA_VAR_USE_SKILL_METEOR_ASSAULT, 2, mob_count)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 379, 1200, AA_VAR_USE_SKILL_SOUL_BREAKER)) return;
+            if (weapon == W_KATAR && aa_can_use_offensive_skill(sd, target_id, 136, 2000, AA_VAR_USE_SKILL_SONIC_BLOW)) return;
+            if (weapon == W_BOW && aa_can_use_offensive_skill(sd, target_id, 46, 600, AA_VAR_USE_SKILL_DOUBLE_STRAFE)) return;
 
             break;
         }
@@ -713,9 +843,9 @@ static void autoattack_use_offensive_skill(struct map_session_data* sd, int mob_
         case JOB_ACOLYTE: case JOB_PRIEST: case JOB_HIGH_PRIEST:
         case JOB_MONK: case JOB_CHAMPION:
         {
-            if (aa_can_use_offensive_skill(sd, target_id, 79, 2000, "AA_USE_SKILL_MAGNUS", 2, mob_count)) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 77, 1000, "AA_USE_SKILL_TURN_UNDEAD")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 15, 800, "AA_USE_SKILL_HOLY_LIGHT")) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 79, 2000, AA_VAR_USE_SKILL_MAGNUS, 2, mob_count)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 77, 1000, AA_VAR_USE_SKILL_TURN_UNDEAD)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 15, 800, AA_VAR_USE_SKILL_HOLY_LIGHT)) return;
 
             break;
         }
@@ -723,65 +853,65 @@ static void autoattack_use_offensive_skill(struct map_session_data* sd, int mob_
         case JOB_MERCHANT: case JOB_BLACKSMITH: case JOB_WHITESMITH:
         case JOB_ALCHEMIST: case JOB_CREATOR:
         {
-            if (aa_can_use_offensive_skill(sd, target_id, 490, 1000, "AA_USE_SKILL_ACID_DEMO")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 408, 600, "AA_USE_SKILL_CART_TERM")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 230, 800, "AA_USE_SKILL_ACID_TERROR")) return;
-            if (sd->status.zeny >= 1000 && aa_can_use_offensive_skill(sd, target_id, 42, 600, "AA_USE_SKILL_MAMMONITE")) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 490, 1000, AA_VAR_USE_SKILL_ACID_DEMO)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 408, 600, AA_VAR_USE_SKILL_CART_TERM)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 230, 800, AA_VAR_USE_SKILL_ACID_TERROR)) return;
+            if (sd->status.zeny >= 1000 && aa_can_use_offensive_skill(sd, target_id, 42, 600, AA_VAR_USE_SKILL_MAMMONITE)) return;
 
             break;
         }
 
         case JOB_SUPER_NOVICE:
         {
-            if (aa_can_use_offensive_skill(sd, target_id, 21, 1500, "AA_USE_SKILL_THUNDER_STORM", 2, mob_count)) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 17, 1000, "AA_USE_SKILL_FIRE_BALL", 2, mob_count)) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 19, 1000, "AA_USE_SKILL_FIRE_BOLT")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 14, 1000, "AA_USE_SKILL_COLD_BOLT")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 20, 1000, "AA_USE_SKILL_LIGHTNING_BOLT")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 13, 800, "AA_USE_SKILL_SOUL_STRIKE")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 11, 800, "AA_USE_SKILL_NAPALM_BEAT", 2, mob_count)) return;
-            if (sd->status.zeny >= 1000 && aa_can_use_offensive_skill(sd, target_id, 42, 800, "AA_USE_SKILL_MAMMONITE")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 7, 1000, "AA_USE_SKILL_MAGNUM_BREAK", 2, mob_count)) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 5, 800, "AA_USE_SKILL_BASH")) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 21, 1500, AA_VAR_USE_SKILL_THUNDER_STORM, 2, mob_count)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 17, 1000, AA_VAR_USE_SKILL_FIRE_BALL, 2, mob_count)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 19, 1000, AA_VAR_USE_SKILL_FIRE_BOLT)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 14, 1000, AA_VAR_USE_SKILL_COLD_BOLT)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 20, 1000, AA_VAR_USE_SKILL_LIGHTNING_BOLT)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 13, 800, AA_VAR_USE_SKILL_SOUL_STRIKE)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 11, 800, AA_VAR_USE_SKILL_NAPALM_BEAT, 2, mob_count)) return;
+            if (sd->status.zeny >= 1000 && aa_can_use_offensive_skill(sd, target_id, 42, 800, AA_VAR_USE_SKILL_MAMMONITE)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 7, 1000, AA_VAR_USE_SKILL_MAGNUM_BREAK, 2, mob_count)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 5, 800, AA_VAR_USE_SKILL_BASH)) return;
             
             break;
         }
 
         case JOB_NINJA:
         {
-            if (aa_can_use_offensive_skill(sd, target_id, 536, 1500, "AA_USE_SKILL_DRAGON_FIRE", 2, mob_count)) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 542, 1200, "AA_USE_SKILL_NORTH_WIND", 2, mob_count)) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 534, 1000, "AA_USE_SKILL_FIRE_BLOSSOM")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 537, 1000, "AA_USE_SKILL_SPEAR_ICE")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 540, 1000, "AA_USE_SKILL_WIND_BLADE")) return;
-            if (weapon == W_HUUMA && aa_can_use_offensive_skill(sd, target_id, 525, 1200, "AA_USE_SKILL_THROW_HUUMA")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 524, 800, "AA_USE_SKILL_THROW_KUNAI")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 523, 600, "AA_USE_SKILL_THROW_SHURIKEN")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 528, 800, "AA_USE_SKILL_MIST_SLASH")) return;
-            if (sd->status.zeny >= 500 && aa_can_use_offensive_skill(sd, target_id, 526, 1000, "AA_USE_SKILL_THROW_ZENY")) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 536, 1500, AA_VAR_USE_SKILL_DRAGON_FIRE, 2, mob_count)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 542, 1200, AA_VAR_USE_SKILL_NORTH_WIND, 2, mob_count)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 534, 1000, AA_VAR_USE_SKILL_FIRE_BLOSSOM)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 537, 1000, AA_VAR_USE_SKILL_SPEAR_ICE)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 540, 1000, AA_VAR_USE_SKILL_WIND_BLADE)) return;
+            if (weapon == W_HUUMA && aa_can_use_offensive_skill(sd, target_id, 525, 1200, AA_VAR_USE_SKILL_THROW_HUUMA)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 524, 800, AA_VAR_USE_SKILL_THROW_KUNAI)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 523, 600, AA_VAR_USE_SKILL_THROW_SHURIKEN)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 528, 800, AA_VAR_USE_SKILL_MIST_SLASH)) return;
+            if (sd->status.zeny >= 500 && aa_can_use_offensive_skill(sd, target_id, 526, 1000, AA_VAR_USE_SKILL_THROW_ZENY)) return;
 
             break;
         }
 
         case JOB_GUNSLINGER:
         {
-            if (weapon == W_REVOLVER && aa_can_use_offensive_skill(sd, target_id, 515, 800, "AA_USE_SKILL_RAPID_SHOWER")) return;
-            if (weapon == W_SHOTGUN && aa_can_use_offensive_skill(sd, target_id, 519, 2000, "AA_USE_SKILL_FULL_BUSTER")) return;
-            if (weapon == W_SHOTGUN && aa_can_use_offensive_skill(sd, target_id, 520, 1200, "AA_USE_SKILL_SPREAD_ATTACK", 2, mob_count)) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 512, 1500, "AA_USE_SKILL_TRACKING")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 514, 1000, "AA_USE_SKILL_PIERCING_SHOT")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 518, 800, "AA_USE_SKILL_DUST")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 513, 800, "AA_USE_SKILL_DISARM")) return;
+            if (weapon == W_REVOLVER && aa_can_use_offensive_skill(sd, target_id, 515, 800, AA_VAR_USE_SKILL_RAPID_SHOWER)) return;
+            if (weapon == W_SHOTGUN && aa_can_use_offensive_skill(sd, target_id, 519, 2000, AA_VAR_USE_SKILL_FULL_BUSTER)) return;
+            if (weapon == W_SHOTGUN && aa_can_use_offensive_skill(sd, target_id, 520, 1200, AA_VAR_USE_SKILL_SPREAD_ATTACK, 2, mob_count)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 512, 1500, AA_VAR_USE_SKILL_TRACKING)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 514, 1000, AA_VAR_USE_SKILL_PIERCING_SHOT)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 518, 800, AA_VAR_USE_SKILL_DUST)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 513, 800, AA_VAR_USE_SKILL_DISARM)) return;
             
             break;
         }
 
         case JOB_TAEKWON: case JOB_STAR_GLADIATOR: case JOB_SOUL_LINKER:
         {
-            if (aa_can_use_offensive_skill(sd, target_id, 456, 1000, "AA_USE_SKILL_ESMA")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 455, 800, "AA_USE_SKILL_ESTUN")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 454, 800, "AA_USE_SKILL_ESTIN")) return;
-            if (aa_can_use_offensive_skill(sd, target_id, 414, 800, "AA_USE_SKILL_FLYING_KICK")) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 456, 1000, AA_VAR_USE_SKILL_ESMA)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 455, 800, AA_VAR_USE_SKILL_ESTUN)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 454, 800, AA_VAR_USE_SKILL_ESTIN)) return;
+            if (aa_can_use_offensive_skill(sd, target_id, 414, 800, AA_VAR_USE_SKILL_FLYING_KICK)) return;
 
             break;
         }
@@ -794,140 +924,316 @@ static void autoattack_use_offensive_skill(struct map_session_data* sd, int mob_
 // === CORE AUTOATTACK LOOP FUNCTIONS ===
 // =====================================================================================
 
-static bool autoattack_motion(struct map_session_data* sd)
+static bool autoattack_motion(struct map_session_data* sd, const autoattack_scan& scan)
 {
-    int i, target_id;
-    
-    // 1. Search for a target mob
-    for(i=0;i<=AUTOATTACK_RADIUS;i++)
-    {
-        target_id=0;
-        map_foreachinarea(buildin_autoattack_sub, sd->bl.m, sd->bl.x-i, sd->bl.y-i, sd->bl.x+i, sd->bl.y+i, BL_MOB, &target_id);
-        
-        if(target_id)
-        {
-            // Found a target: initiate attack motion
-            unit_attack(&sd->bl,target_id,1);
-            return true;
-        }
+    // 1. Attack the nearest mob found by this tick's scan
+    int target_id = scan.nearest_target();
+
+    if (target_id) {
+        unit_attack(&sd->bl, target_id, 1);
+        return true;
     }
-    
+
     // 2. No target found: initiate random short movement
-    if(!target_id)
-    {
-        int dx = (rand()%2==0?-1:1)*(rand()%10);
-        int dy = (rand()%2==0?-1:1)*(rand()%10);
-        unit_walktoxy(&sd->bl, sd->bl.x + dx, sd->bl.y + dy, 0);
-    }
-    
+    int dx = (rand()%2==0?-1:1)*(rand()%10);
+    int dy = (rand()%2==0?-1:1)*(rand()%10);
+    unit_walktoxy(&sd->bl, sd->bl.x + dx, sd->bl.y + dy, 0);
+
     return false;
 }
 
+// =====================================================================================
+// === SCHEDULER ===
+// =====================================================================================
+
 /**
- * @brief The main timer function.
+ * @brief Delays the bot's next action. One slot step of slack absorbs timer jitter,
+ * so a 1000ms delay lands exactly two intervals later.
  */
-int autoattack_timer(int tid, t_tick tick, int id, intptr_t data)
+static void autoattack_delay(s_autoattack_bot& bot, t_tick tick, t_tick delay)
 {
-    struct map_session_data *sd = map_id2sd(id);
-    static std::unordered_map<int, int> autoattack_notarget_ticks;
-    
-    if (sd == NULL) return 0;
-    
+    bot.next_tick = tick + delay - AUTOATTACK_INTERVAL / AUTOATTACK_SLOTS;
+}
+
+static void autoattack_bucket_add(int idx, int16 m)
+{
+    s_autoattack_bot& bot = aa_bots[idx];
+    std::vector<int>& list = aa_buckets[m].slots[bot.slot];
+
+    bot.m = m;
+    bot.pos = (int)list.size();
+    list.push_back(idx);
+}
+
+static void autoattack_bucket_remove(int idx)
+{
+    s_autoattack_bot& bot = aa_bots[idx];
+    auto it = aa_buckets.find(bot.m);
+
+    if (it == aa_buckets.end())
+        return;
+
+    std::vector<int>& list = it->second.slots[bot.slot];
+
+    // Swap with the last entry to keep the list dense
+    int last = list.back();
+    list[bot.pos] = last;
+    aa_bots[last].pos = bot.pos;
+    list.pop_back();
+}
+
+static void autoattack_unregister(int idx)
+{
+    s_autoattack_bot& bot = aa_bots[idx];
+
+    autoattack_bucket_remove(idx);
+    aa_slot_load[bot.slot]--;
+    aa_bot_index.erase(bot.sd->bl.id);
+    bot.sd = nullptr;
+    aa_free.push_back(idx);
+}
+
+void autoattack_start(struct map_session_data* sd, t_tick delay)
+{
+    nullpo_retv(sd);
+
+    t_tick tick = gettick();
+    auto it = aa_bot_index.find(sd->bl.id);
+
+    // Settings may have been changed while auto-attack was off
+    autoattack_config_invalidate(sd);
+
+    if (it != aa_bot_index.end()) {
+        autoattack_delay(aa_bots[it->second], tick, delay);
+        return;
+    }
+
+    int idx;
+
+    if (!aa_free.empty()) {
+        idx = aa_free.back();
+        aa_free.pop_back();
+    } else {
+        idx = (int)aa_bots.size();
+        aa_bots.emplace_back();
+    }
+
+    s_autoattack_bot& bot = aa_bots[idx];
+    bool queued = bot.queued; // A stale queue entry may still point at this index
+
+    bot = s_autoattack_bot();
+    bot.sd = sd;
+    bot.queued = queued;
+
+    // Least loaded slot
+    int slot = 0;
+    for (int i = 1; i < AUTOATTACK_SLOTS; i++) {
+        if (aa_slot_load[i] < aa_slot_load[slot])
+            slot = i;
+    }
+    bot.slot = (uint8)slot;
+    aa_slot_load[slot]++;
+
+    autoattack_delay(bot, tick, delay);
+    autoattack_bucket_add(idx, sd->bl.m);
+    aa_bot_index[sd->bl.id] = idx;
+}
+
+void autoattack_stop(struct map_session_data* sd)
+{
+    nullpo_retv(sd);
+
+    auto it = aa_bot_index.find(sd->bl.id);
+
+    if (it != aa_bot_index.end())
+        autoattack_unregister(it->second);
+}
+
+/**
+ * @brief Runs one auto-attack cycle of a bot.
+ */
+static void autoattack_process(int idx, t_tick tick)
+{
+    s_autoattack_bot& bot = aa_bots[idx];
+    struct map_session_data *sd = bot.sd;
+
+    if (DIFF_TICK(bot.next_tick, tick) > 0)
+        return;
+
     if (pc_isdead(sd)) { 
         sd->sc.option &= ~OPTION_AUTOATTACK;
-        autoattack_notarget_ticks.erase(id);
         clif_changeoption(&sd->bl);
-        return 0;
+        autoattack_unregister(idx);
+        return;
     }
 
-    if (sd->sc.option & OPTION_AUTOATTACK)
-    {
-        // ---------------------------------------------------------
-        // [UPDATED] RESTING / SITTING LOGIC (Single Value Mode)
-        // ---------------------------------------------------------
-        // ---------------------------------------------------------
-        int sit_hp_trigger = get_aa_var(sd, "AA_REST_HP");
-        int sit_sp_trigger = get_aa_var(sd, "AA_REST_SP");
-
-        if (sit_hp_trigger > 0 || sit_sp_trigger > 0) {
-            auto pct = [](uint32 cur, uint32 max){
-                return max == 0 ? 100 : (int)((cur * 100ULL) / max);
-            };
-
-            int cur_hp = pct(sd->battle_status.hp, sd->battle_status.max_hp);
-            int cur_sp = pct(sd->battle_status.sp, sd->battle_status.max_sp);
-
-            // Logic: If standing, check if we need to SIT
-            if (!pc_issit(sd)) { 
-                bool low_hp = (sit_hp_trigger > 0 && cur_hp < sit_hp_trigger);
-                bool low_sp = (sit_sp_trigger > 0 && cur_sp < sit_sp_trigger);
-
-                if (low_hp || low_sp) {
-                    unit_stop_attack(&sd->bl); 
-                    pc_setsit(sd, 1);
-                    clif_sitting(&sd->bl);
-                    clif_status_change(&sd->bl, 12, 1, 0, 0, 0, 0);
-                    add_timer(gettick() + 1000, autoattack_timer, sd->bl.id, 0);
-                    return 0; 
-                }
-            } 
-            // Logic: If sitting, check if we can STAND
-            else { 
-                // Standing logic: trigger + 5% buffer to prevent sit/stand loops
-                bool healthy_hp = (sit_hp_trigger == 0 || cur_hp >= (sit_hp_trigger + 5));
-                bool healthy_sp = (sit_sp_trigger == 0 || cur_sp >= (sit_sp_trigger + 5));
-
-                if (healthy_hp && healthy_sp) {
-                    pc_setsit(sd, 0);
-                    clif_standing(&sd->bl);
-                    clif_status_change(&sd->bl, 12, 0, 0, 0, 0, 0);
-                } else {
-                    add_timer(gettick() + 1000, autoattack_timer, sd->bl.id, 0);
-                    return 0;
-                }
+    if (!(sd->sc.option & OPTION_AUTOATTACK)) {
+        autoattack_unregister(idx);
+        return;
+    }
+
+    // Follow the player to its current map's bucket
+    if (sd->bl.m != bot.m) {
+        autoattack_bucket_remove(idx);
+        autoattack_bucket_add(idx, sd->bl.m);
+    }
+
+    // ---------------------------------------------------------
+    // [UPDATED] RESTING / SITTING LOGIC (Single Value Mode)
+    // ---------------------------------------------------------
+    // ---------------------------------------------------------
+    int sit_hp_trigger = get_aa_var(sd, AA_VAR_REST_HP);
+    int sit_sp_trigger = get_aa_var(sd, AA_VAR_REST_SP);
+
+    if (sit_hp_trigger > 0 || sit_sp_trigger > 0) {
+        auto pct = [](uint32 cur, uint32 max){
+            return max == 0 ? 100 : (int)((cur * 100ULL) / max);
+        };
+
+        int cur_hp = pct(sd->battle_status.hp, sd->battle_status.max_hp);
+        int cur_sp = pct(sd->battle_status.sp, sd->battle_status.max_sp);
+
+        // Logic: If standing, check if we need to SIT
+        if (!pc_issit(sd)) { 
+            bool low_hp = (sit_hp_trigger > 0 && cur_hp < sit_hp_trigger);
+            bool low_sp = (sit_sp_trigger > 0 && cur_sp < sit_sp_trigger);
+
+            if (low_hp || low_sp) {
+                unit_stop_attack(&sd->bl); 
+                pc_setsit(sd, 1);
+                clif_sitting(&sd->bl);
+                clif_status_change(&sd->bl, 12, 1, 0, 0, 0, 0);
+                autoattack_delay(bot, tick, 1000);
+                return; 
+            }
+        } 
+        // Logic: If sitting, check if we can STAND
+        else { 
+            // Standing logic: trigger + 5% buffer to prevent sit/stand loops
+            bool healthy_hp = (sit_hp_trigger == 0 || cur_hp >= (sit_hp_trigger + 5));
+            bool healthy_sp = (sit_sp_trigger == 0 || cur_sp >= (sit_sp_trigger + 5));
+
+            if (healthy_hp && healthy_sp) {
+                pc_setsit(sd, 0);
+                clif_standing(&sd->bl);
+                clif_status_change(&sd->bl, 12, 0, 0, 0, 0, 0);
+            } else {
+                autoattack_delay(bot, tick, 1000);
+                return;
             }
         }
-        // ---------------------------------------------------------
+    }
+    // ---------------------------------------------------------
+
+    // 1. Support & Potion Variable Checking
+    autoattack_rebuff(sd);
+    autoattack_try_consumables(sd);
+    autoattack_try_autopots(sd, bot);
 
-        // 1. Support & Potion Variable Checking
-        autoattack_rebuff(sd);
-        autoattack_try_consumables(sd);
-        autoattack_try_autopots(sd);
+    // Single area pass shared by every decision below
+    const autoattack_scan& scan = autoattack_gather(sd, AUTOATTACK_RADIUS);
+    int mob_count = scan.mob_count;
 
-        int mob_count = autoattack_count_nearby_mobs(sd, AUTOATTACK_RADIUS);
+    int tp_threshold = get_aa_var(sd, AA_VAR_TP_MOBCOUNT);
 
-        int tp_threshold = get_aa_var(sd, "AA_TP_MOBCOUNT");
+    if (tp_threshold > 0 && mob_count >= tp_threshold) {
+        autoattack_perform_teleport(sd);
+        clif_displaymessage(sd->fd, "Auto-Defense: Teleporting (Mob density too high).");
+        bot.miss = 0;
+        return;
+    }
+    
+    // Priority 2: Offensive Skills (Bowling Bash)
+    autoattack_use_offensive_skill(sd, mob_count);
 
-        if (tp_threshold > 0 && mob_count >= tp_threshold) {
-            autoattack_perform_teleport(sd);
-            clif_displaymessage(sd->fd, "Auto-Defense: Teleporting (Mob density too high).");
-            autoattack_notarget_ticks.erase(sd->bl.id);
-            add_timer(gettick() + 500, autoattack_timer, sd->bl.id, 0);
-            return 0;
+    // Priority 3: Normal Attack/Motion
+    bool found = autoattack_motion(sd, scan); 
+    
+    if (found) {
+        bot.miss = 0;
+    } else {
+        auto& config = get_autoattack_config(sd);
+        if (++bot.miss >= config.idle_cycles_before_tp) {
+            if (!(map_getmapflag(sd->bl.m, MF_NOTELEPORT)))
+                autoattack_perform_teleport(sd);
+            bot.miss = 0;
         }
-        
-        // Priority 2: Offensive Skills (Bowling Bash)
-        autoattack_use_offensive_skill(sd, mob_count);
+    }
+}
 
-        // Priority 3: Normal Attack/Motion
-        bool found = autoattack_motion(sd); 
-        
-        if (found) {
-            autoattack_notarget_ticks.erase(sd->bl.id);
-        } else {
-            int &miss = autoattack_notarget_ticks[sd->bl.id];
-            auto& config = get_autoattack_config(sd);
-            if (++miss >= config.idle_cycles_before_tp) {
-                if (!(map_getmapflag(sd->bl.m, MF_NOTELEPORT)))
-                    autoattack_perform_teleport(sd);
-                miss = 0;
-            }
+/**
+ * @brief The scheduler timer. Queues the bots of the current slot map by map and
+ * processes the queue until AUTOATTACK_TICK_BUDGET is spent; leftovers run first
+ * on the next call.
+ */
+int autoattack_timer(int tid, t_tick tick, int id, intptr_t data)
+{
+    int slot = aa_cur_slot;
+
+    aa_cur_slot = (aa_cur_slot + 1) % AUTOATTACK_SLOTS;
+
+    for (auto& it : aa_buckets) {
+        for (int idx : it.second.slots[slot]) {
+            if (aa_bots[idx].queued)
+                continue;
+            aa_bots[idx].queued = true;
+            aa_queue.push_back(idx);
         }
-        
-        add_timer(gettick() + 500, autoattack_timer, sd->bl.id, 0);
-    } else {
-        autoattack_notarget_ticks.erase(id);
     }
-    
+
+    t_tick start = gettick_nocache();
+
+    aa_scan_stats.tick_cells_visited = 0;
+
+    while (aa_queue_pos < aa_queue.size()) {
+        int idx = aa_queue[aa_queue_pos++];
+
+        aa_bots[idx].queued = false;
+
+        if (aa_bots[idx].sd == nullptr)
+            continue;
+
+        autoattack_process(idx, tick);
+
+        if (DIFF_TICK(gettick_nocache(), start) >= AUTOATTACK_TICK_BUDGET)
+            break;
+    }
+
+    if (aa_queue_pos >= aa_queue.size()) {
+        aa_queue.clear();
+        aa_queue_pos = 0;
+    } else if (aa_queue_pos > 0) {
+        aa_queue.erase(aa_queue.begin(), aa_queue.begin() + aa_queue_pos);
+        aa_queue_pos = 0;
+    }
+
+    aa_scan_stats.ticks++;
+    aa_scan_stats.last_tick_cells_visited = aa_scan_stats.tick_cells_visited;
+    aa_scan_stats.max_tick_cells_visited = max(aa_scan_stats.max_tick_cells_visited, aa_scan_stats.tick_cells_visited);
+
     return 0;
-}
\ No newline at end of file
+}
+
+void do_init_autoattack(void)
+{
+    for (int i = 0; i < AA_VAR_MAX; i++)
+        aa_var_uid[i] = add_str(aa_var_names[i]);
+    aa_ic_exp_uid = add_str("AA_IC_EXP");
+
+    add_timer_func_list(autoattack_timer, "autoattack_timer");
+    add_timer_interval(gettick() + AUTOATTACK_INTERVAL, autoattack_timer, 0, 0, AUTOATTACK_INTERVAL / AUTOATTACK_SLOTS);
+}
+
+void do_final_autoattack(void)
+{
+    autoattack_configs.clear();
+    aa_config_sd = nullptr;
+    aa_config_last = nullptr;
+    aa_bots.clear();
+    aa_free.clear();
+    aa_bot_index.clear();
+    aa_buckets.clear();
+    aa_queue.clear();
+    aa_queue_pos = 0;
+    memset(aa_slot_load, 0, sizeof(aa_slot_load));
+}
@@ -20,6 +20,177 @@ static const int AUTOATTACK_RADIUS              = 9;
 static const int AUTOATTACK_MISS_CYCLES_DEFAULT = 2;
 // Default maximum hostile mobs in range before initiating a random teleport.
 static const int AUTOATTACK_MAX_MOBS_DEFAULT    = 15;
+// Interval (ms) between two actions of the same bot.
+static const int AUTOATTACK_INTERVAL            = 500;
+// Number of time slots the bots are spread across within one interval.
+static const int AUTOATTACK_SLOTS               = 10;
+// Wall time (ms) a single slot may spend before deferring the rest to the next slot.
+static const int AUTOATTACK_TICK_BUDGET         = 10;
+
+// =====================================================================================
+// === CHARACTER VARIABLES ===
+// =====================================================================================
+
+/**
+ * @brief Permanent character variables read by the auto-attack loop, without the "AA_" prefix.
+ * They are compiled into autoattack_config::vars and only re-read after a change.
+ */
+#define AUTOATTACK_VARS(X) \
+    X(ASPD_ITEM) \
+    X(HP_ITEM) \
+    X(HP_THRESHOLD) \
+    X(REST_HP) \
+    X(REST_SP) \
+    X(SP_ITEM) \
+    X(SP_THRESHOLD) \
+    X(TP_MOBCOUNT) \
+    X(TP_USE_FLY_WING) \
+    X(TP_USE_JUMP) \
+    X(USE_AGI_SCROLL) \
+    X(USE_BATTLE_MANUAL) \
+    X(USE_BLESS_SCROLL) \
+    X(USE_BUBBLE_GUM) \
+    X(USE_BUFF_2H_QUICKEN) \
+    X(USE_BUFF_ACCURACY) \
+    X(USE_BUFF_ADRENALINE) \
+    X(USE_BUFF_ANGELUS) \
+    X(USE_BUFF_ASSASSIN) \
+    X(USE_BUFF_ASSUMPTIO) \
+    X(USE_BUFF_AURA_BLADE) \
+    X(USE_BUFF_BERSERK) \
+    X(USE_BUFF_BLESSING) \
+    X(USE_BUFF_BRAGI) \
+    X(USE_BUFF_CARTBOOST) \
+    X(USE_BUFF_CICADA) \
+    X(USE_BUFF_CONCENTRATION) \
+    X(USE_BUFF_CP_ARMOR) \
+    X(USE_BUFF_CP_HELM) \
+    X(USE_BUFF_CP_SHIELD) \
+    X(USE_BUFF_CP_WEAPON) \
+    X(USE_BUFF_DEFENDER) \
+    X(USE_BUFF_DOUBLECAST) \
+    X(USE_BUFF_EARTH_WPN) \
+    X(USE_BUFF_ECOAT) \
+    X(USE_BUFF_EDP) \
+    X(USE_BUFF_ENCPOISON) \
+    X(USE_BUFF_ENDURE) \
+    X(USE_BUFF_FCP) \
+    X(USE_BUFF_FIRE_WPN) \
+    X(USE_BUFF_GATLING) \
+    X(USE_BUFF_GLORIA) \
+    X(USE_BUFF_GUARD) \
+    X(USE_BUFF_HUMMING) \
+    X(USE_BUFF_IMPOSITIO) \
+    X(USE_BUFF_IMPROVE_CON) \
+    X(USE_BUFF_INCAGI) \
+    X(USE_BUFF_INDULGE) \
+    X(USE_BUFF_KISS) \
+    X(USE_BUFF_KYRIE) \
+    X(USE_BUFF_LINK) \
+    X(USE_BUFF_LONGING) \
+    X(USE_BUFF_MADNESS) \
+    X(USE_BUFF_MAGNIFICAT) \
+    X(USE_BUFF_MARIONETTE) \
+    X(USE_BUFF_MAXIMIZE) \
+    X(USE_BUFF_MELTDOWN) \
+    X(USE_BUFF_MEMORIZE) \
+    X(USE_BUFF_MIRROR) \
+    X(USE_BUFF_NINJA_AURA) \
+    X(USE_BUFF_OVERTHRUST) \
+    X(USE_BUFF_OVERTHRUSTMAX) \
+    X(USE_BUFF_PARRYING) \
+    X(USE_BUFF_PERFECTION) \
+    X(USE_BUFF_POISONREACT) \
+    X(USE_BUFF_PRESERVE) \
+    X(USE_BUFF_PROTECTION) \
+    X(USE_BUFF_PROVIDENCE) \
+    X(USE_BUFF_REFLECT) \
+    X(USE_BUFF_REJECTSWORD) \
+    X(USE_BUFF_RELAX) \
+    X(USE_BUFF_RUNNING) \
+    X(USE_BUFF_SERVICE) \
+    X(USE_BUFF_SPEAR_QUICKEN) \
+    X(USE_BUFF_TRUE_SIGHT) \
+    X(USE_BUFF_WATER_WPN) \
+    X(USE_BUFF_WIND_WALK) \
+    X(USE_BUFF_WIND_WPN) \
+    X(USE_SKILL_ACID_DEMO) \
+    X(USE_SKILL_ACID_TERROR) \
+    X(USE_SKILL_ARROW_SHOWER) \
+    X(USE_SKILL_ARROW_VULCAN) \
+    X(USE_SKILL_BASH) \
+    X(USE_SKILL_BLITZ_BEAT) \
+    X(USE_SKILL_BOWLING_BASH) \
+    X(USE_SKILL_BRANDISH_SPEAR) \
+    X(USE_SKILL_CART_TERM) \
+    X(USE_SKILL_COLD_BOLT) \
+    X(USE_SKILL_DISARM) \
+    X(USE_SKILL_DOUBLE_STRAFE) \
+    X(USE_SKILL_DRAGON_FIRE) \
+    X(USE_SKILL_DUST) \
+    X(USE_SKILL_EARTH_SPIKE) \
+    X(USE_SKILL_ESMA) \
+    X(USE_SKILL_ESTIN) \
+    X(USE_SKILL_ESTUN) \
+    X(USE_SKILL_FALCON_ASSAULT) \
+    X(USE_SKILL_FIRE_BALL) \
+    X(USE_SKILL_FIRE_BLOSSOM) \
+    X(USE_SKILL_FIRE_BOLT) \
+    X(USE_SKILL_FLYING_KICK) \
+    X(USE_SKILL_FULL_BUSTER) \
+    X(USE_SKILL_GRAND_CROSS) \
+    X(USE_SKILL_HEAD_CRUSH) \
+    X(USE_SKILL_HEAVEN_DRIVE) \
+    X(USE_SKILL_HOLY_CROSS) \
+    X(USE_SKILL_HOLY_LIGHT) \
+    X(USE_SKILL_JOINT_BEAT) \
+    X(USE_SKILL_JUPITEL_THUNDER) \
+    X(USE_SKILL_LIGHTNING_BOLT) \
+    X(USE_SKILL_MAGNUM_BREAK) \
+    X(USE_SKILL_MAGNUS) \
+    X(USE_SKILL_MAMMONITE) \
+    X(USE_SKILL_METEOR_ASSAULT) \
+    X(USE_SKILL_METEOR_STORM) \
+    X(USE_SKILL_MIST_SLASH) \
+    X(USE_SKILL_MUSICAL_STRIKE) \
+    X(USE_SKILL_NAPALM_BEAT) \
+    X(USE_SKILL_NAPALM_VULCAN) \
+    X(USE_SKILL_NORTH_WIND) \
+    X(USE_SKILL_PIERCE) \
+    X(USE_SKILL_PIERCING_SHOT) \
+    X(USE_SKILL_PRESSURE) \
+    X(USE_SKILL_RAPID_SHOWER) \
+    X(USE_SKILL_SHARP_SHOOTING) \
+    X(USE_SKILL_SHIELD_BOOMERANG) \
+    X(USE_SKILL_SHIELD_CHAIN) \
+    X(USE_SKILL_SHIELD_CHARGE) \
+    X(USE_SKILL_SONIC_BLOW) \
+    X(USE_SKILL_SOUL_BREAKER) \
+    X(USE_SKILL_SOUL_STRIKE) \
+    X(USE_SKILL_SPEAR_BOOMERANG) \
+    X(USE_SKILL_SPEAR_ICE) \
+    X(USE_SKILL_SPEAR_STAB) \
+    X(USE_SKILL_SPIRAL_PIERCE) \
+    X(USE_SKILL_SPREAD_ATTACK) \
+    X(USE_SKILL_STORM_GUST) \
+    X(USE_SKILL_THROW_ARROW) \
+    X(USE_SKILL_THROW_HUUMA) \
+    X(USE_SKILL_THROW_KUNAI) \
+    X(USE_SKILL_THROW_SHURIKEN) \
+    X(USE_SKILL_THROW_ZENY) \
+    X(USE_SKILL_THUNDER_STORM) \
+    X(USE_SKILL_TRACKING) \
+    X(USE_SKILL_TURN_UNDEAD) \
+    X(USE_SKILL_VERMILION) \
+    X(USE_SKILL_WATER_BALL) \
+    X(USE_SKILL_WIND_BLADE)
+
+enum e_aa_var : uint16 {
+#define AA_VAR_ENUM(name) AA_VAR_##name,
+    AUTOATTACK_VARS(AA_VAR_ENUM)
+#undef AA_VAR_ENUM
+    AA_VAR_MAX
+};
 
 // =====================================================================================
 // === DATA STRUCTURES ===
@@ -46,6 +217,11 @@ struct autoattack_config {
     int idle_cycles_before_tp = AUTOATTACK_MISS_CYCLES_DEFAULT; // Idle cycle limit before teleport.
     std::vector<t_itemid> aspd_pot_ids;             // Custom list of ASPD potion Item IDs.
     std::vector<autoattack_pot_entry> heal_pot_configs; // Custom list of HP/SP potion configurations.
+    bool vars_dirty = true;                         // vars must be recompiled from the character registry.
+    int vars[AA_VAR_MAX] = {};                      // Compiled AA_* character variables.
+    bool ticks_loaded = false;                      // Cooldown ticks were read from the registry.
+    bool ticks_dirty = false;                       // Cooldown ticks changed since they were loaded.
+    t_tick ic_expire = 0;                           // Improve Concentration expiry (AA_IC_EXP), flushed on logout.
 };
 
 /**
@@ -65,19 +241,94 @@ struct autoattack_item_entry {
     enum sc_type sc_if_sc;
 };
 
+/**
+ * @brief A mob collected by the per-tick area scan.
+ */
+struct autoattack_candidate {
+    int id;     // Block ID of the mob.
+    int dist;   // Chebyshev distance to the player (ring of the search square).
+};
+
+/**
+ * @brief Result of the single gather pass done once per auto-attack tick.
+ * Reused between ticks so the candidate list keeps its capacity.
+ */
+struct autoattack_scan {
+    int mob_count = 0;                          // Mobs inside AUTOATTACK_RADIUS.
+    int attacker_count = 0;                     // Mobs among them targeting the player.
+    int cells_visited = 0;                      // Block cells walked by the scan.
+    std::vector<autoattack_candidate> candidates; // Sorted by distance, nearest first.
+
+    void clear() {
+        mob_count = attacker_count = cells_visited = 0;
+        candidates.clear();
+    }
+
+    /// Nearest candidate's block ID, or 0 if nothing is in range.
+    int nearest_target() const {
+        return candidates.empty() ? 0 : candidates.front().id;
+    }
+};
+
+/**
+ * @brief Cumulative statistics of the auto-attack area scans.
+ */
+struct autoattack_scan_stats {
+    uint64 scans = 0;           // Number of gather passes performed.
+    uint64 cells_visited = 0;   // Total block cells walked by all passes.
+    int last_cells_visited = 0; // Block cells walked by the most recent pass.
+    uint64 ticks = 0;           // Number of scheduler ticks.
+    int tick_cells_visited = 0; // Block cells walked so far by the running tick.
+    int last_tick_cells_visited = 0; // Block cells walked by the most recent tick.
+    int max_tick_cells_visited = 0;  // Most block cells walked by a single tick.
+};
+
 
 // =====================================================================================
 // === PUBLIC FUNCTION PROTOTYPES ===
 // =====================================================================================
 
 /**
- * @brief The main timer function that drives the auto-attack loop (runs every 2s).
+ * @brief The scheduler timer: runs one time slot of bots every AUTOATTACK_INTERVAL/AUTOATTACK_SLOTS ms.
  */
 int autoattack_timer(int tid, t_tick tick, int id, intptr_t data);
 
+/**
+ * @brief Registers a player with the scheduler; the first action happens after delay ms.
+ */
+void autoattack_start(struct map_session_data* sd, t_tick delay);
+
+/**
+ * @brief Removes a player from the scheduler (toggle off, logout, map-server change).
+ */
+void autoattack_stop(struct map_session_data* sd);
+
+void do_init_autoattack(void);
+void do_final_autoattack(void);
+
 /**
  * @brief Retrieves or initializes the autoattack_config struct for a player.
  */
 autoattack_config& get_autoattack_config(struct map_session_data* sd);
 
+/**
+ * @brief Returns the block cell counters of the auto-attack area scan.
+ */
+const autoattack_scan_stats& autoattack_get_scan_stats(void);
+
+/**
+ * @brief Marks the player's compiled AA_* variables as stale; called when one of them is set.
+ */
+void autoattack_config_invalidate(struct map_session_data* sd);
+
+/**
+ * @brief Flushes in-memory cooldown ticks to permanent character variables (logout).
+ */
+void autoattack_save(struct map_session_data* sd);
+
+/**
+ * @brief Drops all auto-attack state of a player that leaves the map-server.
+ */
+void autoattack_free(struct map_session_data* sd);
+
 #endif // MAP_AUTOATTACK_HPP
\ No newline at end of file
@@ -9188,6 +9188,8 @@ static const struct _battle_data {
 	{ "idletime_mer_option",                &battle_config.idletime_mer_option,             0x1F,   0x1,    0xFFF,          },
 	{ "feature.refineui",                   &battle_config.feature_refineui,                1,      0,      1,              },
 	{ "rndopt_drop_pillar",                 &battle_config.rndopt_drop_pillar,              1,      0,      1,              },
+	{ "monster_ai_threads",                 &battle_config.mob_ai_threads,                  0,      0,      MAX_MOB_AI_THREADS, },
+	{ "area_interest_check",                &battle_config.area_interest_check,             0,      0,      1,              },
 
 #include "../custom/battle_config_init.inc"
 };
@@ -692,6 +692,8 @@ struct Battle_Config
 	int idletime_mer_option;
 	int feature_refineui;
 	int rndopt_drop_pillar;
+	int mob_ai_threads;
+	int area_interest_check;
 
 #include "../custom/battle_config_struct.inc"
 };
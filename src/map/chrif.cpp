@@ -46,7 +46,7 @@ static const int packet_len_table[0x3d] = { // U - used, F - free
 	11,10,10, 0,11, -1, 0,10,	// 2b10-2b17: U->2b10, U->2b11, U->2b12, F->2b13, U->2b14, U->2b15, F->2b16, U->2b17
 	 2,10, 2,-1,-1,-1, 2, 7,	// 2b18-2b1f: U->2b18, U->2b19, U->2b1a, U->2b1b, U->2b1c, U->2b1d, U->2b1e, U->2b1f
 	-1,10, 8, 2, 2,14,19,19,	// 2b20-2b27: U->2b20, U->2b21, U->2b22, U->2b23, U->2b24, U->2b25, U->2b26, U->2b27
-	-1, 0, 6,15, 0, 6,-1,-1,	// 2b28-2b2f: U->2b28, F->2b29, U->2b2a, U->2b2b, F->2b2c, U->2b2d, U->2b2e, U->2b2f
+	-1,10, 6,15,-1, 6,-1,-1,	// 2b28-2b2f: U->2b28, U->2b29, U->2b2a, U->2b2b, U->2b2c, U->2b2d, U->2b2e, U->2b2f
  };
 
 //Used Packets:
@@ -59,7 +59,7 @@ static const int packet_len_table[0x3d] = { // U - used, F - free
 //2afe: Outgoing, send_usercount_tochar -> 'sends player count of this map server to charserver'
 //2aff: Outgoing, send_users_tochar -> 'sends all actual connected character ids to charserver'
 //2b00: Incoming, map_setusers -> 'set the actual usercount? PACKET.2B COUNT.L.. ?' (not sure)
-//2b01: Outgoing, chrif_save -> 'charsave of char XY account XY (complete struct)'
+//2b01: Outgoing, chrif_save -> 'charsave of char XY account XY (complete struct and the changed sections)'
 //2b02: Outgoing, chrif_charselectreq -> 'player returns from ingame to charserver to select another char.., this packets includes sessid etc' ? (not 100% sure)
 //2b03: Incoming, clif_charselectok -> '' (i think its the packet after enterworld?) (not sure)
 //2b04: Incoming, chrif_recvmap -> 'getting maps from charserver of other mapserver's'
@@ -98,10 +98,10 @@ static const int packet_len_table[0x3d] = { // U - used, F - free
 //2b26: Outgoing, chrif_authreq -> 'client authentication request'
 //2b27: Incoming, chrif_authfail -> 'client authentication failed'
 //2b28: Outgoing, chrif_req_charban -> 'ban a specific char '
-//2b29: FREE
+//2b29: Incoming, chrif_save_resync -> 'a delta save could not be applied, send the complete character'
 //2b2a: Outgoing, chrif_req_charunban -> 'unban a specific char '
 //2b2b: Incoming, chrif_parse_ack_vipActive -> vip info result
-//2b2c: FREE
+//2b2c: Outgoing, chrif_save_delta -> 'charsave of char XY account XY (changed bytes since the previous save)'
 //2b2d: Outgoing, chrif_bsdata_request -> request bonus_script for pc_authok'ed char.
 //2b2e: Outgoing, chrif_bsdata_save -> Send bonus_script of player for saving.
 //2b2f: Incoming, chrif_bsdata_received -> received bonus_script of player for loading.
@@ -291,8 +291,125 @@ int chrif_isconnected(void) {
  *  CSAVE_INVENTORY: Character changed inventory data
  *  CSAVE_CART: Character changed cart data
  */
+/// Hashes a part of the character for chrif_save_changed (FNV-1a)
+static uint64 chrif_save_hash(struct map_session_data* sd, enum e_pc_save_part part) {
+	const struct mmo_charstatus* status = &sd->status;
+	struct {
+		const void* data;
+		size_t len;
+	} ranges[2] = {};
+	uint64 hash = 0xcbf29ce484222325ULL;
+
+	switch( part ) {
+		case PC_SAVE_STATUS: // everything but the arrays of the other parts
+			ranges[0] = { status, offsetof(struct mmo_charstatus, memo_point) };
+			ranges[1] = { &status->show_equip, sizeof(struct mmo_charstatus) - offsetof(struct mmo_charstatus, show_equip) };
+			break;
+		case PC_SAVE_MEMO:
+			ranges[0] = { status->memo_point, sizeof(status->memo_point) };
+			break;
+		case PC_SAVE_SKILLS:
+			ranges[0] = { status->skill, sizeof(status->skill) };
+			break;
+		case PC_SAVE_FRIENDS:
+			ranges[0] = { status->friends, sizeof(status->friends) };
+			break;
+		case PC_SAVE_HOTKEYS:
+#ifdef HOTKEY_SAVING
+			ranges[0] = { status->hotkeys, sizeof(status->hotkeys) };
+#endif
+			break;
+		case PC_SAVE_INVENTORY:
+			ranges[0] = { sd->inventory.u.items_inventory, sizeof(sd->inventory.u.items_inventory) };
+			break;
+		case PC_SAVE_CART:
+			ranges[0] = { sd->cart.u.items_cart, sizeof(sd->cart.u.items_cart) };
+			break;
+		default:
+			return 0;
+	}
+
+	for( const auto& range : ranges ) {
+		const uint8* p = (const uint8*)range.data;
+
+		for( size_t i = 0; i < range.len; i++ ) {
+			hash ^= p[i];
+			hash *= 0x100000001b3ULL;
+		}
+	}
+
+	return hash;
+}
+
+/// Checks whether a part of the character changed since it was last sent to the char-server.
+/// @param force: consider it changed anyway
+/// @return true if the part has to be saved, its hash is then remembered as sent
+static bool chrif_save_changed(struct map_session_data* sd, enum e_pc_save_part part, bool force) {
+	uint64 hash = chrif_save_hash(sd, part);
+
+	if( !force && sd->save_hash[part] == hash )
+		return false;
+
+	sd->save_hash[part] = hash;
+	return true;
+}
+
+/// Sends the bytes of the character that changed since its previous save.
+/// Unchanged bytes between two changes are sent along when the gap is short.
+/// @param status: character as it is saved
+/// @return false if the complete character has to be sent instead
+static bool chrif_save_delta(struct map_session_data* sd, const struct mmo_charstatus* status, uint32 sections) {
+	const uint8* cur = (const uint8*)status;
+	const uint8* base = (const uint8*)&sd->save_base;
+	const size_t size = sizeof(struct mmo_charstatus);
+	const size_t max_gap = 8; // a new range costs a 4 byte header
+	size_t len = 24;
+
+	if( sd->save_seq == 0 || save_full_interval == 0 || sd->save_deltas + 1 >= save_full_interval )
+		return false; // no base or time for a checkpoint
+
+	WFIFOHEAD(char_fd, size + 21);
+	for( size_t i = 0; i < size; ) {
+		size_t start, end;
+
+		if( cur[i] == base[i] ) {
+			i++;
+			continue;
+		}
+
+		start = i;
+		end = i + 1;
+		for( size_t j = end; j < size && j - end < max_gap; j++ ) {
+			if( cur[j] != base[j] )
+				end = j + 1;
+		}
+
+		if( len + 4 + (end - start) >= size + 21 )
+			return false; // larger than the complete character
+
+		WFIFOW(char_fd,len) = (uint16)start;
+		WFIFOW(char_fd,len+2) = (uint16)(end - start);
+		memcpy(WFIFOP(char_fd,len+4), cur + start, end - start);
+		len += 4 + end - start;
+		i = end;
+	}
+
+	WFIFOW(char_fd,0) = 0x2b2c;
+	WFIFOW(char_fd,2) = (uint16)len;
+	WFIFOL(char_fd,4) = sd->status.account_id;
+	WFIFOL(char_fd,8) = sd->status.char_id;
+	WFIFOL(char_fd,12) = sections;
+	WFIFOL(char_fd,16) = sd->save_seq;
+	WFIFOL(char_fd,20) = sd->save_seq + 1;
+	WFIFOSET(char_fd, len);
+
+	return true;
+}
+
 int chrif_save(struct map_session_data *sd, int flag) {
 	uint16 mmo_charstatus_len = 0;
+	uint32 sections = 0;
+	bool force;
 
 	nullpo_retr(-1, sd);
 
@@ -309,13 +426,16 @@ int chrif_save(struct map_session_data *sd, int flag) {
 
 	chrif_check(-1); //Character is saved on reconnect.
 
+	// only the parts that changed since the last save are written, all of them when leaving the server
+	force = (flag&CSAVE_QUITTING) != 0;
+
 	chrif_bsdata_save(sd, ((flag&CSAVE_QUITTING) && !(flag&CSAVE_AUTOTRADE)));
 
 	if (sd->storage.dirty)
 		storage_storagesave(sd);
-	if (flag&CSAVE_INVENTORY)
+	if ((flag&CSAVE_INVENTORY) && chrif_save_changed(sd, PC_SAVE_INVENTORY, force))
 		intif_storage_save(sd,&sd->inventory);
-	if (flag&CSAVE_CART)
+	if ((flag&CSAVE_CART) && chrif_save_changed(sd, PC_SAVE_CART, force))
 		intif_storage_save(sd,&sd->cart);
 
 	//For data sync
@@ -331,30 +451,47 @@ int chrif_save(struct map_session_data *sd, int flag) {
 	if (sd->vars_dirty)
 		intif_saveregistry(sd);
 
-	mmo_charstatus_len = sizeof(sd->status) + 13;
-	WFIFOHEAD(char_fd, mmo_charstatus_len);
-	WFIFOW(char_fd,0) = 0x2b01;
-	WFIFOW(char_fd,2) = mmo_charstatus_len;
-	WFIFOL(char_fd,4) = sd->status.account_id;
-	WFIFOL(char_fd,8) = sd->status.char_id;
-	WFIFOB(char_fd,12) = (flag&CSAVE_QUIT) ? 1 : 0; //Flag to tell char-server this character is quitting.
+	for (int part = PC_SAVE_STATUS; part <= PC_SAVE_HOTKEYS; part++) {
+		if (chrif_save_changed(sd, (enum e_pc_save_part)part, force))
+			sections |= 1 << part;
+	}
 
-	// If the user is on a instance map, we have to fake his current position
-	if( map_getmapdata(sd->bl.m)->instance_id ){
+	// nothing to write, the quit flag has to reach the char-server anyway
+	if (sections != 0 || (flag&CSAVE_QUIT)) {
 		struct mmo_charstatus status;
 
 		// Copy the whole status
 		memcpy( &status, &sd->status, sizeof( struct mmo_charstatus ) );
-		// Change his current position to his savepoint
-		memcpy( &status.last_point, &status.save_point, sizeof( struct point ) );
-		// Copy the copied status into the packet
-		memcpy( WFIFOP( char_fd, 13 ), &status, sizeof( struct mmo_charstatus ) );
-	} else {
-		// Copy the whole status into the packet
-		memcpy( WFIFOP( char_fd, 13 ), &sd->status, sizeof( struct mmo_charstatus ) );
-	}
 
-	WFIFOSET(char_fd, WFIFOW(char_fd,2));
+		// If the user is on a instance map, we have to fake his current position
+		if( map_getmapdata(sd->bl.m)->instance_id ){
+			// Change his current position to his savepoint
+			memcpy( &status.last_point, &status.save_point, sizeof( struct point ) );
+		}
+
+		if (!force && chrif_save_delta(sd, &status, sections))
+			sd->save_deltas++;
+		else {
+			mmo_charstatus_len = sizeof(sd->status) + 21;
+			WFIFOHEAD(char_fd, mmo_charstatus_len);
+			WFIFOW(char_fd,0) = 0x2b01;
+			WFIFOW(char_fd,2) = mmo_charstatus_len;
+			WFIFOL(char_fd,4) = sd->status.account_id;
+			WFIFOL(char_fd,8) = sd->status.char_id;
+			WFIFOB(char_fd,12) = (flag&CSAVE_QUIT) ? 1 : 0; //Flag to tell char-server this character is quitting.
+			WFIFOL(char_fd,13) = sections;
+			WFIFOL(char_fd,17) = sd->save_seq + 1;
+			// Copy the status into the packet
+			memcpy( WFIFOP( char_fd, 21 ), &status, sizeof( struct mmo_charstatus ) );
+			WFIFOSET(char_fd, WFIFOW(char_fd,2));
+			sd->save_deltas = 0;
+		}
+
+		// base of the next delta
+		memcpy( &sd->save_base, &status, sizeof( struct mmo_charstatus ) );
+		if (++sd->save_seq == 0)
+			sd->save_seq = 1;
+	}
 
 	if( sd->status.pet_id > 0 && sd->pd )
 		intif_save_petdata(sd->status.account_id,&sd->pd->pet);
@@ -566,6 +703,17 @@ static int chrif_reconnect(DBKey key, DBData *data, va_list ap) {
 
 
 /// Called when all the connection steps are completed.
+/// Forgets what was sent with the previous saves of the online characters
+static void chrif_save_reset(void) {
+	struct s_mapiterator* iter = mapit_getallusers();
+
+	for( struct map_session_data* sd = (TBL_PC*)mapit_first(iter); mapit_exists(iter); sd = (TBL_PC*)mapit_next(iter) ) {
+		memset(sd->save_hash, 0, sizeof(sd->save_hash));
+		sd->save_seq = 0;
+	}
+	mapit_free(iter);
+}
+
 void chrif_on_ready(void) {
 	ShowStatus("Map Server is now online.\n");
 
@@ -576,6 +724,9 @@ void chrif_on_ready(void) {
 	//If there are players online, send them to the char-server. [Skotlex]
 	send_users_tochar();
 
+	//Their next save is complete, the previous ones may not have been stored.
+	chrif_save_reset();
+
 	//Auth db reconnect handling
 	auth_db->foreach(auth_db,chrif_reconnect);
 
@@ -1748,6 +1899,21 @@ int chrif_bsdata_received(int fd) {
 /*==========================================
  *
  *------------------------------------------*/
+/**
+ * The char-server couldn't apply a delta save, the complete character is sent now.
+ * ZA 0x2b29 <account_id>.L <char_id>.L
+ */
+static void chrif_save_resync(int fd) {
+	struct map_session_data* sd = map_charid2sd(RFIFOL(fd,6));
+
+	if( sd == NULL || sd->status.account_id != RFIFOL(fd,2) )
+		return;
+
+	memset(sd->save_hash, 0, sizeof(sd->save_hash));
+	sd->save_seq = 0;
+	chrif_save(sd, CSAVE_NORMAL);
+}
+
 int chrif_parse(int fd) {
 	int packet_len;
 
@@ -1821,6 +1987,7 @@ int chrif_parse(int fd) {
 			case 0x2b24: chrif_keepalive_ack(fd); break;
 			case 0x2b25: chrif_deadopt(RFIFOL(fd,2), RFIFOL(fd,6), RFIFOL(fd,10)); break;
 			case 0x2b27: chrif_authfail(fd); break;
+			case 0x2b29: chrif_save_resync(fd); break;
 			case 0x2b2b: chrif_parse_ack_vipActive(fd); break;
 			case 0x2b2f: chrif_bsdata_received(fd); break;
 			default:
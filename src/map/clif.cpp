@@ -4,6 +4,7 @@
 
 #include "clif.hpp"
 
+#include <algorithm>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
@@ -395,6 +396,7 @@ static int clif_send_sub(struct block_list *bl, va_list ap)
 {
 	struct block_list *src_bl;
 	struct map_session_data *sd;
+	struct s_send_slice *slice;
 	unsigned char *buf;
 	int len, type, fd;
 
@@ -410,6 +412,7 @@ static int clif_send_sub(struct block_list *bl, va_list ap)
 	len = va_arg(ap,int);
 	nullpo_ret(src_bl = va_arg(ap,struct block_list*));
 	type = va_arg(ap,int);
+	slice = va_arg(ap,struct s_send_slice*);
 
 	switch(type) {
 	case AREA_WOS:
@@ -441,7 +444,6 @@ static int clif_send_sub(struct block_list *bl, va_list ap)
 		!sd->sc.data[SC_INTRAVISION] && battle_check_target(src_bl,&sd->bl,BCT_ENEMY) > 0)
 		return 0;
 
-	WFIFOHEAD(fd, len);
 	if (WFIFOP(fd,0) == buf) {
 		ShowError("WARNING: Invalid use of clif_send function\n");
 		ShowError("         Packet x%4x use a WFIFO of a player instead of to use a buffer.\n", WBUFW(buf,0));
@@ -452,8 +454,7 @@ static int clif_send_sub(struct block_list *bl, va_list ap)
 		return 0;
 	}
 
-	memcpy(WFIFOP(fd,0), buf, len);
-	WFIFOSET(fd,len);
+	WFIFOSHARE(fd, slice, buf, len);
 
 	return 0;
 }
@@ -462,6 +463,72 @@ static int clif_send_sub(struct block_list *bl, va_list ap)
  * Packet Delegation (called on all packets that require data to be sent to more than one client)
  * functions that are sent solely to one use whose ID it posses use WFIFOSET
  *------------------------------------------*/
+/// Calls clif_send_sub for a single player.
+static int clif_send_sub_call(struct block_list *bl, ...)
+{
+	va_list ap;
+	int ret;
+
+	va_start(ap, bl);
+	ret = clif_send_sub(bl, ap);
+	va_end(ap);
+
+	return ret;
+}
+
+static int clif_send_area_check_sub(struct block_list *bl, va_list ap)
+{
+	std::vector<struct map_session_data*> *list = va_arg(ap, std::vector<struct map_session_data*>*);
+
+	list->push_back((struct map_session_data*)bl);
+	return 0;
+}
+
+/**
+ * Compares the interest set of a block with a scan of the grid (battle_config.area_interest_check).
+ */
+static void clif_send_area_check(struct block_list *bl, const std::vector<struct map_session_data*>& area)
+{
+	std::vector<struct map_session_data*> scan, list(area);
+
+	map_foreachinallarea(clif_send_area_check_sub, bl->m, bl->x-AREA_SIZE, bl->y-AREA_SIZE, bl->x+AREA_SIZE, bl->y+AREA_SIZE, BL_PC, &scan);
+
+	std::sort(scan.begin(), scan.end());
+	std::sort(list.begin(), list.end());
+
+	if (scan != list)
+		ShowDebug("clif_send_area_check: interest set of block %d (type %d) at %s (%d,%d) has %" PRIuPTR " players, the grid has %" PRIuPTR ".\n",
+			bl->id, bl->type, map_getmapdata(bl->m)->name, bl->x, bl->y, list.size(), scan.size());
+}
+
+/**
+ * Sends a packet to the players within range of a block, using its interest set.
+ * @param range: AREA_SIZE or less
+ * @return false if the block has no interest set and the grid has to be scanned
+ */
+static bool clif_send_area(const void* buf, int len, struct block_list* bl, int range, enum send_target type, struct s_send_slice* slice)
+{
+	const std::vector<struct map_session_data*> *area = map_area_interest(bl);
+
+	if (area == nullptr)
+		return false;
+
+	if (battle_config.area_interest_check)
+		clif_send_area_check(bl, *area);
+
+	// by index, the set is not expected to change while sending but don't trust it
+	for (size_t i = 0; i < area->size(); i++) {
+		struct map_session_data *tsd = (*area)[i];
+
+		if (range < AREA_SIZE && (abs(tsd->bl.x - bl->x) > range || abs(tsd->bl.y - bl->y) > range))
+			continue;
+
+		clif_send_sub_call(&tsd->bl, buf, len, bl, type, slice);
+	}
+
+	return true;
+}
+
 int clif_send(const void* buf, int len, struct block_list* bl, enum send_target type)
 {
 	int i;
@@ -471,6 +538,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 	std::shared_ptr<s_battleground_data> bg;
 	int x0 = 0, x1 = 0, y0 = 0, y1 = 0, fd;
 	struct s_mapiterator* iter;
+	struct s_send_slice slice = {}; // the packet is copied once and shared by all recipients
 
 	if( type != ALL_CLIENT )
 		nullpo_ret(bl);
@@ -483,9 +551,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 		iter = mapit_getallusers();
 		while( ( tsd = (map_session_data*)mapit_next( iter ) ) != nullptr ){
 			if( session_isActive( fd = tsd->fd ) ){
-				WFIFOHEAD( fd, len );
-				memcpy( WFIFOP( fd, 0 ), buf, len );
-				WFIFOSET( fd, len );
+				WFIFOSHARE(fd, &slice, buf, len);
 			}
 		}
 		mapit_free(iter);
@@ -495,9 +561,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 		iter = mapit_getallusers();
 		while( ( tsd = (map_session_data*)mapit_next( iter ) ) != nullptr ){
 			if( bl->m == tsd->bl.m && session_isActive( fd = tsd->fd ) ){
-				WFIFOHEAD( fd, len );
-				memcpy( WFIFOP( fd, 0 ), buf, len );
-				WFIFOSET( fd, len );
+				WFIFOSHARE(fd, &slice, buf, len);
 			}
 		}
 		mapit_free(iter);
@@ -509,12 +573,14 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 			clif_send (buf, len, bl, SELF);
 	case AREA_WOC:
 	case AREA_WOS:
-		map_foreachinallarea(clif_send_sub, bl->m, bl->x-AREA_SIZE, bl->y-AREA_SIZE, bl->x+AREA_SIZE, bl->y+AREA_SIZE,
-			BL_PC, buf, len, bl, type);
+		if (!clif_send_area(buf, len, bl, AREA_SIZE, type, &slice))
+			map_foreachinallarea(clif_send_sub, bl->m, bl->x-AREA_SIZE, bl->y-AREA_SIZE, bl->x+AREA_SIZE, bl->y+AREA_SIZE,
+				BL_PC, buf, len, bl, type, &slice);
 		break;
 	case AREA_CHAT_WOC:
-		map_foreachinallarea(clif_send_sub, bl->m, bl->x-(AREA_SIZE-5), bl->y-(AREA_SIZE-5),
-			bl->x+(AREA_SIZE-5), bl->y+(AREA_SIZE-5), BL_PC, buf, len, bl, AREA_WOC);
+		if (!clif_send_area(buf, len, bl, AREA_SIZE-5, AREA_WOC, &slice))
+			map_foreachinallarea(clif_send_sub, bl->m, bl->x-(AREA_SIZE-5), bl->y-(AREA_SIZE-5),
+				bl->x+(AREA_SIZE-5), bl->y+(AREA_SIZE-5), BL_PC, buf, len, bl, AREA_WOC, &slice);
 		break;
 
 	case CHAT:
@@ -532,9 +598,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 				if (type == CHAT_WOS && cd->usersd[i] == sd)
 					continue;
 				if( session_isActive( fd = cd->usersd[i]->fd ) ){
-					WFIFOHEAD(fd,len);
-					memcpy(WFIFOP(fd,0), buf, len);
-					WFIFOSET(fd,len);
+					WFIFOSHARE(fd, &slice, buf, len);
 				}
 			}
 		}
@@ -570,9 +634,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 				if( (type == PARTY_AREA || type == PARTY_AREA_WOS) && (sd->bl.x < x0 || sd->bl.y < y0 || sd->bl.x > x1 || sd->bl.y > y1) )
 					continue;
 
-				WFIFOHEAD(fd, len);
-				memcpy(WFIFOP(fd, 0), buf, len);
-				WFIFOSET(fd, len);
+				WFIFOSHARE(fd, &slice, buf, len);
 			}
 			if (!enable_spy) //Skip unnecessary parsing. [Skotlex]
 				break;
@@ -580,9 +642,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 			iter = mapit_getallusers();
 			while( ( tsd = (map_session_data*)mapit_next( iter ) ) != nullptr ){
 				if( tsd->partyspy == p->party.party_id && session_isActive( fd = tsd->fd ) ){
-					WFIFOHEAD( fd, len );
-					memcpy( WFIFOP( fd, 0 ), buf, len );
-					WFIFOSET( tsd->fd, len );
+					WFIFOSHARE(fd, &slice, buf, len);
 				}
 			}
 			mapit_free(iter);
@@ -598,9 +658,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 			if( type == DUEL_WOS && bl->id == tsd->bl.id )
 				continue;
 			if( sd->duel_group == tsd->duel_group && session_isActive( fd = tsd->fd ) ){
-				WFIFOHEAD( fd, len );
-				memcpy( WFIFOP( fd, 0 ), buf, len );
-				WFIFOSET( fd, len );
+				WFIFOSHARE(fd, &slice, buf, len);
 			}
 		}
 		mapit_free(iter);
@@ -648,9 +706,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 					if( (type == GUILD_AREA || type == GUILD_AREA_WOS) && (sd->bl.x < x0 || sd->bl.y < y0 || sd->bl.x > x1 || sd->bl.y > y1) )
 						continue;
 
-					WFIFOHEAD(fd,len);
-					memcpy(WFIFOP(fd,0), buf, len);
-					WFIFOSET(fd,len);
+					WFIFOSHARE(fd, &slice, buf, len);
 				}
 			}
 			if (!enable_spy) //Skip unnecessary parsing. [Skotlex]
@@ -659,9 +715,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 			iter = mapit_getallusers();
 			while( ( tsd = (map_session_data*)mapit_next( iter ) ) != nullptr ){
 				if( tsd->guildspy == g->guild_id && session_isActive( fd = tsd->fd ) ){
-					WFIFOHEAD( fd, len );
-					memcpy( WFIFOP( fd, 0 ), buf, len );
-					WFIFOSET( fd, len );
+					WFIFOSHARE(fd, &slice, buf, len);
 				}
 			}
 			mapit_free(iter);
@@ -689,9 +743,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 					continue;
 				if( (type == BG_AREA || type == BG_AREA_WOS) && (sd->bl.x < x0 || sd->bl.y < y0 || sd->bl.x > x1 || sd->bl.y > y1) )
 					continue;
-				WFIFOHEAD(fd,len);
-				memcpy(WFIFOP(fd,0), buf, len);
-				WFIFOSET(fd,len);
+				WFIFOSHARE(fd, &slice, buf, len);
 			}
 		}
 		break;
@@ -704,9 +756,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 					continue;
 				}
 
-				WFIFOHEAD(fd,len);
-				memcpy(WFIFOP(fd,0), buf, len);
-				WFIFOSET(fd,len);
+				WFIFOSHARE(fd, &slice, buf, len);
 			}
 
 			if (!enable_spy) //Skip unnecessary parsing. [Skotlex]
@@ -715,9 +765,7 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 			iter = mapit_getallusers();
 			while( ( tsd = (map_session_data*)mapit_next( iter ) ) != nullptr ){
 				if( tsd->clanspy == clan->id && session_isActive( fd = tsd->fd ) ){
-					WFIFOHEAD(fd, len);
-					memcpy(WFIFOP(fd, 0), buf, len);
-					WFIFOSET(fd, len);
+					WFIFOSHARE(fd, &slice, buf, len);
 				}
 			}
 			mapit_free(iter);
@@ -729,6 +777,8 @@ int clif_send(const void* buf, int len, struct block_list* bl, enum send_target
 		return -1;
 	}
 
+	WFIFOSHARE_END(&slice);
+
 	return 0;
 }
 
@@ -3,13 +3,22 @@
 
 #include "log.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdarg.h>
 #include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "../common/cbasetypes.hpp"
 #include "../common/nullpo.hpp"
 #include "../common/showmsg.hpp"
 #include "../common/sql.hpp" // SQL_INNODB
 #include "../common/strlib.hpp"
+#include "../common/utils.hpp"
 
 #include "battle.hpp"
 #include "homunculus.hpp"
@@ -55,6 +64,257 @@ struct Log_Config log_config;
 #endif
 
 
+/// Asynchronous log writer
+/// With log_async the main thread doesn't insert the SQL logs itself. The rows
+/// are queued in a bounded single producer/single consumer ring and a thread
+/// with its own connection inserts them, several rows per query.
+
+/// Row waiting for the log writer
+struct s_log_row {
+	const char* table;   // table name of log_config
+	const char* columns; // column list, static storage
+	time_t time;
+	std::string values;  // escaped values after the time column
+};
+
+static Sql* log_writer_handle = nullptr;
+static std::thread log_writer_thread;
+static std::atomic<bool> log_writer_running(false);
+static std::mutex log_writer_mutex;
+static std::condition_variable log_writer_cv;
+static std::mutex log_spill_mutex;
+
+static std::vector<struct s_log_row*> log_ring;
+static std::atomic<size_t> log_ring_head(0); // next slot written by the main thread
+static std::atomic<size_t> log_ring_tail(0); // next slot read by the writer
+
+// statistics, the atomic ones are updated by the writer
+static size_t log_stat_max_depth = 0;
+static uint64 log_stat_queued = 0, log_stat_dropped = 0;
+static std::atomic<uint64> log_stat_spilled(0), log_stat_written(0), log_stat_failed(0), log_stat_batches(0);
+static std::atomic<uint64> log_stat_last_flush(0), log_stat_max_flush(0), log_stat_total_flush(0);
+
+static size_t log_writer_depth(void)
+{
+	return log_ring_head.load() - log_ring_tail.load();
+}
+
+/// Appends a row to the spill file, as a statement that can be run later
+static bool log_writer_spill(const struct s_log_row* row)
+{
+	std::lock_guard<std::mutex> guard(log_spill_mutex);
+	FILE* fp;
+
+	if( ( fp = fopen(log_config.async_spill_file, "a") ) == NULL )
+		return false;
+	fprintf(fp, LOG_QUERY " INTO `%s` (%s) VALUES (FROM_UNIXTIME(%" PRId64 "), %s);\n", row->table, row->columns, (int64)row->time, row->values.c_str());
+	fclose(fp);
+	log_stat_spilled++;
+	return true;
+}
+
+/// Inserts the queued rows, consecutive rows of the same table share a query
+static void log_writer_flush(void)
+{
+	std::vector<struct s_log_row*> batch;
+	std::string query;
+
+	while( true ) {
+		size_t tail = log_ring_tail.load(std::memory_order_relaxed);
+		size_t count = min(log_ring_head.load(std::memory_order_acquire) - tail, (size_t)log_config.async_batch_size);
+
+		if( count == 0 )
+			break;
+
+		batch.clear();
+		for( size_t i = 0; i < count; i++ )
+			batch.push_back(log_ring[(tail + i) % log_ring.size()]);
+		log_ring_tail.store(tail + count, std::memory_order_release);
+
+		for( size_t i = 0, j; i < batch.size(); i = j ) {
+			query.assign(LOG_QUERY " INTO `").append(batch[i]->table).append("` (").append(batch[i]->columns).append(") VALUES ");
+			for( j = i; j < batch.size() && batch[j]->table == batch[i]->table && batch[j]->columns == batch[i]->columns; j++ ) {
+				if( j > i )
+					query.append(",");
+				query.append("(FROM_UNIXTIME(").append(std::to_string((int64)batch[j]->time)).append("), ").append(batch[j]->values).append(")");
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			bool success = Sql_ExecuteStr(log_writer_handle, query.data(), query.size()) == SQL_SUCCESS;
+			uint64 elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+			log_stat_batches++;
+			log_stat_last_flush = elapsed;
+			log_stat_total_flush += elapsed;
+			if( elapsed > log_stat_max_flush )
+				log_stat_max_flush = elapsed;
+
+			if( success )
+				log_stat_written += j - i;
+			else {
+				log_stat_failed += j - i;
+				if( log_config.async_overflow ) {// keep them for later
+					for( size_t k = i; k < j; k++ )
+						log_writer_spill(batch[k]);
+				}
+			}
+		}
+
+		for( auto row : batch )
+			delete row;
+	}
+}
+
+static void log_writer_run(void)
+{
+	auto last_query = std::chrono::steady_clock::now();
+
+	Sql_ThreadInit();
+
+	while( true ) {
+		{
+			// a missed notification only delays the batch until the interval
+			std::unique_lock<std::mutex> lock(log_writer_mutex);
+			log_writer_cv.wait_for(lock, std::chrono::milliseconds(log_config.async_batch_interval), [] {
+				return !log_writer_running.load() || log_writer_depth() >= (size_t)log_config.async_batch_size;
+			});
+		}
+
+		bool running = log_writer_running.load();
+		auto now = std::chrono::steady_clock::now();
+
+		if( log_writer_depth() > 0 ) {
+			log_writer_flush();
+			last_query = now;
+		} else if( now - last_query > std::chrono::minutes(5) ) {// keep the connection alive
+			Sql_Ping(log_writer_handle);
+			last_query = now;
+		}
+
+		if( !running )
+			break; // everything queued before the stop was flushed
+	}
+
+	Sql_ThreadEnd();
+}
+
+/// Starts the log writer, which takes over the connected handle
+void log_writer_init(Sql* handle)
+{
+	Sql_StopKeepalive(handle); // pinged by the writer
+	log_writer_handle = handle;
+
+	log_ring.assign(log_config.async_queue_size, nullptr);
+	log_ring_head = 0;
+	log_ring_tail = 0;
+
+	log_writer_running = true;
+	log_writer_thread = std::thread(log_writer_run);
+
+	ShowStatus("Writing SQL logs from a separate thread (queue of %d rows, batches of %d rows or %d ms).\n", log_config.async_queue_size, log_config.async_batch_size, log_config.async_batch_interval);
+}
+
+/// Stops the log writer after it inserted the queued rows
+void log_writer_final(void)
+{
+	if( log_writer_handle == nullptr )
+		return;
+
+	log_writer_running = false;
+	log_writer_cv.notify_one();
+	log_writer_thread.join();
+
+	if( log_stat_dropped || log_stat_spilled || log_stat_failed )
+		ShowWarning("Log writer: %" PRIu64 " rows dropped, %" PRIu64 " spilled to '%s', %" PRIu64 " failed to insert.\n", log_stat_dropped, log_stat_spilled.load(), log_config.async_spill_file, log_stat_failed.load());
+
+	Sql_Free(log_writer_handle);
+	log_writer_handle = nullptr;
+	log_ring.clear();
+}
+
+bool log_writer_active(void)
+{
+	return log_writer_handle != nullptr;
+}
+
+void log_writer_get_stats(struct s_log_writer_stats* stats)
+{
+	stats->depth = log_writer_active() ? log_writer_depth() : 0;
+	stats->max_depth = log_stat_max_depth;
+	stats->queued = log_stat_queued;
+	stats->written = log_stat_written;
+	stats->dropped = log_stat_dropped;
+	stats->spilled = log_stat_spilled;
+	stats->failed = log_stat_failed;
+	stats->batches = log_stat_batches;
+	stats->last_flush = log_stat_last_flush;
+	stats->max_flush = log_stat_max_flush;
+	stats->total_flush = log_stat_total_flush;
+}
+
+/// Escapes a string for log_sql_insert
+static std::string log_escape(const char* str, size_t len)
+{
+	std::string out(2 * len + 1, '\0');
+
+	out.resize(Sql_EscapeStringLen(logmysql_handle, &out[0], str, len));
+	return out;
+}
+
+/// Inserts a row into a log table, through the log writer when it is active.
+/// @param columns: column list, starting with the time column
+/// @param format: values after the time column, strings have to be escaped with log_escape
+static void log_sql_insert(const char* table, const char* columns, const char* format, ...)
+{
+	std::string values;
+	va_list ap;
+	int len;
+
+	va_start(ap, format);
+	len = vsnprintf(NULL, 0, format, ap);
+	va_end(ap);
+	if( len < 0 )
+		return;
+
+	values.resize(len + 1);
+	va_start(ap, format);
+	vsnprintf(&values[0], values.size(), format, ap);
+	va_end(ap);
+	values.resize(len);
+
+	if( !log_writer_active() ) {
+		if( SQL_ERROR == Sql_Query(logmysql_handle, LOG_QUERY " INTO `%s` (%s) VALUES (NOW(), %s)", table, columns, values.c_str()) )
+			Sql_ShowDebug(logmysql_handle);
+		return;
+	}
+
+	struct s_log_row* row = new s_log_row;
+	size_t head = log_ring_head.load(std::memory_order_relaxed);
+	size_t depth = head - log_ring_tail.load(std::memory_order_acquire);
+
+	row->table = table;
+	row->columns = columns;
+	row->time = time(NULL);
+	row->values = std::move(values);
+
+	if( depth >= log_ring.size() ) {// queue is full
+		if( !log_config.async_overflow || !log_writer_spill(row) )
+			log_stat_dropped++;
+		delete row;
+		return;
+	}
+
+	log_ring[head % log_ring.size()] = row;
+	log_ring_head.store(head + 1, std::memory_order_release);
+
+	log_stat_queued++;
+	if( ++depth > log_stat_max_depth )
+		log_stat_max_depth = depth;
+	if( depth == (size_t)log_config.async_batch_size )
+		log_writer_cv.notify_one();
+}
+
+
 /// obtain log type character for item/zeny logs
 static char log_picktype2char(e_log_pick_type type)
 {
@@ -172,17 +432,8 @@ void log_branch(struct map_session_data* sd)
 		return;
 
 	if( log_config.sql_logs ) {
-		SqlStmt* stmt;
-		stmt = SqlStmt_Malloc(logmysql_handle);
-		if( SQL_SUCCESS != SqlStmt_Prepare(stmt, LOG_QUERY " INTO `%s` (`branch_date`, `account_id`, `char_id`, `char_name`, `map`) VALUES (NOW(), '%d', '%d', ?, '%s')", log_config.log_branch, sd->status.account_id, sd->status.char_id, mapindex_id2name(sd->mapindex) )
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 0, SQLDT_STRING, sd->status.name, strnlen(sd->status.name, NAME_LENGTH))
-		||  SQL_SUCCESS != SqlStmt_Execute(stmt) )
-		{
-			SqlStmt_ShowDebug(stmt);
-			SqlStmt_Free(stmt);
-			return;
-		}
-		SqlStmt_Free(stmt);
+		log_sql_insert(log_config.log_branch, "`branch_date`, `account_id`, `char_id`, `char_name`, `map`", "'%d', '%d', '%s', '%s'",
+			sd->status.account_id, sd->status.char_id, log_escape(sd->status.name, strnlen(sd->status.name, NAME_LENGTH)).c_str(), mapindex_id2name(sd->mapindex));
 	}
 	else
 	{
@@ -213,32 +464,34 @@ void log_pick(int id, int16 m, e_log_pick_type type, int amount, struct item* it
 
 	if( log_config.sql_logs )
 	{
+		static std::string columns;
 		int i;
-		SqlStmt* stmt = SqlStmt_Malloc(logmysql_handle);
 		StringBuf buf;
 		StringBuf_Init(&buf);
 
-		StringBuf_Printf(&buf, "%s INTO `%s` (`time`, `char_id`, `type`, `nameid`, `amount`, `refine`, `map`, `unique_id`, `bound`, `enchantgrade`", LOG_QUERY, log_config.log_pick);
-		for (i = 0; i < MAX_SLOTS; ++i)
-			StringBuf_Printf(&buf, ", `card%d`", i);
-		for (i = 0; i < MAX_ITEM_RDM_OPT; ++i) {
-			StringBuf_Printf(&buf, ", `option_id%d`", i);
-			StringBuf_Printf(&buf, ", `option_val%d`", i);
-			StringBuf_Printf(&buf, ", `option_parm%d`", i);
+		if( columns.empty() ) {
+			StringBuf_AppendStr(&buf, "`time`, `char_id`, `type`, `nameid`, `amount`, `refine`, `map`, `unique_id`, `bound`, `enchantgrade`");
+			for (i = 0; i < MAX_SLOTS; ++i)
+				StringBuf_Printf(&buf, ", `card%d`", i);
+			for (i = 0; i < MAX_ITEM_RDM_OPT; ++i) {
+				StringBuf_Printf(&buf, ", `option_id%d`", i);
+				StringBuf_Printf(&buf, ", `option_val%d`", i);
+				StringBuf_Printf(&buf, ", `option_parm%d`", i);
+			}
+			columns = StringBuf_Value(&buf);
+			StringBuf_Clear(&buf);
 		}
-		StringBuf_Printf(&buf, ") VALUES(NOW(),'%u','%c','%u','%d','%d','%s','%" PRIu64 "','%d','%d'",
+
+		StringBuf_Printf(&buf, "'%u','%c','%u','%d','%d','%s','%" PRIu64 "','%d','%d'",
 			id, log_picktype2char(type), itm->nameid, amount, itm->refine, map_getmapdata(m)->name[0] ? map_getmapdata(m)->name : "", itm->unique_id, itm->bound, itm->enchantgrade);
 
 		for (i = 0; i < MAX_SLOTS; i++)
 			StringBuf_Printf(&buf, ",'%u'", itm->card[i]);
 		for (i = 0; i < MAX_ITEM_RDM_OPT; i++)
 			StringBuf_Printf(&buf, ",'%d','%d','%d'", itm->option[i].id, itm->option[i].value, itm->option[i].param);
-		StringBuf_Printf(&buf, ")");
 
-		if (SQL_SUCCESS != SqlStmt_PrepareStr(stmt, StringBuf_Value(&buf)) || SQL_SUCCESS != SqlStmt_Execute(stmt))
-			SqlStmt_ShowDebug(stmt);
+		log_sql_insert(log_config.log_pick, columns.c_str(), "%s", StringBuf_Value(&buf));
 
-		SqlStmt_Free(stmt);
 		StringBuf_Destroy(&buf);
 	}
 	else
@@ -281,12 +534,8 @@ void log_zeny(struct map_session_data* sd, e_log_pick_type type, struct map_sess
 
 	if( log_config.sql_logs )
 	{
-		if( SQL_ERROR == Sql_Query(logmysql_handle, LOG_QUERY " INTO `%s` (`time`, `char_id`, `src_id`, `type`, `amount`, `map`) VALUES (NOW(), '%d', '%d', '%c', '%d', '%s')",
-			log_config.log_zeny, sd->status.char_id, src_sd->status.char_id, log_picktype2char(type), amount, mapindex_id2name(sd->mapindex)) )
-		{
-			Sql_ShowDebug(logmysql_handle);
-			return;
-		}
+		log_sql_insert(log_config.log_zeny, "`time`, `char_id`, `src_id`, `type`, `amount`, `map`", "'%d', '%d', '%c', '%d', '%s'",
+			sd->status.char_id, src_sd->status.char_id, log_picktype2char(type), amount, mapindex_id2name(sd->mapindex));
 	}
 	else
 	{
@@ -314,12 +563,8 @@ void log_mvpdrop(struct map_session_data* sd, int monster_id, t_itemid nameid, t
 
 	if( log_config.sql_logs )
 	{
-		if( SQL_ERROR == Sql_Query(logmysql_handle, LOG_QUERY " INTO `%s` (`mvp_date`, `kill_char_id`, `monster_id`, `prize`, `mvpexp`, `map`) VALUES (NOW(), '%d', '%d', '%u', '%" PRIu64 "', '%s') ",
-			log_config.log_mvpdrop, sd->status.char_id, monster_id, nameid, exp, mapindex_id2name(sd->mapindex)) )
-		{
-			Sql_ShowDebug(logmysql_handle);
-			return;
-		}
+		log_sql_insert(log_config.log_mvpdrop, "`mvp_date`, `kill_char_id`, `monster_id`, `prize`, `mvpexp`, `map`", "'%d', '%d', '%u', '%" PRIu64 "', '%s'",
+			sd->status.char_id, monster_id, nameid, exp, mapindex_id2name(sd->mapindex));
 	}
 	else
 	{
@@ -348,19 +593,9 @@ void log_atcommand(struct map_session_data* sd, const char* message)
 
 	if( log_config.sql_logs )
 	{
-		SqlStmt* stmt;
-
-		stmt = SqlStmt_Malloc(logmysql_handle);
-		if( SQL_SUCCESS != SqlStmt_Prepare(stmt, LOG_QUERY " INTO `%s` (`atcommand_date`, `account_id`, `char_id`, `char_name`, `map`, `command`) VALUES (NOW(), '%d', '%d', ?, '%s', ?)", log_config.log_gm, sd->status.account_id, sd->status.char_id, mapindex_id2name(sd->mapindex) )
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 0, SQLDT_STRING, sd->status.name, strnlen(sd->status.name, NAME_LENGTH))
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 1, SQLDT_STRING, (char*)message, safestrnlen(message, 255))
-		||  SQL_SUCCESS != SqlStmt_Execute(stmt) )
-		{
-			SqlStmt_ShowDebug(stmt);
-			SqlStmt_Free(stmt);
-			return;
-		}
-		SqlStmt_Free(stmt);
+		log_sql_insert(log_config.log_gm, "`atcommand_date`, `account_id`, `char_id`, `char_name`, `map`, `command`", "'%d', '%d', '%s', '%s', '%s'",
+			sd->status.account_id, sd->status.char_id, log_escape(sd->status.name, strnlen(sd->status.name, NAME_LENGTH)).c_str(), mapindex_id2name(sd->mapindex),
+			log_escape(message, safestrnlen(message, 255)).c_str());
 	}
 	else
 	{
@@ -386,18 +621,8 @@ void log_npc( struct npc_data* nd, const char* message ){
 
 	if( log_config.sql_logs )
 	{
-		SqlStmt* stmt;
-		stmt = SqlStmt_Malloc(logmysql_handle);
-		if( SQL_SUCCESS != SqlStmt_Prepare(stmt, LOG_QUERY " INTO `%s` (`npc_date`, `char_name`, `map`, `mes`) VALUES (NOW(), ?, '%s', ?)", log_config.log_npc, map_mapid2mapname(nd->bl.m) )
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 0, SQLDT_STRING, nd->name, strnlen(nd->name, NAME_LENGTH))
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 1, SQLDT_STRING, (char*)message, safestrnlen(message, 255))
-		||  SQL_SUCCESS != SqlStmt_Execute(stmt) )
-		{
-			SqlStmt_ShowDebug(stmt);
-			SqlStmt_Free(stmt);
-			return;
-		}
-		SqlStmt_Free(stmt);
+		log_sql_insert(log_config.log_npc, "`npc_date`, `char_name`, `map`, `mes`", "'%s', '%s', '%s'",
+			log_escape(nd->name, strnlen(nd->name, NAME_LENGTH)).c_str(), map_mapid2mapname(nd->bl.m), log_escape(message, safestrnlen(message, 255)).c_str());
 	}
 	else
 	{
@@ -424,18 +649,9 @@ void log_npc(struct map_session_data* sd, const char* message)
 
 	if( log_config.sql_logs )
 	{
-		SqlStmt* stmt;
-		stmt = SqlStmt_Malloc(logmysql_handle);
-		if( SQL_SUCCESS != SqlStmt_Prepare(stmt, LOG_QUERY " INTO `%s` (`npc_date`, `account_id`, `char_id`, `char_name`, `map`, `mes`) VALUES (NOW(), '%d', '%d', ?, '%s', ?)", log_config.log_npc, sd->status.account_id, sd->status.char_id, mapindex_id2name(sd->mapindex) )
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 0, SQLDT_STRING, sd->status.name, strnlen(sd->status.name, NAME_LENGTH))
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 1, SQLDT_STRING, (char*)message, safestrnlen(message, 255))
-		||  SQL_SUCCESS != SqlStmt_Execute(stmt) )
-		{
-			SqlStmt_ShowDebug(stmt);
-			SqlStmt_Free(stmt);
-			return;
-		}
-		SqlStmt_Free(stmt);
+		log_sql_insert(log_config.log_npc, "`npc_date`, `account_id`, `char_id`, `char_name`, `map`, `mes`", "'%d', '%d', '%s', '%s', '%s'",
+			sd->status.account_id, sd->status.char_id, log_escape(sd->status.name, strnlen(sd->status.name, NAME_LENGTH)).c_str(), mapindex_id2name(sd->mapindex),
+			log_escape(message, safestrnlen(message, 255)).c_str());
 	}
 	else
 	{
@@ -471,19 +687,9 @@ void log_chat(e_log_chat_type type, int type_id, int src_charid, int src_accid,
 	}
 
 	if( log_config.sql_logs ) {
-		SqlStmt* stmt;
-
-		stmt = SqlStmt_Malloc(logmysql_handle);
-		if( SQL_SUCCESS != SqlStmt_Prepare(stmt, LOG_QUERY " INTO `%s` (`time`, `type`, `type_id`, `src_charid`, `src_accountid`, `src_map`, `src_map_x`, `src_map_y`, `dst_charname`, `message`) VALUES (NOW(), '%c', '%d', '%d', '%d', '%s', '%d', '%d', ?, ?)", log_config.log_chat, log_chattype2char(type), type_id, src_charid, src_accid, mapname, x, y)
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 0, SQLDT_STRING, (char*)dst_charname, safestrnlen(dst_charname, NAME_LENGTH))
-		||  SQL_SUCCESS != SqlStmt_BindParam(stmt, 1, SQLDT_STRING, (char*)message, safestrnlen(message, CHAT_SIZE_MAX))
-		||  SQL_SUCCESS != SqlStmt_Execute(stmt) )
-		{
-			SqlStmt_ShowDebug(stmt);
-			SqlStmt_Free(stmt);
-			return;
-		}
-		SqlStmt_Free(stmt);
+		log_sql_insert(log_config.log_chat, "`time`, `type`, `type_id`, `src_charid`, `src_accountid`, `src_map`, `src_map_x`, `src_map_y`, `dst_charname`, `message`", "'%c', '%d', '%d', '%d', '%s', '%d', '%d', '%s', '%s'",
+			log_chattype2char(type), type_id, src_charid, src_accid, mapname, x, y,
+			log_escape(dst_charname, safestrnlen(dst_charname, NAME_LENGTH)).c_str(), log_escape(message, safestrnlen(message, CHAT_SIZE_MAX)).c_str());
 	}
 	else
 	{
@@ -508,12 +714,8 @@ void log_cash( struct map_session_data* sd, e_log_pick_type type, e_log_cash_typ
 		return;
 
 	if( log_config.sql_logs ){
-		if( SQL_ERROR == Sql_Query( logmysql_handle, LOG_QUERY " INTO `%s` ( `time`, `char_id`, `type`, `cash_type`, `amount`, `map` ) VALUES ( NOW(), '%d', '%c', '%c', '%d', '%s' )",
-			log_config.log_cash, sd->status.char_id, log_picktype2char( type ), log_cashtype2char( cash_type ), amount, mapindex_id2name( sd->mapindex ) ) )
-		{
-			Sql_ShowDebug( logmysql_handle );
-			return;
-		}
+		log_sql_insert( log_config.log_cash, "`time`, `char_id`, `type`, `cash_type`, `amount`, `map`", "'%d', '%c', '%c', '%d', '%s'",
+			sd->status.char_id, log_picktype2char( type ), log_cashtype2char( cash_type ), amount, mapindex_id2name( sd->mapindex ) );
 	}else{
 		char timestring[255];
 		time_t curtime;
@@ -561,12 +763,8 @@ void log_feeding(struct map_session_data *sd, e_log_feeding_type type, t_itemid
 	}
 
 	if (log_config.sql_logs) {
-		if (SQL_ERROR == Sql_Query(logmysql_handle, LOG_QUERY " INTO `%s` (`time`, `char_id`, `target_id`, `target_class`, `type`, `intimacy`, `item_id`, `map`, `x`, `y`) VALUES ( NOW(), '%" PRIu32 "', '%" PRIu32 "', '%hu', '%c', '%" PRIu32 "', '%u', '%s', '%hu', '%hu' )",
-			log_config.log_feeding, sd->status.char_id, target_id, target_class, log_feedingtype2char(type), intimacy, nameid, mapindex_id2name(sd->mapindex), sd->bl.x, sd->bl.y))
-		{
-			Sql_ShowDebug(logmysql_handle);
-			return;
-		}
+		log_sql_insert(log_config.log_feeding, "`time`, `char_id`, `target_id`, `target_class`, `type`, `intimacy`, `item_id`, `map`, `x`, `y`", "'%" PRIu32 "', '%" PRIu32 "', '%hu', '%c', '%" PRIu32 "', '%u', '%s', '%hu', '%hu'",
+			sd->status.char_id, target_id, target_class, log_feedingtype2char(type), intimacy, nameid, mapindex_id2name(sd->mapindex), sd->bl.x, sd->bl.y);
 	} else {
 		char timestring[255];
 		time_t curtime;
@@ -591,6 +789,12 @@ void log_set_defaults(void)
 	log_config.price_items_log  = 1000; // 1000z
 	log_config.amount_items_log = 100;
 
+	log_config.async_queue_size = 8192;
+	log_config.async_batch_size = 100;
+	log_config.async_batch_interval = 1000;
+	log_config.async_overflow = 1;
+	safestrncpy(log_config.async_spill_file, "log/log_spill.sql", sizeof(log_config.async_spill_file));
+
 	safestrncpy(log_timestamp_format, "%m/%d/%Y %H:%M:%S", sizeof(log_timestamp_format));
 }
 
@@ -669,6 +873,18 @@ int log_config_read(const char* cfgName)
 				safestrncpy( log_config.log_cash, w2, sizeof( log_config.log_cash ) );
 			else if( strcmpi( w1, "log_feeding_db" ) == 0 )
 				safestrncpy( log_config.log_feeding, w2, sizeof( log_config.log_feeding ) );
+			else if( strcmpi(w1, "log_async") == 0 )
+				log_config.async = config_switch(w2) > 0;
+			else if( strcmpi(w1, "log_async_queue_size") == 0 )
+				log_config.async_queue_size = cap_value(atoi(w2), 1, 1000000);
+			else if( strcmpi(w1, "log_async_batch_size") == 0 )
+				log_config.async_batch_size = cap_value(atoi(w2), 1, 1000);
+			else if( strcmpi(w1, "log_async_batch_interval") == 0 )
+				log_config.async_batch_interval = cap_value(atoi(w2), 10, 60000);
+			else if( strcmpi(w1, "log_async_overflow") == 0 )
+				log_config.async_overflow = atoi(w2) ? 1 : 0;
+			else if( strcmpi(w1, "log_async_spill_file") == 0 )
+				safestrncpy(log_config.async_spill_file, w2, sizeof(log_config.async_spill_file));
 			// log file timestamp format
 			else if( strcmpi( w1, "log_timestamp_format" ) == 0 )
 				safestrncpy(log_timestamp_format, w2, sizeof(log_timestamp_format));
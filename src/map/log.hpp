@@ -7,6 +7,7 @@
 #include "../common/cbasetypes.hpp"
 #include "../common/mmo.hpp"
 
+struct Sql;
 struct block_list;
 struct map_session_data;
 struct mob_data;
@@ -86,6 +87,19 @@ void log_mvpdrop(struct map_session_data* sd, int monster_id, t_itemid nameid, t
 
 int log_config_read(const char* cfgName);
 
+/// Asynchronous SQL log writer
+struct s_log_writer_stats {
+	size_t depth, max_depth; // rows waiting in the queue
+	uint64 queued, written, dropped, spilled, failed; // rows
+	uint64 batches; // INSERT queries
+	uint64 last_flush, max_flush, total_flush; // duration of the INSERT queries, in microseconds
+};
+
+void log_writer_init(struct Sql* handle);
+void log_writer_final(void);
+bool log_writer_active(void);
+void log_writer_get_stats(struct s_log_writer_stats* stats);
+
 extern struct Log_Config
 {
 	e_log_pick_type enable_logs;
@@ -98,6 +112,9 @@ extern struct Log_Config
 	unsigned feeding : 2;
 	char log_branch[64], log_pick[64], log_zeny[64], log_mvpdrop[64], log_gm[64], log_npc[64], log_chat[64], log_cash[64];
 	char log_feeding[64];
+	bool async; // write SQL logs from a separate thread
+	int async_queue_size, async_batch_size, async_batch_interval, async_overflow;
+	char async_spill_file[256];
 } log_config;
 
 #endif /* LOG_HPP */
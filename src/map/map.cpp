@@ -23,6 +23,7 @@
 
 #include "achievement.hpp"
 #include "atcommand.hpp"
+#include "autoattack.hpp"
 #include "battle.hpp"
 #include "battleground.hpp"
 #include "cashshop.hpp"
@@ -112,7 +113,6 @@ static DBMap* map_msg_db=NULL;
 
 static int map_users=0;
 
-#define BLOCK_SIZE 8
 #define block_free_max 1048576
 struct block_list *block_free[block_free_max];
 static int block_free_count = 0, block_free_lock = 0;
@@ -121,6 +121,16 @@ static int block_free_count = 0, block_free_lock = 0;
 static struct block_list *bl_list[BL_LIST_MAX];
 static int bl_list_count = 0;
 
+/// Players within AREA_SIZE of each block on a map, kept up to date by map_addblock,
+/// map_delblock and map_moveblock so that area broadcasts don't have to scan the grid.
+static std::unordered_map<struct block_list*, std::vector<struct map_session_data*>> area_interest;
+/// AREA_SIZE the interest sets were built with, they are rebuilt when it changes.
+static int area_interest_size = -1;
+
+/// Block types that broadcast to their area and get an interest set.
+/// Others (items, skill units) use a grid scan instead.
+#define BL_AREA_INTEREST (BL_PC|BL_MOB|BL_PET|BL_HOM|BL_MER|BL_NPC|BL_ELEM)
+
 #ifndef MAP_MAX_MSG
 	#define MAP_MAX_MSG 1550
 #endif
@@ -132,6 +142,8 @@ int map_port=0;
 
 int autosave_interval = DEFAULT_AUTOSAVE_INTERVAL;
 int minsave_interval = 100;
+int save_full_interval = 10;
+int timer_profile_log_interval = 0; // interval of the timer profile log line, 0 = disabled
 int16 save_settings = CHARSAVE_ALL;
 bool agit_flag = false;
 bool agit2_flag = false;
@@ -264,6 +276,13 @@ int map_freeblock_unlock (void)
 	return block_free_lock;
 }
 
+// Logs the most time consuming timer functions.
+// Called each timer_profile_log_time seconds
+TIMER_FUNC(map_timer_profile_timer){
+	timer_profile_report(5);
+	return 0;
+}
+
 // Timer function to check if there some remaining lock and remove them if so.
 // Called each 1s
 TIMER_FUNC(map_freeblock_timer){
@@ -310,6 +329,197 @@ static void map_delblcell(struct block_list *bl)
 }
 #endif
 
+/*==========================================
+ * Area interest sets
+ *------------------------------------------*/
+
+/// Removes a player from an interest set.
+static void map_interest_remove(std::vector<struct map_session_data*>& list, struct map_session_data* sd)
+{
+	auto it = std::find(list.begin(), list.end(), sd);
+
+	if (it != list.end()) {
+		*it = list.back();
+		list.pop_back();
+	}
+}
+
+/**
+ * Calls func for each block of the given arrays of a map within an area.
+ * @param pc_only: only go through the non-mob blocks (which hold the players)
+ */
+template <typename F>
+static void map_interest_foreach(struct map_data* mapdata, int x0, int y0, int x1, int y1, bool pc_only, F func)
+{
+	x0 = max(x0, 0);
+	y0 = max(y0, 0);
+	x1 = min(x1, mapdata->xs - 1);
+	y1 = min(y1, mapdata->ys - 1);
+
+	for (int by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++) {
+		for (int bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++) {
+			for (struct block_list* bl = mapdata->block[bx + by * mapdata->bxs]; bl != nullptr; bl = bl->next)
+				if (!pc_only || bl->type == BL_PC)
+					func(bl);
+			if (pc_only)
+				continue;
+			for (struct block_list* bl = mapdata->block_mob[bx + by * mapdata->bxs]; bl != nullptr; bl = bl->next)
+				func(bl);
+		}
+	}
+}
+
+/// Rebuilds the interest sets of all blocks on all maps.
+static void map_interest_rebuild(void)
+{
+	area_interest.clear();
+	area_interest_size = AREA_SIZE;
+
+	for (int i = 0; i < map_num; i++) {
+		struct map_data* mapdata = map_getmapdata(i);
+
+		if (mapdata->cell == nullptr || mapdata->block == nullptr || mapdata->block_mob == nullptr)
+			continue;
+
+		map_interest_foreach(mapdata, 0, 0, mapdata->xs - 1, mapdata->ys - 1, false, [&](struct block_list* bl) {
+			if (!(bl->type&BL_AREA_INTEREST))
+				return;
+
+			std::vector<struct map_session_data*>& own = area_interest[bl];
+
+			map_interest_foreach(mapdata, bl->x - AREA_SIZE, bl->y - AREA_SIZE, bl->x + AREA_SIZE, bl->y + AREA_SIZE, true, [&](struct block_list* b) {
+				if (b->x >= bl->x - AREA_SIZE && b->x <= bl->x + AREA_SIZE && b->y >= bl->y - AREA_SIZE && b->y <= bl->y + AREA_SIZE)
+					own.push_back((struct map_session_data*)b);
+			});
+		});
+	}
+}
+
+/// Rebuilds the interest sets if AREA_SIZE changed since they were built (@reloadbattleconf, setbattleflag).
+/// Returns true if they were rebuilt.
+static bool map_interest_check(void)
+{
+	if (area_interest_size == AREA_SIZE)
+		return false;
+
+	map_interest_rebuild();
+	return true;
+}
+
+/// Builds the interest set of a block that was just added to the map, and adds a player to the sets of the blocks around.
+static void map_interest_add(struct block_list* bl)
+{
+	if (!(bl->type&BL_AREA_INTEREST))
+		return;
+	if (map_interest_check()) // the block is already linked, so it was included
+		return;
+
+	struct map_data* mapdata = map_getmapdata(bl->m);
+	std::vector<struct map_session_data*>& own = area_interest[bl];
+	bool is_pc = (bl->type == BL_PC);
+
+	own.clear();
+	map_interest_foreach(mapdata, bl->x - AREA_SIZE, bl->y - AREA_SIZE, bl->x + AREA_SIZE, bl->y + AREA_SIZE, !is_pc, [&](struct block_list* b) {
+		if (b->x < bl->x - AREA_SIZE || b->x > bl->x + AREA_SIZE || b->y < bl->y - AREA_SIZE || b->y > bl->y + AREA_SIZE)
+			return;
+		if (b->type == BL_PC)
+			own.push_back((struct map_session_data*)b);
+		if (is_pc && b != bl && (b->type&BL_AREA_INTEREST))
+			area_interest[b].push_back((struct map_session_data*)bl);
+	});
+}
+
+/// Drops the interest set of a block leaving the map, and removes a player from the sets of the blocks around.
+static void map_interest_del(struct block_list* bl)
+{
+	if (!(bl->type&BL_AREA_INTEREST))
+		return;
+
+	map_interest_check();
+
+	if (bl->type == BL_PC) {
+		map_interest_foreach(map_getmapdata(bl->m), bl->x - AREA_SIZE, bl->y - AREA_SIZE, bl->x + AREA_SIZE, bl->y + AREA_SIZE, false, [bl](struct block_list* b) {
+			if (b == bl || b->x < bl->x - AREA_SIZE || b->x > bl->x + AREA_SIZE || b->y < bl->y - AREA_SIZE || b->y > bl->y + AREA_SIZE)
+				return;
+
+			auto it = area_interest.find(b);
+
+			if (it != area_interest.end())
+				map_interest_remove(it->second, (struct map_session_data*)bl);
+		});
+	}
+
+	area_interest.erase(bl);
+}
+
+/// Updates the interest sets after a block moved from (x0,y0) inside the same map block.
+/// Only the blocks entering or leaving its area are touched.
+static void map_interest_move(struct block_list* bl, int x0, int y0)
+{
+	if (!(bl->type&BL_AREA_INTEREST))
+		return;
+	if (map_interest_check()) // the block is already at its new position
+		return;
+
+	auto own_it = area_interest.find(bl);
+	bool is_pc = (bl->type == BL_PC);
+
+	if (own_it == area_interest.end())
+		return;
+
+	std::vector<struct map_session_data*>& own = own_it->second;
+
+	map_interest_foreach(map_getmapdata(bl->m), min(x0, (int)bl->x) - AREA_SIZE, min(y0, (int)bl->y) - AREA_SIZE,
+		max(x0, (int)bl->x) + AREA_SIZE, max(y0, (int)bl->y) + AREA_SIZE, !is_pc, [&](struct block_list* b) {
+		if (b == bl)
+			return;
+
+		bool was_in = (abs(b->x - x0) <= AREA_SIZE && abs(b->y - y0) <= AREA_SIZE);
+		bool is_in = (abs(b->x - bl->x) <= AREA_SIZE && abs(b->y - bl->y) <= AREA_SIZE);
+
+		if (was_in == is_in)
+			return;
+
+		if (b->type == BL_PC) {
+			if (is_in)
+				own.push_back((struct map_session_data*)b);
+			else
+				map_interest_remove(own, (struct map_session_data*)b);
+		}
+
+		if (is_pc && (b->type&BL_AREA_INTEREST)) {
+			if (is_in)
+				area_interest[b].push_back((struct map_session_data*)bl);
+			else {
+				auto it = area_interest.find(b);
+
+				if (it != area_interest.end())
+					map_interest_remove(it->second, (struct map_session_data*)bl);
+			}
+		}
+	});
+}
+
+/**
+ * Returns the players within AREA_SIZE of a block, in no particular order.
+ * Returns nullptr if the block is not on a map, is a temporary block or is not a BL_AREA_INTEREST type,
+ * use a grid scan then.
+ */
+const std::vector<struct map_session_data*>* map_area_interest(struct block_list* bl)
+{
+	if (bl->prev == nullptr || !(bl->type&BL_AREA_INTEREST))
+		return nullptr;
+
+	map_interest_check();
+
+	auto it = area_interest.find(bl);
+
+	if (it == area_interest.end())
+		return nullptr;
+
+	return &it->second;
+}
+
 /*==========================================
  * Adds a block to the map.
  * Returns 0 on success, 1 on failure (illegal coordinates).
@@ -348,6 +558,7 @@ int map_addblock(struct block_list* bl)
 	}
 
 	pos = x/BLOCK_SIZE+(y/BLOCK_SIZE)*mapdata->bxs;
+	mapdata->block_gen++;
 
 	if (bl->type == BL_MOB) {
 		bl->next = mapdata->block_mob[pos];
@@ -365,6 +576,8 @@ int map_addblock(struct block_list* bl)
 	map_addblcell(bl);
 #endif
 
+	map_interest_add(bl);
+
 	return 0;
 }
 
@@ -389,9 +602,12 @@ int map_delblock(struct block_list* bl)
 	map_delblcell(bl);
 #endif
 
+	map_interest_del(bl);
+
 	struct map_data *mapdata = map_getmapdata(bl->m);
 
 	pos = bl->x/BLOCK_SIZE+(bl->y/BLOCK_SIZE)*mapdata->bxs;
+	mapdata->block_gen++;
 
 	if (bl->next)
 		bl->next->prev = bl->prev;
@@ -463,6 +679,7 @@ int map_moveblock(struct block_list *bl, int x1, int y1, t_tick tick)
 #endif
 	bl->x = x1;
 	bl->y = y1;
+	map_getmapdata(bl->m)->block_gen++;
 	if (moveblock) {
 		if(map_addblock(bl))
 			return 1;
@@ -470,6 +687,8 @@ int map_moveblock(struct block_list *bl, int x1, int y1, t_tick tick)
 #ifdef CELL_NOSTACK
 	else map_addblcell(bl);
 #endif
+	if (!moveblock) // map_delblock and map_addblock already rebuilt the sets otherwise
+		map_interest_move(bl, x0, y0);
 
 	if (bl->type&BL_CHAR) {
 
@@ -2076,6 +2295,7 @@ int map_quit(struct map_session_data *sd) {
 		clan_member_left(sd);
 
 	pc_itemcd_do(sd,false);
+	autoattack_save(sd);
 
 	npc_script_event(sd, NPCE_LOGOUT);
 
@@ -3290,6 +3510,7 @@ void map_setcell(int16 m, int16 x, int16 y, cell_t cell, bool flag)
 		return;
 
 	j = x + y*mapdata->xs;
+	mapdata->block_gen++;
 
 	switch( cell ) {
 		case CELL_WALKABLE:      mapdata->cell[j].walkable = flag;      break;
@@ -3321,6 +3542,7 @@ void map_setgatcell(int16 m, int16 x, int16 y, int gat)
 	j = x + y*mapdata->xs;
 
 	cell = map_gat2cell(gat);
+	mapdata->block_gen++;
 	mapdata->cell[j].walkable = cell.walkable;
 	mapdata->cell[j].shootable = cell.shootable;
 	mapdata->cell[j].water = cell.water;
@@ -4068,7 +4290,13 @@ int map_config_read(const char *cfgName)
 			minsave_interval= atoi(w2);
 			if (minsave_interval < 1)
 				minsave_interval = 1;
-		} else if (strcmpi(w1, "save_settings") == 0)
+		} else if (strcmpi(w1, "save_full_interval") == 0) {
+			save_full_interval = max(atoi(w2), 0);
+		} else if (strcmpi(w1, "timer_profile") == 0)
+			timer_profile_enable(config_switch(w2) != 0);
+		else if (strcmpi(w1, "timer_profile_log_time") == 0)
+			timer_profile_log_interval = max(atoi(w2), 0) * 1000; //Pass from sec to ms
+		else if (strcmpi(w1, "save_settings") == 0)
 			save_settings = cap_value(atoi(w2),CHARSAVE_NONE,CHARSAVE_ALL);
 		else if (strcmpi(w1, "motd_txt") == 0)
 			safestrncpy(motd_txt, w2, sizeof(motd_txt));
@@ -4301,6 +4529,27 @@ int map_sql_init(void)
 	return 0;
 }
 
+/// Opens a new connection to the map database, exits on failure
+Sql* map_sql_connect(void)
+{
+	Sql* handle = Sql_Malloc();
+
+	if( SQL_ERROR == Sql_Connect(handle, map_server_id, map_server_pw, map_server_ip, map_server_port, map_server_db) )
+	{
+		ShowError("Couldn't connect with uname='%s',passwd='%s',host='%s',port='%d',database='%s'\n",
+			map_server_id, map_server_pw, map_server_ip, map_server_port, map_server_db);
+		Sql_ShowDebug(handle);
+		Sql_Free(handle);
+		exit(EXIT_FAILURE);
+	}
+
+	if( strlen(default_codepage) > 0 )
+		if ( SQL_ERROR == Sql_SetEncoding(handle, default_codepage) )
+			Sql_ShowDebug(handle);
+
+	return handle;
+}
+
 int map_sql_close(void)
 {
 	ShowStatus("Close Map DB Connection....\n");
@@ -4312,6 +4561,7 @@ int map_sql_close(void)
 	if (log_config.sql_logs)
 	{
 		ShowStatus("Close Log DB Connection....\n");
+		log_writer_final();
 		Sql_Free(logmysql_handle);
 		logmysql_handle = NULL;
 	}
@@ -4319,24 +4569,36 @@ int map_sql_close(void)
 	return 0;
 }
 
-int log_sql_init(void)
+/// Opens a new connection to the log database, exits on failure
+static Sql* log_sql_connect(void)
 {
-	// log db connection
-	logmysql_handle = Sql_Malloc();
+	Sql* handle = Sql_Malloc();
 
 	ShowInfo("" CL_WHITE "[SQL]" CL_RESET ": Connecting to the Log Database " CL_WHITE "%s" CL_RESET " At " CL_WHITE "%s" CL_RESET "...\n",log_db_db,log_db_ip);
-	if ( SQL_ERROR == Sql_Connect(logmysql_handle, log_db_id, log_db_pw, log_db_ip, log_db_port, log_db_db) ){
+	if ( SQL_ERROR == Sql_Connect(handle, log_db_id, log_db_pw, log_db_ip, log_db_port, log_db_db) ){
 		ShowError("Couldn't connect with uname='%s',passwd='%s',host='%s',port='%d',database='%s'\n",
 			log_db_id, log_db_pw, log_db_ip, log_db_port, log_db_db);
-		Sql_ShowDebug(logmysql_handle);
-		Sql_Free(logmysql_handle);
+		Sql_ShowDebug(handle);
+		Sql_Free(handle);
 		exit(EXIT_FAILURE);
 	}
 	ShowStatus("" CL_WHITE "[SQL]" CL_RESET ": Successfully '" CL_GREEN "connected" CL_RESET "' to Database '" CL_WHITE "%s" CL_RESET "'.\n", log_db_db);
 
 	if( strlen(default_codepage) > 0 )
-		if ( SQL_ERROR == Sql_SetEncoding(logmysql_handle, default_codepage) )
-			Sql_ShowDebug(logmysql_handle);
+		if ( SQL_ERROR == Sql_SetEncoding(handle, default_codepage) )
+			Sql_ShowDebug(handle);
+
+	return handle;
+}
+
+int log_sql_init(void)
+{
+	// log db connection
+	logmysql_handle = log_sql_connect();
+
+	// second connection owned by the log writer thread
+	if( log_config.async )
+		log_writer_init(log_sql_connect());
 
 	return 0;
 }
@@ -4935,8 +5197,12 @@ void do_final(void){
 	do_final_channel(); //should be called after final guild
 	do_final_vending();
 	do_final_buyingstore();
+	do_final_autoattack();
 	do_final_path();
 
+	area_interest.clear();
+	area_interest_size = -1;
+
 	map_db->destroy(map_db, map_db_final);
 
 	for (int i = 0; i < map_num; i++) {
@@ -5014,6 +5280,8 @@ void display_helpscreen(bool do_exit)
 	ShowInfo("  -?, -h [--help]\t\tDisplays this help screen.\n");
 	ShowInfo("  -v [--version]\t\tDisplays the server's version.\n");
 	ShowInfo("  --run-once\t\t\tCloses server after loading (testing).\n");
+	ShowInfo("  --timer-wheel\t\t\tUses the timing wheel instead of the timer heap.\n");
+	ShowInfo("  --timer-trace <file>\t\tRecords timer operations for the timerbench tool.\n");
 	ShowInfo("  --map-config <file>\t\tAlternative map-server configuration.\n");
 	ShowInfo("  --battle-config <file>\tAlternative battle configuration.\n");
 	ShowInfo("  --atcommand-config <file>\tAlternative atcommand configuration.\n");
@@ -5230,7 +5498,10 @@ int do_init(int argc, char *argv[])
 	add_timer_func_list(map_freeblock_timer, "map_freeblock_timer");
 	add_timer_func_list(map_clearflooritem_timer, "map_clearflooritem_timer");
 	add_timer_func_list(map_removemobs_timer, "map_removemobs_timer");
+	add_timer_func_list(map_timer_profile_timer, "map_timer_profile_timer");
 	add_timer_interval(gettick()+1000, map_freeblock_timer, 0, 0, 60*1000);
+	if (timer_profile_log_interval > 0)
+		add_timer_interval(gettick()+timer_profile_log_interval, map_timer_profile_timer, 0, 0, timer_profile_log_interval);
 	
 	map_do_init_msg();
 	do_init_path();
@@ -5263,6 +5534,7 @@ int do_init(int argc, char *argv[])
 	do_init_duel();
 	do_init_vending();
 	do_init_buyingstore();
+	do_init_autoattack();
 
 	npc_event_do_oninit();	// Init npcs (OnInit)
 
@@ -43,6 +43,7 @@ void map_msg_reload(void);
 
 #define MAX_NPC_PER_MAP 512
 #define AREA_SIZE battle_config.area_size
+#define BLOCK_SIZE 8
 #define DAMAGELOG_SIZE 30
 #define LOOTITEM_SIZE 10
 #define MAX_MOBSKILL 50		//Max 128, see mob skill_idx type if need this higher
@@ -767,6 +768,7 @@ struct map_data {
 	int16 m;
 	int16 xs,ys; // map dimensions (in cells)
 	int16 bxs,bys; // map dimensions (in blocks)
+	uint32 block_gen; // increased each time a block is added, removed or moved, or a cell changes
 	int16 bgscore_lion, bgscore_eagle; // Battleground ScoreBoard
 	int npc_num; // number total of npc on the map
 	int npc_num_area; // number of npc with a trigger area on the map
@@ -821,6 +823,7 @@ extern int map_num;
 
 extern int autosave_interval;
 extern int minsave_interval;
+extern int save_full_interval;
 extern int16 save_settings;
 extern int night_flag; // 0=day, 1=night [Yor]
 extern int enable_spy; //Determines if @spy commands are active.
@@ -1045,6 +1048,7 @@ int map_freeblock_unlock(void);
 int map_addblock(struct block_list* bl);
 int map_delblock(struct block_list* bl);
 int map_moveblock(struct block_list *, int, int, t_tick);
+const std::vector<struct map_session_data*>* map_area_interest(struct block_list* bl);
 int map_foreachinrange(int (*func)(struct block_list*,va_list), struct block_list* center, int16 range, int type, ...);
 int map_foreachinallrange(int (*func)(struct block_list*,va_list), struct block_list* center, int16 range, int type, ...);
 int map_foreachinshootrange(int (*func)(struct block_list*,va_list), struct block_list* center, int16 range, int type, ...);
@@ -1215,6 +1219,8 @@ extern Sql* mmysql_handle;
 extern Sql* qsmysql_handle;
 extern Sql* logmysql_handle;
 
+Sql* map_sql_connect(void);
+
 extern char buyingstores_table[32];
 extern char buyingstore_items_table[32];
 extern char item_table[32];
@@ -3,7 +3,17 @@
 
 #include "mapreg.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <stdlib.h>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
 
 #include "../common/cbasetypes.hpp"
 #include "../common/db.hpp"
@@ -22,10 +32,134 @@ static struct eri *mapreg_ers;
 bool skip_insert = false;
 
 static char mapreg_table[32] = "mapreg";
-static bool mapreg_dirty = false; // Whether there are modified regs to be saved
+static int mapreg_batch_size = 500; // rows per INSERT or DELETE
+static bool mapreg_async_save = false; // whether the saves are run by the writer thread
+static std::unordered_set<int64> mapreg_dirty; // uids to be saved, or deleted when the variable is gone
 struct reg_db regs;
 
 #define MAPREG_AUTOSAVE_INTERVAL (300*1000)
+// maximum length of a save query, to stay below max_allowed_packet
+#define MAPREG_QUERY_MAX (1024*1024)
+// rows read per query when loading
+#define MAPREG_LOAD_CHUNK 10000
+
+
+/// Mapreg writer
+/// With mapreg_async_save the queries of a save are run by a thread with its
+/// own connection, in the order they were queued. They are built on the main
+/// thread, so the thread never touches the variables.
+
+static Sql* mapreg_writer_handle = nullptr;
+static std::thread mapreg_writer_thread;
+static bool mapreg_writer_running = false;
+static bool mapreg_writer_busy = false; // a query was taken from the queue and is running
+static std::mutex mapreg_writer_mutex;
+static std::condition_variable mapreg_writer_cv; // wakes the writer
+static std::condition_variable mapreg_writer_idle_cv; // wakes the main thread waiting for the queue to drain
+static std::deque<std::string> mapreg_writer_queue;
+static std::atomic<uint32> mapreg_writer_failed(0);
+
+static void mapreg_writer_run(void)
+{
+	auto last_query = std::chrono::steady_clock::now();
+
+	Sql_ThreadInit();
+
+	while( true ) {
+		std::string query;
+
+		{
+			std::unique_lock<std::mutex> lock(mapreg_writer_mutex);
+
+			mapreg_writer_cv.wait_for(lock, std::chrono::minutes(1), [] {
+				return !mapreg_writer_running || !mapreg_writer_queue.empty();
+			});
+			if( !mapreg_writer_queue.empty() ) {
+				query = std::move(mapreg_writer_queue.front());
+				mapreg_writer_queue.pop_front();
+				mapreg_writer_busy = true;
+			} else if( !mapreg_writer_running )
+				break; // everything queued before the stop was run
+		}
+
+		auto now = std::chrono::steady_clock::now();
+
+		if( query.empty() ) {
+			if( now - last_query > std::chrono::minutes(5) ) {// keep the connection alive
+				Sql_Ping(mapreg_writer_handle);
+				last_query = now;
+			}
+			continue;
+		}
+
+		if( SQL_SUCCESS != Sql_ExecuteStr(mapreg_writer_handle, query.data(), query.size()) )
+			mapreg_writer_failed++;
+		last_query = now;
+
+		{
+			std::lock_guard<std::mutex> lock(mapreg_writer_mutex);
+			mapreg_writer_busy = false;
+		}
+		mapreg_writer_idle_cv.notify_all();
+	}
+
+	Sql_ThreadEnd();
+}
+
+/// Starts the mapreg writer with a connection of its own
+static void mapreg_writer_init(void)
+{
+	mapreg_writer_handle = map_sql_connect();
+	Sql_StopKeepalive(mapreg_writer_handle); // pinged by the writer
+
+	mapreg_writer_running = true;
+	mapreg_writer_thread = std::thread(mapreg_writer_run);
+}
+
+/// Stops the mapreg writer after it ran the queued queries
+static void mapreg_writer_final(void)
+{
+	if( mapreg_writer_handle == nullptr )
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mapreg_writer_mutex);
+		mapreg_writer_running = false;
+	}
+	mapreg_writer_cv.notify_one();
+	mapreg_writer_thread.join();
+
+	Sql_Free(mapreg_writer_handle);
+	mapreg_writer_handle = nullptr;
+}
+
+/// Waits until the mapreg writer ran the queued queries
+static void mapreg_writer_wait(void)
+{
+	if( mapreg_writer_handle == nullptr )
+		return;
+
+	std::unique_lock<std::mutex> lock(mapreg_writer_mutex);
+
+	mapreg_writer_idle_cv.wait(lock, [] {
+		return mapreg_writer_queue.empty() && !mapreg_writer_busy;
+	});
+}
+
+/**
+ * Marks a permanent variable to be written with the next save.
+ * The variable is saved with its value at that time, or deleted if it's gone by then.
+ *
+ * @param uid: variable's unique identifier
+ */
+static void mapreg_set_dirty(int64 uid)
+{
+	struct mapreg_save *m = (struct mapreg_save *)i64db_get(regs.vars, uid);
+
+	if (m != NULL)
+		m->save = true;
+	mapreg_dirty.insert(uid);
+}
 
 
 /**
@@ -69,10 +203,8 @@ bool mapreg_setreg(int64 uid, int64 val)
 	if (val != 0) {
 		if ((m = static_cast<mapreg_save *>(i64db_get(regs.vars, uid)))) {
 			m->u.i = val;
-			if (name[1] != '@') {
-				m->save = true;
-				mapreg_dirty = true;
-			}
+			if (name[1] != '@')
+				mapreg_set_dirty(uid);
 		} else {
 			if (i)
 				script_array_update(&regs, uid, false);
@@ -84,13 +216,9 @@ bool mapreg_setreg(int64 uid, int64 val)
 			m->save = false;
 			m->is_string = false;
 
-			if (name[1] != '@' && !skip_insert) {// write new variable to database
-				char esc_name[32 * 2 + 1];
-				Sql_EscapeStringLen(mmysql_handle, esc_name, name, strnlen(name, 32));
-				if (SQL_ERROR == Sql_Query(mmysql_handle, "INSERT INTO `%s`(`varname`,`index`,`value`) VALUES ('%s','%" PRIu32 "','%" PRId64 "')", mapreg_table, esc_name, i, val))
-					Sql_ShowDebug(mmysql_handle);
-			}
 			i64db_put(regs.vars, uid, m);
+			if (name[1] != '@' && !skip_insert) // write new variable to database
+				mapreg_set_dirty(uid);
 		}
 	} else { // val == 0
 		if (i)
@@ -100,12 +228,8 @@ bool mapreg_setreg(int64 uid, int64 val)
 		}
 		i64db_remove(regs.vars, uid);
 
-		if (name[1] != '@') {// Remove from database because it is unused.
-			char esc_name[32 * 2 + 1];
-			Sql_EscapeStringLen(mmysql_handle, esc_name, name, strnlen(name, 32));
-			if (SQL_ERROR == Sql_Query(mmysql_handle, "DELETE FROM `%s` WHERE `varname`='%s' AND `index`='%" PRIu32 "'", mapreg_table, esc_name, i))
-				Sql_ShowDebug(mmysql_handle);
-		}
+		if (name[1] != '@') // Remove from database because it is unused.
+			mapreg_set_dirty(uid);
 	}
 
 	return true;
@@ -128,27 +252,21 @@ bool mapreg_setregstr(int64 uid, const char* str)
 	if (str == NULL || *str == 0) {
 		if (i)
 			script_array_update(&regs, uid, true);
-		if (name[1] != '@') {
-			char esc_name[32 * 2 + 1];
-			Sql_EscapeStringLen(mmysql_handle, esc_name, name, strnlen(name, 32));
-			if (SQL_ERROR == Sql_Query(mmysql_handle, "DELETE FROM `%s` WHERE `varname`='%s' AND `index`='%" PRIu32 "'", mapreg_table, esc_name, i))
-				Sql_ShowDebug(mmysql_handle);
-		}
 		if ((m = static_cast<mapreg_save *>(i64db_get(regs.vars, uid)))) {
 			if (m->u.str != NULL)
 				aFree(m->u.str);
 			ers_free(mapreg_ers, m);
 		}
 		i64db_remove(regs.vars, uid);
+		if (name[1] != '@') // Remove from database because it is unused.
+			mapreg_set_dirty(uid);
 	} else {
 		if ((m = static_cast<mapreg_save *>(i64db_get(regs.vars, uid)))) {
 			if (m->u.str != NULL)
 				aFree(m->u.str);
 			m->u.str = aStrdup(str);
-			if (name[1] != '@') {
-				mapreg_dirty = true;
-				m->save = true;
-			}
+			if (name[1] != '@')
+				mapreg_set_dirty(uid);
 		} else {
 			if (i)
 				script_array_update(&regs, uid, false);
@@ -160,15 +278,9 @@ bool mapreg_setregstr(int64 uid, const char* str)
 			m->save = false;
 			m->is_string = true;
 
-			if (name[1] != '@' && !skip_insert) { //put returned null, so we must insert.
-				char esc_name[32 * 2 + 1];
-				char esc_str[255 * 2 + 1];
-				Sql_EscapeStringLen(mmysql_handle, esc_name, name, strnlen(name, 32));
-				Sql_EscapeStringLen(mmysql_handle, esc_str, str, strnlen(str, 255));
-				if (SQL_ERROR == Sql_Query(mmysql_handle, "INSERT INTO `%s`(`varname`,`index`,`value`) VALUES ('%s','%" PRIu32 "','%s')", mapreg_table, esc_name, i, esc_str))
-					Sql_ShowDebug(mmysql_handle);
-			}
 			i64db_put(regs.vars, uid, m);
+			if (name[1] != '@' && !skip_insert) //put returned null, so we must insert.
+				mapreg_set_dirty(uid);
 		}
 	}
 
@@ -177,6 +289,8 @@ bool mapreg_setregstr(int64 uid, const char* str)
 
 /**
  * Loads permanent variables from database.
+ * The rows are read in chunks of MAPREG_LOAD_CHUNK in key order, so the
+ * result of a query never holds the whole table.
  */
 static void script_load_mapreg(void)
 {
@@ -191,10 +305,11 @@ static void script_load_mapreg(void)
 	uint32 index;
 	char value[255+1];
 	uint32 length;
+	char last_varname[32+1] = ""; // key of the last row read
+	uint32 last_index = 0;
+	uint64 rows;
 
-	if ( SQL_ERROR == SqlStmt_Prepare(stmt, "SELECT `varname`, `index`, `value` FROM `%s`", mapreg_table)
-	  || SQL_ERROR == SqlStmt_Execute(stmt)
-	  ) {
+	if ( SQL_ERROR == SqlStmt_Prepare(stmt, "SELECT `varname`, `index`, `value` FROM `%s` WHERE `varname` > ? OR (`varname` = ? AND `index` > ?) ORDER BY `varname`, `index` LIMIT %d", mapreg_table, MAPREG_LOAD_CHUNK) ) {
 		SqlStmt_ShowDebug(stmt);
 		SqlStmt_Free(stmt);
 		return;
@@ -202,62 +317,166 @@ static void script_load_mapreg(void)
 
 	skip_insert = true;
 
-	SqlStmt_BindColumn(stmt, 0, SQLDT_STRING, &varname[0], sizeof(varname), &length, NULL);
-	SqlStmt_BindColumn(stmt, 1, SQLDT_UINT32, &index, 0, NULL, NULL);
-	SqlStmt_BindColumn(stmt, 2, SQLDT_STRING, &value[0], sizeof(value), NULL, NULL);
+	do {
+		if ( SQL_ERROR == SqlStmt_BindParam(stmt, 0, SQLDT_STRING, last_varname, strlen(last_varname))
+		  || SQL_ERROR == SqlStmt_BindParam(stmt, 1, SQLDT_STRING, last_varname, strlen(last_varname))
+		  || SQL_ERROR == SqlStmt_BindParam(stmt, 2, SQLDT_UINT32, &last_index, 0)
+		  || SQL_ERROR == SqlStmt_Execute(stmt)
+		  ) {
+			SqlStmt_ShowDebug(stmt);
+			break;
+		}
 
-	while ( SQL_SUCCESS == SqlStmt_NextRow(stmt) ) {
-		int s = add_str(varname);
-		int64 uid = reference_uid(s, index);
+		SqlStmt_BindColumn(stmt, 0, SQLDT_STRING, &varname[0], sizeof(varname), &length, NULL);
+		SqlStmt_BindColumn(stmt, 1, SQLDT_UINT32, &index, 0, NULL, NULL);
+		SqlStmt_BindColumn(stmt, 2, SQLDT_STRING, &value[0], sizeof(value), NULL, NULL);
 
-		if( i64db_exists(regs.vars, uid) ) {
-			ShowWarning("load_mapreg: duplicate! '%s' => '%s' skipping...\n",varname,value);
-			continue;
-		}
-		if( varname[length-1] == '$' ) {
-			mapreg_setregstr(uid, value);
-		} else {
-			mapreg_setreg(uid, strtoll(value,NULL,10));
+		rows = SqlStmt_NumRows(stmt);
+
+		while ( SQL_SUCCESS == SqlStmt_NextRow(stmt) ) {
+			int s = add_str(varname);
+			int64 uid = reference_uid(s, index);
+
+			safestrncpy(last_varname, varname, sizeof(last_varname));
+			last_index = index;
+
+			if( i64db_exists(regs.vars, uid) ) {
+				ShowWarning("load_mapreg: duplicate! '%s' => '%s' skipping...\n",varname,value);
+				continue;
+			}
+			if( varname[length-1] == '$' ) {
+				mapreg_setregstr(uid, value);
+			} else {
+				mapreg_setreg(uid, strtoll(value,NULL,10));
+			}
 		}
-	}
+	} while( rows == MAPREG_LOAD_CHUNK );
 
 	SqlStmt_Free(stmt);
 
 	skip_insert = false;
-	mapreg_dirty = false;
+}
+
+/**
+ * Adds a row to a multi-row query, running the query when it's full.
+ *
+ * @param queries: finished queries
+ * @param query: query being built
+ * @param rows: rows in query
+ * @param head: start of the query, before the first row
+ * @param row: row to add
+ * @param tail: end of the query, after the last row
+ */
+static void mapreg_query_add(std::vector<std::string>& queries, std::string& query, int& rows, const char* head, const std::string& row, const char* tail)
+{
+	if (rows == 0)
+		query = head;
+	else
+		query += ",";
+	query += row;
+
+	if (++rows >= mapreg_batch_size || query.size() >= MAPREG_QUERY_MAX) {
+		query += tail;
+		queries.push_back(std::move(query));
+		query.clear();
+		rows = 0;
+	}
 }
 
 /**
  * Saves permanent variables to database.
+ * The variables changed since the last save are written with multi-row
+ * upserts, the removed ones deleted with one query per batch.
  */
 static void script_save_mapreg(void)
 {
-	if (mapreg_dirty) {
-		DBIterator *iter = db_iterator(regs.vars);
-		struct mapreg_save *m;
-		for (m = static_cast<mapreg_save *>(dbi_first(iter)); dbi_exists(iter); m = static_cast<mapreg_save *>(dbi_next(iter))) {
-			if (m->save) {
-				int num = script_getvarid(m->uid);
-				uint32 i = script_getvaridx(m->uid);
-				const char* name = get_str(num);
-				if (!m->is_string) {
-					char esc_name[32 * 2 + 1];
-					Sql_EscapeStringLen(mmysql_handle, esc_name, name, strnlen(name, 32));
-					if (SQL_ERROR == Sql_Query(mmysql_handle, "UPDATE `%s` SET `value`='%" PRId64 "' WHERE `varname`='%s' AND `index`='%" PRIu32 "' LIMIT 1", mapreg_table, m->u.i, esc_name, i))
-						Sql_ShowDebug(mmysql_handle);
-				} else {
-					char esc_str[2 * 255 + 1];
-					char esc_name[32 * 2 + 1];
-					Sql_EscapeStringLen(mmysql_handle, esc_name, name, strnlen(name, 32));
-					Sql_EscapeStringLen(mmysql_handle, esc_str, m->u.str, safestrnlen(m->u.str, 255));
-					if (SQL_ERROR == Sql_Query(mmysql_handle, "UPDATE `%s` SET `value`='%s' WHERE `varname`='%s' AND `index`='%" PRIu32 "' LIMIT 1", mapreg_table, esc_str, esc_name, i))
-						Sql_ShowDebug(mmysql_handle);
-				}
-				m->save = false;
+	uint32 failed = mapreg_writer_failed.exchange(0);
+
+	if (failed > 0)
+		ShowWarning("script_save_mapreg: %" PRIu32 " queries failed to save permanent variables.\n", failed);
+
+	if (mapreg_dirty.empty())
+		return;
+
+	std::vector<int64> uids(mapreg_dirty.begin(), mapreg_dirty.end());
+	std::vector<std::string> queries;
+	std::string upsert_head, upsert_tail, upsert, remove;
+	int upsert_rows = 0, remove_rows = 0;
+	int remove_num = 0; // variable of the condition the deletion query ends with
+	char esc_name[32 * 2 + 1];
+	char esc_str[2 * 255 + 1];
+
+	mapreg_dirty.clear();
+
+	// by variable, so deletions of an array share their condition
+	std::sort(uids.begin(), uids.end(), [](int64 a, int64 b) {
+		if (script_getvarid(a) != script_getvarid(b))
+			return script_getvarid(a) < script_getvarid(b);
+		return script_getvaridx(a) < script_getvaridx(b);
+	});
+
+	upsert_head = "INSERT INTO `" + std::string(mapreg_table) + "` (`varname`,`index`,`value`) VALUES ";
+	upsert_tail = " ON DUPLICATE KEY UPDATE `value`=VALUES(`value`)";
+
+	for (int64 uid : uids) {
+		int num = script_getvarid(uid);
+		uint32 i = script_getvaridx(uid);
+		const char* name = get_str(num);
+		struct mapreg_save *m = (struct mapreg_save *)i64db_get(regs.vars, uid);
+
+		Sql_EscapeStringLen(mmysql_handle, esc_name, name, strnlen(name, 32));
+
+		if (m != NULL) {
+			std::string row = "('" + std::string(esc_name) + "','" + std::to_string(i) + "','";
+
+			if (!m->is_string)
+				row += std::to_string(m->u.i);
+			else {
+				Sql_EscapeStringLen(mmysql_handle, esc_str, m->u.str, safestrnlen(m->u.str, 255));
+				row += esc_str;
+			}
+			row += "')";
+			m->save = false;
+			mapreg_query_add(queries, upsert, upsert_rows, upsert_head.c_str(), row, upsert_tail.c_str());
+		} else {
+			// (`varname`='a' AND `index` IN (0,1)) OR (`varname`='b' AND `index` IN (0))
+			if (remove_rows == 0)
+				remove = "DELETE FROM `" + std::string(mapreg_table) + "` WHERE ";
+			else if (remove_num == num)
+				remove += ",";
+			else
+				remove += ")) OR ";
+			if (remove_rows == 0 || remove_num != num)
+				remove += "(`varname`='" + std::string(esc_name) + "' AND `index` IN (";
+			remove += std::to_string(i);
+			remove_num = num;
+
+			if (++remove_rows >= mapreg_batch_size || remove.size() >= MAPREG_QUERY_MAX) {
+				remove += "))";
+				queries.push_back(std::move(remove));
+				remove_rows = 0;
 			}
 		}
-		dbi_destroy(iter);
-		mapreg_dirty = false;
+	}
+	if (upsert_rows > 0)
+		queries.push_back(upsert + upsert_tail);
+	if (remove_rows > 0)
+		queries.push_back(remove + "))");
+
+	if (mapreg_writer_handle != nullptr) {
+		{
+			std::lock_guard<std::mutex> lock(mapreg_writer_mutex);
+
+			for (std::string& query : queries)
+				mapreg_writer_queue.push_back(std::move(query));
+		}
+		mapreg_writer_cv.notify_one();
+		return;
+	}
+
+	for (const std::string& query : queries) {
+		if (SQL_ERROR == Sql_QueryStr(mmysql_handle, query.c_str()))
+			Sql_ShowDebug(mmysql_handle);
 	}
 }
 
@@ -301,6 +520,7 @@ int mapreg_destroyreg(DBKey key, DBData *data, va_list ap)
 void mapreg_reload(void)
 {
 	script_save_mapreg();
+	mapreg_writer_wait();
 
 	regs.vars->clear(regs.vars, mapreg_destroyreg);
 
@@ -318,6 +538,7 @@ void mapreg_reload(void)
 void mapreg_final(void)
 {
 	script_save_mapreg();
+	mapreg_writer_final();
 
 	regs.vars->destroy(regs.vars, mapreg_destroyreg);
 
@@ -340,6 +561,9 @@ void mapreg_init(void)
 
 	script_load_mapreg();
 
+	if (mapreg_async_save)
+		mapreg_writer_init();
+
 	add_timer_func_list(script_autosave_mapreg, "script_autosave_mapreg");
 	add_timer_interval(gettick() + MAPREG_AUTOSAVE_INTERVAL, script_autosave_mapreg, 0, 0, MAPREG_AUTOSAVE_INTERVAL);
 }
@@ -351,6 +575,10 @@ bool mapreg_config_read(const char* w1, const char* w2)
 {
 	if(!strcmpi(w1, "mapreg_table"))
 		safestrncpy(mapreg_table, w2, sizeof(mapreg_table));
+	else if(!strcmpi(w1, "mapreg_batch_size"))
+		mapreg_batch_size = max(atoi(w2), 1);
+	else if(!strcmpi(w1, "mapreg_async_save"))
+		mapreg_async_save = config_switch(w2) != 0;
 	else
 		return false;
 
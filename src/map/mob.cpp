@@ -4,9 +4,13 @@
 #include "mob.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <map>
 #include <math.h>
+#include <mutex>
 #include <stdlib.h>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -1386,6 +1390,184 @@ static int mob_ai_sub_hard_lootsearch(struct block_list *bl,va_list ap)
 	return 0;
 }
 
+/*==========================================
+ * Parallel area search of the hard AI (monster_ai_threads)
+ * The surroundings of every mob about to think are gathered by worker
+ * threads, one map per job, while the main thread waits. The mobs then
+ * think one by one on the main thread and use these lists instead of
+ * searching the map again, as long as nothing changed on their map since.
+ *------------------------------------------*/
+struct s_mob_ai_scan {
+	struct mob_data *md;
+	int16 m, x, y;
+	int16 view_range;
+	int enemy_type;
+	bool loot, enemies; // which lists were gathered
+	uint32 block_gen; // block generation of the map when gathered
+	std::vector<struct block_list *> items; // floor items in shoot range, in map_foreachinshootrange order
+	std::vector<struct block_list *> targets; // enemy_type blocks in range, in map_foreachinallrange order
+};
+
+/// A mob in active AI range of a player, in map_foreachpc order
+struct s_mob_ai_pair {
+	struct mob_data *md;
+	struct map_session_data *sd;
+	int scan; // index in mob_ai_scans, -1 if the mob will not think
+};
+
+static std::vector<s_mob_ai_scan> mob_ai_scans;
+static size_t mob_ai_scan_count = 0;
+static std::vector<s_mob_ai_pair> mob_ai_pairs;
+static std::vector<size_t> mob_ai_scan_order; // scans sorted by map
+static std::vector<std::pair<size_t, size_t>> mob_ai_scan_jobs; // one range of mob_ai_scan_order per map
+static struct s_mob_ai_scan *mob_ai_scan_current = nullptr; // scan of the mob thinking right now
+
+static struct {
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake, done;
+	uint32 round; // increased for every parallel phase
+	int pending; // workers still busy with the current round
+	bool stop;
+	std::atomic<size_t> next_job;
+} mob_ai_pool;
+
+/**
+ * Gathers the blocks of a type around a mob, in the same order as map_foreachinrangeV.
+ * Runs on worker threads: only reads the map and does not use the shared bl_list.
+ */
+static void mob_ai_scan_area(struct s_mob_ai_scan &scan, int type, bool wall_check, std::vector<struct block_list *> &list)
+{
+	struct map_data *mapdata = map_getmapdata(scan.m);
+	struct block_list *bl;
+	int bx, by, x0, y0, x1, y1;
+
+	list.clear();
+
+	if (mapdata == nullptr || mapdata->block == nullptr)
+		return;
+
+	x0 = i16max(scan.x - scan.view_range, 0);
+	y0 = i16max(scan.y - scan.view_range, 0);
+	x1 = i16min(scan.x + scan.view_range, mapdata->xs - 1);
+	y1 = i16min(scan.y + scan.view_range, mapdata->ys - 1);
+
+	for (int pass = 0; pass < 2; pass++) {
+		struct block_list **blocks = pass ? mapdata->block_mob : mapdata->block;
+
+		if (pass ? !(type&BL_MOB) : !(type&~BL_MOB))
+			continue;
+
+		for (by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++) {
+			for (bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++) {
+				for (bl = blocks[bx + by * mapdata->bxs]; bl != nullptr; bl = bl->next) {
+					if ((pass || bl->type&type)
+						&& bl->x >= x0 && bl->x <= x1 && bl->y >= y0 && bl->y <= y1
+#ifdef CIRCULAR_AREA
+						&& check_distance_blxy(bl, scan.x, scan.y, scan.view_range)
+#endif
+						&& (!wall_check || path_search_long(nullptr, scan.m, scan.x, scan.y, bl->x, bl->y, CELL_CHKWALL)))
+						list.push_back(bl);
+				}
+			}
+		}
+	}
+}
+
+/// Runs the scan jobs until none is left, on the main thread and on the workers.
+static void mob_ai_scan_run(void)
+{
+	size_t job;
+
+	while ((job = mob_ai_pool.next_job++) < mob_ai_scan_jobs.size()) {
+		for (size_t i = mob_ai_scan_jobs[job].first; i < mob_ai_scan_jobs[job].second; i++) {
+			struct s_mob_ai_scan &scan = mob_ai_scans[mob_ai_scan_order[i]];
+
+			if (scan.loot)
+				mob_ai_scan_area(scan, BL_ITEM, true, scan.items);
+			if (scan.enemies)
+				mob_ai_scan_area(scan, scan.enemy_type, false, scan.targets);
+		}
+	}
+}
+
+/// Runs the scan jobs of each round after the given one, until the pool is stopped.
+static void mob_ai_worker(uint32 round)
+{
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mob_ai_pool.mutex);
+
+			mob_ai_pool.wake.wait(lock, [&round] { return mob_ai_pool.stop || mob_ai_pool.round != round; });
+			if (mob_ai_pool.stop)
+				return;
+			round = mob_ai_pool.round;
+		}
+
+		mob_ai_scan_run();
+
+		std::lock_guard<std::mutex> lock(mob_ai_pool.mutex);
+
+		if (--mob_ai_pool.pending == 0)
+			mob_ai_pool.done.notify_one();
+	}
+}
+
+/// Starts or stops worker threads to match the given count.
+static void mob_ai_pool_resize(size_t count)
+{
+	if (mob_ai_pool.workers.size() == count)
+		return;
+
+	if (!mob_ai_pool.workers.empty()) {
+		{
+			std::lock_guard<std::mutex> lock(mob_ai_pool.mutex);
+			mob_ai_pool.stop = true;
+		}
+		mob_ai_pool.wake.notify_all();
+		for (auto &worker : mob_ai_pool.workers)
+			worker.join();
+		mob_ai_pool.workers.clear();
+		mob_ai_pool.stop = false;
+	}
+
+	uint32 round;
+
+	{
+		// new workers wait for the next round, not the ones already done
+		std::lock_guard<std::mutex> lock(mob_ai_pool.mutex);
+		round = mob_ai_pool.round;
+	}
+
+	for (size_t i = 0; i < count; i++)
+		mob_ai_pool.workers.emplace_back(mob_ai_worker, round);
+}
+
+/// Returns the gathered surroundings of the thinking mob, if they are still accurate.
+static struct s_mob_ai_scan *mob_ai_scan_get(struct mob_data *md, int view_range)
+{
+	struct s_mob_ai_scan *scan = mob_ai_scan_current;
+
+	if (scan == nullptr || scan->md != md || scan->m != md->bl.m || scan->x != md->bl.x || scan->y != md->bl.y
+		|| scan->view_range != view_range || scan->block_gen != map_getmapdata(md->bl.m)->block_gen)
+		return nullptr;
+
+	return scan;
+}
+
+/// Calls a map_foreach* style callback on a single block.
+static int mob_ai_scan_call(int (*func)(struct block_list *, va_list), struct block_list *bl, ...)
+{
+	va_list ap;
+	int ret;
+
+	va_start(ap, bl);
+	ret = func(bl, ap);
+	va_end(ap);
+
+	return ret;
+}
+
 static int mob_warpchase_sub(struct block_list *bl,va_list ap) {
 	struct block_list *target;
 	struct npc_data **target_nd;
@@ -1818,19 +2000,46 @@ static bool mob_ai_sub_hard(struct mob_data *md, t_tick tick)
 	if (!tbl && can_move && mode&MD_LOOTER && md->lootitems && DIFF_TICK(tick, md->ud.canact_tick) > 0 &&
 		(md->lootitem_count < LOOTITEM_SIZE || battle_config.monster_loot_type != 1))
 	{	// Scan area for items to loot, avoid trying to loot if the mob is full and can't consume the items.
-		map_foreachinshootrange (mob_ai_sub_hard_lootsearch, &md->bl, view_range, BL_ITEM, md, &tbl);
+		struct s_mob_ai_scan *scan = mob_ai_scan_get(md, view_range);
+
+		if (scan && scan->loot) {
+			for (struct block_list *bl : scan->items)
+				if (bl->prev)
+					mob_ai_scan_call(mob_ai_sub_hard_lootsearch, bl, md, &tbl);
+		} else
+			map_foreachinshootrange (mob_ai_sub_hard_lootsearch, &md->bl, view_range, BL_ITEM, md, &tbl);
 	}
 
 	if ((mode&MD_AGGRESSIVE && (!tbl || slave_lost_target)) || md->state.skillstate == MSS_FOLLOW)
 	{
-		map_foreachinallrange (mob_ai_sub_hard_activesearch, &md->bl, view_range, DEFAULT_ENEMY_TYPE(md), md, &tbl, mode);
+		struct s_mob_ai_scan *scan = mob_ai_scan_get(md, view_range);
+
+		if (scan && scan->enemies) {
+			for (struct block_list *bl : scan->targets)
+				if (bl->prev)
+					mob_ai_scan_call(mob_ai_sub_hard_activesearch, bl, md, &tbl, mode);
+		} else
+			map_foreachinallrange (mob_ai_sub_hard_activesearch, &md->bl, view_range, DEFAULT_ENEMY_TYPE(md), md, &tbl, mode);
 	}
 	else
 	if (mode&MD_CHANGECHASE && (md->state.skillstate == MSS_RUSH || md->state.skillstate == MSS_FOLLOW))
 	{
 		int search_size;
 		search_size = view_range<md->status.rhw.range ? view_range:md->status.rhw.range;
-		map_foreachinallrange (mob_ai_sub_hard_changechase, &md->bl, search_size, DEFAULT_ENEMY_TYPE(md), md, &tbl);
+
+		struct s_mob_ai_scan *scan = mob_ai_scan_get(md, view_range);
+
+		if (scan && scan->enemies) {
+			// Narrower than the gathered range, keep the blocks map_foreachinallrange would find
+			for (struct block_list *bl : scan->targets)
+				if (bl->prev && abs(bl->x - md->bl.x) <= search_size && abs(bl->y - md->bl.y) <= search_size
+#ifdef CIRCULAR_AREA
+					&& check_distance_bl(&md->bl, bl, search_size)
+#endif
+					)
+					mob_ai_scan_call(mob_ai_sub_hard_changechase, bl, md, &tbl);
+		} else
+			map_foreachinallrange (mob_ai_sub_hard_changechase, &md->bl, search_size, DEFAULT_ENEMY_TYPE(md), md, &tbl);
 	}
 
 	if (!tbl) { //No targets available.
@@ -1999,6 +2208,123 @@ static int mob_ai_sub_foreachclient(struct map_session_data *sd,va_list ap)
 	return 0;
 }
 
+static int mob_ai_collect_sub(struct block_list *bl, va_list ap)
+{
+	struct map_session_data *sd = va_arg(ap, struct map_session_data *);
+
+	mob_ai_pairs.push_back({ (struct mob_data *)bl, sd, -1 });
+	return 0;
+}
+
+static int mob_ai_collect(struct map_session_data *sd, va_list ap)
+{
+	map_foreachinallrange(mob_ai_collect_sub, &sd->bl, AREA_SIZE+ACTIVE_AI_RANGE, BL_MOB, sd);
+	return 0;
+}
+
+/*==========================================
+ * Serious processing for mob in PC field of view, with the area searches
+ * done in parallel first (monster_ai_threads)
+ *------------------------------------------*/
+static void mob_ai_hard_parallel(t_tick tick)
+{
+	std::unordered_map<struct mob_data *, int> scan_index;
+
+	mob_ai_pool_resize(battle_config.mob_ai_threads);
+
+	// Mobs in range of players, in the order the serial AI would visit them
+	mob_ai_pairs.clear();
+	map_foreachpc(mob_ai_collect);
+
+	mob_ai_scan_count = 0;
+	for (auto &pair : mob_ai_pairs) {
+		struct mob_data *md = pair.md;
+
+		auto it = scan_index.find(md);
+		if (it != scan_index.end()) {
+			pair.scan = it->second;
+			continue;
+		}
+
+		// Same early outs as mob_ai_sub_hard, the mob won't search
+		if (md->bl.prev == nullptr || md->status.hp == 0 || DIFF_TICK(tick, md->last_thinktime) < MIN_MOBTHINKTIME || md->ud.skilltimer != INVALID_TIMER) {
+			scan_index[md] = -1;
+			continue;
+		}
+
+		if (mob_ai_scan_count == mob_ai_scans.size())
+			mob_ai_scans.emplace_back();
+
+		struct s_mob_ai_scan &scan = mob_ai_scans[mob_ai_scan_count];
+		int mode = status_get_mode(&md->bl);
+
+		scan.md = md;
+		scan.m = md->bl.m;
+		scan.x = md->bl.x;
+		scan.y = md->bl.y;
+		scan.view_range = (md->sc.count && md->sc.data[SC_BLIND]) ? 3 : md->db->range2;
+		scan.enemy_type = DEFAULT_ENEMY_TYPE(md);
+		scan.loot = (mode&MD_LOOTER) && md->lootitems;
+		scan.enemies = (mode&(MD_AGGRESSIVE|MD_CHANGECHASE)) || md->state.skillstate == MSS_FOLLOW;
+		scan.block_gen = map_getmapdata(md->bl.m)->block_gen;
+		scan.items.clear();
+		scan.targets.clear();
+
+		pair.scan = scan_index[md] = (int)mob_ai_scan_count++;
+	}
+
+	// One job per map
+	mob_ai_scan_order.resize(mob_ai_scan_count);
+	for (size_t i = 0; i < mob_ai_scan_count; i++)
+		mob_ai_scan_order[i] = i;
+	std::stable_sort(mob_ai_scan_order.begin(), mob_ai_scan_order.end(), [](size_t a, size_t b) {
+		return mob_ai_scans[a].m < mob_ai_scans[b].m;
+	});
+
+	mob_ai_scan_jobs.clear();
+	for (size_t i = 0; i < mob_ai_scan_count; i++) {
+		if (i == 0 || mob_ai_scans[mob_ai_scan_order[i]].m != mob_ai_scans[mob_ai_scan_order[i - 1]].m)
+			mob_ai_scan_jobs.emplace_back(i, i);
+		mob_ai_scan_jobs.back().second = i + 1;
+	}
+
+	// Parallel phase, the main thread takes jobs too and waits for the workers
+	mob_ai_pool.next_job = 0;
+	{
+		std::lock_guard<std::mutex> lock(mob_ai_pool.mutex);
+		mob_ai_pool.pending = (int)mob_ai_pool.workers.size();
+		mob_ai_pool.round++;
+	}
+	mob_ai_pool.wake.notify_all();
+	mob_ai_scan_run();
+	{
+		std::unique_lock<std::mutex> lock(mob_ai_pool.mutex);
+		mob_ai_pool.done.wait(lock, [] { return mob_ai_pool.pending == 0; });
+	}
+
+	// Serial phase, mobs think and act in order
+	map_freeblock_lock();
+
+	for (auto &pair : mob_ai_pairs) {
+		struct mob_data *md = pair.md;
+		struct map_session_data *sd = pair.sd;
+
+		// Earlier mobs may have moved or removed this one
+		if (md->bl.prev == nullptr || sd->bl.prev == nullptr || md->bl.m != sd->bl.m || !check_distance_bl(&md->bl, &sd->bl, AREA_SIZE+ACTIVE_AI_RANGE))
+			continue;
+
+		mob_ai_scan_current = (pair.scan >= 0) ? &mob_ai_scans[pair.scan] : nullptr;
+		if (mob_ai_sub_hard(md, tick))
+		{	//Hard AI triggered.
+			mob_add_spotted(md, sd->status.char_id);
+			md->last_pcneartime = tick;
+		}
+	}
+
+	mob_ai_scan_current = nullptr;
+	map_freeblock_unlock();
+}
+
 /*==========================================
  * Negligent mode MOB AI (PC is not in near)
  *------------------------------------------*/
@@ -2096,6 +2422,8 @@ static TIMER_FUNC(mob_ai_hard){
 
 	if (battle_config.mob_ai&0x20)
 		map_foreachmob(mob_ai_sub_lazy,tick);
+	else if (battle_config.mob_ai_threads > 0)
+		mob_ai_hard_parallel(tick);
 	else
 		map_foreachpc(mob_ai_sub_foreachclient,tick);
 
@@ -6514,6 +6842,7 @@ void do_final_mob(bool is_reload){
 	mob_item_drop_ratio.clear();
 	mob_summon_db.clear();
 	if( !is_reload ) {
+		mob_ai_pool_resize(0);
 		ers_destroy(item_drop_ers);
 		ers_destroy(item_drop_list_ers);
 	}
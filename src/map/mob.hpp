@@ -36,6 +36,9 @@ const t_tick MIN_MOBLINKTIME = 1000;
 //Min time between random walks
 const t_tick MIN_RANDOMWALKTIME = 4000;
 
+//Max worker threads for the area searches of the hard AI (see monster_ai_threads)
+#define MAX_MOB_AI_THREADS 16
+
 //Distance that slaves should keep from their master.
 #define MOB_SLAVEDISTANCE 2
 
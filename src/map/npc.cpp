@@ -4,8 +4,14 @@
 #include "npc.hpp"
 
 #include <errno.h>
+#include <algorithm>
+#include <atomic>
+#include <future>
 #include <map>
 #include <stdlib.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "../common/cbasetypes.hpp"
@@ -89,6 +95,7 @@ int npc_get_new_npc_id(void) {
 }
 
 static DBMap* ev_db; // const char* event_name -> struct event_data*
+static std::unordered_map<std::string, std::vector<std::string>> ev_label_db; // lower case label -> event names in ev_db, in export order
 static DBMap* npcname_db; // const char* npc_name -> struct npc_data*
 
 struct event_data {
@@ -421,6 +428,33 @@ int npc_event_dequeue(struct map_session_data* sd,bool free_script_stack)
 	return 1;
 }
 
+/// Key of a label in ev_label_db, labels are matched case-insensitively
+static std::string npc_event_label_key(const char* label)
+{
+	std::string key(label);
+
+	std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+	return key;
+}
+
+/// Removes an event name ("npc::label") from ev_label_db
+static void npc_event_label_remove(const char* eventname)
+{
+	const char* label = strstr(eventname, "::");
+
+	if (label == NULL)
+		return;
+
+	auto it = ev_label_db.find(npc_event_label_key(label + 2));
+
+	if (it == ev_label_db.end())
+		return;
+
+	util::vector_erase_if_exists(it->second, std::string(eventname));
+	if (it->second.empty())
+		ev_label_db.erase(it);
+}
+
 /*==========================================
  * exports a npc event label
  * called from npc_parse_script
@@ -458,43 +492,13 @@ static int npc_event_export(struct npc_data *nd, int i)
 		ev->pos = pos;
 		if (strdb_put(ev_db, buf, ev)) // There was already another event of the same name?
 			return 1;
+		ev_label_db[npc_event_label_key(lname)].push_back(buf);
 	}
 	return 0;
 }
 
 int npc_event_sub(struct map_session_data* sd, struct event_data* ev, const char* eventname); //[Lance]
 
-/**
- * Exec name (NPC events) on player or global
- * Do on all NPC when called with foreach
- * @see DBApply
- */
-int npc_event_doall_sub(DBKey key, DBData *data, va_list ap)
-{
-	const char* p = key.str;
-	struct event_data* ev;
-	int* c;
-	const char* name;
-	int rid;
-
-	nullpo_ret(ev = (struct event_data*)db_data2ptr(data));
-	nullpo_ret(c = va_arg(ap, int *));
-	nullpo_ret(name = va_arg(ap, const char *));
-	rid = va_arg(ap, int);
-
-	p = strchr(p, ':'); // match only the event name
-	if( p && strcmpi(name, p) == 0 /* && !ev->nd->src_id */ ) // Do not run on duplicates. [Paradox924X]
-	{
-		if(rid) // a player may only have 1 script running at the same time
-			npc_event_sub(map_id2sd(rid),ev,key.str);
-		else
-			run_script(ev->nd->u.scr.script,ev->pos,rid,ev->nd->bl.id);
-		(*c)++;
-	}
-
-	return 0;
-}
-
 /**
  * @see DBApply
  */
@@ -522,8 +526,8 @@ static int npc_event_do_sub(DBKey key, DBData *data, va_list ap)
 int npc_event_do_id(const char* name, int rid) {
 	int c = 0;
 
-	if( name[0] == ':' && name[1] == ':' )
-		ev_db->foreach(ev_db,npc_event_doall_sub,&c,name,0,rid);
+	if( name[0] == ':' && name[1] == ':' ) // global events run without a RID, rid may be a monster or unit
+		c = npc_event_doall_id(name + 2, 0);
 	else
 		ev_db->foreach(ev_db,npc_event_do_sub,&c,name,rid);
 
@@ -550,9 +554,29 @@ void npc_event_runall( const char* eventname ){
 int npc_event_doall_id(const char* name, int rid)
 {
 	int c = 0;
-	char buf[EVENT_NAME_LENGTH];
-	safesnprintf(buf, sizeof(buf), "::%s", name);
-	ev_db->foreach(ev_db,npc_event_doall_sub,&c,buf,rid);
+	auto it = ev_label_db.find(npc_event_label_key(name));
+
+	if( it == ev_label_db.end() )
+		return 0;
+
+	// the scripts may load or unload npcs, run from a copy and look each event up again
+	std::vector<std::string> events = it->second;
+
+	for( const std::string& eventname : events ) {
+		struct event_data* ev = (struct event_data*)strdb_get(ev_db, eventname.c_str());
+
+		if( ev == NULL )
+			continue;
+
+		struct map_session_data* sd = map_id2sd(rid);
+
+		if(sd) // a player may only have 1 script running at the same time
+			npc_event_sub(sd,ev,eventname.c_str());
+		else
+			run_script(ev->nd->u.scr.script,ev->pos,rid,ev->nd->bl.id);
+		c++;
+	}
+
 	return c;
 }
 
@@ -1165,6 +1189,127 @@ int npc_touch_areanpc(struct map_session_data* sd, int16 m, int16 x, int16 y, st
 	return 1;
 }
 
+/// Touch area of a npc, as registered in npc_area_db
+struct s_npc_area {
+	int16 m, x0, y0, x1, y1;
+};
+
+static std::unordered_map<int16, std::vector<std::vector<int>>> npc_area_db; // map id -> ids of the npcs whose touch area overlaps each block of the map
+static std::unordered_map<int, struct s_npc_area> npc_area_registered; // npc id -> touch area registered in npc_area_db
+
+/// Removes the touch area of a npc from npc_area_db
+static void npc_area_del(struct npc_data* nd)
+{
+	auto it = npc_area_registered.find(nd->bl.id);
+
+	if (it == npc_area_registered.end())
+		return;
+
+	const struct s_npc_area& area = it->second;
+	auto blocks = npc_area_db.find(area.m);
+
+	if (blocks != npc_area_db.end()) {
+		struct map_data* mapdata = map_getmapdata(area.m);
+
+		for (int by = area.y0 / BLOCK_SIZE; by <= area.y1 / BLOCK_SIZE; by++) {
+			for (int bx = area.x0 / BLOCK_SIZE; bx <= area.x1 / BLOCK_SIZE; bx++) {
+				size_t block = bx + by * mapdata->bxs;
+
+				if (block < blocks->second.size())
+					util::vector_erase_if_exists(blocks->second[block], nd->bl.id);
+			}
+		}
+	}
+	npc_area_registered.erase(it);
+}
+
+/// Adds the touch area of a npc to npc_area_db, in each block it overlaps
+static void npc_area_add(struct npc_data* nd, int16 xs, int16 ys)
+{
+	struct map_data* mapdata = map_getmapdata(nd->bl.m);
+	struct s_npc_area area;
+
+	area.m = nd->bl.m;
+	area.x0 = i16max(nd->bl.x - xs, 0);
+	area.y0 = i16max(nd->bl.y - ys, 0);
+	area.x1 = i16min(nd->bl.x + xs, mapdata->xs - 1);
+	area.y1 = i16min(nd->bl.y + ys, mapdata->ys - 1);
+
+	auto it = npc_area_registered.find(nd->bl.id);
+
+	if (it != npc_area_registered.end()) {
+		const struct s_npc_area& old = it->second;
+
+		// cells are set again for the npcs around a removed one
+		if (old.m == area.m && old.x0 == area.x0 && old.y0 == area.y0 && old.x1 == area.x1 && old.y1 == area.y1)
+			return;
+		npc_area_del(nd);
+	}
+
+	if (area.x0 > area.x1 || area.y0 > area.y1)
+		return; // outside of the map
+
+	std::vector<std::vector<int>>& blocks = npc_area_db[area.m];
+
+	if (blocks.size() < (size_t)(mapdata->bxs * mapdata->bys))
+		blocks.resize(mapdata->bxs * mapdata->bys);
+
+	for (int by = area.y0 / BLOCK_SIZE; by <= area.y1 / BLOCK_SIZE; by++)
+		for (int bx = area.x0 / BLOCK_SIZE; bx <= area.x1 / BLOCK_SIZE; bx++)
+			blocks[bx + by * mapdata->bxs].push_back(nd->bl.id);
+	npc_area_registered[nd->bl.id] = area;
+}
+
+/**
+ * Lists the npcs whose touch area may overlap an area of a map, warps first like in map_data::npc.
+ * Ids are returned since running a touch event can unload the npcs.
+ * @param m: Map ID
+ * @param x0: Area's left edge
+ * @param y0: Area's bottom edge
+ * @param x1: Area's right edge
+ * @param y1: Area's top edge
+ * @return IDs of the npcs, to check against their touch area
+ */
+static std::vector<int> npc_area_find(int16 m, int16 x0, int16 y0, int16 x1, int16 y1)
+{
+	std::vector<int> warps, scripts;
+	auto blocks = npc_area_db.find(m);
+
+	if (blocks == npc_area_db.end())
+		return warps;
+
+	struct map_data* mapdata = map_getmapdata(m);
+
+	x0 = i16max(x0, 0);
+	y0 = i16max(y0, 0);
+	x1 = i16min(x1, mapdata->xs - 1);
+	y1 = i16min(y1, mapdata->ys - 1);
+
+	for (int by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE && y0 <= y1; by++) {
+		for (int bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE && x0 <= x1; bx++) {
+			size_t block = bx + by * mapdata->bxs;
+
+			if (block >= blocks->second.size())
+				continue;
+
+			for (int id : blocks->second[block]) {
+				struct npc_data* nd = map_id2nd(id);
+
+				if (nd == nullptr)
+					continue;
+
+				std::vector<int>& list = (nd->subtype == NPCTYPE_WARP ? warps : scripts);
+
+				if (!util::vector_exists(list, id)) // spanning several blocks
+					list.push_back(id);
+			}
+		}
+	}
+
+	warps.insert(warps.end(), scripts.begin(), scripts.end());
+	return warps;
+}
+
 /*==========================================
  * Exec OnTouch for player if in range of area event
  *------------------------------------------*/
@@ -1186,8 +1331,13 @@ int npc_touch_area_allnpc(struct map_session_data* sd, int16 m, int16 x, int16 y
 	struct map_data *mapdata = map_getmapdata(m);
 	int f = 1;
 
-	for (int i = 0; i < mapdata->npc_num_area; i++) {
-		switch( npc_touch_areanpc(sd, m, x, y, mapdata->npc[i]) ) {
+	for (int id : npc_area_find(m, x, y, x, y)) {
+		struct npc_data* nd = map_id2nd(id);
+
+		if (nd == nullptr || nd->bl.m != m)
+			continue;
+
+		switch( npc_touch_areanpc(sd, m, x, y, nd) ) {
 		case 0:
 			break;
 		case 1:
@@ -1209,28 +1359,31 @@ int npc_touch_area_allnpc(struct map_session_data* sd, int16 m, int16 x, int16 y
 // Return 1 if Warped
 int npc_touch_areanpc2(struct mob_data *md)
 {
-	int i, x = md->bl.x, y = md->bl.y, id;
+	int x = md->bl.x, y = md->bl.y, id;
 	char eventname[EVENT_NAME_LENGTH];
 	struct event_data* ev;
 	int xs, ys;
-	struct map_data *mapdata = map_getmapdata(md->bl.m);
 
-	for( i = 0; i < mapdata->npc_num_area; i++ )
+	for( int npc_id : npc_area_find(md->bl.m, x, y, x, y) )
 	{
-		if( mapdata->npc[i]->sc.option&(OPTION_INVISIBLE|OPTION_CLOAK) )
+		struct npc_data* nd = map_id2nd(npc_id);
+
+		if( nd == nullptr || nd->bl.m != md->bl.m )
+			continue;
+		if( nd->sc.option&(OPTION_INVISIBLE|OPTION_CLOAK) )
 			continue;
 
-		switch( mapdata->npc[i]->subtype )
+		switch( nd->subtype )
 		{
 			case NPCTYPE_WARP:
 				if( !( battle_config.mob_warp&1 ) )
 					continue;
-				xs = mapdata->npc[i]->u.warp.xs;
-				ys = mapdata->npc[i]->u.warp.ys;
+				xs = nd->u.warp.xs;
+				ys = nd->u.warp.ys;
 				break;
 			case NPCTYPE_SCRIPT:
-				xs = mapdata->npc[i]->u.scr.xs;
-				ys = mapdata->npc[i]->u.scr.ys;
+				xs = nd->u.scr.xs;
+				ys = nd->u.scr.ys;
 				break;
 			default:
 				continue; // Keep Searching
@@ -1238,26 +1391,26 @@ int npc_touch_areanpc2(struct mob_data *md)
 		if (xs < 0 || ys < 0)
 			continue;
 
-		if( x >= mapdata->npc[i]->bl.x-xs && x <= mapdata->npc[i]->bl.x+xs && y >= mapdata->npc[i]->bl.y-ys && y <= mapdata->npc[i]->bl.y+ys )
+		if( x >= nd->bl.x-xs && x <= nd->bl.x+xs && y >= nd->bl.y-ys && y <= nd->bl.y+ys )
 		{ // In the npc touch area
-			switch( mapdata->npc[i]->subtype )
+			switch( nd->subtype )
 			{
 				case NPCTYPE_WARP: {
-					int16 warp_m = map_mapindex2mapid(mapdata->npc[i]->u.warp.mapindex);
+					int16 warp_m = map_mapindex2mapid(nd->u.warp.mapindex);
 
 					if( warp_m < 0 )
 						break; // Cannot Warp between map servers
-					if( unit_warp(&md->bl, warp_m, mapdata->npc[i]->u.warp.x, mapdata->npc[i]->u.warp.y, CLR_OUTSIGHT) == 0 )
+					if( unit_warp(&md->bl, warp_m, nd->u.warp.x, nd->u.warp.y, CLR_OUTSIGHT) == 0 )
 						return 1; // Warped
 				}
 					break;
 				case NPCTYPE_SCRIPT:
-					if( mapdata->npc[i]->bl.id == md->areanpc_id )
+					if( nd->bl.id == md->areanpc_id )
 						break; // Already touch this NPC
-					safesnprintf(eventname, ARRAYLENGTH(eventname), "%s::%s", mapdata->npc[i]->exname, script_config.ontouchnpc_event_name);
+					safesnprintf(eventname, ARRAYLENGTH(eventname), "%s::%s", nd->exname, script_config.ontouchnpc_event_name);
 					if( (ev = (struct event_data*)strdb_get(ev_db, eventname)) == NULL || ev->nd == NULL )
 						break; // No OnTouchNPC Event
-					md->areanpc_id = mapdata->npc[i]->bl.id;
+					md->areanpc_id = nd->bl.id;
 					id = md->bl.id; // Stores Unique ID
 					run_script(ev->nd->u.scr.script, ev->pos, md->bl.id, ev->nd->bl.id);
 					if( map_id2md(id) == NULL ) return 1; // Not Warped, but killed
@@ -1308,37 +1461,39 @@ int npc_check_areanpc(int flag, int16 m, int16 x, int16 y, int16 range)
 	if (!i) return 0; //No NPC_CELLs.
 
 	//Now check for the actual NPC on said range.
-	for (i = 0; i < mapdata->npc_num_area; i++)
+	for (int npc_id : npc_area_find(m, x0, y0, x1, y1))
 	{
-		if (mapdata->npc[i]->sc.option&OPTION_INVISIBLE)
+		struct npc_data* nd = map_id2nd(npc_id);
+
+		if (nd == nullptr || nd->bl.m != m)
+			continue;
+		if (nd->sc.option&OPTION_INVISIBLE)
 			continue;
 
-		switch(mapdata->npc[i]->subtype)
+		switch(nd->subtype)
 		{
 		case NPCTYPE_WARP:
 			if (!(flag&1))
 				continue;
-			xs=mapdata->npc[i]->u.warp.xs;
-			ys=mapdata->npc[i]->u.warp.ys;
+			xs=nd->u.warp.xs;
+			ys=nd->u.warp.ys;
 			break;
 		case NPCTYPE_SCRIPT:
 			if (!(flag&2))
 				continue;
-			xs=mapdata->npc[i]->u.scr.xs;
-			ys=mapdata->npc[i]->u.scr.ys;
+			xs=nd->u.scr.xs;
+			ys=nd->u.scr.ys;
 			break;
 		default:
 			continue;
 		}
 
-		if( x1 >= mapdata->npc[i]->bl.x-xs && x0 <= mapdata->npc[i]->bl.x+xs
-		&&  y1 >= mapdata->npc[i]->bl.y-ys && y0 <= mapdata->npc[i]->bl.y+ys )
-			break; // found a npc
+		if( x1 >= nd->bl.x-xs && x0 <= nd->bl.x+xs
+		&&  y1 >= nd->bl.y-ys && y0 <= nd->bl.y+ys )
+			return nd->bl.id; // found a npc
 	}
-	if (i == mapdata->npc_num_area)
-		return 0;
 
-	return (mapdata->npc[i]->bl.id);
+	return 0;
 }
 
 /*==========================================
@@ -2357,6 +2512,7 @@ static int npc_unload_ev(DBKey key, DBData *data, va_list ap)
 	char* npcname = va_arg(ap, char *);
 
 	if(strcmp(ev->nd->exname,npcname)==0){
+		npc_event_label_remove(key.str);
 		db_remove(ev_db, key);
 		return 1;
 	}
@@ -3187,8 +3343,13 @@ int npc_convertlabel_db(DBKey key, DBData *data, va_list ap)
 	return 0;
 }
 
+// Script body of the current definition, already skipped by the npc source worker threads
+static const char* npc_skip_start = NULL;
+static const char* npc_skip_end = NULL;
+
 // Skip the contents of a script.
-static const char* npc_skip_script(const char* start, const char* buffer, const char* filepath)
+// With quiet, errors are not reported and the parser state is not used (for the worker threads).
+static const char* npc_skip_script_sub(const char* start, const char* buffer, const char* filepath, bool quiet)
 {
 	const char* p;
 	int curly_count;
@@ -3200,14 +3361,17 @@ static const char* npc_skip_script(const char* start, const char* buffer, const
 	p = strchr(start,'{');
 	if( p == NULL )
 	{
-		ShowError("npc_skip_script: Missing left curly in file '%s', line'%d'.", filepath, strline(buffer,start-buffer));
+		if( !quiet )
+			ShowError("npc_skip_script: Missing left curly in file '%s', line'%d'.", filepath, strline(buffer,start-buffer));
 		return NULL;// can't continue
 	}
 
 	// skip everything
 	for( curly_count = 1; curly_count > 0 ; )
 	{
-		p = skip_space(p+1) ;
+		p = quiet ? skip_space_quiet(p+1) : skip_space(p+1);
+		if( p == NULL )
+			return NULL;// can't continue
 		if( *p == '}' )
 		{// right curly
 			--curly_count;
@@ -3224,19 +3388,22 @@ static const char* npc_skip_script(const char* start, const char* buffer, const
 					++p;// escape sequence (not part of a multibyte character)
 				else if( *p == '\0' )
 				{
-					script_error(buffer, filepath, 0, "Unexpected end of string.", p);
+					if( !quiet )
+						script_error(buffer, filepath, 0, "Unexpected end of string.", p);
 					return NULL;// can't continue
 				}
 				else if( *p == '\n' )
 				{
-					script_error(buffer, filepath, 0, "Unexpected newline at string.", p);
+					if( !quiet )
+						script_error(buffer, filepath, 0, "Unexpected newline at string.", p);
 					return NULL;// can't continue
 				}
 			}
 		}
 		else if( *p == '\0' )
 		{// end of buffer
-			ShowError("Missing %d right curlys at file '%s', line '%d'.\n", curly_count, filepath, strline(buffer,p-buffer));
+			if( !quiet )
+				ShowError("Missing %d right curlys at file '%s', line '%d'.\n", curly_count, filepath, strline(buffer,p-buffer));
 			return NULL;// can't continue
 		}
 	}
@@ -3244,6 +3411,15 @@ static const char* npc_skip_script(const char* start, const char* buffer, const
 	return p+1;// return after the last '}'
 }
 
+// Skip the contents of a script.
+static const char* npc_skip_script(const char* start, const char* buffer, const char* filepath)
+{
+	if( start != NULL && start == npc_skip_start )
+		return npc_skip_end;// already skipped by the worker threads
+
+	return npc_skip_script_sub(start, buffer, filepath, false);
+}
+
 /**
  * Parses a npc script.
  * Line definition :
@@ -3301,7 +3477,7 @@ static const char* npc_parse_script(char* w1, char* w2, char* w3, char* w4, cons
 	if( end == NULL )
 		return NULL;// (simple) parse error, don't continue
 
-	script = parse_script(script_start, filepath, strline(buffer,script_start-buffer), SCRIPT_USE_LABEL_DB);
+	script = parse_script_cached(script_start, end - script_start, filepath, strline(buffer,script_start-buffer), SCRIPT_USE_LABEL_DB);
 	label_list = NULL;
 	label_list_num = 0;
 	if( script )
@@ -3822,6 +3998,8 @@ void npc_setcells(struct npc_data* nd)
 	if (m < 0 || xs < 0 || ys < 0) //invalid range or map
 		return;
 
+	npc_area_add(nd, xs, ys);
+
 	for (i = y-ys; i <= y+ys; i++) {
 		for (j = x-xs; j <= x+xs; j++) {
 			if (map_getcell(m, j, i, CELL_CHKNOPASS))
@@ -3845,6 +4023,8 @@ void npc_unsetcells(struct npc_data* nd)
 	int16 m = nd->bl.m, x = nd->bl.x, y = nd->bl.y, xs, ys;
 	int i,j, x0, x1, y0, y1;
 
+	npc_area_del(nd);
+
 	if (nd->subtype == NPCTYPE_WARP) {
 		xs = nd->u.warp.xs;
 		ys = nd->u.warp.ys;
@@ -4005,7 +4185,7 @@ static const char* npc_parse_function(char* w1, char* w2, char* w3, char* w4, co
 	if( end == NULL )
 		return NULL;// (simple) parse error, don't continue
 
-	script = parse_script(script_start, filepath, strline(buffer,start-buffer), SCRIPT_RETURN_EMPTY_SCRIPT);
+	script = parse_script_cached(script_start, end - script_start, filepath, strline(buffer,start-buffer), SCRIPT_RETURN_EMPTY_SCRIPT);
 	if( script == NULL )// parse error, continue
 		return end;
 
@@ -4413,6 +4593,167 @@ static const char* npc_parse_mapflag(char* w1, char* w2, char* w3, char* w4, con
 	return strchr(start,'\n');// continue
 }
 
+// maximum number of threads reading and splitting npc source files ahead
+#define NPC_SRC_READ_THREADS 4
+
+/// Result of reading a npc source file
+enum e_npc_src_read : uint8 {
+	NPC_SRC_OK,
+	NPC_SRC_NOTFILE, // not a regular file
+	NPC_SRC_NOTFOUND, // could not be opened
+	NPC_SRC_FAILED, // error while reading
+};
+
+/// Definition of a npc source file, split by a worker thread
+struct s_npc_src_def {
+	size_t start; // offset of the definition in the file
+	int count; // sv_parse result
+	int pos[9]; // sv_parse positions of w1..w4, relative to start
+	size_t script_start, script_end; // offsets of the script body, 0 if none or if it couldn't be skipped
+};
+
+/// Npc source file, read ahead and split into definitions by a worker thread
+struct s_npc_src_read {
+	std::string path;
+	enum e_npc_src_read result;
+	int error; // errno, with NPC_SRC_FAILED
+	std::string data;
+	std::vector<struct s_npc_src_def> defs; // in file order
+	std::promise<void> done;
+	std::future<void> ready;
+};
+
+static std::vector<struct s_npc_src_read*> npc_src_read_list; // in npc_src_files order
+static std::unordered_map<std::string, struct s_npc_src_read*> npc_src_read_db; // path -> file read ahead, not parsed yet
+static std::vector<std::thread> npc_src_read_threads;
+static std::atomic<size_t> npc_src_read_next(0);
+
+/// Reads a npc source file
+/// The memory manager isn't used, so that it can be run by the worker threads.
+static void npc_src_read(struct s_npc_src_read* file)
+{
+	FILE* fp;
+	long len;
+
+	if( check_filepath(file->path.c_str()) != 2 ) {
+		file->result = NPC_SRC_NOTFILE;
+		return;
+	}
+
+	fp = fopen(file->path.c_str(), "rb");
+	if( fp == NULL ) {
+		file->result = NPC_SRC_NOTFOUND;
+		return;
+	}
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	file->data.resize(len > 0 ? len : 0);
+	file->data.resize(len > 0 ? fread(&file->data[0], 1, len, fp) : 0);
+	if( ferror(fp) ) {
+		file->result = NPC_SRC_FAILED;
+		file->error = errno;
+	} else
+		file->result = NPC_SRC_OK;
+	fclose(fp);
+}
+
+/**
+ * Splits a npc source file into its definitions, the way npc_parsesrcfile walks it:
+ * the w1..w4 fields of each definition and the body of scripts and functions.
+ * Only pure string functions are used, so that it can be run by the worker threads.
+ * Stops at the first definition that can't be split, npc_parsesrcfile reports the error and goes on from there.
+ */
+static void npc_src_split(struct s_npc_src_read* file)
+{
+	const char* buffer = file->data.c_str();
+	size_t len = file->data.length();
+	const char* p;
+
+	if( len >= 3 && (unsigned char)buffer[0] == 0xEF && (unsigned char)buffer[1] == 0xBB && (unsigned char)buffer[2] == 0xBF )
+		return;// UTF-8 BOM, not parsed
+
+	for( p = skip_space_quiet(buffer); p && *p; p = skip_space_quiet(p) ) {
+		struct s_npc_src_def def;
+
+		def.start = p - buffer;
+		def.script_start = def.script_end = 0;
+		def.count = sv_parse(p, len+buffer-p, 0, '\t', def.pos, ARRAYLENGTH(def.pos), (e_svopt)(SV_TERMINATE_LF|SV_TERMINATE_CRLF));
+		file->defs.push_back(def);
+
+		if( def.count < 3 )
+			break;// stops the file
+		if( def.count > 3 && def.pos[5]-def.pos[4] == 6 && strncasecmp(p+def.pos[4], "script", 6) == 0 ) {
+			// script body, located like npc_parse_script and npc_parse_function do
+			bool function = (def.pos[3]-def.pos[2] == 8 && strncasecmp(p+def.pos[2], "function", 8) == 0);
+			const char* script_start = strstr(p, function ? "\t{" : ",{");
+			const char* end = strchr(p, '\n');
+
+			if( script_start == NULL || (end != NULL && script_start > end) )
+				break;
+			++script_start;
+			if( (end = npc_skip_script_sub(script_start, buffer, NULL, true)) == NULL )
+				break;
+			file->defs.back().script_start = script_start - buffer;
+			file->defs.back().script_end = end - buffer;
+			p = end;
+		} else
+			p = strchr(p, '\n');
+	}
+}
+
+static void npc_src_read_run(void)
+{
+	size_t i;
+
+	while( (i = npc_src_read_next++) < npc_src_read_list.size() ) {
+		npc_src_read(npc_src_read_list[i]);
+		if( npc_src_read_list[i]->result == NPC_SRC_OK )
+			npc_src_split(npc_src_read_list[i]);
+		npc_src_read_list[i]->done.set_value();
+	}
+}
+
+/**
+ * Starts reading and splitting all npc source files on worker threads, in the order they are loaded.
+ * npc_parsesrcfile then waits for a file to be split instead of reading it, and only compiles and
+ * registers its definitions, in the same order as before, while the workers split the next files.
+ */
+static void npc_src_read_start(void)
+{
+	for( struct npc_src_list* file = npc_src_files; file != NULL; file = file->next ) {
+		struct s_npc_src_read* src = new s_npc_src_read();
+
+		src->path = file->name;
+		src->result = NPC_SRC_NOTFOUND;
+		src->error = 0;
+		src->ready = src->done.get_future();
+		npc_src_read_list.push_back(src);
+		npc_src_read_db[src->path] = src;
+	}
+
+	size_t count = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), NPC_SRC_READ_THREADS);
+
+	count = std::min(count, npc_src_read_list.size());
+	npc_src_read_next = 0;
+	for( size_t i = 0; i < count; i++ )
+		npc_src_read_threads.push_back(std::thread(npc_src_read_run));
+}
+
+/// Stops the worker threads and drops the files that were not parsed
+static void npc_src_read_stop(void)
+{
+	npc_src_read_next = npc_src_read_list.size();
+	for( std::thread& thread : npc_src_read_threads )
+		thread.join();
+	npc_src_read_threads.clear();
+
+	for( struct s_npc_src_read* src : npc_src_read_list )
+		delete src;
+	npc_src_read_list.clear();
+	npc_src_read_db.clear();
+}
+
 /**
  * Read file and create npc/func/mapflag/monster... accordingly.
  * @param filepath : Relative path of file from map-serv bin
@@ -4423,37 +4764,44 @@ int npc_parsesrcfile(const char* filepath)
 {
 	int16 m, x, y;
 	int lines = 0;
-	FILE* fp;
-	size_t len;
+	size_t len, def = 0;
 	char* buffer;
 	const char* p;
 
-	if(check_filepath(filepath)!=2) { //this is not a file 
-		ShowDebug("npc_parsesrcfile: Path doesn't seem to be a file skipping it : '%s'.\n", filepath);
-		return 0;
-	} 
-            
-	// read whole file to buffer
-	fp = fopen(filepath, "rb");
-	if( fp == NULL )
-	{
-		ShowError("npc_parsesrcfile: File not found '%s'.\n", filepath);
-		return 0;
+	// read whole file, or take it and its definitions from the worker threads
+	struct s_npc_src_read single, *src;
+	auto it = npc_src_read_db.find(filepath);
+
+	if( it != npc_src_read_db.end() ) {
+		src = it->second;
+		npc_src_read_db.erase(it);
+		src->ready.wait();
+	} else {
+		src = &single;
+		src->path = filepath;
+		src->error = 0;
+		npc_src_read(src);
 	}
-	fseek(fp, 0, SEEK_END);
-	len = ftell(fp);
+
+	switch( src->result ) {
+		case NPC_SRC_NOTFILE: //this is not a file
+			ShowDebug("npc_parsesrcfile: Path doesn't seem to be a file skipping it : '%s'.\n", filepath);
+			return 0;
+		case NPC_SRC_NOTFOUND:
+			ShowError("npc_parsesrcfile: File not found '%s'.\n", filepath);
+			return 0;
+		case NPC_SRC_FAILED:
+			ShowError("npc_parsesrcfile: Failed to read file '%s' - %s\n", filepath, strerror(src->error));
+			return 0;
+		default:
+			break;
+	}
+
+	len = src->data.length();
 	buffer = (char*)aMalloc(len+1);
-	fseek(fp, 0, SEEK_SET);
-	len = fread(buffer, 1, len, fp);
+	memcpy(buffer, src->data.c_str(), len);
 	buffer[len] = '\0';
-	if( ferror(fp) )
-	{
-		ShowError("npc_parsesrcfile: Failed to read file '%s' - %s\n", filepath, strerror(errno));
-		aFree(buffer);
-		fclose(fp);
-		return 0;
-	}
-	fclose(fp);
+	std::string().swap(src->data); // not needed anymore, the definitions are offsets
 
 	if ((unsigned char)buffer[0] == 0xEF && (unsigned char)buffer[1] == 0xBB && (unsigned char)buffer[2] == 0xBF) {
 		// UTF-8 BOM. This is most likely an error on the user's part, because:
@@ -4474,8 +4822,22 @@ int npc_parsesrcfile(const char* filepath)
 		int i, count;
 		lines++;
 
-		// w1<TAB>w2<TAB>w3<TAB>w4
-		count = sv_parse(p, len+buffer-p, 0, '\t', pos, ARRAYLENGTH(pos), (e_svopt)(SV_TERMINATE_LF|SV_TERMINATE_CRLF));
+		// take the definition split by the worker threads, if the previous one ended where they expected
+		// (it doesn't after skipping a script on an unknown map, the rest of the file is split here then)
+		while( def < src->defs.size() && buffer+src->defs[def].start < p )
+			def++;
+		npc_skip_start = npc_skip_end = NULL;
+		if( def < src->defs.size() && buffer+src->defs[def].start == p ) {
+			count = src->defs[def].count;
+			memcpy(pos, src->defs[def].pos, sizeof(pos));
+			if( src->defs[def].script_end ) {
+				npc_skip_start = buffer+src->defs[def].script_start;
+				npc_skip_end = buffer+src->defs[def].script_end;
+			}
+		} else {
+			// w1<TAB>w2<TAB>w3<TAB>w4
+			count = sv_parse(p, len+buffer-p, 0, '\t', pos, ARRAYLENGTH(pos), (e_svopt)(SV_TERMINATE_LF|SV_TERMINATE_CRLF));
+		}
 		if( count < 0 )
 		{
 			ShowError("npc_parsesrcfile: Parse error in file '%s', line '%d'. Stopping...\n", filepath, strline(buffer,p-buffer));
@@ -4601,6 +4963,8 @@ int npc_parsesrcfile(const char* filepath)
 			p = strchr(p,'\n');// skip and continue
 		}
 	}
+	npc_skip_start = npc_skip_end = NULL;
+	std::vector<struct s_npc_src_def>().swap(src->defs);
 	aFree(buffer);
 
 	return 1;
@@ -4717,6 +5081,7 @@ int npc_reload(void) {
 
 	db_clear(npcname_db);
 	db_clear(ev_db);
+	ev_label_db.clear();
 
 	//Remove all npcs/mobs. [Skotlex]
 
@@ -4772,10 +5137,14 @@ int npc_reload(void) {
 
 	//TODO: the following code is copy-pasted from do_init_npc(); clean it up
 	// Reloading npcs now
+	script_cache_begin();
+	npc_src_read_start();
 	for (nsl = npc_src_files; nsl; nsl = nsl->next) {
 		ShowStatus("Loading NPC file: %s" CL_CLL "\r", nsl->name);
 		npc_parsesrcfile(nsl->name);
 	}
+	npc_src_read_stop();
+	script_cache_end();
 	ShowInfo ("Done loading '" CL_WHITE "%d" CL_RESET "' NPCs:" CL_CLL "\n"
 		"\t-'" CL_WHITE "%d" CL_RESET "' Warps\n"
 		"\t-'" CL_WHITE "%d" CL_RESET "' Shops\n"
@@ -4837,6 +5206,7 @@ bool npc_unloadfile( const char* path ) {
 void do_clear_npc(void) {
 	db_clear(npcname_db);
 	db_clear(ev_db);
+	ev_label_db.clear();
 }
 
 /*==========================================
@@ -4846,6 +5216,9 @@ void do_final_npc(void) {
 	npc_clear_pathlist();
 	script_event.clear();
 	ev_db->destroy(ev_db, NULL);
+	ev_label_db.clear();
+	npc_area_db.clear();
+	npc_area_registered.clear();
 	npcname_db->destroy(npcname_db, NULL);
 	npc_path_db->destroy(npc_path_db, NULL);
 #if PACKETVER >= 20131223
@@ -4923,10 +5296,14 @@ void do_init_npc(void){
 
 	// process all npc files
 	ShowStatus("Loading NPCs...\r");
+	script_cache_begin();
+	npc_src_read_start();
 	for( file = npc_src_files; file != NULL; file = file->next ) {
 		ShowStatus("Loading NPC file: %s" CL_CLL "\r", file->name);
 		npc_parsesrcfile(file->name);
 	}
+	npc_src_read_stop();
+	script_cache_end();
 	ShowInfo ("Done loading '" CL_WHITE "%d" CL_RESET "' NPCs:" CL_CLL "\n"
 		"\t-'" CL_WHITE "%d" CL_RESET "' Warps\n"
 		"\t-'" CL_WHITE "%d" CL_RESET "' Shops\n"
@@ -27,6 +27,7 @@
 
 #include "achievement.hpp"
 #include "atcommand.hpp" // get_atcommand_level()
+#include "autoattack.hpp" // autoattack_config_invalidate()
 #include "battle.hpp" // battle_config
 #include "battleground.hpp"
 #include "buyingstore.hpp"  // struct s_buyingstore
@@ -10313,8 +10314,11 @@ bool pc_setregistry(struct map_session_data *sd, int64 reg, int64 val)
 		}
 	}
 
-	if (!reg_load && p)
+	if (!reg_load && p) {
 		sd->vars_dirty = true;
+		if (strncmp(regname, "AA_", 3) == 0) // Auto-attack settings are compiled, see autoattack_compile
+			autoattack_config_invalidate(sd);
+	}
 
 	return true;
 }
@@ -312,6 +312,19 @@ struct s_qi_display {
 	e_questinfo_markcolor color;
 };
 
+/// Parts of the character compared by chrif_save with the last save.
+/// The first ones match the e_charsave_section bits sent to the char-server.
+enum e_pc_save_part {
+	PC_SAVE_STATUS = 0,
+	PC_SAVE_MEMO,
+	PC_SAVE_SKILLS,
+	PC_SAVE_FRIENDS,
+	PC_SAVE_HOTKEYS,
+	PC_SAVE_INVENTORY,
+	PC_SAVE_CART,
+	PC_SAVE_MAX
+};
+
 struct map_session_data {
 	struct block_list bl;
 	struct unit_data ud;
@@ -712,6 +725,11 @@ struct map_session_data {
 	struct quest *quest_log; ///< Quest log entries (note: Q_COMPLETE quests follow the first <avail_quests>th enties
 	bool save_quest;         ///< Whether the quest_log entries were modified and are waitin to be saved
 
+	uint64 save_hash[PC_SAVE_MAX]; ///< Hash of each part as sent with the last save, 0 if it has to be sent
+	struct mmo_charstatus save_base; ///< Status as sent with the last save, base of the next delta save
+	uint32 save_seq; ///< Number of the last save, 0 if the next one has to be complete
+	int save_deltas; ///< Delta saves since the last complete one
+
 	// Achievement log system
 	struct s_achievement_data {
 		int total_score;                  ///< Total achievement points
@@ -13,6 +13,9 @@
 #include <math.h>
 #include <setjmp.h>
 #include <stdlib.h> // atoi, strtol, strtoll, exit
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #ifdef PCRE_SUPPORT
 #include "../../3rdparty/pcre/include/pcre.h" // preg_match
@@ -208,6 +211,21 @@ static inline void SETVALUE(unsigned char* buf, int i, int n)
 
 // String buffer structures.
 // str_data stores string information
+/// Scope of a variable, given by the prefix of its name
+enum e_var_scope : uint8 {
+	VAR_SCOPE_CHAR, // permanent character variable, no prefix
+	VAR_SCOPE_CHAR_TEMP, // '@' temporary character variable
+	VAR_SCOPE_ACCOUNT, // '#' local account variable
+	VAR_SCOPE_ACCOUNT_GLOBAL, // '##' global account variable
+	VAR_SCOPE_MAPREG, // '$' or '$@' global variable
+	VAR_SCOPE_NPC, // '.' npc variable
+	VAR_SCOPE_FUNCTION, // '.@' scope variable
+	VAR_SCOPE_INSTANCE, // '\'' instance variable
+};
+
+/// Returns if the scope needs an attached player
+#define var_scope_isplayer(scope) ( (scope) <= VAR_SCOPE_ACCOUNT_GLOBAL )
+
 static struct str_data_struct {
 	enum c_op type;
 	int str;
@@ -218,6 +236,11 @@ static struct str_data_struct {
 	int next;
 	const char *name;
 	bool deprecated;
+	// resolved from the name by add_str, so variable accesses don't inspect it
+	enum e_var_scope var_scope;
+	bool var_string; // name ends with '$'
+	bool var_longname; // name too long for a variable, see script_check_RegistryVariableLength
+	unsigned int var_slot; // '.@' variable: slot it was last found in, see script_slot_find
 } *str_data = nullptr;
 static int str_data_size = 0; // size of the data
 static int str_num = LABEL_START; // next id to be assigned
@@ -747,6 +770,29 @@ int add_str(const char* p)
 	str_data[str_num].func = NULL;
 	str_data[str_num].backpatch = -1;
 	str_data[str_num].label = -1;
+	str_data[str_num].var_string = ( len > 0 && p[len - 1] == '$' );
+	str_data[str_num].var_longname = !script_check_RegistryVariableLength( 0, p, NULL );
+	str_data[str_num].var_slot = 0;
+	switch( p[0] ){
+		case '@':
+			str_data[str_num].var_scope = VAR_SCOPE_CHAR_TEMP;
+			break;
+		case '#':
+			str_data[str_num].var_scope = ( p[1] == '#' ) ? VAR_SCOPE_ACCOUNT_GLOBAL : VAR_SCOPE_ACCOUNT;
+			break;
+		case '$':
+			str_data[str_num].var_scope = VAR_SCOPE_MAPREG;
+			break;
+		case '.':
+			str_data[str_num].var_scope = ( p[1] == '@' ) ? VAR_SCOPE_FUNCTION : VAR_SCOPE_NPC;
+			break;
+		case '\'':
+			str_data[str_num].var_scope = VAR_SCOPE_INSTANCE;
+			break;
+		default:
+			str_data[str_num].var_scope = VAR_SCOPE_CHAR;
+			break;
+	}
 	str_pos += len+1;
 
 	return str_num++;
@@ -859,7 +905,8 @@ void set_label(int l,int pos, const char* script_pos_cur)
 }
 
 /// Skips spaces and/or comments.
-const char* skip_space(const char* p)
+/// Sets unclosed instead of warning when the buffer ends inside a block comment.
+static const char* skip_space_sub(const char* p, bool* unclosed)
 {
 	if( p == NULL )
 		return NULL;
@@ -878,7 +925,7 @@ const char* skip_space(const char* p)
 			for(;;)
 			{
 				if( *p == '\0' ) {
-					disp_warning_message("script:script->skip_space: end of file while parsing block comment. expected " CL_BOLD "*/" CL_NORM, p);
+					*unclosed = true;
 					return p;
 				}
 				if( *p == '*' && p[1] == '/' )
@@ -895,6 +942,27 @@ const char* skip_space(const char* p)
 	return p;
 }
 
+/// Skips spaces and/or comments.
+const char* skip_space(const char* p)
+{
+	bool unclosed = false;
+
+	p = skip_space_sub(p, &unclosed);
+	if( unclosed )
+		disp_warning_message("script:script->skip_space: end of file while parsing block comment. expected " CL_BOLD "*/" CL_NORM, p);
+	return p;
+}
+
+/// Skips spaces and/or comments, without using the parser state.
+/// Returns NULL when the buffer ends inside a block comment.
+const char* skip_space_quiet(const char* p)
+{
+	bool unclosed = false;
+
+	p = skip_space_sub(p, &unclosed);
+	return unclosed ? NULL : p;
+}
+
 /// Skips a word.
 /// A word consists of undercores and/or alphanumeric characters,
 /// and valid variable prefixes/postfixes.
@@ -2659,6 +2727,369 @@ struct script_code* parse_script(const char *src,const char *file,int line,int o
 	return code;
 }
 
+/*==========================================
+ * Compiled script cache
+ *
+ * The scripts of the npc files are compiled once, and stored in
+ * script_cache_file with the names they reference and their labels.
+ * A script whose source is unchanged is rebuilt from there instead of
+ * being parsed again, as long as the buildins, parameters and constants
+ * it was compiled against are the same. A change to any of them
+ * discards the whole cache.
+ *------------------------------------------*/
+
+#define SCRIPT_CACHE_MAGIC "RASC"
+#define SCRIPT_CACHE_VERSION 1
+
+/// Compiled script, stored in the cache
+struct s_script_cache_entry {
+	std::string buf; // compiled code
+	std::vector<std::pair<int, std::string>> names; // position of a str_data id in buf -> referenced name
+	std::vector<std::pair<std::string, int>> labels; // label name -> position in buf, with SCRIPT_USE_LABEL_DB
+};
+
+static char script_cache_file[256] = ""; // empty when disabled
+static bool script_cache_active = false; // between script_cache_begin and script_cache_end
+static uint64 script_cache_env = 0; // fingerprint of the buildins, parameters and constants
+static std::unordered_map<uint64, struct s_script_cache_entry> script_cache_db; // source hash -> entry, read from the file
+static std::unordered_map<uint64, struct s_script_cache_entry> script_cache_used; // source hash -> entry, written back to the file
+static int script_cache_hits = 0, script_cache_misses = 0;
+
+/// 64-bit FNV-1a hash
+static uint64 script_cache_hash(uint64 hash, const void* data, size_t len)
+{
+	const unsigned char* p = (const unsigned char*)data;
+
+	for( size_t i = 0; i < len; i++ ){
+		hash ^= p[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+/// Fingerprint of everything that is resolved or checked when compiling a script
+static uint64 script_cache_fingerprint(void)
+{
+	uint64 hash = 14695981039346656037ULL;
+	int version = SCRIPT_CACHE_VERSION;
+
+	hash = script_cache_hash(hash, &version, sizeof(version));
+	for( int i = LABEL_START; i < str_num; i++ ){
+		if( str_data[i].type != C_INT && str_data[i].type != C_PARAM && str_data[i].type != C_FUNC )
+			continue;
+
+		const char* name = get_str(i);
+
+		hash = script_cache_hash(hash, name, strlen(name) + 1);
+		hash = script_cache_hash(hash, &str_data[i].type, sizeof(str_data[i].type));
+		hash = script_cache_hash(hash, &str_data[i].val, sizeof(str_data[i].val));
+		if( str_data[i].type == C_FUNC && buildin_func[str_data[i].val].arg )
+			hash = script_cache_hash(hash, buildin_func[str_data[i].val].arg, strlen(buildin_func[str_data[i].val].arg) + 1);
+	}
+
+	return hash;
+}
+
+static bool script_cache_read_string(FILE* fp, std::string& str)
+{
+	uint16 len;
+
+	if( fread(&len, sizeof(len), 1, fp) != 1 )
+		return false;
+	str.resize(len);
+
+	return len == 0 || fread(&str[0], len, 1, fp) == 1;
+}
+
+static void script_cache_write_string(FILE* fp, const std::string& str)
+{
+	uint16 len = (uint16)str.length();
+
+	fwrite(&len, sizeof(len), 1, fp);
+	fwrite(str.c_str(), len, 1, fp);
+}
+
+/// Reads the cache file, if it was written with the current fingerprint
+static void script_cache_read(void)
+{
+	FILE* fp = fopen(script_cache_file, "rb");
+	char magic[4];
+	int version;
+	uint64 env;
+	uint32 count;
+
+	if( fp == NULL )
+		return;
+
+	if( fread(magic, sizeof(magic), 1, fp) != 1 || memcmp(magic, SCRIPT_CACHE_MAGIC, sizeof(magic)) != 0
+		|| fread(&version, sizeof(version), 1, fp) != 1 || version != SCRIPT_CACHE_VERSION
+		|| fread(&env, sizeof(env), 1, fp) != 1 || fread(&count, sizeof(count), 1, fp) != 1 ){
+		ShowWarning("script_cache_read: Ignoring invalid script cache '%s'.\n", script_cache_file);
+		fclose(fp);
+		return;
+	}
+
+	if( env != script_cache_env ){
+		ShowInfo("Script cache '%s' is outdated, compiling all scripts.\n", script_cache_file);
+		fclose(fp);
+		return;
+	}
+
+	for( uint32 i = 0; i < count; i++ ){
+		struct s_script_cache_entry entry;
+		uint64 key;
+		uint32 size, num;
+		bool valid = true;
+
+		if( fread(&key, sizeof(key), 1, fp) != 1 || fread(&size, sizeof(size), 1, fp) != 1 )
+			break;
+		entry.buf.resize(size);
+		if( size == 0 || fread(&entry.buf[0], size, 1, fp) != 1 )
+			break;
+
+		if( fread(&num, sizeof(num), 1, fp) != 1 )
+			break;
+		for( uint32 j = 0; j < num && valid; j++ ){
+			uint32 pos;
+			std::string name;
+
+			valid = ( fread(&pos, sizeof(pos), 1, fp) == 1 && script_cache_read_string(fp, name) && pos + 3 <= size && !name.empty() );
+			entry.names.emplace_back(pos, name);
+		}
+
+		if( !valid || fread(&num, sizeof(num), 1, fp) != 1 )
+			break;
+		for( uint32 j = 0; j < num && valid; j++ ){
+			uint32 pos;
+			std::string name;
+
+			valid = ( script_cache_read_string(fp, name) && fread(&pos, sizeof(pos), 1, fp) == 1 && pos < size && !name.empty() );
+			entry.labels.emplace_back(name, pos);
+		}
+
+		if( !valid )
+			break;
+		script_cache_db[key] = std::move(entry);
+	}
+
+	if( script_cache_db.size() != count ){
+		ShowWarning("script_cache_read: Script cache '%s' is damaged, compiling all scripts.\n", script_cache_file);
+		script_cache_db.clear();
+	}
+
+	fclose(fp);
+}
+
+/// Writes the scripts compiled or reused since script_cache_begin to the cache file
+static void script_cache_write(void)
+{
+	FILE* fp = fopen(script_cache_file, "wb");
+	int version = SCRIPT_CACHE_VERSION;
+	uint32 count = (uint32)script_cache_used.size();
+
+	if( fp == NULL ){
+		ShowError("script_cache_write: Can't write script cache '%s'.\n", script_cache_file);
+		return;
+	}
+
+	fwrite(SCRIPT_CACHE_MAGIC, 4, 1, fp);
+	fwrite(&version, sizeof(version), 1, fp);
+	fwrite(&script_cache_env, sizeof(script_cache_env), 1, fp);
+	fwrite(&count, sizeof(count), 1, fp);
+
+	for( const auto& it : script_cache_used ){
+		const struct s_script_cache_entry& entry = it.second;
+		uint32 size = (uint32)entry.buf.length(), num;
+
+		fwrite(&it.first, sizeof(it.first), 1, fp);
+		fwrite(&size, sizeof(size), 1, fp);
+		fwrite(entry.buf.c_str(), size, 1, fp);
+
+		num = (uint32)entry.names.size();
+		fwrite(&num, sizeof(num), 1, fp);
+		for( const auto& name : entry.names ){
+			uint32 pos = name.first;
+
+			fwrite(&pos, sizeof(pos), 1, fp);
+			script_cache_write_string(fp, name.second);
+		}
+
+		num = (uint32)entry.labels.size();
+		fwrite(&num, sizeof(num), 1, fp);
+		for( const auto& label : entry.labels ){
+			uint32 pos = label.second;
+
+			script_cache_write_string(fp, label.first);
+			fwrite(&pos, sizeof(pos), 1, fp);
+		}
+	}
+
+	fclose(fp);
+}
+
+/**
+ * Starts using the compiled script cache, for a load of the npc files.
+ * Called once the buildins, parameters and constants are all defined.
+ */
+void script_cache_begin(void)
+{
+	if( script_cache_file[0] == '\0' )
+		return;
+
+	script_cache_env = script_cache_fingerprint();
+	script_cache_db.clear();
+	script_cache_used.clear();
+	script_cache_hits = 0;
+	script_cache_misses = 0;
+	script_cache_read();
+	script_cache_active = true;
+}
+
+/**
+ * Stops using the compiled script cache and saves the scripts of this load.
+ * Entries of sources that were not loaded are dropped.
+ */
+void script_cache_end(void)
+{
+	if( !script_cache_active )
+		return;
+
+	script_cache_active = false;
+	script_cache_write();
+	ShowInfo("Loaded '" CL_WHITE "%d" CL_RESET "' scripts from the script cache, compiled '" CL_WHITE "%d" CL_RESET "'.\n", script_cache_hits, script_cache_misses);
+	script_cache_db.clear();
+	script_cache_used.clear();
+}
+
+static int script_cache_store_label(DBKey key, DBData* data, va_list ap)
+{
+	struct s_script_cache_entry* entry = va_arg(ap, struct s_script_cache_entry*);
+
+	entry->labels.emplace_back(key.str, db_data2i(data));
+	return 0;
+}
+
+/// Stores a compiled script in the cache, with the names it references
+static void script_cache_store(uint64 key, struct script_code* code, int options)
+{
+	struct s_script_cache_entry entry;
+	unsigned char* buf = code->script_buf;
+	int pos = 0;
+
+	entry.buf.assign((const char*)buf, code->script_size);
+
+	while( pos < code->script_size ){
+		switch( get_com(buf, &pos) ){
+			case C_INT:
+				get_num(buf, &pos);
+				break;
+			case C_POS:
+				pos += 3;
+				break;
+			case C_NAME:
+				entry.names.emplace_back(pos, get_str(GETVALUE(buf, pos)));
+				pos += 3;
+				break;
+			case C_STR:
+				pos += (int)strlen((const char*)buf + pos) + 1;
+				break;
+			default:
+				break;
+		}
+	}
+
+	if( options&SCRIPT_USE_LABEL_DB )
+		scriptlabel_db->foreach(scriptlabel_db, script_cache_store_label, &entry);
+
+	script_cache_used[key] = std::move(entry);
+}
+
+/// Rebuilds a compiled script from the cache, resolving the names it references
+static struct script_code* script_cache_restore(const struct s_script_cache_entry& entry, int options)
+{
+	struct script_code* code;
+
+	CREATE(code, struct script_code, 1);
+	code->script_size = (int)entry.buf.length();
+	code->script_buf = (unsigned char*)aMalloc(code->script_size);
+	memcpy(code->script_buf, entry.buf.c_str(), code->script_size);
+	code->local.vars = NULL;
+	code->local.arrays = NULL;
+
+	for( const auto& name : entry.names ){
+		int id = add_str(name.second.c_str());
+
+		switch( str_data[id].type ){
+			case C_NOP:
+			case C_POS:
+			case C_USERFUNC:
+			case C_USERFUNC_POS:
+				// same as an unknown reference defaulted to a variable by parse_script
+				str_data[id].type = C_NAME;
+				str_data[id].backpatch = -1;
+				str_data[id].label = id;
+				break;
+			default:
+				break;
+		}
+		SETVALUE(code->script_buf, name.first, id);
+	}
+
+	if( options&SCRIPT_USE_LABEL_DB ){
+		db_clear(scriptlabel_db);
+		for( const auto& label : entry.labels )
+			strdb_iput(scriptlabel_db, label.first.c_str(), label.second);
+	}
+
+	return code;
+}
+
+/**
+ * Analysis of the script, reusing the compiled script cache when it is active.
+ * @param src: Source, the first len characters of which are compiled
+ * @param len: Length of the script in src
+ * @param file: File the script is in, for error messages
+ * @param line: Line the script starts on, for error messages
+ * @param options: Parse options (SCRIPT_*)
+ * @return Compiled script, or NULL on error or empty script
+ */
+struct script_code* parse_script_cached(const char* src, size_t len, const char* file, int line, int options)
+{
+	if( !script_cache_active || src == NULL )
+		return parse_script(src, file, line, options);
+
+	uint64 key = script_cache_hash(script_cache_env, &options, sizeof(options));
+
+	key = script_cache_hash(key, src, len);
+
+	auto used = script_cache_used.find(key);
+
+	if( used != script_cache_used.end() ){// duplicated source
+		script_cache_hits++;
+		return script_cache_restore(used->second, options);
+	}
+
+	auto cached = script_cache_db.find(key);
+
+	if( cached != script_cache_db.end() ){
+		struct script_code* code = script_cache_restore(cached->second, options);
+
+		script_cache_hits++;
+		script_cache_used[key] = std::move(cached->second);
+		script_cache_db.erase(cached);
+		return code;
+	}
+
+	struct script_code* code = parse_script(src, file, line, options);
+
+	script_cache_misses++;
+	if( code != NULL )
+		script_cache_store(key, code, options);
+
+	return code;
+}
+
 /// Returns the player attached to this script, identified by the rid.
 /// If there is no player attached, the script is terminated.
 static bool script_rid2sd_( struct script_state *st, struct map_session_data** sd, const char *func ){
@@ -2675,6 +3106,85 @@ static bool script_rid2sd_( struct script_state *st, struct map_session_data** s
 	}
 }
 
+/// '.@' integer variable in a scope slot
+struct script_slot {
+	int id; // name id
+	int64 value;
+};
+
+/// '.@' integer variables of a scope.
+/// They are kept in slots instead of the vars db, so that loops read and write them without hashing:
+/// each name remembers the slot it was last found in, the index is only used when that slot
+/// belongs to another variable (same name in another scope, recursion).
+/// Array members other than [0] stay in the vars db, along with the array data.
+struct script_slots {
+	std::vector<struct script_slot> list;
+	std::unordered_map<int, unsigned int> index; // name id -> slot
+};
+
+/// Finds the slot of a '.@' integer variable, NULL if it isn't set in this scope.
+static struct script_slot* script_slot_find(struct script_slots* slots, int id)
+{
+	unsigned int& last = str_data[id].var_slot;
+
+	if( slots == NULL )
+		return NULL;
+	if( last < slots->list.size() && slots->list[last].id == id )
+		return &slots->list[last];
+
+	auto it = slots->index.find(id);
+
+	if( it == slots->index.end() )
+		return NULL;
+
+	last = it->second;
+	return &slots->list[last];
+}
+
+/// Reads a '.@' integer variable from the slots of a scope.
+static int64 script_slot_get(struct reg_db* scope, int id)
+{
+	struct script_slot* slot = script_slot_find(scope->slots, id);
+
+	return slot ? slot->value : 0;
+}
+
+/// Writes a '.@' integer variable to the slots of a scope.
+static void script_slot_set(struct reg_db* scope, int id, int64 value)
+{
+	struct script_slot* slot = script_slot_find(scope->slots, id);
+
+	if( slot != NULL ) {
+		slot->value = value;
+		return;
+	}
+	if( value == 0 )
+		return;// unset variables are 0
+
+	if( scope->slots == NULL )
+		scope->slots = new script_slots();
+	str_data[id].var_slot = (unsigned int)scope->slots->list.size();
+	scope->slots->index[id] = str_data[id].var_slot;
+	scope->slots->list.push_back({ id, value });
+}
+
+/// Frees the slots of a scope.
+static void script_slot_free(struct reg_db* scope)
+{
+	delete scope->slots;
+	scope->slots = NULL;
+}
+
+/// Returns the reference to the current scope passed to callfunc/callsub for a '.@' argument.
+/// The slots are shared with the reference, so they are allocated now if they weren't yet.
+static struct reg_db* script_scope_ref(struct script_state* st, struct reg_db* ref)
+{
+	if( st->stack->scope.slots == NULL )
+		st->stack->scope.slots = new script_slots();
+	ref->slots = st->stack->scope.slots;
+	return ref;
+}
+
 /**
  * Dereferences a variable/constant, replacing it with a copy of the value.
  * @param st Script state
@@ -2683,26 +3193,20 @@ static bool script_rid2sd_( struct script_state *st, struct map_session_data** s
  */
 struct script_data *get_val_(struct script_state* st, struct script_data* data, struct map_session_data *sd)
 {
-	const char* name;
-	char prefix;
-	char postfix;
-
 	if( !data_isreference(data) )
 		return data;// not a variable/constant
 
-	name = reference_getname(data);
-	prefix = name[0];
-	postfix = name[strlen(name) - 1];
+	const struct str_data_struct& var = str_data[reference_getid(data)];
 
 	//##TODO use reference_tovariable(data) when it's confirmed that it works [FlavioJS]
-	if( !reference_toconstant(data) && not_server_variable(prefix) ) {
+	if( !reference_toconstant(data) && var_scope_isplayer(var.var_scope) ) {
 		if( sd == NULL && !script_rid2sd(sd) ) {// needs player attached
-			if( postfix == '$' ) {// string variable
-				ShowWarning("script:get_val: cannot access player variable '%s', defaulting to \"\"\n", name);
+			if( var.var_string ) {// string variable
+				ShowWarning("script:get_val: cannot access player variable '%s', defaulting to \"\"\n", reference_getname(data));
 				data->type = C_CONSTSTR;
 				data->u.str = const_cast<char *>("");
 			} else {// integer variable
-				ShowWarning("script:get_val: cannot access player variable '%s', defaulting to 0\n", name);
+				ShowWarning("script:get_val: cannot access player variable '%s', defaulting to 0\n", reference_getname(data));
 				data->type = C_INT;
 				data->u.num = 0;
 			}
@@ -2710,25 +3214,26 @@ struct script_data *get_val_(struct script_state* st, struct script_data* data,
 		}
 	}
 
-	if( postfix == '$' ) {// string variable
+	if( var.var_string ) {// string variable
 
-		switch( prefix ) {
-			case '@':
+		switch( var.var_scope ) {
+			case VAR_SCOPE_CHAR_TEMP:
 				data->u.str = pc_readregstr(sd, data->u.num);
 				break;
-			case '$':
+			case VAR_SCOPE_MAPREG:
 				data->u.str = mapreg_readregstr(data->u.num);
 				break;
-			case '#':
-				if( name[1] == '#' )
-					data->u.str = pc_readaccountreg2str(sd, data->u.num);// global
-				else
-					data->u.str = pc_readaccountregstr(sd, data->u.num);// local
+			case VAR_SCOPE_ACCOUNT_GLOBAL:
+				data->u.str = pc_readaccountreg2str(sd, data->u.num);
 				break;
-			case '.':
+			case VAR_SCOPE_ACCOUNT:
+				data->u.str = pc_readaccountregstr(sd, data->u.num);
+				break;
+			case VAR_SCOPE_NPC:
+			case VAR_SCOPE_FUNCTION:
 				{
 					struct DBMap* n = data->ref ?
-							data->ref->vars : name[1] == '@' ?
+							data->ref->vars : var.var_scope == VAR_SCOPE_FUNCTION ?
 							st->stack->scope.vars : // instance/scope variable
 							st->script->local.vars; // npc variable
 					if( n )
@@ -2737,7 +3242,7 @@ struct script_data *get_val_(struct script_state* st, struct script_data* data,
 						data->u.str = NULL;
 				}
 				break;
-			case '\'':
+			case VAR_SCOPE_INSTANCE:
 				{
 					struct DBMap* n = nullptr;
 					if (data->ref)
@@ -2751,7 +3256,7 @@ struct script_data *get_val_(struct script_state* st, struct script_data* data,
 					if (n)
 						data->u.str = (char*)i64db_get(n,reference_getuid(data));
 					else {
-						ShowWarning("script:get_val: cannot access instance variable '%s', defaulting to \"\"\n", name);
+						ShowWarning("script:get_val: cannot access instance variable '%s', defaulting to \"\"\n", reference_getname(data));
 						data->u.str = NULL;
 					}
 					break;
@@ -2778,23 +3283,29 @@ struct script_data *get_val_(struct script_state* st, struct script_data* data,
 		} else if( reference_toparam(data) ) {
 			data->u.num = pc_readparam(sd, reference_getparamtype(data));
 		} else
-			switch( prefix ) {
-				case '@':
+			switch( var.var_scope ) {
+				case VAR_SCOPE_CHAR_TEMP:
 					data->u.num = pc_readreg(sd, data->u.num);
 					break;
-				case '$':
+				case VAR_SCOPE_MAPREG:
 					data->u.num = mapreg_readreg(data->u.num);
 					break;
-				case '#':
-					if( name[1] == '#' )
-						data->u.num = pc_readaccountreg2(sd, data->u.num);// global
-					else
-						data->u.num = pc_readaccountreg(sd, data->u.num);// local
+				case VAR_SCOPE_ACCOUNT_GLOBAL:
+					data->u.num = pc_readaccountreg2(sd, data->u.num);
 					break;
-				case '.':
+				case VAR_SCOPE_ACCOUNT:
+					data->u.num = pc_readaccountreg(sd, data->u.num);
+					break;
+				case VAR_SCOPE_FUNCTION:
+					if( reference_getindex(data) == 0 ) {// not an array member, in a slot
+						data->u.num = script_slot_get(data->ref ? data->ref : &st->stack->scope, reference_getid(data));
+						break;
+					}
+					// fall through
+				case VAR_SCOPE_NPC:
 					{
 						struct DBMap* n = data->ref ?
-								data->ref->vars : name[1] == '@' ?
+								data->ref->vars : var.var_scope == VAR_SCOPE_FUNCTION ?
 								st->stack->scope.vars : // instance/scope variable
 								st->script->local.vars; // npc variable
 						if( n )
@@ -2803,7 +3314,7 @@ struct script_data *get_val_(struct script_state* st, struct script_data* data,
 							data->u.num = 0;
 					}
 					break;
-				case '\'':
+				case VAR_SCOPE_INSTANCE:
 					{
 						struct DBMap* n = nullptr;
 						if (data->ref)
@@ -2817,7 +3328,7 @@ struct script_data *get_val_(struct script_state* st, struct script_data* data,
 						if (n)
 							data->u.num = i64db_i64get(n,reference_getuid(data));
 						else {
-							ShowWarning("script:get_val: cannot access instance variable '%s', defaulting to 0\n", name);
+							ShowWarning("script:get_val: cannot access instance variable '%s', defaulting to 0\n", reference_getname(data));
 							data->u.num = 0;
 						}
 						break;
@@ -3137,29 +3648,31 @@ void script_array_update(struct reg_db *src, int64 num, bool empty)
  * TODO: return values are screwed up, have been for some time (reaad: years), e.g. some functions return 1 failure and success.
  *------------------------------------------*/
 bool set_reg_str( struct script_state* st, struct map_session_data* sd, int64 num, const char* name, const char* value, struct reg_db *ref ){
-	char prefix = name[0];
-	size_t vlen = 0;
+	const struct str_data_struct& var = str_data[script_getvarid( num )];
 
-	if( !script_check_RegistryVariableLength( 0, name, &vlen ) ){
-		ShowError( "set_reg: Variable name length is too long (aid: %d, cid: %d): '%s' sz=%" PRIuPTR "\n", sd ? sd->status.account_id : -1, sd ? sd->status.char_id : -1, name, vlen );
+	if( var.var_longname ){
+		ShowError( "set_reg: Variable name length is too long (aid: %d, cid: %d): '%s' sz=%" PRIuPTR "\n", sd ? sd->status.account_id : -1, sd ? sd->status.char_id : -1, name, strlen( name ) );
 		return false;
 	}
 
-	if( !is_string_variable( name ) ){
+	if( !var.var_string ){
 		// integer variable
 		return false;
 	}
 
-	switch( prefix ){
-		case '@':
+	switch( var.var_scope ){
+		case VAR_SCOPE_CHAR_TEMP:
 			pc_setregstr( sd, num, value );
 			return true;
-		case '$':
+		case VAR_SCOPE_MAPREG:
 			return mapreg_setregstr( num, value );
-		case '#':
-			return ( name[1] == '#' ) ? pc_setaccountreg2str( sd, num, value ) : pc_setaccountregstr( sd, num, value );
-		case '.': {
-				struct reg_db *n = ( ref ) ? ref : ( name[1] == '@' ) ? &st->stack->scope : &st->script->local;
+		case VAR_SCOPE_ACCOUNT_GLOBAL:
+			return pc_setaccountreg2str( sd, num, value );
+		case VAR_SCOPE_ACCOUNT:
+			return pc_setaccountregstr( sd, num, value );
+		case VAR_SCOPE_NPC:
+		case VAR_SCOPE_FUNCTION: {
+				struct reg_db *n = ( ref ) ? ref : ( var.var_scope == VAR_SCOPE_FUNCTION ) ? &st->stack->scope : &st->script->local;
 
 				if( n ){
 					if( value[0] ){
@@ -3178,7 +3691,7 @@ bool set_reg_str( struct script_state* st, struct map_session_data* sd, int64 nu
 				}
 			}
 			return true;
-		case '\'': {
+		case VAR_SCOPE_INSTANCE: {
 				struct reg_db *src = nullptr;
 
 				if( ref ){
@@ -3217,21 +3730,20 @@ bool set_reg_str( struct script_state* st, struct map_session_data* sd, int64 nu
 }
 
 bool set_reg_num( struct script_state* st, struct map_session_data* sd, int64 num, const char* name, int64 value, struct reg_db *ref ){
-	char prefix = name[0];
-	size_t vlen = 0;
+	const struct str_data_struct& var = str_data[script_getvarid( num )];
 
-	if( !script_check_RegistryVariableLength( 0, name, &vlen ) ){
-		ShowError( "set_reg: Variable name length is too long (aid: %d, cid: %d): '%s' sz=%" PRIuPTR "\n", sd ? sd->status.account_id : -1, sd ? sd->status.char_id : -1, name, vlen );
+	if( var.var_longname ){
+		ShowError( "set_reg: Variable name length is too long (aid: %d, cid: %d): '%s' sz=%" PRIuPTR "\n", sd ? sd->status.account_id : -1, sd ? sd->status.char_id : -1, name, strlen( name ) );
 		return false;
 	}
 
-	if( is_string_variable( name ) ){
+	if( var.var_string ){
 		// string variable
 		return false;
 	}
 
-	if( str_data[script_getvarid(num)].type == C_PARAM ){
-		if( pc_setparam( sd, str_data[script_getvarid(num)].val, value ) == 0 ){
+	if( var.type == C_PARAM ){
+		if( pc_setparam( sd, var.val, value ) == 0 ){
 			if( st != NULL ) {
 				ShowError( "script_set_reg: failed to set param '%s' to %" PRId64 ".\n", name, value );
 				script_reportsrc( st );
@@ -3244,16 +3756,25 @@ bool set_reg_num( struct script_state* st, struct map_session_data* sd, int64 nu
 		return true;
 	}
 
-	switch( prefix ){
-		case '@':
+	switch( var.var_scope ){
+		case VAR_SCOPE_CHAR_TEMP:
 			pc_setreg( sd, num, value );
 			return true;
-		case '$':
+		case VAR_SCOPE_MAPREG:
 			return mapreg_setreg( num, value );
-		case '#':
-			return ( name[1] == '#' ) ? pc_setaccountreg2(sd, num, value) :	pc_setaccountreg( sd, num, value );
-		case '.': {
-				struct reg_db *n = ( ref ) ? ref : ( name[1] == '@' ) ? &st->stack->scope : &st->script->local;
+		case VAR_SCOPE_ACCOUNT_GLOBAL:
+			return pc_setaccountreg2( sd, num, value );
+		case VAR_SCOPE_ACCOUNT:
+			return pc_setaccountreg( sd, num, value );
+		case VAR_SCOPE_FUNCTION:
+			if( script_getvaridx( num ) == 0 ){
+				// not an array member, in a slot
+				script_slot_set( ( ref ) ? ref : &st->stack->scope, script_getvarid( num ), value );
+				return true;
+			}
+			// fall through
+		case VAR_SCOPE_NPC: {
+				struct reg_db *n = ( ref ) ? ref : ( var.var_scope == VAR_SCOPE_FUNCTION ) ? &st->stack->scope : &st->script->local;
 
 				if( n ){
 					if( value != 0 ){
@@ -3272,7 +3793,7 @@ bool set_reg_num( struct script_state* st, struct map_session_data* sd, int64 nu
 				}
 			}
 			return true;
-		case '\'': {
+		case VAR_SCOPE_INSTANCE: {
 				struct reg_db *src = nullptr;
 
 				if( ref ){
@@ -3315,7 +3836,7 @@ bool set_var_str( struct map_session_data* sd, const char* name, const char* val
 }
 
 bool clear_reg( struct script_state* st, struct map_session_data* sd, int64 num, const char* name, struct reg_db *ref ){
-	if( is_string_variable( name ) ){
+	if( str_data[script_getvarid( num )].var_string ){
 		return set_reg_str( st, sd, num, name, "", ref );
 	}else{
 		return set_reg_num( st, sd, num, name, 0, ref );
@@ -3549,6 +4070,7 @@ void pop_stack(struct script_state* st, int start, int end)
 				ri->scope.arrays->destroy(ri->scope.arrays, script_free_array_db);
 				ri->scope.arrays = NULL;
 			}
+			script_slot_free(&ri->scope);
 			if( data->ref )
 				aFree(data->ref);
 			aFree(ri);
@@ -3633,6 +4155,7 @@ struct script_state* script_alloc_state(struct script_code* rootscript, int pos,
 	st->stack->defsp = st->stack->sp;
 	st->stack->scope.vars = i64db_alloc(DB_OPT_RELEASE_DATA);
 	st->stack->scope.arrays = NULL;
+	st->stack->scope.slots = NULL;
 	st->state = RUN;
 	st->script = rootscript;
 	st->pos = pos;
@@ -3686,6 +4209,7 @@ void script_free_state(struct script_state* st)
 			script_free_vars(st->stack->scope.vars);
 			if (st->stack->scope.arrays)
 				st->stack->scope.arrays->destroy(st->stack->scope.arrays, script_free_array_db);
+			script_slot_free(&st->stack->scope);
 			pop_stack(st, 0, st->stack->sp);
 			aFree(st->stack->stack_data);
 			ers_free(stack_ers, st->stack);
@@ -4158,6 +4682,7 @@ int run_func(struct script_state *st)
 		}
 		script_free_vars(st->stack->scope.vars);
 		st->stack->scope.arrays->destroy(st->stack->scope.arrays, script_free_array_db);
+		script_slot_free(&st->stack->scope);
 
 		ri = st->stack->stack_data[st->stack->defsp-1].u.ri;
 		nargs = ri->nargs;
@@ -4165,6 +4690,7 @@ int run_func(struct script_state *st)
 		st->script = ri->script;
 		st->stack->scope.vars = ri->scope.vars;
 		st->stack->scope.arrays = ri->scope.arrays;
+		st->stack->scope.slots = ri->scope.slots;
 		st->stack->defsp = ri->defsp;
 		memset(ri, 0, sizeof(struct script_retinfo));
 
@@ -4557,6 +5083,9 @@ int script_config_read(const char *cfgName)
 		else if(strcmpi(w1,"warn_func_mismatch_argtypes")==0) {
 			script_config.warn_func_mismatch_argtypes = config_switch(w2);
 		}
+		else if(strcmpi(w1,"script_cache")==0) {
+			safestrncpy(script_cache_file, w2, sizeof(script_cache_file));
+		}
 		else if(strcmpi(w1,"import")==0){
 			script_config_read(w2);
 		}
@@ -5386,7 +5915,7 @@ BUILDIN_FUNC(callfunc)
 			const char* name = reference_getname(data);
 
 			if (name[0] == '.')
-				data->ref = (name[1] == '@' ? &ref[0] : &ref[1]);
+				data->ref = (name[1] == '@' ? script_scope_ref(st, &ref[0]) : &ref[1]);
 		}
 	}
 
@@ -5394,6 +5923,7 @@ BUILDIN_FUNC(callfunc)
 	ri->script       = st->script;              // script code
 	ri->scope.vars   = st->stack->scope.vars;   // scope variables
 	ri->scope.arrays = st->stack->scope.arrays; // scope arrays
+	ri->scope.slots  = st->stack->scope.slots;  // scope variable slots
 	ri->pos          = st->pos;                 // script location
 	ri->nargs        = j;                       // argument count
 	ri->defsp        = st->stack->defsp;        // default stack pointer
@@ -5405,6 +5935,7 @@ BUILDIN_FUNC(callfunc)
 	st->state = GOTO;
 	st->stack->scope.vars = i64db_alloc(DB_OPT_RELEASE_DATA);
 	st->stack->scope.arrays = idb_alloc(DB_OPT_BASE);
+	st->stack->scope.slots = NULL;
 
 	if (!st->script->local.vars)
 		st->script->local.vars = i64db_alloc(DB_OPT_RELEASE_DATA);
@@ -5442,7 +5973,7 @@ BUILDIN_FUNC(callsub)
 			const char* name = reference_getname(data);
 
 			if (name[0] == '.' && name[1] == '@')
-				data->ref = &ref[0];
+				data->ref = script_scope_ref(st, &ref[0]);
 		}
 	}
 
@@ -5450,6 +5981,7 @@ BUILDIN_FUNC(callsub)
 	ri->script       = st->script;              // script code
 	ri->scope.vars   = st->stack->scope.vars;   // scope variables
 	ri->scope.arrays = st->stack->scope.arrays; // scope arrays
+	ri->scope.slots  = st->stack->scope.slots;  // scope variable slots
 	ri->pos          = st->pos;                 // script location
 	ri->nargs        = j;                       // argument count
 	ri->defsp        = st->stack->defsp;        // default stack pointer
@@ -5460,6 +5992,7 @@ BUILDIN_FUNC(callsub)
 	st->state = GOTO;
 	st->stack->scope.vars = i64db_alloc(DB_OPT_RELEASE_DATA);
 	st->stack->scope.arrays = idb_alloc(DB_OPT_BASE);
+	st->stack->scope.slots = NULL;
 
 	return SCRIPT_CMD_SUCCESS;
 }
@@ -25245,6 +25778,13 @@ BUILDIN_FUNC(achievement_condition){
 	return SCRIPT_CMD_SUCCESS;
 }
 
+// This function is only meant to be used inside of achievement conditions, ARG<n> is rewritten into it
+BUILDIN_FUNC(achievement_condition_arg){
+	script_pushint( st, achievement_condition_arg( script_getnum( st, 2 ) ) );
+
+	return SCRIPT_CMD_SUCCESS;
+}
+
 /// Returns a reference to a variable of the specific instance ID.
 /// Returns 0 if an error occurs.
 ///
@@ -26185,6 +26725,7 @@ struct script_function buildin_func[] = {
 	BUILDIN_DEF(camerainfo,"iii?"),
 
 	BUILDIN_DEF(achievement_condition,"i"),
+	BUILDIN_DEF(achievement_condition_arg,"i"),
 	BUILDIN_DEF(getinstancevar,"ri"),
 	BUILDIN_DEF2_DEPRECATED(getinstancevar, "getvariableofinstance","ri", "2021-12-13"),
 	BUILDIN_DEF(convertpcinfo,"vi"),
@@ -254,12 +254,15 @@ typedef enum c_op {
 	C_SUB_PRE, // --a
 } c_op;
 
+struct script_slots;
+
 /**
  * Generic reg database abstraction to be used with various types of regs/script variables.
  */
 struct reg_db {
 	struct DBMap *vars;
 	struct DBMap *arrays;
+	struct script_slots *slots; ///< '.@' integer variables (not array members), scopes only
 };
 
 struct script_retinfo {
@@ -2084,11 +2087,15 @@ extern struct eri *st_ers;
 extern struct eri *stack_ers;
 
 const char* skip_space(const char* p);
+const char* skip_space_quiet(const char* p);
 void script_error(const char* src, const char* file, int start_line, const char* error_msg, const char* error_pos);
 void script_warning(const char* src, const char* file, int start_line, const char* error_msg, const char* error_pos);
 
 bool is_number(const char *p);
 struct script_code* parse_script(const char* src,const char* file,int line,int options);
+struct script_code* parse_script_cached(const char* src, size_t len, const char* file, int line, int options);
+void script_cache_begin(void);
+void script_cache_end(void);
 void run_script(struct script_code *rootscript,int pos,int rid,int oid);
 
 bool set_reg_num(struct script_state* st, struct map_session_data* sd, int64 num, const char* name, const int64 value, struct reg_db *ref);
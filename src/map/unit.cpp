@@ -16,6 +16,7 @@
 #include "../common/timer.hpp"
 
 #include "achievement.hpp"
+#include "autoattack.hpp"
 #include "battle.hpp"
 #include "battleground.hpp"
 #include "channel.hpp"
@@ -3378,6 +3379,7 @@ int unit_free(struct block_list *bl, clr_type clrtype)
 				pc_setrestartvalue(sd,2);
 
 			pc_delinvincibletimer(sd);
+			autoattack_free(sd);
 
 			pc_delautobonus(*sd, sd->autobonus, false);
 			pc_delautobonus(*sd, sd->autobonus2, false);
@@ -0,0 +1,278 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+#include <chrono>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../common/cbasetypes.hpp"
+#include "../common/core.hpp"
+#include "../common/showmsg.hpp"
+#include "../common/timer.hpp"
+
+// A recorded timer operation, see timer_trace_open
+struct trace_op {
+	char type;      // A(dd), D(elete), S(ettick), T(ick)
+	int tid;
+	t_tick tick;
+	int interval;
+};
+
+std::string trace_file;
+int synthetic_timers = 0;
+int rounds = 1;
+
+std::vector<trace_op> trace;
+std::vector<int> trace_tid_to_replay; // trace tid -> replay tid
+std::vector<int> replay_tid_to_trace; // replay tid -> trace tid
+std::vector<bool> trace_tid_alive;
+uint64 expired = 0;
+t_tick trace_start = 0; // smallest tick of the trace
+
+static void map_tid(std::vector<int>& v, int from, int to)
+{
+	if( from >= (int)v.size() )
+		v.resize(from + 1, INVALID_TIMER);
+	v[from] = to;
+}
+
+static bool is_alive(int tid)
+{
+	return tid >= 0 && tid < (int)trace_tid_alive.size() && trace_tid_alive[tid];
+}
+
+TIMER_FUNC(bench_timer)
+{
+	int trace_tid = replay_tid_to_trace[tid];
+
+	expired++;
+	// single-use timers are gone after this, drop later delete/settick ops on them
+	if( get_timer(tid)->type & TIMER_ONCE_AUTODEL )
+		trace_tid_alive[trace_tid] = false;
+	return 0;
+}
+
+// Reads a trace written by a server started with --timer-trace
+bool load_trace(const char* filename)
+{
+	FILE* fp = fopen(filename, "r");
+	char line[256];
+
+	if( fp == NULL ) {
+		ShowError("Failed to open trace '%s'.\n", filename);
+		return false;
+	}
+
+	while( fgets(line, sizeof(line), fp) ) {
+		trace_op op = {};
+		int64 tick = 0;
+
+		op.type = line[0];
+		switch( op.type ) {
+			case 'A':
+				if( sscanf(line + 1, "%d %" SCNd64 " %d", &op.tid, &tick, &op.interval) != 3 )
+					continue;
+				break;
+			case 'D':
+				if( sscanf(line + 1, "%d", &op.tid) != 1 )
+					continue;
+				break;
+			case 'S':
+				if( sscanf(line + 1, "%d %" SCNd64, &op.tid, &tick) != 2 )
+					continue;
+				break;
+			case 'T':
+				if( sscanf(line + 1, "%" SCNd64, &tick) != 1 )
+					continue;
+				break;
+			default:
+				continue;
+		}
+		op.tick = (t_tick)tick;
+		trace.push_back(op);
+	}
+
+	fclose(fp);
+	return true;
+}
+
+// Builds a load similar to a busy map-server: many short single-use timers,
+// a share of them cancelled or rescheduled, and a set of long-running intervals.
+void build_synthetic_trace(int count)
+{
+	t_tick now = 0;
+	int next_tid = 0;
+	std::vector<int> live;
+
+	srand(1);
+	for( int i = 0; i < count / 10; i++ ) {
+		trace.push_back({ 'A', next_tid++, now + rand() % 1000, 100 + rand() % 900 });
+	}
+	for( int i = 0; i < count; i++ ) {
+		int tid = next_tid++;
+
+		trace.push_back({ 'A', tid, now + 20 + rand() % 2000, 0 });
+		live.push_back(tid);
+
+		if( live.size() > 64 && rand() % 4 == 0 ) {
+			size_t idx = rand() % live.size();
+
+			if( rand() % 2 )
+				trace.push_back({ 'D', live[idx], 0, 0 });
+			else
+				trace.push_back({ 'S', live[idx], now + rand() % 5000, 0 });
+			live[idx] = live.back();
+			live.pop_back();
+		}
+		if( i % 50 == 0 ) {
+			now += 20;
+			trace.push_back({ 'T', 0, now, 0 });
+		}
+	}
+	for( int i = 0; i < 6000 / 20; i++ ) {
+		now += 20;
+		trace.push_back({ 'T', 0, now, 0 });
+	}
+}
+
+// Replays the trace against a backend, returns the elapsed time in microseconds
+int64 replay(enum e_timer_backend backend)
+{
+	t_tick offset;
+
+	timer_init();
+	add_timer_func_list(bench_timer, "bench_timer");
+	timer_set_backend(backend);
+
+	trace_tid_to_replay.clear();
+	replay_tid_to_trace.clear();
+	trace_tid_alive.clear();
+	expired = 0;
+
+	// replay at the current time, no tick may be older than the wheel cursor
+	offset = gettick_nocache() - trace_start;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for( const trace_op& op : trace ) {
+		switch( op.type ) {
+			case 'A': {
+				int tid;
+
+				if( op.interval > 0 )
+					tid = add_timer_interval(op.tick + offset, bench_timer, 0, 0, op.interval);
+				else
+					tid = add_timer(op.tick + offset, bench_timer, 0, 0);
+				map_tid(trace_tid_to_replay, op.tid, tid);
+				map_tid(replay_tid_to_trace, tid, op.tid);
+				if( op.tid >= (int)trace_tid_alive.size() )
+					trace_tid_alive.resize(op.tid + 1, false);
+				trace_tid_alive[op.tid] = true;
+				break;
+			}
+			case 'D':
+				if( is_alive(op.tid) ) {
+					delete_timer(trace_tid_to_replay[op.tid], bench_timer);
+					trace_tid_alive[op.tid] = false;
+				}
+				break;
+			case 'S':
+				if( is_alive(op.tid) )
+					sett_tickimer(trace_tid_to_replay[op.tid], op.tick + offset);
+				break;
+			case 'T':
+				do_timer(op.tick + offset);
+				break;
+		}
+	}
+
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+	timer_final();
+
+	return elapsed.count();
+}
+
+void display_helpscreen(bool do_exit)
+{
+	ShowInfo("Usage: %s [options]\n", SERVER_NAME);
+	ShowInfo("\n");
+	ShowInfo("Options:\n");
+	ShowInfo("  -trace <file>\t\tReplays a trace recorded with --timer-trace.\n");
+	ShowInfo("  -synthetic <count>\tReplays a generated load of <count> timers instead.\n");
+	ShowInfo("  -rounds <count>\tNumber of replays per backend (default 1).\n");
+	if( do_exit )
+		exit(EXIT_SUCCESS);
+}
+
+void process_args(int argc, char *argv[])
+{
+	for( int i = 1; i < argc; i++ ) {
+		if( strcmp(argv[i], "-trace") == 0 ) {
+			if( ++i < argc )
+				trace_file = argv[i];
+		} else if( strcmp(argv[i], "-synthetic") == 0 ) {
+			if( ++i < argc )
+				synthetic_timers = atoi(argv[i]);
+		} else if( strcmp(argv[i], "-rounds") == 0 ) {
+			if( ++i < argc )
+				rounds = max(atoi(argv[i]), 1);
+		} else if( strcmp(argv[i], "-help") == 0 || strcmp(argv[i], "--help") == 0 ) {
+			display_helpscreen(true);
+		}
+	}
+}
+
+int do_init(int argc, char** argv)
+{
+	process_args(argc, argv);
+
+	if( !trace_file.empty() ) {
+		if( !load_trace(trace_file.c_str()) )
+			return 1;
+	} else if( synthetic_timers > 0 )
+		build_synthetic_trace(synthetic_timers);
+	else
+		display_helpscreen(true);
+
+	bool first = true;
+
+	for( const trace_op& op : trace ) {
+		if( op.type != 'D' && (first || op.tick < trace_start) ) {
+			trace_start = op.tick;
+			first = false;
+		}
+	}
+
+	ShowStatus("Replaying %" PRIuPTR " timer operations, %d round(s) per backend.\n", trace.size(), rounds);
+
+	const struct {
+		enum e_timer_backend backend;
+		const char* name;
+	} backends[] = {
+		{ TIMER_BACKEND_HEAP, "heap" },
+		{ TIMER_BACKEND_WHEEL, "wheel" },
+	};
+
+	for( const auto& it : backends ) {
+		int64 best = -1;
+
+		for( int i = 0; i < rounds; i++ ) {
+			int64 elapsed = replay(it.backend);
+
+			if( best < 0 || elapsed < best )
+				best = elapsed;
+		}
+		ShowInfo("%-6s: %" PRId64 " us, %" PRIu64 " expirations\n", it.name, best, expired);
+	}
+
+	return 0;
+}
+
+void do_final(void)
+{
+}